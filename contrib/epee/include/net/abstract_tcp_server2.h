@@ -113,7 +113,8 @@ class connection
   private:
 	//----------------- i_service_endpoint ---------------------
 	virtual bool do_send(const void *ptr, size_t cb);		///< (see do_send from i_service_endpoint)
-	virtual bool do_send_chunk(const void *ptr, size_t cb); ///< will send (or queue) a part of data
+	virtual bool do_send(const shared_buffer &message);		///< queues slices of message, no copy
+	virtual bool do_send_chunk(const shared_buffer &chunk); ///< will send (or queue) a part of data
 	virtual bool close();
 	virtual bool call_run_once_service_io();
 	virtual bool request_callback();
@@ -390,6 +390,17 @@ bool connection<t_protocol_handler>::call_run_once_service_io()
 //---------------------------------------------------------------------------------
 template <class t_protocol_handler>
 bool connection<t_protocol_handler>::do_send(const void *ptr, size_t cb)
+{
+	GULPS_TRY_ENTRY();
+	if(m_was_shutdown)
+		return false;
+	// copied once, the chunks queued below are slices of this buffer
+	return do_send(shared_buffer(std::string((const char *)ptr, cb)));
+	GULPS_CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send", false);
+}
+//---------------------------------------------------------------------------------
+template <class t_protocol_handler>
+bool connection<t_protocol_handler>::do_send(const shared_buffer &message)
 {
 	GULPS_TRY_ENTRY();
 
@@ -399,7 +410,9 @@ bool connection<t_protocol_handler>::do_send(const void *ptr, size_t cb)
 		return false;
 	if(m_was_shutdown)
 		return false;
-	// TODO avoid copy
+
+	const void *ptr = message.data();
+	const size_t cb = message.size();
 
 	const double factor = 32;			 // TODO config
 	typedef long long signed int t_safe; // my t_size to avoid any overunderflow in arithmetic
@@ -439,14 +452,12 @@ bool connection<t_protocol_handler>::do_send(const void *ptr, size_t cb)
 				GULPS_CHECK_AND_ASSERT_MES(len > 0, false, "len not strictly positive");										// (redundant)
 				GULPS_CHECK_AND_ASSERT_MES(len_unsigned < std::numeric_limits<size_t>::max(), false, "Invalid len_unsigned"); // yeap we want strong < then max size, to be sure
 
-				void *chunk_start = ((char *)ptr) + pos;
-				GULPSF_LOG_L1("chunk_start={} ptr={} pos={}", chunk_start , ptr , pos);
-				GULPS_CHECK_AND_ASSERT_MES(chunk_start >= ptr, false, "Pointer wraparound"); // not wrapped around address?
-				//std::memcpy( (void*)buf, chunk_start, len);
+				shared_buffer chunk = message.get_slice(pos, len);
+				GULPSF_LOG_L1("chunk_start={} ptr={} pos={}", (const void *)chunk.data() , ptr , pos);
 
 				GULPSF_LOG_L1("part of {}: pos={} len={}", lenall , pos , len);
 
-				bool ok = do_send_chunk(chunk_start, len); // <====== ***
+				bool ok = do_send_chunk(chunk); // <====== ***
 
 				all_ok = all_ok && ok;
 				if(!all_ok)
@@ -469,8 +480,8 @@ bool connection<t_protocol_handler>::do_send(const void *ptr, size_t cb)
 		}				   // LOCK: chunking
 	}					   // a big block (to be chunked) - all chunks
 	else
-	{								   // small block
-		return do_send_chunk(ptr, cb); // just send as 1 big chunk
+	{								  // small block
+		return do_send_chunk(message); // just send as 1 big chunk
 	}
 
 	GULPS_CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send", false);
@@ -478,9 +489,11 @@ bool connection<t_protocol_handler>::do_send(const void *ptr, size_t cb)
 
 //---------------------------------------------------------------------------------
 template <class t_protocol_handler>
-bool connection<t_protocol_handler>::do_send_chunk(const void *ptr, size_t cb)
+bool connection<t_protocol_handler>::do_send_chunk(const shared_buffer &chunk)
 {
 	GULPS_TRY_ENTRY();
+	const void *ptr = chunk.data();
+	const size_t cb = chunk.size();
 	// Use safe_shared_from_this, because of this is public method and it can be called on the object being deleted
 	auto self = safe_shared_from_this();
 	if(!self)
@@ -530,8 +543,7 @@ bool connection<t_protocol_handler>::do_send_chunk(const void *ptr, size_t cb)
 		}
 	}
 
-	m_send_que.resize(m_send_que.size() + 1);
-	m_send_que.back().assign((const char *)ptr, cb);
+	m_send_que.push_back(chunk);
 
 	if(m_send_que.size() > 1)
 	{ // active operation should be in progress, nothing to do, just wait last operation callback
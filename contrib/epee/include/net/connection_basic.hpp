@@ -93,7 +93,7 @@ class connection_basic
 	volatile uint32_t m_want_close_connection;
 	std::atomic<bool> m_was_shutdown;
 	critical_section m_send_que_lock;
-	std::list<std::string> m_send_que;
+	std::list<shared_buffer> m_send_que;
 	volatile bool m_is_multithreaded;
 	double m_start_time;
 	/// Strand to ensure the connection's handlers are not called concurrently.
@@ -119,6 +119,50 @@
 		GULPSF_LOG_L1("{}() processed with {}/{}/{}ms", s_pattern, ticks1 - ticks, ticks2 - ticks1, ticks3 - ticks2); \
 	}
 
+// Like MAP_URI_AUTO_BIN2, but the callback writes the serialized response body itself,
+// which lets it serve a body that was serialized earlier.
+#define MAP_URI_AUTO_BIN2_RAW(s_pattern, callback_f, command_type)                                                               \
+	else if(query_info.m_URI == s_pattern)                                                                                       \
+	{                                                                                                                            \
+		GULPS_CAT_MAJOR("epee_http_serv");                                                                                       \
+		handled = true;                                                                                                          \
+		uint64_t ticks = misc_utils::get_tick_count();                                                                           \
+		boost::value_initialized<command_type::request> req;                                                                     \
+		bool parse_res = epee::serialization::load_t_from_binary(static_cast<command_type::request &>(req), query_info.m_body);  \
+		GULPS_CHECK_AND_ASSERT_MES(parse_res, false, "Failed to parse bin body data, body size=" , query_info.m_body.size());    \
+		uint64_t ticks1 = misc_utils::get_tick_count();                                                                          \
+		if(!callback_f(static_cast<command_type::request &>(req), response_info.m_body))                                         \
+		{                                                                                                                        \
+			GULPSF_ERROR("Failed to {}()", #callback_f);                                                                         \
+			response_info.m_response_code = 500;                                                                                 \
+			response_info.m_response_comment = "Internal Server Error";                                                          \
+			return true;                                                                                                         \
+		}                                                                                                                        \
+		uint64_t ticks2 = misc_utils::get_tick_count();                                                                          \
+		response_info.m_mime_tipe = " application/octet-stream";                                                                 \
+		response_info.m_header_info.m_content_type = " application/octet-stream";                                                \
+		GULPSF_LOG_L1("{}() processed with {}/{}ms", s_pattern, ticks1 - ticks, ticks2 - ticks1);                                \
+	}
+
+#define MAP_URI_TEXT2_IF(s_pattern, callback_f, cond)                                                                            \
+	else if((query_info.m_URI == s_pattern) && (cond))                                                                           \
+	{                                                                                                                            \
+		GULPS_CAT_MAJOR("epee_http_serv");                                                                                       \
+		handled = true;                                                                                                          \
+		uint64_t ticks = misc_utils::get_tick_count();                                                                           \
+		if(!callback_f(response_info.m_body))                                                                                    \
+		{                                                                                                                        \
+			GULPSF_ERROR("Failed to {}()", #callback_f);                                                                         \
+			response_info.m_response_code = 500;                                                                                 \
+			response_info.m_response_comment = "Internal Server Error";                                                          \
+			return true;                                                                                                         \
+		}                                                                                                                        \
+		uint64_t ticks1 = misc_utils::get_tick_count();                                                                          \
+		response_info.m_mime_tipe = "text/plain; version=0.0.4";                                                                 \
+		response_info.m_header_info.m_content_type = " text/plain; version=0.0.4";                                               \
+		GULPSF_LOG_L1("{}() processed with {}ms", s_pattern, ticks1 - ticks);                                                    \
+	}
+
 #define CHAIN_URI_MAP2(callback)                             \
 	else                                                     \
 	{                                                        \
@@ -31,7 +31,9 @@
 #include <boost/unordered_map.hpp>
 #include <boost/uuid/uuid_generators.hpp>
 
+#include <algorithm>
 #include <atomic>
+#include <vector>
 
 #include "levin_base.h"
 #include "misc_language.h"
@@ -49,6 +51,14 @@
 #define MIN_BYTES_WANTED 512
 #endif
 
+#ifndef LEVIN_POOLED_BUFFER_MAX_SIZE
+#define LEVIN_POOLED_BUFFER_MAX_SIZE (64 * 1024)
+#endif
+
+#ifndef LEVIN_POOLED_BUFFERS_MAX_COUNT
+#define LEVIN_POOLED_BUFFERS_MAX_COUNT 64
+#endif
+
 namespace epee
 {
 namespace levin
@@ -60,6 +70,25 @@ namespace levin
 template <class t_connection_context>
 class async_protocol_handler;
 
+//Serializes a notification once, the result can be sent to any number of connections
+inline net_utils::shared_buffer make_notify_message(int command, const std::string &in_buff)
+{
+	bucket_head2 head = {0};
+	head.m_signature = LEVIN_SIGNATURE;
+	head.m_have_to_return_data = false;
+	head.m_cb = in_buff.size();
+
+	head.m_command = command;
+	head.m_protocol_version = LEVIN_PROTOCOL_VER_1;
+	head.m_flags = LEVIN_PACKET_REQUEST;
+
+	std::string message;
+	message.reserve(sizeof(head) + in_buff.size());
+	message.append((const char *)&head, sizeof(head));
+	message.append(in_buff);
+	return net_utils::shared_buffer(std::move(message));
+}
+
 template <class t_connection_context>
 class async_protocol_handler_config
 {
@@ -81,6 +110,13 @@ class async_protocol_handler_config
 
 	void delete_connections(size_t count, bool incoming);
 
+	//Bodies of small packets are recycled here instead of going back to the allocator
+	critical_section m_recv_buffers_lock;
+	std::vector<std::string> m_recv_buffers;
+
+	std::string get_recv_buffer(size_t size);
+	void put_recv_buffer(std::string &buff);
+
   public:
 	typedef t_connection_context connection_context;
 	uint64_t m_max_packet_size;
@@ -91,6 +127,7 @@ class async_protocol_handler_config
 	int invoke_async(int command, const std::string &in_buff, boost::uuids::uuid connection_id, const callback_t &cb, size_t timeout = LEVIN_DEFAULT_TIMEOUT_PRECONFIGURED);
 
 	int notify(int command, const std::string &in_buff, boost::uuids::uuid connection_id);
+	int send(const net_utils::shared_buffer &message, boost::uuids::uuid connection_id);
 	bool close(boost::uuids::uuid connection_id);
 	bool update_connection_context(const t_connection_context &contxt);
 	bool request_callback(boost::uuids::uuid connection_id);
@@ -145,7 +182,9 @@ class async_protocol_handler
 	config_type &m_config;
 	t_connection_context &m_connection_context;
 
-	std::string m_cache_in_buffer;
+	std::string m_cache_in_buffer; //partial header, never more than sizeof(bucket_head2)
+	std::string m_body_buffer;     //body of the current packet, grown as it arrives up to m_current_head.m_cb
+	std::atomic<uint64_t> m_recv_bytes;
 	stream_state m_state;
 
 	int32_t m_oponent_protocol_ver;
@@ -273,6 +312,7 @@ class async_protocol_handler
 		m_deletion_initiated = false;
 		m_protocol_released = false;
 		m_wait_count = 0;
+		m_recv_bytes = 0;
 		m_oponent_protocol_ver = 0;
 		m_connection_initialized = false;
 	}
@@ -366,26 +406,38 @@ class async_protocol_handler
 			return false;
 		}
 
-		if(m_cache_in_buffer.size() + cb > m_config.m_max_packet_size)
+		if(m_cache_in_buffer.size() + m_body_buffer.size() + cb > m_config.m_max_packet_size)
 		{
 			GULPS_WARN(m_connection_context , "Maximum packet size exceed!, m_max_packet_size = " , m_config.m_max_packet_size
-										  , ", packet received " , m_cache_in_buffer.size() + cb
+										  , ", packet received " , m_cache_in_buffer.size() + m_body_buffer.size() + cb
 										  , ", connection will be closed.");
 			return false;
 		}
 
-		m_cache_in_buffer.append((const char *)ptr, cb);
+		m_recv_bytes += cb;
 
+		const char *data = (const char *)ptr;
 		bool is_continue = true;
 		while(is_continue)
 		{
 			switch(m_state)
 			{
 			case stream_state_body:
-				if(m_cache_in_buffer.size() < m_current_head.m_cb)
+			{
+				//copy straight from the socket buffer into the body, leftovers belong to the next packet
+				size_t wanted = (size_t)m_current_head.m_cb - m_body_buffer.size();
+				size_t taken = std::min(wanted, cb);
+				//the header size is not trusted, memory is only committed for bytes that actually arrived
+				if(m_body_buffer.size() + taken > m_body_buffer.capacity())
+					m_body_buffer.reserve(std::min<size_t>(m_current_head.m_cb, std::max(m_body_buffer.size() + taken, 2 * m_body_buffer.capacity())));
+				m_body_buffer.append(data, taken);
+				data += taken;
+				cb -= taken;
+
+				if(m_body_buffer.size() < m_current_head.m_cb)
 				{
 					is_continue = false;
-					if(cb >= MIN_BYTES_WANTED)
+					if(taken >= MIN_BYTES_WANTED)
 					{
 						CRITICAL_REGION_LOCAL(m_invoke_response_handlers_lock);
 						if(!m_invoke_response_handlers.empty())
@@ -393,20 +445,14 @@ class async_protocol_handler
 							//async call scenario
 							boost::shared_ptr<invoke_response_handler_base> response_handler = m_invoke_response_handlers.front();
 							response_handler->reset_timer();
-							GULPS_LOG_L1(m_connection_context , "LEVIN_PACKET partial msg received. len=" , cb);
+							GULPS_LOG_L1(m_connection_context , "LEVIN_PACKET partial msg received. len=" , taken);
 						}
 					}
 					break;
 				}
 				{
 					std::string buff_to_invoke;
-					if(m_cache_in_buffer.size() == m_current_head.m_cb)
-						buff_to_invoke.swap(m_cache_in_buffer);
-					else
-					{
-						buff_to_invoke.assign(m_cache_in_buffer, 0, (std::string::size_type)m_current_head.m_cb);
-						m_cache_in_buffer.erase(0, (std::string::size_type)m_current_head.m_cb);
-					}
+					buff_to_invoke.swap(m_body_buffer);
 
 					bool is_response = (m_oponent_protocol_ver == LEVIN_PROTOCOL_VER_1 && m_current_head.m_flags & LEVIN_PACKET_RESPONSE);
 
@@ -481,11 +527,18 @@ class async_protocol_handler
 						else
 							m_config.m_pcommands_handler->notify(m_current_head.m_command, buff_to_invoke, m_connection_context);
 					}
+					m_config.put_recv_buffer(buff_to_invoke);
 				}
 				m_state = stream_state_head;
-				break;
+			}
+			break;
 			case stream_state_head:
 			{
+				size_t taken = std::min(sizeof(bucket_head2) - m_cache_in_buffer.size(), cb);
+				m_cache_in_buffer.append(data, taken);
+				data += taken;
+				cb -= taken;
+
 				if(m_cache_in_buffer.size() < sizeof(bucket_head2))
 				{
 					if(m_cache_in_buffer.size() >= sizeof(uint64_t) && *((uint64_t *)m_cache_in_buffer.data()) != LEVIN_SIGNATURE)
@@ -505,7 +558,7 @@ class async_protocol_handler
 				}
 				m_current_head = *phead;
 
-				m_cache_in_buffer.erase(0, sizeof(bucket_head2));
+				m_cache_in_buffer.clear();
 				m_state = stream_state_body;
 				m_oponent_protocol_ver = m_current_head.m_protocol_version;
 				if(m_current_head.m_cb > m_config.m_max_packet_size)
@@ -515,6 +568,7 @@ class async_protocol_handler
 																										   , ", connection will be closed.");
 					return false;
 				}
+				m_body_buffer = m_config.get_recv_buffer((size_t)m_current_head.m_cb);
 			}
 			break;
 			default:
@@ -651,13 +705,13 @@ class async_protocol_handler
 									, ", ver=" , head.m_protocol_version);
 
 		uint64_t ticks_start = misc_utils::get_tick_count();
-		size_t prev_size = 0;
+		uint64_t prev_size = m_recv_bytes;
 
 		while(!boost::interprocess::ipcdetail::atomic_read32(&m_invoke_buf_ready) && !m_deletion_initiated && !m_protocol_released)
 		{
-			if(m_cache_in_buffer.size() - prev_size >= MIN_BYTES_WANTED)
+			if(m_recv_bytes - prev_size >= MIN_BYTES_WANTED)
 			{
-				prev_size = m_cache_in_buffer.size();
+				prev_size = m_recv_bytes;
 				ticks_start = misc_utils::get_tick_count();
 			}
 			if(misc_utils::get_tick_count() - ticks_start > m_config.m_invoke_timeout)
@@ -682,6 +736,12 @@ class async_protocol_handler
 	}
 
 	int notify(int command, const std::string &in_buff)
+	{
+		return send(make_notify_message(command, in_buff));
+	}
+	//------------------------------------------------------------------------------------------
+	/// Queues an already framed levin packet, the buffer is shared and not copied
+	int send(const net_utils::shared_buffer &message)
 	{
 		misc_utils::auto_scope_leave_caller scope_exit_handler = misc_utils::create_scope_leave_handler(
 			boost::bind(&async_protocol_handler::finish_outer_call, this));
@@ -694,22 +754,11 @@ class async_protocol_handler
 		if(m_deletion_initiated)
 			return LEVIN_ERROR_CONNECTION_DESTROYED;
 
-		bucket_head2 head = {0};
-		head.m_signature = LEVIN_SIGNATURE;
-		head.m_have_to_return_data = false;
-		head.m_cb = in_buff.size();
+		GULPS_CHECK_AND_ASSERT_MES(message.size() >= sizeof(bucket_head2), -1, "Levin message without a header");
+		const bucket_head2 &head = *(const bucket_head2 *)message.data();
 
-		head.m_command = command;
-		head.m_protocol_version = LEVIN_PROTOCOL_VER_1;
-		head.m_flags = LEVIN_PACKET_REQUEST;
 		CRITICAL_REGION_BEGIN(m_send_lock);
-		if(!m_pservice_endpoint->do_send(&head, sizeof(head)))
-		{
-			GULPS_LOG_ERROR(m_connection_context, "Failed to do_send()");
-			return -1;
-		}
-
-		if(!m_pservice_endpoint->do_send(in_buff.data(), (int)in_buff.size()))
+		if(!m_pservice_endpoint->do_send(message))
 		{
 			GULPS_LOG_ERROR(m_connection_context, "Failed to do_send()");
 			return -1;
@@ -861,6 +910,37 @@ size_t async_protocol_handler_config<t_connection_context>::get_connections_coun
 }
 //------------------------------------------------------------------------------------------
 template <class t_connection_context>
+std::string async_protocol_handler_config<t_connection_context>::get_recv_buffer(size_t size)
+{
+	std::string buff;
+	if(size <= LEVIN_POOLED_BUFFER_MAX_SIZE)
+	{
+		CRITICAL_REGION_LOCAL(m_recv_buffers_lock);
+		if(!m_recv_buffers.empty())
+		{
+			buff.swap(m_recv_buffers.back());
+			m_recv_buffers.pop_back();
+		}
+	}
+	//a small body fits in one go, larger ones start at the pooled size and double as they arrive
+	buff.reserve(std::min<size_t>(size, LEVIN_POOLED_BUFFER_MAX_SIZE));
+	return buff;
+}
+//------------------------------------------------------------------------------------------
+template <class t_connection_context>
+void async_protocol_handler_config<t_connection_context>::put_recv_buffer(std::string &buff)
+{
+	if(buff.capacity() > LEVIN_POOLED_BUFFER_MAX_SIZE)
+		return;
+	CRITICAL_REGION_LOCAL(m_recv_buffers_lock);
+	if(m_recv_buffers.size() >= LEVIN_POOLED_BUFFERS_MAX_COUNT)
+		return;
+	buff.clear();
+	m_recv_buffers.emplace_back();
+	m_recv_buffers.back().swap(buff);
+}
+//------------------------------------------------------------------------------------------
+template <class t_connection_context>
 void async_protocol_handler_config<t_connection_context>::set_handler(levin_commands_handler<t_connection_context> *handler, void (*destroy)(levin_commands_handler<t_connection_context> *))
 {
 	if(m_pcommands_handler && m_pcommands_handler_destroy)
@@ -878,6 +958,14 @@ int async_protocol_handler_config<t_connection_context>::notify(int command, con
 }
 //------------------------------------------------------------------------------------------
 template <class t_connection_context>
+int async_protocol_handler_config<t_connection_context>::send(const net_utils::shared_buffer &message, boost::uuids::uuid connection_id)
+{
+	async_protocol_handler<t_connection_context> *aph;
+	int r = find_and_lock_connection(connection_id, aph);
+	return LEVIN_OK == r ? aph->send(message) : r;
+}
+//------------------------------------------------------------------------------------------
+template <class t_connection_context>
 bool async_protocol_handler_config<t_connection_context>::close(boost::uuids::uuid connection_id)
 {
 	CRITICAL_REGION_LOCAL(m_connects_lock);
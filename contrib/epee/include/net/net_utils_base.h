@@ -27,6 +27,7 @@
 #ifndef _NET_UTILS_BASE_H_
 #define _NET_UTILS_BASE_H_
 
+#include "net/shared_buffer.h"
 #include "serialization/keyvalue_serialization.h"
 #include <boost/asio/io_service.hpp>
 #include <boost/uuid/uuid.hpp>
@@ -317,6 +318,8 @@ struct connection_context_base
 struct i_service_endpoint
 {
 	virtual bool do_send(const void *ptr, size_t cb) = 0;
+	//queue a buffer that may be shared with other connections, endpoints without a send queue just copy it
+	virtual bool do_send(const shared_buffer &message) { return do_send(message.data(), message.size()); }
 	virtual bool close() = 0;
 	virtual bool call_run_once_service_io() = 0;
 	virtual bool request_callback() = 0;
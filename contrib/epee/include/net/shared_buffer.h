@@ -0,0 +1,90 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace epee
+{
+namespace net_utils
+{
+/*!
+ * \brief Immutable, reference counted byte buffer.
+ *
+ * Copies of a shared_buffer and slices taken from it share one storage, so a
+ * message serialized once can sit in the send queues of many connections.
+ */
+class shared_buffer
+{
+  public:
+	shared_buffer() : m_offset(0), m_size(0) {}
+
+	explicit shared_buffer(std::string &&data) :
+		m_storage(std::make_shared<const std::string>(std::move(data))), m_offset(0), m_size(m_storage->size()) {}
+
+	const char *data() const { return m_storage ? m_storage->data() + m_offset : nullptr; }
+	size_t size() const { return m_size; }
+	bool empty() const { return m_size == 0; }
+
+	/*!
+	 * \brief View of `size` bytes starting at `offset`, sharing this buffer's storage
+	 * \throw std::out_of_range if the range is not inside this buffer
+	 */
+	shared_buffer get_slice(size_t offset, size_t size) const
+	{
+		if(offset > m_size || size > m_size - offset)
+			throw std::out_of_range("shared_buffer slice out of range");
+		shared_buffer slice;
+		slice.m_storage = m_storage;
+		slice.m_offset = m_offset + offset;
+		slice.m_size = size;
+		return slice;
+	}
+
+  private:
+	std::shared_ptr<const std::string> m_storage;
+	size_t m_offset;
+	size_t m_size;
+};
+}
+}
@@ -33,6 +33,7 @@
 #include "portable_storage_to_bin.h"
 #include "portable_storage_to_json.h"
 #include "portable_storage_val_converters.h"
+#include "span.h"
 
 #include "common/gulps.hpp"
 
@@ -82,6 +83,7 @@ class portable_storage
 	//-------------------------------------------------------------------------------
 	bool store_to_binary(binarybuffer &target);
 	bool load_from_binary(const binarybuffer &target);
+	bool load_from_binary(const epee::span<const uint8_t> source);
 	template <class trace_policy>
 	bool dump_as_xml(std::string &targetObj, const std::string &root_name = "");
 	bool dump_as_json(std::string &targetObj, size_t indent = 0, bool insert_newlines = true);
@@ -143,6 +145,10 @@ inline bool portable_storage::store_to_binary(binarybuffer &target)
 	GULPS_CATCH_ENTRY("portable_storage::store_to_binary", false)
 }
 inline bool portable_storage::load_from_binary(const binarybuffer &source)
+{
+	return load_from_binary(epee::to_byte_span(epee::to_span(source)));
+}
+inline bool portable_storage::load_from_binary(const epee::span<const uint8_t> source)
 {
 	m_root.m_entries.clear();
 	if(source.size() < sizeof(storage_block_header))
@@ -55,6 +55,7 @@
 #include "cryptonote_basic/hardfork.h"
 #include <boost/program_options.hpp>
 #include <exception>
+#include <iosfwd>
 #include <list>
 #include <string>
 
@@ -1052,6 +1053,27 @@ class BlockchainDB
    */
 	virtual void pop_block(block &blk, std::vector<transaction> &txs);
 
+	/**
+   * @brief stores the proof of work hash of a verified block
+   *
+   * The proof of work hash only depends on the block blob, so an entry stays
+   * valid after its block is popped and can be used if the block is added again.
+   *
+   * @param blk_hash the block's hash
+   * @param pow_hash the block's proof of work hash
+   */
+	virtual void add_block_pow_hash(const crypto::hash &blk_hash, const crypto::hash &pow_hash) = 0;
+
+	/**
+   * @brief fetch a proof of work hash stored with add_block_pow_hash
+   *
+   * @param blk_hash the block's hash
+   * @param pow_hash return-by-reference the block's proof of work hash
+   *
+   * @return true if the hash was found, otherwise false
+   */
+	virtual bool get_block_pow_hash(const crypto::hash &blk_hash, crypto::hash &pow_hash) const = 0;
+
 	/**
    * @brief check if a transaction with a given hash exists
    *
@@ -1483,6 +1505,29 @@ class BlockchainDB
    */
 	virtual void drop_hard_fork_info() = 0;
 
+	/**
+   * @brief write the chain tables to a snapshot
+   *
+   * The snapshot holds the raw records of every table derived from the
+   * blocks, in key order, split into checksummed chunks. It is only meant
+   * to be loaded back by the same backend on the same architecture.
+   *
+   * @param out the stream to write to
+   */
+	virtual void export_snapshot(std::ostream &out) const = 0;
+
+	/**
+   * @brief load a snapshot written by export_snapshot into an empty database
+   *
+   * If the snapshot fails its checksums part way, the tables are left
+   * partially filled and the database has to be deleted.
+   *
+   * @param in the stream to read from
+   *
+   * @return the height of the imported chain
+   */
+	virtual uint64_t import_snapshot(std::istream &in) = 0;
+
 	/**
    * @brief return a histogram of outputs on the blockchain
    *
@@ -45,6 +45,7 @@
 
 #include <boost/current_function.hpp>
 #include <boost/filesystem.hpp>
+#include <algorithm>
 #include <cstring> // memcpy
 #include <memory>  // std::unique_ptr
 #include <random>
@@ -66,7 +67,7 @@ using namespace crypto;
 
 // Increase when the DB changes in a non backward compatible way, and there
 // is no automatic conversion, so that a full resync is needed.
-#define VERSION 1
+#define VERSION 2
 
 namespace
 {
@@ -189,6 +190,10 @@ int compare_string(const MDB_val *a, const MDB_val *b)
  * txpool_meta      txn hash     txn metadata
  * txpool_blob      txn hash     txn blob
  *
+ * pow_hashes       block hash   proof of work hash
+ *
+ * block_rct_outs   block ID     RCT outputs in the chain up to and including the block
+ *
  * Note: where the data items are of uniform size, DUPFIXED tables have
  * been used to save space. In most of these cases, a dummy "zerokval"
  * key is used when accessing the table; the Key listed above will be
@@ -217,9 +222,86 @@ const char *const LMDB_HF_VERSIONS = "hf_versions";
 
 const char *const LMDB_PROPERTIES = "properties";
 
+const char *const LMDB_POW_HASHES = "pow_hashes";
+
+const char *const LMDB_BLOCK_RCT_OUTS = "block_rct_outs";
+
 const char zerokey[8] = {0};
 const MDB_val zerokval = {sizeof(zerokey), (void *)zerokey};
 
+/* Snapshot layout: magic, snapshot version, db version and height, the table manifest (a u8 count
+ * and the length prefixed names in load order), then for each table a length prefixed name
+ * followed by chunks of [u32 key size][key][u32 value size][value] records. Every
+ * chunk is preceded by its record count and byte size and followed by the hash of its records.
+ * A chunk of 0 records ends a table, a name of length 0 ends the snapshot.
+ * Records are raw LMDB keys and values, so a snapshot is tied to the db version and endianness.
+ * The chunk hashes catch corruption, they are not signed and do not protect against tampering.
+ */
+const char snapshot_magic[8] = {'R', 'Y', 'O', 'S', 'N', 'A', 'P', '\0'};
+const uint32_t snapshot_version = 2;
+const size_t snapshot_chunk_size = 4 << 20;
+const size_t snapshot_chunks_per_txn = 16;
+
+template <typename T>
+inline void snapshot_write(std::ostream &out, const T &v)
+{
+	out.write(reinterpret_cast<const char *>(&v), sizeof(v));
+}
+
+template <typename T>
+inline bool snapshot_read(std::istream &in, T &v)
+{
+	return (bool)in.read(reinterpret_cast<char *>(&v), sizeof(v));
+}
+
+inline void snapshot_write_name(std::ostream &out, const char *name)
+{
+	const uint8_t name_size = strlen(name);
+	snapshot_write(out, name_size);
+	out.write(name, name_size);
+}
+
+inline bool snapshot_read_name(std::istream &in, std::string &name)
+{
+	uint8_t name_size;
+	if(!snapshot_read(in, name_size))
+		return false;
+	name.resize(name_size);
+	return name_size == 0 || (bool)in.read(&name[0], name_size);
+}
+
+inline void snapshot_append(std::string &chunk, const MDB_val &val)
+{
+	const uint32_t size = val.mv_size;
+	chunk.append(reinterpret_cast<const char *>(&size), sizeof(size));
+	chunk.append(static_cast<const char *>(val.mv_data), val.mv_size);
+}
+
+inline bool snapshot_next(const std::string &chunk, size_t &pos, MDB_val &val)
+{
+	uint32_t size;
+	if(chunk.size() - pos < sizeof(size))
+		return false;
+	memcpy(&size, chunk.data() + pos, sizeof(size));
+	pos += sizeof(size);
+	if(chunk.size() - pos < size)
+		return false;
+	val.mv_size = size;
+	val.mv_data = (void *)(chunk.data() + pos);
+	pos += size;
+	return true;
+}
+
+void snapshot_write_chunk(std::ostream &out, const std::string &chunk, uint32_t records)
+{
+	crypto::hash h;
+	crypto::cn_fast_hash(chunk.data(), chunk.size(), h);
+	snapshot_write(out, records);
+	snapshot_write(out, uint32_t(chunk.size()));
+	out.write(chunk.data(), chunk.size());
+	snapshot_write(out, h);
+}
+
 const std::string lmdb_error(const std::string &error_string, int mdb_res)
 {
 	const std::string full_string = error_string + mdb_strerror(mdb_res);
@@ -272,6 +354,12 @@ typedef struct mdb_block_info
 	crypto::hash bi_hash;
 } mdb_block_info;
 
+typedef struct mdb_block_rct_outs
+{
+	uint64_t bro_height;
+	uint64_t bro_cum_outs;
+} mdb_block_rct_outs;
+
 typedef struct blk_height
 {
 	crypto::hash bh_hash;
@@ -418,6 +506,19 @@ void mdb_txn_safe::allow_new_txns()
 	creation_gate.clear();
 }
 
+void mdb_txn_safe::increment_txns(int i)
+{
+	if(i > 0)
+	{
+		while(creation_gate.test_and_set())
+			;
+		num_active_txns += i;
+		creation_gate.clear();
+	}
+	else
+		num_active_txns -= -i;
+}
+
 void lmdb_resized(MDB_env *env)
 {
 	mdb_txn_safe::prevent_new_txns();
@@ -747,6 +848,14 @@ void BlockchainLMDB::add_block(const block &blk, const size_t &block_size, const
 	if(result)
 		throw0(DB_ERROR(lmdb_error("Failed to add block height by hash to db transaction: ", result).c_str()));
 
+	// the block's outputs are already in, and add_output only takes RCT ones
+	CURSOR(block_rct_outs)
+	mdb_block_rct_outs bro = {m_height, num_outputs()};
+	MDB_val_set(val_bro, bro);
+	result = mdb_cursor_put(m_cur_block_rct_outs, (MDB_val *)&zerokval, &val_bro, MDB_APPENDDUP);
+	if(result)
+		throw0(DB_ERROR(lmdb_error("Failed to add block rct output count to db transaction: ", result).c_str()));
+
 	m_cum_size += block_size;
 	m_cum_count++;
 }
@@ -766,6 +875,7 @@ void BlockchainLMDB::remove_block()
 	CURSOR(block_info)
 	CURSOR(block_heights)
 	CURSOR(blocks)
+	CURSOR(block_rct_outs)
 	MDB_val_copy<uint64_t> k(m_height - 1);
 	MDB_val h = k;
 	if((result = mdb_cursor_get(m_cur_block_info, (MDB_val *)&zerokval, &h, MDB_GET_BOTH)))
@@ -788,6 +898,12 @@ void BlockchainLMDB::remove_block()
 
 	if((result = mdb_cursor_del(m_cur_block_info, 0)))
 		throw1(DB_ERROR(lmdb_error("Failed to add removal of block info to db transaction: ", result).c_str()));
+
+	h = k;
+	if((result = mdb_cursor_get(m_cur_block_rct_outs, (MDB_val *)&zerokval, &h, MDB_GET_BOTH)))
+		throw1(DB_ERROR(lmdb_error("Failed to locate block rct output count for removal: ", result).c_str()));
+	if((result = mdb_cursor_del(m_cur_block_rct_outs, 0)))
+		throw1(DB_ERROR(lmdb_error("Failed to add removal of block rct output count to db transaction: ", result).c_str()));
 }
 
 uint64_t BlockchainLMDB::add_transaction_data(const crypto::hash &blk_hash, const transaction &tx, const crypto::hash &tx_hash)
@@ -1121,6 +1237,8 @@ BlockchainLMDB::BlockchainLMDB(bool batch_transactions) : BlockchainDB()
 	m_cum_count = 0;
 
 	m_hardfork = nullptr;
+	m_pow_hashes_open = false;
+	m_block_rct_outs_open = false;
 }
 
 void BlockchainLMDB::open(const std::string &filename, const int db_flags)
@@ -1245,16 +1363,42 @@ void BlockchainLMDB::open(const std::string &filename, const int db_flags)
 
 	lmdb_db_open(txn, LMDB_PROPERTIES, MDB_CREATE, m_properties, "Failed to open db handle for m_properties");
 
+	// added in version 2, a version 1 db opened read-only does not have it and is read the slow way
+	if(!(mdb_flags & MDB_RDONLY))
+	{
+		lmdb_db_open(txn, LMDB_BLOCK_RCT_OUTS, MDB_INTEGERKEY | MDB_CREATE | MDB_DUPSORT | MDB_DUPFIXED, m_block_rct_outs, "Failed to open db handle for m_block_rct_outs");
+		m_block_rct_outs_open = true;
+	}
+	else
+	{
+		m_block_rct_outs_open = mdb_dbi_open(txn, LMDB_BLOCK_RCT_OUTS, MDB_INTEGERKEY | MDB_DUPSORT | MDB_DUPFIXED, &m_block_rct_outs) == 0;
+	}
+
+	// optional cache of verified pow hashes, a db opened read-only may not have it yet
+	if(!(mdb_flags & MDB_RDONLY))
+	{
+		lmdb_db_open(txn, LMDB_POW_HASHES, MDB_CREATE, m_pow_hashes, "Failed to open db handle for m_pow_hashes");
+		m_pow_hashes_open = true;
+	}
+	else
+	{
+		m_pow_hashes_open = mdb_dbi_open(txn, LMDB_POW_HASHES, 0, &m_pow_hashes) == 0;
+	}
+
 	mdb_set_dupsort(txn, m_spent_keys, compare_hash32);
 	mdb_set_dupsort(txn, m_block_heights, compare_hash32);
 	mdb_set_dupsort(txn, m_tx_indices, compare_hash32);
 	mdb_set_dupsort(txn, m_output_amounts, compare_uint64);
 	mdb_set_dupsort(txn, m_output_txs, compare_uint64);
 	mdb_set_dupsort(txn, m_block_info, compare_uint64);
+	if(m_block_rct_outs_open)
+		mdb_set_dupsort(txn, m_block_rct_outs, compare_uint64);
 
 	mdb_set_compare(txn, m_txpool_meta, compare_hash32);
 	mdb_set_compare(txn, m_txpool_blob, compare_hash32);
 	mdb_set_compare(txn, m_properties, compare_string);
+	if(m_pow_hashes_open)
+		mdb_set_compare(txn, m_pow_hashes, compare_hash32);
 
 	if(!(mdb_flags & MDB_RDONLY))
 	{
@@ -1283,7 +1427,8 @@ void BlockchainLMDB::open(const std::string &filename, const int db_flags)
 			compatible = false;
 		}
 #if VERSION > 0
-		else if(*(const uint32_t *)v.mv_data < VERSION)
+		// a version 1 db opened read-only is usable as is, it only lacks block_rct_outs
+		else if(*(const uint32_t *)v.mv_data < VERSION && !(*(const uint32_t *)v.mv_data == 1 && (mdb_flags & MDB_RDONLY)))
 		{
 			// Note that there was a schema change within version 0 as well.
 			// See commit e5d2680094ee15889934fe28901e4e133cda56f2 2015/07/10
@@ -1407,6 +1552,10 @@ void BlockchainLMDB::reset()
 		throw0(DB_ERROR(lmdb_error("Failed to drop m_hf_versions: ", result).c_str()));
 	if(auto result = mdb_drop(txn, m_properties, 0))
 		throw0(DB_ERROR(lmdb_error("Failed to drop m_properties: ", result).c_str()));
+	if(auto result = mdb_drop(txn, m_pow_hashes, 0))
+		throw0(DB_ERROR(lmdb_error("Failed to drop m_pow_hashes: ", result).c_str()));
+	if(auto result = mdb_drop(txn, m_block_rct_outs, 0))
+		throw0(DB_ERROR(lmdb_error("Failed to drop m_block_rct_outs: ", result).c_str()));
 
 	// init with current version
 	MDB_val_copy<const char *> k("version");
@@ -2895,6 +3044,7 @@ bool BlockchainLMDB::block_rtxn_start(MDB_txn **mtxn, mdb_txn_cursors **mcur) co
 		m_tinfo.reset(tinfo);
 		memset(&tinfo->m_ti_rcursors, 0, sizeof(tinfo->m_ti_rcursors));
 		memset(&tinfo->m_ti_rflags, 0, sizeof(tinfo->m_ti_rflags));
+		tinfo->m_ti_counted = false;
 		if(auto mdb_res = lmdb_txn_begin(m_env, NULL, MDB_RDONLY, &tinfo->m_ti_rtxn))
 			throw0(DB_ERROR_TXN_START(lmdb_error("Failed to create a read transaction for the db: ", mdb_res).c_str()));
 		ret = true;
@@ -2920,6 +3070,19 @@ void BlockchainLMDB::block_rtxn_stop() const
 	GULPS_LOG_L3("BlockchainLMDB::", __func__);
 	mdb_txn_reset(m_tinfo->m_ti_rtxn);
 	memset(&m_tinfo->m_ti_rflags, 0, sizeof(m_tinfo->m_ti_rflags));
+	release_rtxn_count();
+}
+
+// A read txn held open across calls by block_txn_start(true) may outlive the
+// caller's locks, so it is counted as active to keep do_resize from changing
+// the map under it.
+void BlockchainLMDB::release_rtxn_count() const
+{
+	if(m_tinfo.get() && m_tinfo->m_ti_counted)
+	{
+		m_tinfo->m_ti_counted = false;
+		mdb_txn_safe::increment_txns(-1);
+	}
 }
 
 void BlockchainLMDB::block_txn_start(bool readonly)
@@ -2928,7 +3091,24 @@ void BlockchainLMDB::block_txn_start(bool readonly)
 	{
 		MDB_txn *mtxn;
 		mdb_txn_cursors *mcur;
-		block_rtxn_start(&mtxn, &mcur);
+		bool started = false;
+		mdb_txn_safe::increment_txns(1);
+		try
+		{
+			started = block_rtxn_start(&mtxn, &mcur);
+		}
+		catch(...)
+		{
+			mdb_txn_safe::increment_txns(-1);
+			throw;
+		}
+		// a read txn this thread already had open is now held across calls as well,
+		// so it is counted too unless an earlier call counted it
+		const bool is_writer = m_write_txn && m_writer == boost::this_thread::get_id();
+		if(!is_writer && (started || !m_tinfo->m_ti_counted))
+			m_tinfo->m_ti_counted = true;
+		else
+			mdb_txn_safe::increment_txns(-1);
 		return;
 	}
 
@@ -2958,6 +3138,7 @@ void BlockchainLMDB::block_txn_start(bool readonly)
 			if(m_tinfo->m_ti_rflags.m_rf_txn)
 				mdb_txn_reset(m_tinfo->m_ti_rtxn);
 			memset(&m_tinfo->m_ti_rflags, 0, sizeof(m_tinfo->m_ti_rflags));
+			release_rtxn_count();
 		}
 	}
 	else if(m_writer != boost::this_thread::get_id())
@@ -2985,6 +3166,7 @@ void BlockchainLMDB::block_txn_stop()
 	{
 		mdb_txn_reset(m_tinfo->m_ti_rtxn);
 		memset(&m_tinfo->m_ti_rflags, 0, sizeof(m_tinfo->m_ti_rflags));
+		release_rtxn_count();
 	}
 }
 
@@ -3004,6 +3186,7 @@ void BlockchainLMDB::block_txn_abort()
 	{
 		mdb_txn_reset(m_tinfo->m_ti_rtxn);
 		memset(&m_tinfo->m_ti_rflags, 0, sizeof(m_tinfo->m_ti_rflags));
+		release_rtxn_count();
 	}
 	else
 	{
@@ -3283,6 +3466,9 @@ bool BlockchainLMDB::get_output_distribution(uint64_t amount, uint64_t from_heig
 	GULPS_LOG_L3("BlockchainLMDB::", __func__);
 	check_open();
 
+	if(amount == 0 && m_block_rct_outs_open)
+		return get_rct_output_distribution(from_height, to_height, distribution, base);
+
 	TXN_PREFIX_RDONLY();
 	RCURSOR(output_amounts);
 
@@ -3319,6 +3505,50 @@ bool BlockchainLMDB::get_output_distribution(uint64_t amount, uint64_t from_heig
 	return true;
 }
 
+bool BlockchainLMDB::get_rct_output_distribution(uint64_t from_height, uint64_t to_height, std::vector<uint64_t> &distribution, uint64_t &base) const
+{
+	GULPS_LOG_L3("BlockchainLMDB::", __func__);
+	check_open();
+
+	TXN_PREFIX_RDONLY();
+	RCURSOR(block_rct_outs);
+
+	distribution.clear();
+	const uint64_t db_height = height();
+	if(from_height >= db_height)
+		return false;
+	distribution.resize(db_height - from_height, 0);
+	const uint64_t last_height = to_height > 0 && to_height < db_height ? to_height : db_height - 1;
+
+	// start one block early, its cumulative count is the base
+	mdb_block_rct_outs bro = {from_height > 0 ? from_height - 1 : 0, 0};
+	MDB_val_set(v, bro);
+	// MDB_NEXT_DUP writes the key back, so it can't be the const zerokval
+	MDB_val k = zerokval;
+	int result = mdb_cursor_get(m_cur_block_rct_outs, &k, &v, MDB_GET_BOTH);
+	uint64_t prev_cum_outs = 0;
+	while(1)
+	{
+		if(result == MDB_NOTFOUND)
+			break;
+		if(result)
+			throw0(DB_ERROR(lmdb_error("Failed to enumerate block rct output counts: ", result).c_str()));
+		const mdb_block_rct_outs *bp = (const mdb_block_rct_outs *)v.mv_data;
+		if(bp->bro_height < from_height)
+			base += bp->bro_cum_outs;
+		else
+			distribution[bp->bro_height - from_height] = bp->bro_cum_outs - prev_cum_outs;
+		prev_cum_outs = bp->bro_cum_outs;
+		if(bp->bro_height >= last_height)
+			break;
+		result = mdb_cursor_get(m_cur_block_rct_outs, &k, &v, MDB_NEXT_DUP);
+	}
+
+	TXN_POSTFIX_RDONLY();
+
+	return true;
+}
+
 void BlockchainLMDB::check_hard_fork_info()
 {
 }
@@ -3340,6 +3570,251 @@ void BlockchainLMDB::drop_hard_fork_info()
 	TXN_POSTFIX_SUCCESS();
 }
 
+std::vector<std::pair<const char *, MDB_dbi>> BlockchainLMDB::snapshot_tables() const
+{
+	std::vector<std::pair<const char *, MDB_dbi>> tables = {
+		{LMDB_BLOCKS, m_blocks},
+		{LMDB_BLOCK_INFO, m_block_info},
+		{LMDB_BLOCK_HEIGHTS, m_block_heights},
+		{LMDB_TXS, m_txs},
+		{LMDB_TX_INDICES, m_tx_indices},
+		{LMDB_TX_OUTPUTS, m_tx_outputs},
+		{LMDB_OUTPUT_TXS, m_output_txs},
+		{LMDB_OUTPUT_AMOUNTS, m_output_amounts},
+		{LMDB_SPENT_KEYS, m_spent_keys},
+		{LMDB_HF_VERSIONS, m_hf_versions}};
+	if(m_block_rct_outs_open)
+		tables.emplace_back(LMDB_BLOCK_RCT_OUTS, m_block_rct_outs);
+	if(m_pow_hashes_open)
+		tables.emplace_back(LMDB_POW_HASHES, m_pow_hashes);
+	return tables;
+}
+
+void BlockchainLMDB::export_snapshot(std::ostream &out) const
+{
+	GULPS_LOG_L3("BlockchainLMDB::", __func__);
+	check_open();
+
+	// a single read txn, so all tables are taken at the same height
+	TXN_PREFIX_RDONLY();
+
+	MDB_stat db_stats;
+	if(int result = mdb_stat(m_txn, m_blocks, &db_stats))
+		throw0(DB_ERROR(lmdb_error("Failed to query m_blocks: ", result).c_str()));
+
+	// a version 1 db opened read-only is exported as is, the importer has to know
+	MDB_val_copy<const char *> version_key("version");
+	MDB_val version_val;
+	if(int result = mdb_get(m_txn, m_properties, &version_key, &version_val))
+		throw0(DB_ERROR(lmdb_error("Failed to read the db version: ", result).c_str()));
+	uint32_t db_version;
+	memcpy(&db_version, version_val.mv_data, sizeof(db_version));
+
+	out.write(snapshot_magic, sizeof(snapshot_magic));
+	snapshot_write(out, snapshot_version);
+	snapshot_write(out, db_version);
+	snapshot_write(out, uint64_t(db_stats.ms_entries));
+
+	const std::vector<std::pair<const char *, MDB_dbi>> tables = snapshot_tables();
+	snapshot_write(out, uint8_t(tables.size()));
+	for(const auto &table : tables)
+		snapshot_write_name(out, table.first);
+
+	std::string chunk;
+	chunk.reserve(snapshot_chunk_size + 4096);
+	for(const auto &table : tables)
+	{
+		snapshot_write_name(out, table.first);
+
+		MDB_cursor *cur;
+		if(int result = mdb_cursor_open(m_txn, table.second, &cur))
+			throw0(DB_ERROR(lmdb_error("Failed to open cursor: ", result).c_str()));
+		std::unique_ptr<MDB_cursor, void (*)(MDB_cursor *)> cur_guard(cur, &mdb_cursor_close);
+
+		MDB_val k, v;
+		uint64_t total = 0;
+		uint32_t records = 0;
+		chunk.clear();
+		MDB_cursor_op op = MDB_FIRST;
+		while(true)
+		{
+			int ret = mdb_cursor_get(cur, &k, &v, op);
+			op = MDB_NEXT;
+			if(ret && ret != MDB_NOTFOUND)
+				throw0(DB_ERROR(lmdb_error(std::string("Failed to enumerate ") + table.first + ": ", ret).c_str()));
+
+			if(records > 0 && (ret == MDB_NOTFOUND || chunk.size() >= snapshot_chunk_size))
+			{
+				snapshot_write_chunk(out, chunk, records);
+				total += records;
+				records = 0;
+				chunk.clear();
+			}
+			if(ret == MDB_NOTFOUND)
+				break;
+
+			snapshot_append(chunk, k);
+			snapshot_append(chunk, v);
+			records++;
+		}
+
+		snapshot_write(out, uint32_t(0));
+		snapshot_write(out, uint32_t(0));
+		if(!out)
+			throw0(DB_ERROR("Failed to write snapshot"));
+		GULPSF_LOG_L0("Exported {} records of {}", total, table.first);
+	}
+	snapshot_write(out, uint8_t(0));
+
+	TXN_POSTFIX_RDONLY();
+
+	if(!out.flush())
+		throw0(DB_ERROR("Failed to write snapshot"));
+}
+
+uint64_t BlockchainLMDB::import_snapshot(std::istream &in)
+{
+	GULPS_LOG_L3("BlockchainLMDB::", __func__);
+	check_open();
+
+	if(m_write_txn != nullptr)
+		throw0(DB_ERROR("Snapshot import is not possible while a write transaction is active"));
+
+	char magic[sizeof(snapshot_magic)];
+	uint32_t version, db_version;
+	uint64_t height;
+	if(!in.read(magic, sizeof(magic)) || memcmp(magic, snapshot_magic, sizeof(magic)) || !snapshot_read(in, version))
+		throw0(DB_ERROR("Not a blockchain snapshot"));
+	if(version != snapshot_version)
+		throw0(DB_ERROR((std::string("Unsupported snapshot version ") + std::to_string(version)).c_str()));
+	if(!snapshot_read(in, db_version) || !snapshot_read(in, height))
+		throw0(DB_ERROR("Snapshot is truncated"));
+	if(db_version != VERSION)
+		throw0(DB_ERROR(("Snapshot of db version " + std::to_string(db_version) + " does not match db version " + std::to_string(VERSION)).c_str()));
+
+	// the snapshot has to hold exactly the tables of this db, in load order, before anything is loaded
+	const std::vector<std::pair<const char *, MDB_dbi>> tables = snapshot_tables();
+	std::string name;
+	uint8_t table_count;
+	if(!snapshot_read(in, table_count))
+		throw0(DB_ERROR("Snapshot is truncated"));
+	if(table_count != tables.size())
+		throw0(DB_ERROR(("Snapshot has " + std::to_string(table_count) + " tables, the db has " + std::to_string(tables.size())).c_str()));
+	for(const auto &table : tables)
+	{
+		if(!snapshot_read_name(in, name))
+			throw0(DB_ERROR("Snapshot is truncated"));
+		if(name != table.first)
+			throw0(DB_ERROR(("Snapshot table " + name + " does not match db table " + table.first).c_str()));
+	}
+
+	std::unique_ptr<mdb_txn_safe> txn;
+	MDB_cursor *cur = nullptr;
+	const uint64_t txn_bytes = snapshot_chunk_size * snapshot_chunks_per_txn;
+
+	// records are appended, so every table has to start out empty
+	txn.reset(new mdb_txn_safe());
+	if(auto result = lmdb_txn_begin(m_env, NULL, 0, *txn))
+		throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+	for(const auto &table : tables)
+	{
+		MDB_stat db_stats;
+		if(int result = mdb_stat(*txn, table.second, &db_stats))
+			throw0(DB_ERROR(lmdb_error(std::string("Failed to query ") + table.first + ": ", result).c_str()));
+		if(db_stats.ms_entries != 0)
+			throw0(DB_ERROR("Snapshot import needs an empty database"));
+	}
+	txn->commit();
+	txn.reset();
+
+	auto begin_txn = [&](MDB_dbi dbi) {
+		if(need_resize(2 * txn_bytes))
+			do_resize(std::max<uint64_t>(2 * txn_bytes, uint64_t(512) << 20));
+		txn.reset(new mdb_txn_safe());
+		if(auto result = lmdb_txn_begin(m_env, NULL, 0, *txn))
+			throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+		if(int result = mdb_cursor_open(*txn, dbi, &cur))
+			throw0(DB_ERROR(lmdb_error("Failed to open cursor: ", result).c_str()));
+	};
+	auto end_txn = [&]() {
+		mdb_cursor_close(cur);
+		cur = nullptr;
+		txn->commit();
+		txn.reset();
+	};
+
+	std::string chunk, prev_key;
+	for(auto table = tables.begin(); ; ++table)
+	{
+		if(!snapshot_read_name(in, name))
+			throw0(DB_ERROR("Snapshot is truncated"));
+		if(name.empty() && table == tables.end())
+			break;
+		if(table == tables.end() || name != table->first)
+			throw0(DB_ERROR(("Snapshot table " + name + " is not in manifest order").c_str()));
+
+		begin_txn(table->second);
+		unsigned int db_flags;
+		if(int result = mdb_dbi_flags(*txn, table->second, &db_flags))
+			throw0(DB_ERROR(lmdb_error("Failed to query table flags: ", result).c_str()));
+		const bool dupsort = db_flags & MDB_DUPSORT;
+
+		uint64_t total = 0;
+		size_t txn_chunks = 0;
+		prev_key.clear();
+		while(true)
+		{
+			uint32_t records, size;
+			if(!snapshot_read(in, records) || !snapshot_read(in, size))
+				throw0(DB_ERROR("Snapshot is truncated"));
+			if(records == 0)
+				break;
+			if(size > 2 * snapshot_chunk_size)
+				throw0(DB_ERROR(("Malformed snapshot chunk in " + name).c_str()));
+
+			chunk.resize(size);
+			crypto::hash expected, h;
+			if(!in.read(&chunk[0], size) || !snapshot_read(in, expected))
+				throw0(DB_ERROR("Snapshot is truncated"));
+			crypto::cn_fast_hash(chunk.data(), chunk.size(), h);
+			if(h != expected)
+				throw0(DB_ERROR(("Snapshot checksum mismatch in " + name).c_str()));
+
+			if(txn_chunks++ == snapshot_chunks_per_txn)
+			{
+				end_txn();
+				begin_txn(table->second);
+				txn_chunks = 1;
+			}
+
+			size_t pos = 0;
+			for(uint32_t i = 0; i < records; i++)
+			{
+				MDB_val k, v;
+				if(!snapshot_next(chunk, pos, k) || !snapshot_next(chunk, pos, v))
+					throw0(DB_ERROR(("Malformed snapshot chunk in " + name).c_str()));
+
+				// dups of the previous key are appended to its data, anything else is a new last key
+				unsigned int flags = MDB_APPEND;
+				if(dupsort && prev_key.size() == k.mv_size && memcmp(prev_key.data(), k.mv_data, k.mv_size) == 0)
+					flags = MDB_APPENDDUP;
+				else if(dupsort)
+					prev_key.assign(static_cast<const char *>(k.mv_data), k.mv_size);
+
+				if(int result = mdb_cursor_put(cur, &k, &v, flags))
+					throw0(DB_ERROR(lmdb_error("Failed to add snapshot record to " + name + ": ", result).c_str()));
+			}
+			total += records;
+		}
+		end_txn();
+		GULPSF_LOG_L0("Imported {} records of {}", total, name);
+	}
+
+	if(this->height() != height)
+		throw0(DB_ERROR("Snapshot height does not match the imported blocks"));
+	return height;
+}
+
 void BlockchainLMDB::set_hard_fork_version(uint64_t height, uint8_t version)
 {
 	GULPS_LOG_L3("BlockchainLMDB::", __func__);
@@ -3378,6 +3853,50 @@ uint8_t BlockchainLMDB::get_hard_fork_version(uint64_t height) const
 	return ret;
 }
 
+void BlockchainLMDB::add_block_pow_hash(const crypto::hash &blk_hash, const crypto::hash &pow_hash)
+{
+	GULPS_LOG_L3("BlockchainLMDB::", __func__);
+	check_open();
+
+	if(!m_pow_hashes_open)
+		return;
+
+	TXN_BLOCK_PREFIX(0);
+
+	MDB_val k = {sizeof(blk_hash), (void *)&blk_hash};
+	MDB_val v = {sizeof(pow_hash), (void *)&pow_hash};
+	// a block re-added after a pop is already there, keep its page clean
+	auto result = mdb_put(*txn_ptr, m_pow_hashes, &k, &v, MDB_NOOVERWRITE);
+	if(result && result != MDB_KEYEXIST)
+		throw1(DB_ERROR(lmdb_error("Error adding pow hash to db transaction: ", result).c_str()));
+
+	TXN_BLOCK_POSTFIX_SUCCESS();
+}
+
+bool BlockchainLMDB::get_block_pow_hash(const crypto::hash &blk_hash, crypto::hash &pow_hash) const
+{
+	GULPS_LOG_L3("BlockchainLMDB::", __func__);
+	check_open();
+
+	if(!m_pow_hashes_open)
+		return false;
+
+	TXN_PREFIX_RDONLY();
+	RCURSOR(pow_hashes)
+
+	MDB_val k = {sizeof(blk_hash), (void *)&blk_hash};
+	MDB_val v;
+	auto result = mdb_cursor_get(m_cur_pow_hashes, &k, &v, MDB_SET);
+	if(result == MDB_NOTFOUND)
+		return false;
+	if(result != 0)
+		throw0(DB_ERROR(lmdb_error("Error finding pow hash: ", result).c_str()));
+
+	pow_hash = *(const crypto::hash *)v.mv_data;
+	TXN_POSTFIX_RDONLY();
+	return true;
+}
+
 bool BlockchainLMDB::is_read_only() const
 {
 	unsigned int flags;
@@ -3979,12 +4498,104 @@ void BlockchainLMDB::migrate_0_1()
 	txn.commit();
 }
 
+void BlockchainLMDB::migrate_1_2()
+{
+	GULPS_LOG_L3("BlockchainLMDB::", __func__);
+	uint64_t m_height;
+	int result;
+	mdb_txn_safe txn(false);
+	MDB_val k, v;
+
+	GULPS_INFO_CLR(gulps::COLOR_YELLOW, "Migrating blockchain from DB version 1 to 2 - this may take a while:");
+	GULPS_INFO("building the per block RCT output counts...");
+
+	do
+	{
+		result = mdb_txn_begin(m_env, NULL, 0, txn);
+		if(result)
+			throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+
+		MDB_stat db_stats;
+		if((result = mdb_stat(txn, m_blocks, &db_stats)))
+			throw0(DB_ERROR(lmdb_error("Failed to query m_blocks: ", result).c_str()));
+		m_height = db_stats.ms_entries;
+		GULPSF_INFO("Total number of blocks: {}", m_height);
+
+		if((result = mdb_stat(txn, m_block_rct_outs, &db_stats)))
+			throw0(DB_ERROR(lmdb_error("Failed to query m_block_rct_outs: ", result).c_str()));
+		if(db_stats.ms_entries == m_height)
+		{
+			txn.abort();
+			GULPS_LOG_L1("  block_rct_outs already migrated");
+			break;
+		}
+		// left over from an interrupted migration
+		if((result = mdb_drop(txn, m_block_rct_outs, 0)))
+			throw0(DB_ERROR(lmdb_error("Failed to drop m_block_rct_outs: ", result).c_str()));
+
+		MDB_cursor *c_amounts, *c_outs;
+		result = mdb_cursor_open(txn, m_output_amounts, &c_amounts);
+		if(result)
+			throw0(DB_ERROR(lmdb_error("Failed to open a cursor for output_amounts: ", result).c_str()));
+		result = mdb_cursor_open(txn, m_block_rct_outs, &c_outs);
+		if(result)
+			throw0(DB_ERROR(lmdb_error("Failed to open a cursor for block_rct_outs: ", result).c_str()));
+
+		// RCT outputs are the amount 0 duplicates, in the order they were added to the chain
+		mdb_block_rct_outs bro = {0, 0};
+		MDB_val_set(nv, bro);
+		uint64_t amount = 0;
+		k.mv_size = sizeof(amount);
+		k.mv_data = (void *)&amount;
+		MDB_cursor_op op = MDB_SET;
+		while(1)
+		{
+			result = mdb_cursor_get(c_amounts, &k, &v, op);
+			op = MDB_NEXT_DUP;
+			if(result == MDB_NOTFOUND)
+				break;
+			if(result)
+				throw0(DB_ERROR(lmdb_error("Failed to get a record from output_amounts: ", result).c_str()));
+			const uint64_t out_height = ((const outkey *)v.mv_data)->data.height;
+			for(; bro.bro_height < out_height; bro.bro_height++)
+			{
+				if((result = mdb_cursor_put(c_outs, (MDB_val *)&zerokval, &nv, MDB_APPENDDUP)))
+					throw0(DB_ERROR(lmdb_error("Failed to put a record into block_rct_outs: ", result).c_str()));
+				if(!(bro.bro_height % 10000))
+					GULPSF_LOG_L0("{}/{}\r", bro.bro_height, m_height);
+			}
+			bro.bro_cum_outs++;
+		}
+		for(; bro.bro_height < m_height; bro.bro_height++)
+		{
+			if((result = mdb_cursor_put(c_outs, (MDB_val *)&zerokval, &nv, MDB_APPENDDUP)))
+				throw0(DB_ERROR(lmdb_error("Failed to put a record into block_rct_outs: ", result).c_str()));
+		}
+
+		txn.commit();
+	} while(0);
+
+	uint32_t version = 2;
+	v.mv_data = (void *)&version;
+	v.mv_size = sizeof(version);
+	MDB_val_copy<const char *> vk("version");
+	result = mdb_txn_begin(m_env, NULL, 0, txn);
+	if(result)
+		throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+	result = mdb_put(txn, m_properties, &vk, &v, 0);
+	if(result)
+		throw0(DB_ERROR(lmdb_error("Failed to update version for the db: ", result).c_str()));
+	txn.commit();
+}
+
 void BlockchainLMDB::migrate(const uint32_t oldversion)
 {
 	switch(oldversion)
 	{
 	case 0:
 		migrate_0_1(); /* FALLTHRU */
+	case 1:
+		migrate_1_2(); /* FALLTHRU */
 	default:;
 	}
 }
@@ -76,6 +76,10 @@ typedef struct mdb_txn_cursors
 	MDB_cursor *m_txc_txpool_blob;
 
 	MDB_cursor *m_txc_hf_versions;
+
+	MDB_cursor *m_txc_pow_hashes;
+
+	MDB_cursor *m_txc_block_rct_outs;
 } mdb_txn_cursors;
 
 #define m_cur_blocks m_cursors->m_txc_blocks
@@ -90,6 +94,8 @@ typedef struct mdb_txn_cursors
 #define m_cur_txpool_meta m_cursors->m_txc_txpool_meta
 #define m_cur_txpool_blob m_cursors->m_txc_txpool_blob
 #define m_cur_hf_versions m_cursors->m_txc_hf_versions
+#define m_cur_pow_hashes m_cursors->m_txc_pow_hashes
+#define m_cur_block_rct_outs m_cursors->m_txc_block_rct_outs
 
 typedef struct mdb_rflags
 {
@@ -106,6 +112,8 @@ typedef struct mdb_rflags
 	bool m_rf_txpool_meta;
 	bool m_rf_txpool_blob;
 	bool m_rf_hf_versions;
+	bool m_rf_pow_hashes;
+	bool m_rf_block_rct_outs;
 } mdb_rflags;
 
 typedef struct mdb_threadinfo
@@ -113,6 +121,7 @@ typedef struct mdb_threadinfo
 	MDB_txn *m_ti_rtxn;			   // per-thread read txn
 	mdb_txn_cursors m_ti_rcursors; // per-thread read cursors
 	mdb_rflags m_ti_rflags;		   // per-thread read state
+	bool m_ti_counted;			   // read txn was opened by block_txn_start and counts as active
 
 	~mdb_threadinfo();
 } mdb_threadinfo;
@@ -146,6 +155,7 @@ struct mdb_txn_safe
 	static void prevent_new_txns();
 	static void wait_no_active_txns();
 	static void allow_new_txns();
+	static void increment_txns(int i);
 
 	mdb_threadinfo *m_tinfo;
 	MDB_txn *m_txn;
@@ -292,6 +302,9 @@ class BlockchainLMDB : public BlockchainDB
 
 	virtual void pop_block(block &blk, std::vector<transaction> &txs);
 
+	virtual void add_block_pow_hash(const crypto::hash &blk_hash, const crypto::hash &pow_hash);
+	virtual bool get_block_pow_hash(const crypto::hash &blk_hash, crypto::hash &pow_hash) const;
+
 	virtual bool can_thread_bulk_indices() const { return true; }
 
 	/**
@@ -348,6 +361,9 @@ class BlockchainLMDB : public BlockchainDB
 	virtual void check_hard_fork_info();
 	virtual void drop_hard_fork_info();
 
+	virtual void export_snapshot(std::ostream &out) const;
+	virtual uint64_t import_snapshot(std::istream &in);
+
 	/**
    * @brief convert a tx output to a blob for storage
    *
@@ -368,6 +384,9 @@ class BlockchainLMDB : public BlockchainDB
 
 	void check_open() const;
 
+	// name and handle of every table written to a snapshot, in snapshot order
+	std::vector<std::pair<const char *, MDB_dbi>> snapshot_tables() const;
+
 	virtual bool is_read_only() const;
 
 	// fix up anything that may be wrong due to past bugs
@@ -379,8 +398,16 @@ class BlockchainLMDB : public BlockchainDB
 	// migrate from DB version 0 to 1
 	void migrate_0_1();
 
+	// migrate from DB version 1 to 2
+	void migrate_1_2();
+
+	// get_output_distribution for amount 0 as a range read of block_rct_outs
+	bool get_rct_output_distribution(uint64_t from_height, uint64_t to_height, std::vector<uint64_t> &distribution, uint64_t &base) const;
+
 	void cleanup_batch();
 
+	void release_rtxn_count() const;
+
   private:
 	MDB_env *m_env;
 
@@ -405,6 +432,12 @@ class BlockchainLMDB : public BlockchainDB
 
 	MDB_dbi m_properties;
 
+	MDB_dbi m_pow_hashes;
+	bool m_pow_hashes_open;
+
+	MDB_dbi m_block_rct_outs;
+	bool m_block_rct_outs_open;
+
 	mutable uint64_t m_cum_size; // used in batch size estimation
 	mutable unsigned int m_cum_count;
 	std::string m_folder;
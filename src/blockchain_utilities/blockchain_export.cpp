@@ -43,6 +43,9 @@
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 
+#include <chrono>
+#include <fstream>
+
 #include "blockchain_db/blockchain_db.h"
 #include "blockchain_db/db_types.h"
 #include "blocksdat_file.h"
@@ -85,6 +88,7 @@ int main(int argc, char *argv[])
 	uint32_t log_level = 0;
 	uint64_t block_stop = 0;
 	bool blocks_dat = false;
+	bool snapshot = false;
 
 	tools::on_startup();
 
@@ -98,6 +102,7 @@ int main(int argc, char *argv[])
 	const command_line::arg_descriptor<std::string> arg_database = {
 		"database", available_dbs.c_str(), default_db_type};
 	const command_line::arg_descriptor<bool> arg_blocks_dat = {"blocksdat", "Output in blocks.dat format", blocks_dat};
+	const command_line::arg_descriptor<bool> arg_snapshot = {"snapshot", "Output a checksummed snapshot of the database tables", snapshot};
 
 	command_line::add_arg(desc_cmd_sett, cryptonote::arg_data_dir);
 	command_line::add_arg(desc_cmd_sett, arg_output_file);
@@ -107,6 +112,7 @@ int main(int argc, char *argv[])
 	command_line::add_arg(desc_cmd_sett, arg_database);
 	command_line::add_arg(desc_cmd_sett, arg_block_stop);
 	command_line::add_arg(desc_cmd_sett, arg_blocks_dat);
+	command_line::add_arg(desc_cmd_sett, arg_snapshot);
 
 	command_line::add_arg(desc_cmd_only, command_line::arg_help);
 
@@ -180,6 +186,17 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 	bool opt_blocks_dat = command_line::get_arg(vm, arg_blocks_dat);
+	bool opt_snapshot = command_line::get_arg(vm, arg_snapshot);
+	if(opt_blocks_dat && opt_snapshot)
+	{
+		GULPS_ERROR("Can't specify more than one of --blocksdat and --snapshot");
+		return 1;
+	}
+	if(opt_snapshot && block_stop != 0)
+	{
+		GULPS_ERROR("A snapshot always covers the whole chain, --block-stop can't be used with --snapshot");
+		return 1;
+	}
 
 	std::string m_config_folder;
 
@@ -195,7 +212,7 @@ int main(int argc, char *argv[])
 	if(command_line::has_arg(vm, arg_output_file))
 		output_file_path = boost::filesystem::path(command_line::get_arg(vm, arg_output_file));
 	else
-		output_file_path = boost::filesystem::path(m_config_folder) / "export" / BLOCKCHAIN_RAW;
+		output_file_path = boost::filesystem::path(m_config_folder) / "export" / (opt_snapshot ? BLOCKCHAIN_SNAPSHOT : BLOCKCHAIN_RAW);
 	GULPS_PRINT("Export output file: " , output_file_path.string());
 
 	// If we wanted to use the memory pool, we would set up a fake_core.
@@ -242,7 +259,32 @@ int main(int argc, char *argv[])
 	GULPS_PRINT("Source blockchain storage initialized OK");
 	GULPS_PRINT("Exporting blockchain raw data...");
 
-	if(opt_blocks_dat)
+	if(opt_snapshot)
+	{
+		boost::system::error_code ec;
+		boost::filesystem::create_directories(output_file_path.parent_path(), ec);
+		std::ofstream out(output_file_path.string(), std::ios::binary | std::ios::trunc);
+		if(!out)
+		{
+			GULPS_ERROR("Failed to open output file: ", output_file_path.string());
+			return 1;
+		}
+		const auto start = std::chrono::steady_clock::now();
+		try
+		{
+			db->export_snapshot(out);
+			r = true;
+		}
+		catch(const std::exception &e)
+		{
+			GULPS_ERROR("Error writing snapshot: ", e.what());
+			r = false;
+		}
+		const auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - start).count();
+		if(r)
+			GULPSF_PRINT("Snapshot of {} blocks written in {} s", db->height(), elapsed);
+	}
+	else if(opt_blocks_dat)
 	{
 		BlocksdatFile blocksdat;
 		r = blocksdat.store_blockchain_raw(core_storage, NULL, output_file_path, block_stop);
@@ -45,12 +45,15 @@
 
 #include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <cstdio>
 #include <fstream>
+#include <thread>
 
 #include "blockchain_db/db_types.h"
 #include "bootstrap_file.h"
 #include "bootstrap_serialization.h"
+#include "common/mpmc_queue.hpp"
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include "cryptonote_core/cryptonote_core.h"
 #include "include_base_utils.h"
@@ -177,16 +180,30 @@ int pop_blocks(cryptonote::core &core, int num_blocks)
 	return num_blocks;
 }
 
-int check_flush(cryptonote::core &core, std::list<block_complete_entry> &blocks, bool force)
+// A run of consecutive blocks handed from the reader thread to the commit thread
+struct import_span
 {
-	if(blocks.empty())
-		return 0;
-	if(!force && blocks.size() < db_batch_size)
-		return 0;
+	import_span() : height(0), bytes(0), count(0) {}
+
+	uint64_t height; // of the first block
+	uint64_t bytes;
+	size_t count;
+	std::list<block_complete_entry> blocks; // verify mode, fed to the core as blobs
+	std::vector<bootstrap::block_package> packages; // added to the db directly otherwise
+};
+
+// spans parsed ahead of the one being committed
+constexpr size_t spans_read_ahead = 2;
+
+inline double blocks_per_sec(uint64_t blocks, const std::chrono::steady_clock::time_point &start)
+{
+	const double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return sec > 0 ? blocks / sec : 0;
+}
 
-	// wait till we can verify a full HOH without extra, for speed
-	uint64_t new_height = core.get_blockchain_storage().get_db().height() + blocks.size();
-	if(!force && new_height % HASH_OF_HASHES_STEP)
+int check_flush(cryptonote::core &core, std::list<block_complete_entry> &blocks, const import_span *next)
+{
+	if(blocks.empty())
 		return 0;
 
 	std::list<crypto::hash> hashes;
@@ -206,17 +223,29 @@ int check_flush(cryptonote::core &core, std::list<block_complete_entry> &blocks,
 
 	core.prepare_handle_incoming_blocks(blocks);
 
+	// check the pow and rct semantics of the next span on the threadpool
+	// while this one is verified and written to the db
+	if(next != nullptr)
+		core.precompute_incoming_blocks(next->height, next->blocks);
+
 	for(const block_complete_entry &block_entry : blocks)
 	{
 		// process transactions
-		for(auto &tx_blob : block_entry.txs)
+		std::vector<tx_verification_context> tvc;
+		core.handle_incoming_txs(block_entry.txs, tvc, true, true, false);
+		if(tvc.size() != block_entry.txs.size())
+		{
+			GULPS_ERROR("Internal error: tvc.size() != block_entry.txs.size()");
+			core.cleanup_handle_incoming_blocks();
+			return 1;
+		}
+		for(size_t i = 0; i < tvc.size(); i++)
 		{
-			tx_verification_context tvc = AUTO_VAL_INIT(tvc);
-			core.handle_incoming_tx(tx_blob, tvc, true, true, false);
-			if(tvc.m_verifivation_failed)
+			if(tvc[i].m_verifivation_failed)
 			{
+				auto tx_blob = std::next(block_entry.txs.begin(), i);
 				GULPS_ERROR("transaction verification failed, tx_id = ",
-					   epee::string_tools::pod_to_hex(get_blob_hash(tx_blob)));
+					   epee::string_tools::pod_to_hex(get_blob_hash(*tx_blob)));
 				core.cleanup_handle_incoming_blocks();
 				return 1;
 			}
@@ -250,6 +279,141 @@ int check_flush(cryptonote::core &core, std::list<block_complete_entry> &blocks,
 	return 0;
 }
 
+// A span is handed over once it is big enough. When verifying it also has to end where a full
+// HOH can be checked without extra, for speed. Otherwise spans end on batch commit heights.
+bool span_complete(const import_span &span, uint64_t next_height)
+{
+	if(opt_verify)
+		return span.count >= db_batch_size && next_height % HASH_OF_HASHES_STEP == 0;
+	return (next_height - 1) % db_batch_size == 0;
+}
+
+// Reader thread: reads and parses the bootstrap file from height h, returns 1 at the end of
+// the file or block_stop, 2 on error. The queue is finished in both cases.
+int read_spans(std::ifstream &import_file, uint64_t h, uint64_t block_stop, mpmc_queue<import_span> &spans)
+{
+	std::string str1;
+	char buffer1[1024];
+	std::vector<char> buffer_block(BUFFER_SIZE);
+	import_span span;
+	span.height = h;
+	int quit = 0;
+
+	while(!quit)
+	{
+		uint32_t chunk_size;
+		import_file.read(buffer1, sizeof(chunk_size));
+		// TODO: bootstrap.read_chunk();
+		if(!import_file)
+		{
+			GULPS_LOG_L0("End of file reached");
+			quit = 1;
+			break;
+		}
+
+		str1.assign(buffer1, sizeof(chunk_size));
+		if(!::serialization::parse_binary(str1, chunk_size))
+		{
+			GULPS_ERROR("Error in deserialization of chunk size");
+			quit = 2;
+			break;
+		}
+		GULPSF_LOG_L1("chunk_size: {}" , chunk_size);
+
+		if(chunk_size > BUFFER_SIZE)
+		{
+			GULPSF_ERROR("Aborting: chunk_size {} > BUFFER_SIZE {}", chunk_size, BUFFER_SIZE);
+			quit = 2;
+			break;
+		}
+		if(chunk_size > CHUNK_SIZE_WARNING_THRESHOLD)
+		{
+			GULPSF_INFO("NOTE: chunk_size {} > {}",  chunk_size, CHUNK_SIZE_WARNING_THRESHOLD);
+		}
+		else if(chunk_size == 0)
+		{
+			GULPS_ERROR("ERROR: chunk_size == 0");
+			quit = 2;
+			break;
+		}
+		import_file.read(buffer_block.data(), chunk_size);
+		if(!import_file)
+		{
+			if(import_file.eof())
+			{
+				GULPS_LOG_L0("End of file reached - file was truncated");
+				quit = 1;
+			}
+			else
+			{
+				GULPSF_ERROR("ERROR: unexpected end of file: bytes read before error: {} of chunk_size {}",
+						import_file.gcount(), chunk_size);
+				quit = 2;
+			}
+			break;
+		}
+
+		if(h > block_stop)
+		{
+			GULPSF_LOG_L0("Specified block number reached - stopping.  block: {}  total blocks: {}", h - 1, h);
+			quit = 1;
+			break;
+		}
+
+		try
+		{
+			str1.assign(buffer_block.data(), chunk_size);
+			bootstrap::block_package bp;
+			if(!::serialization::parse_binary(str1, bp))
+				throw std::runtime_error("Error in deserialization of chunk");
+
+			// NOTE: NUM_BLOCKS_PER_CHUNK is a placeholder in case multi-block chunks are later supported.
+			++h;
+			GULPSF_LOG_L1("loading block number {}, prev_id: {}", h - 1, bp.block.prev_id);
+			span.bytes += chunk_size;
+			span.count++;
+
+			if(opt_verify)
+			{
+				cryptonote::blobdata block;
+				cryptonote::block_to_blob(bp.block, block);
+				std::list<cryptonote::blobdata> txs;
+				for(const auto &tx : bp.txs)
+				{
+					txs.push_back(cryptonote::blobdata());
+					cryptonote::tx_to_blob(tx, txs.back());
+				}
+				span.blocks.push_back({block, txs});
+			}
+			else
+			{
+				span.packages.push_back(std::move(bp));
+			}
+		}
+		catch(const std::exception &e)
+		{
+			GULPSF_ERROR("exception while reading from file, height={}: {}", h, e.what());
+			quit = 2;
+			break;
+		}
+
+		if(span_complete(span, h))
+		{
+			// the commit thread finishes the queue if it gave up
+			if(!spans.push(std::move(span)))
+				break;
+			span = import_span();
+			span.height = h;
+		}
+	}
+
+	// never commit a partial span after an error
+	if(quit == 1 && span.count > 0)
+		spans.push(std::move(span));
+	spans.set_finish_flag();
+	return quit;
+}
+
 int import_from_file(cryptonote::core &core, const std::string &import_file_path, uint64_t block_stop = 0)
 {
 	// Reset stats, in case we're using newly created db, accumulating stats
@@ -297,13 +461,7 @@ int import_from_file(cryptonote::core &core, const std::string &import_file_path
 	// 4 byte magic + (currently) 1024 byte header structures
 	bootstrap.seek_to_first_chunk(import_file);
 
-	std::string str1;
-	char buffer1[1024];
-	char buffer_block[BUFFER_SIZE];
-	block b;
-	transaction tx;
 	int quit = 0;
-	uint64_t bytes_read;
 
 	// Note that a new blockchain will start with block number 0 (total blocks: 1)
 	// due to genesis block being added at initialization.
@@ -321,250 +479,164 @@ int import_from_file(cryptonote::core &core, const std::string &import_file_path
 
 	GULPS_INFO("Reading blockchain from bootstrap file...\n");
 
-	std::list<block_complete_entry> blocks;
-
 	// Skip to start_height before we start adding.
 	{
 		bool q2 = false;
 		import_file.seekg(pos);
-		bytes_read = bootstrap.count_bytes(import_file, start_height - seek_height, h, q2);
+		bootstrap.count_bytes(import_file, start_height - seek_height, h, q2);
 		if(q2)
 		{
-			quit = 2;
-			goto quitting;
+			import_file.close();
+			return 0;
 		}
 		h = start_height;
 	}
 
-	if(use_batch)
-	{
-		uint64_t bytes, h2;
-		bool q2;
-		pos = import_file.tellg();
-		bytes = bootstrap.count_bytes(import_file, db_batch_size, h2, q2);
-		if(import_file.eof())
-			import_file.clear();
-		import_file.seekg(pos);
-		core.get_blockchain_storage().get_db().batch_start(db_batch_size, bytes);
-	}
-	while(!quit)
-	{
-		uint32_t chunk_size;
-		import_file.read(buffer1, sizeof(chunk_size));
-		// TODO: bootstrap.read_chunk();
-		if(!import_file)
-		{
-			GULPS_PRINT( refresh_string);
-			GULPS_INFO("End of file reached");
-			quit = 1;
-			break;
-		}
-		bytes_read += sizeof(chunk_size);
-
-		str1.assign(buffer1, sizeof(chunk_size));
-		if(!::serialization::parse_binary(str1, chunk_size))
-		{
-			throw std::runtime_error("Error in deserialization of chunk size");
-		}
-		GULPSF_LOG_L1("chunk_size: {}" , chunk_size);
-
-		if(chunk_size > BUFFER_SIZE)
-		{
-			GULPSF_WARN("WARNING: chunk_size {} > BUFFER_SIZE {}", chunk_size, BUFFER_SIZE);
-			throw std::runtime_error("Aborting: chunk size exceeds buffer size");
-		}
-		if(chunk_size > CHUNK_SIZE_WARNING_THRESHOLD)
-		{
-			GULPSF_INFO("NOTE: chunk_size {} > {}",  chunk_size, CHUNK_SIZE_WARNING_THRESHOLD);
-		}
-		else if(chunk_size == 0)
+	// The reader thread parses the file ahead into spans, this thread commits them. When verifying,
+	// the pow and signatures of the span after the one being committed are checked on the threadpool.
+	mpmc_queue<import_span> spans(spans_read_ahead);
+	int read_result = 0;
+	std::thread reader([&]() { read_result = read_spans(import_file, h, block_stop, spans); });
+
+	const std::chrono::steady_clock::time_point import_start = std::chrono::steady_clock::now();
+	const int progress_interval = 10;
+	import_span span, next;
+	bool have_span = spans.pop(span);
+	while(have_span)
+	{
+		const std::chrono::steady_clock::time_point span_start = std::chrono::steady_clock::now();
+		bool have_next = false;
+		if(opt_verify)
 		{
-			GULPS_ERROR("ERROR: chunk_size == 0");
-			return 2;
-		}
-		import_file.read(buffer_block, chunk_size);
-		if(!import_file)
-		{
-			if(import_file.eof())
+			have_next = spans.pop(next);
+			if(check_flush(core, span.blocks, have_next ? &next : nullptr))
 			{
-				GULPS_PRINT( refresh_string);
-				GULPS_INFO("End of file reached - file was truncated");
-				quit = 1;
+				quit = 2; // make sure we don't commit partial block data
 				break;
 			}
-			else
-			{
-				GULPSF_ERROR("ERROR: unexpected end of file: bytes read before error: {} of chunk_size {}",
-						import_file.gcount(), chunk_size);
-				return 2;
-			}
-		}
-		bytes_read += chunk_size;
-		GULPSF_LOG_L1("Total bytes read: {}" , bytes_read);
-
-		if(h > block_stop)
-		{
-			GULPSF_PRINT(refresh_string, "block {} / {}\n\n", h - 1, block_stop);
-			GULPSF_INFO("Specified block number reached - stopping.  block: {}  total blocks: {}", h - 1, h);
-			quit = 1;
-			break;
+			h = span.height + span.count;
+			num_imported += span.count;
 		}
-
-		try
+		else
 		{
-			str1.assign(buffer_block, chunk_size);
-			bootstrap::block_package bp;
-			if(!::serialization::parse_binary(str1, bp))
-				throw std::runtime_error("Error in deserialization of chunk");
+			if(use_batch)
+				core.get_blockchain_storage().get_db().batch_start(span.count, span.bytes);
 
-			int display_interval = 1000;
-			int progress_interval = 10;
-			// NOTE: use of NUM_BLOCKS_PER_CHUNK is a placeholder in case multi-block chunks are later supported.
-			for(int chunk_ind = 0; chunk_ind < NUM_BLOCKS_PER_CHUNK; ++chunk_ind)
+			for(const bootstrap::block_package &bp : span.packages)
 			{
 				++h;
-				if((h - 1) % display_interval == 0)
+				// tx number 1: coinbase tx
+				// tx number 2 onwards: bp.txs
+				//
+				// add_block() calls add_transaction(blk_hash, blk.miner_tx) first, and
+				// then a for loop for the transactions in txs.
+				try
 				{
-					GULPS_PRINT( refresh_string);
-					GULPSF_LOG_L1("loading block number {}" , h - 1);
+					core.get_blockchain_storage().get_db().add_block(bp.block, bp.block_size, bp.cumulative_difficulty, bp.coins_generated, bp.txs);
 				}
-				else
+				catch(const std::exception &e)
 				{
-					GULPSF_LOG_L1("loading block number {}" , h - 1);
+					GULPS_PRINT( refresh_string);
+					GULPS_ERROR("Error adding block to blockchain: ", e.what());
+					quit = 2; // make sure we don't commit partial block data
+					break;
 				}
-				b = bp.block;
-				GULPSF_LOG_L1("block prev_id: {}", b.prev_id);
+				++num_imported;
 
 				if((h - 1) % progress_interval == 0)
 				{
-					GULPSF_PRINT("{}block {} / {}\r", refresh_string,  h - 1, block_stop);
+					GULPSF_PRINT("{}block {} / {}\r", refresh_string, h - 1, block_stop);
 				}
+			}
+			if(quit)
+			{
+				// There was an error, so don't commit pending data.
+				// Destructor will abort write txn.
+				break;
+			}
 
-				if(opt_verify)
-				{
-					cryptonote::blobdata block;
-					cryptonote::block_to_blob(bp.block, block);
-					std::list<cryptonote::blobdata> txs;
-					for(const auto &tx : bp.txs)
-					{
-						txs.push_back(cryptonote::blobdata());
-						cryptonote::tx_to_blob(tx, txs.back());
-					}
-					blocks.push_back({block, txs});
-					int ret = check_flush(core, blocks, false);
-					if(ret)
-					{
-						quit = 2; // make sure we don't commit partial block data
-						break;
-					}
-				}
-				else
-				{
-					std::vector<transaction> txs;
-					std::vector<transaction> archived_txs;
-
-					archived_txs = bp.txs;
-
-					// tx number 1: coinbase tx
-					// tx number 2 onwards: archived_txs
-					for(const transaction &tx : archived_txs)
-					{
-						// add blocks with verification.
-						// for Blockchain and blockchain_storage add_new_block().
-						// for add_block() method, without (much) processing.
-						// don't add coinbase transaction to txs.
-						//
-						// because add_block() calls
-						// add_transaction(blk_hash, blk.miner_tx) first, and
-						// then a for loop for the transactions in txs.
-						txs.push_back(tx);
-					}
-
-					size_t block_size;
-					difficulty_type cumulative_difficulty;
-					uint64_t coins_generated;
-
-					block_size = bp.block_size;
-					cumulative_difficulty = bp.cumulative_difficulty;
-					coins_generated = bp.coins_generated;
-
-					try
-					{
-						core.get_blockchain_storage().get_db().add_block(b, block_size, cumulative_difficulty, coins_generated, txs);
-					}
-					catch(const std::exception &e)
-					{
-						GULPS_PRINT( refresh_string);
-						GULPS_ERROR("Error adding block to blockchain: ", e.what());
-						quit = 2; // make sure we don't commit partial block data
-						break;
-					}
-
-					if(use_batch)
-					{
-						if((h - 1) % db_batch_size == 0)
-						{
-							uint64_t bytes, h2;
-							bool q2;
-							GULPS_PRINT( refresh_string);
-							// zero-based height
-							GULPSF_PRINT("\n[- batch commit at height {} -]\n", h - 1);
-							core.get_blockchain_storage().get_db().batch_stop();
-							pos = import_file.tellg();
-							bytes = bootstrap.count_bytes(import_file, db_batch_size, h2, q2);
-							import_file.seekg(pos);
-							core.get_blockchain_storage().get_db().batch_start(db_batch_size, bytes);
-							GULPS_PRINT( "\n");
-							core.get_blockchain_storage().get_db().show_stats();
-						}
-					}
-				}
-				++num_imported;
+			if(use_batch)
+			{
+				GULPS_PRINT( refresh_string);
+				// zero-based height
+				GULPSF_PRINT("\n[- batch commit at height {} -]\n", h - 1);
+				core.get_blockchain_storage().get_db().batch_stop();
+				GULPS_PRINT( "\n");
+				core.get_blockchain_storage().get_db().show_stats();
 			}
+			have_next = spans.pop(next);
 		}
-		catch(const std::exception &e)
-		{
-			GULPS_PRINT( refresh_string);
-			GULPSF_ERROR("exception while reading from file, height={}: {}", h, e.what());
-			return 2;
-		}
-	} // while
 
-quitting:
-	import_file.close();
+		GULPSF_PRINT("{}block {} / {}  {:.1f} blocks/s\r", refresh_string, h - 1, block_stop, blocks_per_sec(span.count, span_start));
 
-	if(opt_verify)
-	{
-		int ret = check_flush(core, blocks, true);
-		if(ret)
-			return ret;
+		span = std::move(next);
+		next = import_span();
+		have_span = have_next;
 	}
 
-	if(use_batch)
-	{
-		if(quit > 1)
-		{
-			// There was an error, so don't commit pending data.
-			// Destructor will abort write txn.
-		}
-		else
-		{
-			core.get_blockchain_storage().get_db().batch_stop();
-		}
-	}
+	// stops the reader if we gave up early
+	spans.set_finish_flag();
+	reader.join();
+	import_file.close();
+
+	if(read_result == 2)
+		quit = 2;
 
+	GULPS_PRINT( refresh_string);
 	core.get_blockchain_storage().get_db().show_stats();
-	GULPSF_INFO("Number of blocks imported: {}" , num_imported);
+	GULPSF_INFO("Number of blocks imported: {}  ({:.1f} blocks/s)", num_imported, blocks_per_sec(num_imported, import_start));
 	if(h > 0)
 		// TODO: if there was an error, the last added block is probably at zero-based height h-2
 		GULPSF_INFO("Finished at block: {}  total blocks: {}", h - 1, h);
 
 	GULPS_PRINT( "\n");
-	return 0;
+	return quit > 1 ? 2 : 0;
 }
 
 gulps_log_level log_scr;
 
+int import_from_snapshot(const std::string &db_type, int db_flags, const std::string &data_dir, const std::string &snapshot_path)
+{
+	std::ifstream in(snapshot_path, std::ios::binary);
+	if(!in)
+	{
+		GULPS_ERROR("Snapshot file not found: ", snapshot_path);
+		return 1;
+	}
+
+	std::unique_ptr<BlockchainDB> db(new_db(db_type));
+	if(db == NULL)
+	{
+		GULPS_ERROR("Attempted to use non-existent database type: ", db_type);
+		return 1;
+	}
+	boost::filesystem::path folder(data_dir);
+	folder /= db->get_db_name();
+	boost::system::error_code ec;
+	if(!boost::filesystem::exists(folder) && !boost::filesystem::create_directories(folder, ec))
+	{
+		GULPS_ERROR("Failed to create directory ", folder.string());
+		return 1;
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	db->open(folder.string(), db_flags);
+	if(db->height() != 0)
+	{
+		GULPS_ERROR("A snapshot can only be loaded into an empty database, remove ", folder.string(), " first");
+		db->close();
+		return 1;
+	}
+
+	GULPS_INFO("Loading snapshot ", snapshot_path, " into ", folder.string());
+	const uint64_t height = db->import_snapshot(in);
+	db->close();
+
+	const auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - start).count();
+	GULPSF_INFO("Loaded {} blocks from snapshot in {} s", height, elapsed);
+	return 0;
+}
+
 int main(int argc, char *argv[])
 {
 #ifdef WIN32
@@ -599,6 +671,7 @@ int main(int argc, char *argv[])
 	po::options_description desc_cmd_only("Command line options");
 	po::options_description desc_cmd_sett("Command line options and settings options");
 	const command_line::arg_descriptor<std::string> arg_input_file = {"input-file", "Specify input file", "", true};
+	const command_line::arg_descriptor<std::string> arg_snapshot_file = {"snapshot-file", "Bulk load a snapshot written by ryo-blockchain-export --snapshot into an empty database", "", true};
 	const command_line::arg_descriptor<std::string> arg_log_level = {"log-level", "0-4 or categories", ""};
 	const command_line::arg_descriptor<uint64_t> arg_block_stop = {"block-stop", "Stop at block number", block_stop};
 	const command_line::arg_descriptor<uint64_t> arg_batch_size = {"batch-size", "", db_batch_size};
@@ -616,6 +689,7 @@ int main(int argc, char *argv[])
 														   "Resume from current height if output database already exists", true};
 
 	command_line::add_arg(desc_cmd_sett, arg_input_file);
+	command_line::add_arg(desc_cmd_sett, arg_snapshot_file);
 	command_line::add_arg(desc_cmd_sett, arg_log_level);
 	command_line::add_arg(desc_cmd_sett, arg_database);
 	command_line::add_arg(desc_cmd_sett, arg_batch_size);
@@ -779,6 +853,20 @@ int main(int argc, char *argv[])
 	GULPS_INFO("bootstrap file path: " , import_file_path);
 	GULPS_INFO("database path:       " , m_config_folder);
 
+	if(command_line::has_arg(vm, arg_snapshot_file))
+	{
+		try
+		{
+			if(import_from_snapshot(db_type, db_flags, m_config_folder, command_line::get_arg(vm, arg_snapshot_file)))
+				return 1;
+		}
+		catch(const std::exception &e)
+		{
+			GULPS_ERROR("Error loading snapshot: ", e.what());
+			return 1;
+		}
+	}
+
 	cryptonote::cryptonote_protocol_stub pr; //TODO: stub only for this kind of test, make real validation of relayed objects
 	cryptonote::core core(&pr);
 
@@ -802,6 +890,21 @@ int main(int argc, char *argv[])
 			return 0;
 		}
 
+		if(command_line::has_arg(vm, arg_snapshot_file))
+		{
+			// the tables were copied without validation, so hold the chain against the compiled-in hashes
+			uint64_t checked_height = 0;
+			const bool valid = core.get_blockchain_storage().check_compiled_in_block_hashes(checked_height);
+			core.deinit();
+			if(!valid)
+			{
+				GULPS_ERROR("Snapshot does not match the compiled-in block hashes, remove the database and try again");
+				return 1;
+			}
+			GULPSF_INFO("Blocks up to height {} match the compiled-in block hashes", checked_height);
+			return 0;
+		}
+
 		if(!command_line::is_arg_defaulted(vm, arg_drop_hf))
 		{
 			GULPS_INFO("Dropping hard fork tables...");
@@ -0,0 +1,329 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "blockchain_db/blockchain_db.h"
+#include "blockchain_db/db_types.h"
+#include "common/command_line.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_core/blockchain.h"
+#include "cryptonote_core/cryptonote_core.h"
+#include "cryptonote_core/tx_pool.h"
+#include "version.h"
+#include "wallet/multi_account_scanner.h"
+#include <boost/algorithm/string.hpp>
+#include <deque>
+#include <fstream>
+
+#include "common/gulps.hpp"
+
+GULPS_CAT_MAJOR("blockch_scan");
+
+namespace po = boost::program_options;
+using namespace epee;
+using namespace cryptonote;
+
+gulps_log_level log_scr;
+
+namespace
+{
+// One "<address> <view secret key>" pair per line, # starts a comment
+bool load_accounts(const std::string &path, network_type nettype, uint32_t major, uint32_t minor, tools::multi_account_scanner &scanner, std::vector<std::string> &addresses)
+{
+	std::ifstream in(path);
+	if(!in)
+	{
+		GULPS_ERROR("Failed to open accounts file ", path);
+		return false;
+	}
+
+	std::string line;
+	size_t line_no = 0;
+	while(std::getline(in, line))
+	{
+		line_no++;
+		const size_t comment = line.find('#');
+		if(comment != std::string::npos)
+			line.erase(comment);
+		boost::trim(line);
+		if(line.empty())
+			continue;
+
+		std::vector<std::string> fields;
+		boost::split(fields, line, boost::is_any_of(" \t"), boost::token_compress_on);
+		address_parse_info info;
+		account_keys keys;
+		if(fields.size() != 2 || !get_account_address_from_str(nettype, info, fields[0]) ||
+			!string_tools::hex_to_pod(fields[1], keys.m_view_secret_key))
+		{
+			GULPS_ERROR("Invalid account on line ", line_no, " of ", path);
+			return false;
+		}
+
+		crypto::public_key view_pub;
+		if(!crypto::secret_key_to_public_key(keys.m_view_secret_key, view_pub) || view_pub != info.address.m_view_public_key)
+		{
+			GULPS_ERROR("View key on line ", line_no, " does not belong to its address");
+			return false;
+		}
+
+		keys.m_account_address = info.address;
+		scanner.add_account(keys.m_view_secret_key, tools::multi_account_scanner::make_subaddresses(keys, major, minor));
+		addresses.push_back(fields[0]);
+	}
+	return true;
+}
+}
+
+int main(int argc, char *argv[])
+{
+#ifdef WIN32
+	std::vector<char*> argptrs;
+	command_line::set_console_utf8();
+	if(command_line::get_windows_args(argptrs))
+	{
+		argc = argptrs.size();
+		argv = argptrs.data();
+	}
+#endif
+
+	GULPS_TRY_ENTRY();
+
+	epee::string_tools::set_module_name_and_folder(argv[0]);
+
+	std::string default_db_type = "lmdb";
+
+	std::string available_dbs = cryptonote::blockchain_db_types(", ");
+	available_dbs = "available: " + available_dbs;
+
+	uint32_t log_level = 0;
+
+	tools::on_startup();
+
+	po::options_description desc_cmd_only("Command line options");
+	po::options_description desc_cmd_sett("Command line options and settings options");
+	const command_line::arg_descriptor<std::string> arg_log_level = {"log-level", "0-4 or categories", ""};
+	const command_line::arg_descriptor<std::string> arg_database = {
+		"database", available_dbs.c_str(), default_db_type};
+	const command_line::arg_descriptor<std::string> arg_accounts = {"accounts", "File with one \"<address> <view secret key>\" pair per line", ""};
+	const command_line::arg_descriptor<uint32_t> arg_major = {"subaddress-major", "Number of subaddress accounts to look for", 50};
+	const command_line::arg_descriptor<uint32_t> arg_minor = {"subaddress-minor", "Number of subaddresses per account to look for", 200};
+	const command_line::arg_descriptor<uint64_t> arg_start_height = {"start-height", "Height to start scanning from", 0};
+	const command_line::arg_descriptor<uint64_t> arg_chunk_size = {"chunk-size", "Number of blocks scanned at once", 1000};
+	const command_line::arg_descriptor<std::string> arg_input = {"input", ""};
+
+	command_line::add_arg(desc_cmd_sett, cryptonote::arg_testnet_on);
+	command_line::add_arg(desc_cmd_sett, cryptonote::arg_stagenet_on);
+	command_line::add_arg(desc_cmd_sett, arg_log_level);
+	command_line::add_arg(desc_cmd_sett, arg_database);
+	command_line::add_arg(desc_cmd_sett, arg_accounts);
+	command_line::add_arg(desc_cmd_sett, arg_major);
+	command_line::add_arg(desc_cmd_sett, arg_minor);
+	command_line::add_arg(desc_cmd_sett, arg_start_height);
+	command_line::add_arg(desc_cmd_sett, arg_chunk_size);
+	command_line::add_arg(desc_cmd_sett, arg_input);
+	command_line::add_arg(desc_cmd_only, command_line::arg_help);
+
+	po::options_description desc_options("Allowed options");
+	desc_options.add(desc_cmd_only).add(desc_cmd_sett);
+
+	po::positional_options_description positional_options;
+	positional_options.add(arg_input.name, -1);
+
+	po::variables_map vm;
+	bool r = command_line::handle_error_helper(desc_options, [&]() {
+		auto parser = po::command_line_parser(argc, argv).options(desc_options).positional(positional_options);
+		po::store(parser.run(), vm);
+		po::notify(vm);
+		return true;
+	});
+	if(!r)
+		return 1;
+
+	gulps::inst().set_thread_tag("BLOCKCH_SCAN");
+
+	//Temp error output
+	std::unique_ptr<gulps::gulps_output> out(new gulps::gulps_print_output(gulps::COLOR_WHITE, gulps::TIMESTAMP_ONLY));
+	out->add_filter([](const gulps::message& msg, bool printed, bool logged) -> bool { return msg.lvl >= gulps::LEVEL_ERROR; });
+	auto temp_handle = gulps::inst().add_output(std::move(out));
+
+	if(!command_line::is_arg_defaulted(vm, arg_log_level))
+	{
+		if(!log_scr.parse_cat_string(command_line::get_arg(vm, arg_log_level).c_str()))
+		{
+			GULPS_ERROR("Failed to parse filter string ", command_line::get_arg(vm, arg_log_level).c_str());
+			return 1;
+		}
+	}
+	else
+	{
+		if(!log_scr.parse_cat_string(std::to_string(log_level).c_str()))
+		{
+			GULPSF_ERROR("Failed to parse filter string {}", log_level);
+			return 1;
+		}
+	}
+
+	gulps::inst().remove_output(temp_handle);
+
+	if(log_scr.is_active())
+	{
+		std::unique_ptr<gulps::gulps_output> out(new gulps::gulps_print_output(gulps::COLOR_WHITE, gulps::TEXT_ONLY));
+		out->add_filter([](const gulps::message& msg, bool printed, bool logged) -> bool {
+				if(msg.out != gulps::OUT_LOG_0 && msg.out != gulps::OUT_USER_0)
+					return false;
+				if(printed)
+					return false;
+				return log_scr.match_msg(msg);
+				});
+		gulps::inst().add_output(std::move(out));
+	}
+
+	if(command_line::get_arg(vm, command_line::arg_help))
+	{
+		GULPS_PRINT("Ryo '", RYO_RELEASE_NAME, "' (", RYO_VERSION_FULL, ")");
+		GULPS_PRINT(desc_options);
+		return 0;
+	}
+
+	bool opt_testnet = command_line::get_arg(vm, cryptonote::arg_testnet_on);
+	bool opt_stagenet = command_line::get_arg(vm, cryptonote::arg_stagenet_on);
+	network_type net_type = opt_testnet ? TESTNET : opt_stagenet ? STAGENET : MAINNET;
+	const uint64_t start_height = command_line::get_arg(vm, arg_start_height);
+	const uint64_t chunk_size = std::max<uint64_t>(command_line::get_arg(vm, arg_chunk_size), 1);
+
+	std::string db_type = command_line::get_arg(vm, arg_database);
+	if(!cryptonote::blockchain_valid_db_type(db_type))
+	{
+		GULPS_ERROR("Invalid database type: ", db_type);
+		return 1;
+	}
+
+	if(command_line::is_arg_defaulted(vm, arg_accounts))
+	{
+		GULPS_ERROR("--accounts is required");
+		return 1;
+	}
+
+	tools::multi_account_scanner scanner;
+	std::vector<std::string> addresses;
+	GULPS_PRINT("Loading accounts and generating subaddresses...");
+	if(!load_accounts(command_line::get_arg(vm, arg_accounts), net_type, command_line::get_arg(vm, arg_major),
+			command_line::get_arg(vm, arg_minor), scanner, addresses))
+		return 1;
+	GULPS_PRINT("Loaded ", scanner.account_count(), " accounts, ", scanner.subaddress_count(), " subaddresses");
+
+	GULPS_PRINT("Initializing source blockchain (BlockchainDB)");
+	const std::string input = command_line::get_arg(vm, arg_input);
+	std::unique_ptr<Blockchain> core_storage;
+	tx_memory_pool m_mempool(*core_storage);
+	core_storage.reset(new Blockchain(m_mempool));
+	BlockchainDB *db = new_db(db_type);
+	if(db == NULL)
+	{
+		GULPS_LOG_ERROR("Attempted to use non-existent database type: ", db_type);
+		throw std::runtime_error("Attempting to use non-existent database type");
+	}
+	GULPS_PRINT("database: " , db_type);
+
+	GULPS_PRINT("Loading blockchain from folder " , input , " ...");
+
+	try
+	{
+		db->open(input, DBF_RDONLY);
+	}
+	catch(const std::exception &e)
+	{
+		GULPS_ERROR("Error opening database: " , e.what());
+		return 1;
+	}
+	r = core_storage->init(db, net_type);
+
+	GULPS_CHECK_AND_ASSERT_MES(r, 1, "Failed to initialize source blockchain storage");
+	GULPS_PRINT("Source blockchain storage initialized OK");
+
+	const uint64_t db_height = core_storage->get_db().height();
+	GULPS_PRINT("Scanning blocks ", start_height, " to ", db_height);
+
+	// Transactions are kept in a deque so the scanner entries can point into it
+	std::deque<transaction> txes;
+	std::vector<tools::multi_account_scanner::tx_entry> entries;
+	std::vector<tools::multi_account_scanner::found_output> found;
+	uint64_t total_found = 0;
+	for(uint64_t height = start_height; height < db_height; height += chunk_size)
+	{
+		const uint64_t end = std::min(height + chunk_size, db_height);
+		txes.clear();
+		entries.clear();
+		found.clear();
+
+		for(uint64_t h = height; h < end; h++)
+		{
+			const block blk = core_storage->get_db().get_block_from_height(h);
+			txes.push_back(blk.miner_tx);
+			entries.push_back({get_transaction_hash(blk.miner_tx), nullptr, h});
+			for(const crypto::hash &txid : blk.tx_hashes)
+			{
+				txes.emplace_back();
+				if(!core_storage->get_db().get_tx(txid, txes.back()))
+				{
+					GULPS_ERROR("Transaction ", txid, " of block ", h, " not found in the database");
+					return 1;
+				}
+				entries.push_back({txid, nullptr, h});
+			}
+		}
+		for(size_t i = 0; i < entries.size(); i++)
+			entries[i].tx = &txes[i];
+
+		scanner.scan(entries.data(), entries.size(), found);
+		for(const auto &o : found)
+		{
+			GULPSF_PRINT("{} height {} tx {} output {} subaddress {}/{} amount {}", addresses[o.account], o.height,
+				o.txid, o.output_index, o.index.major, o.index.minor, print_money(o.amount));
+		}
+		total_found += found.size();
+		GULPS_LOG_L0("Scanned up to height ", end);
+	}
+
+	GULPS_PRINT("Blockchain scanned OK, ", total_found, " outputs found");
+	return 0;
+
+	GULPS_CATCH_ENTRY("Scan error", 1);
+}
@@ -52,3 +52,4 @@
 #define CHUNK_SIZE_WARNING_THRESHOLD 500000
 #define NUM_BLOCKS_PER_CHUNK 1
 #define BLOCKCHAIN_RAW "blockchain.raw"
+#define BLOCKCHAIN_SNAPSHOT "blockchain.snapshot"
@@ -72,7 +72,7 @@ public:
 			set_bit(dist(mtgen));
 	}
 
-	inline bool not_present(const void* data, size_t data_len)
+	inline bool not_present(const void* data, size_t data_len) const
 	{
 		crypto::hash h = crypto::cn_fast_hash(data, data_len);
 
@@ -95,7 +95,7 @@ private:
 	size_t bits_number;
 	std::vector<uint8_t> bytes;
 
-	inline bool read_bit(size_t pos)
+	inline bool read_bit(size_t pos) const
 	{
 		size_t byte = pos / 8;
 		size_t bit = pos % 8;
@@ -0,0 +1,252 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fmt/format.h>
+
+namespace tools
+{
+namespace metrics
+{
+namespace
+{
+std::atomic<size_t> next_histogram_id(0);
+
+// Shards this thread writes to, indexed by histogram id
+struct thread_shards
+{
+	std::vector<histogram::shard *> shards;
+
+	~thread_shards()
+	{
+		for(histogram::shard *s : shards)
+		{
+			if(s != nullptr)
+				s->in_use.store(false, std::memory_order_release);
+		}
+	}
+};
+
+thread_local thread_shards tls_shards;
+
+inline void relaxed_add(std::atomic<uint64_t> &a, uint64_t n)
+{
+	// only the owning thread writes to a shard
+	a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+std::string format_double(double v)
+{
+	return fmt::format("{:.9g}", v);
+}
+}
+
+constexpr size_t histogram::sub_bucket_bits;
+constexpr size_t histogram::max_value_bits;
+constexpr size_t histogram::bucket_count;
+
+histogram::shard::shard() : count(0), sum(0), in_use(true)
+{
+	for(std::atomic<uint64_t> &b : buckets)
+		b.store(0, std::memory_order_relaxed);
+}
+
+histogram::histogram(const std::string &name, const std::string &help) : m_name(name), m_help(help), m_id(next_histogram_id++)
+{
+}
+
+size_t histogram::bucket_index(uint64_t value)
+{
+	const uint64_t sub_buckets = 1 << sub_bucket_bits;
+	if(value < sub_buckets)
+		return value;
+	value = std::min<uint64_t>(value, (uint64_t(1) << max_value_bits) - 1);
+	size_t exponent = 63 - __builtin_clzll(value);
+	size_t sub = (value >> (exponent - sub_bucket_bits)) & (sub_buckets - 1);
+	return ((exponent - sub_bucket_bits + 1) << sub_bucket_bits) + sub;
+}
+
+uint64_t histogram::bucket_lower_bound(size_t index)
+{
+	const uint64_t sub_buckets = 1 << sub_bucket_bits;
+	if(index < sub_buckets)
+		return index;
+	size_t exponent = (index >> sub_bucket_bits) + sub_bucket_bits - 1;
+	return (sub_buckets + (index & (sub_buckets - 1))) << (exponent - sub_bucket_bits);
+}
+
+uint64_t histogram::bucket_width(size_t index)
+{
+	if(index < (1u << sub_bucket_bits))
+		return 1;
+	size_t exponent = (index >> sub_bucket_bits) + sub_bucket_bits - 1;
+	return uint64_t(1) << (exponent - sub_bucket_bits);
+}
+
+histogram::shard *histogram::acquire_shard()
+{
+	std::lock_guard<std::mutex> lock(m_shards_lock);
+	for(const std::unique_ptr<shard> &s : m_shards)
+	{
+		bool expected = false;
+		if(s->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire))
+			return s.get();
+	}
+	m_shards.emplace_back(new shard());
+	return m_shards.back().get();
+}
+
+void histogram::record(uint64_t value)
+{
+	std::vector<shard *> &shards = tls_shards.shards;
+	if(shards.size() <= m_id)
+		shards.resize(m_id + 1, nullptr);
+	shard *s = shards[m_id];
+	if(s == nullptr)
+		s = shards[m_id] = acquire_shard();
+
+	relaxed_add(s->buckets[bucket_index(value)], 1);
+	relaxed_add(s->sum, value);
+	relaxed_add(s->count, 1);
+}
+
+histogram::snapshot histogram::get_snapshot() const
+{
+	snapshot snap;
+	snap.buckets.assign(bucket_count, 0);
+	snap.count = 0;
+	snap.sum = 0;
+
+	std::lock_guard<std::mutex> lock(m_shards_lock);
+	for(const std::unique_ptr<shard> &s : m_shards)
+	{
+		for(size_t i = 0; i < bucket_count; ++i)
+			snap.buckets[i] += s->buckets[i].load(std::memory_order_relaxed);
+		snap.sum += s->sum.load(std::memory_order_relaxed);
+	}
+	// the shards are read while being written, count what the buckets say
+	for(uint64_t b : snap.buckets)
+		snap.count += b;
+	return snap;
+}
+
+uint64_t histogram::snapshot::quantile(double q) const
+{
+	if(count == 0)
+		return 0;
+	q = std::min(std::max(q, 0.0), 1.0);
+	uint64_t rank = std::max<uint64_t>(1, std::ceil(q * count));
+	uint64_t seen = 0;
+	for(size_t i = 0; i < buckets.size(); ++i)
+	{
+		seen += buckets[i];
+		if(seen >= rank)
+			return bucket_lower_bound(i) + bucket_width(i) / 2;
+	}
+	return bucket_lower_bound(buckets.size() - 1);
+}
+
+histogram &registry::get_histogram(const std::string &name, const std::string &help)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	std::unique_ptr<histogram> &h = m_histograms[name];
+	if(!h)
+		h.reset(new histogram(name, help));
+	return *h;
+}
+
+counter &registry::get_counter(const std::string &name, const std::string &help)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	std::unique_ptr<counter> &c = m_counters[name];
+	if(!c)
+		c.reset(new counter(name, help));
+	return *c;
+}
+
+gauge &registry::get_gauge(const std::string &name, const std::string &help)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	std::unique_ptr<gauge> &g = m_gauges[name];
+	if(!g)
+		g.reset(new gauge(name, help));
+	return *g;
+}
+
+std::string registry::to_prometheus() const
+{
+	static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+	std::string out;
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	for(const auto &c : m_counters)
+	{
+		const std::string name = "ryo_" + c.first;
+		if(!c.second->help().empty())
+			out += fmt::format("# HELP {} {}\n", name, c.second->help());
+		out += fmt::format("# TYPE {} counter\n{} {}\n", name, name, c.second->value());
+	}
+
+	for(const auto &g : m_gauges)
+	{
+		const std::string name = "ryo_" + g.first;
+		if(!g.second->help().empty())
+			out += fmt::format("# HELP {} {}\n", name, g.second->help());
+		out += fmt::format("# TYPE {} gauge\n{} {}\n", name, name, g.second->value());
+	}
+
+	for(const auto &h : m_histograms)
+	{
+		const std::string name = "ryo_" + h.first + "_seconds";
+		const histogram::snapshot snap = h.second->get_snapshot();
+		if(!h.second->help().empty())
+			out += fmt::format("# HELP {} {}\n", name, h.second->help());
+		out += fmt::format("# TYPE {} summary\n", name);
+		for(double q : quantiles)
+			out += fmt::format("{}{{quantile=\"{}\"}} {}\n", name, q, format_double(snap.quantile(q) / 1e9));
+		out += fmt::format("{}_sum {}\n{}_count {}\n", name, format_double(snap.sum / 1e9), name, snap.count);
+	}
+	return out;
+}
+}
+}
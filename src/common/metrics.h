@@ -0,0 +1,183 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace tools
+{
+namespace metrics
+{
+//! Latency histogram with per-thread shards
+//
+// Values (nanoseconds) go into log-linear buckets, 8 per power of two, so quantiles
+// are within ~12.5% of the recorded value. Every thread writes to its own shard with
+// relaxed atomics, only readers walk all the shards. Shards of exited threads are
+// handed to new threads as they are, their counts stay part of the totals.
+//
+// Threads keep raw pointers to their shards until they exit, so histograms are only
+// created by the registry, which never frees them.
+class histogram
+{
+  public:
+	static constexpr size_t sub_bucket_bits = 3;
+	static constexpr size_t max_value_bits = 40; //!< ~18 minutes in ns, larger values are clamped
+	static constexpr size_t bucket_count = (max_value_bits - sub_bucket_bits + 1) << sub_bucket_bits;
+
+	//! Merged view of all shards
+	struct snapshot
+	{
+		std::vector<uint64_t> buckets;
+		uint64_t count;
+		uint64_t sum;
+
+		//! Value at quantile q (0..1), the middle of the bucket it falls in
+		uint64_t quantile(double q) const;
+	};
+
+	void record(uint64_t value);
+	snapshot get_snapshot() const;
+
+	const std::string &name() const { return m_name; }
+	const std::string &help() const { return m_help; }
+
+	static size_t bucket_index(uint64_t value);
+	static uint64_t bucket_lower_bound(size_t index);
+	static uint64_t bucket_width(size_t index);
+
+	struct shard
+	{
+		shard();
+		std::atomic<uint64_t> buckets[bucket_count];
+		std::atomic<uint64_t> count;
+		std::atomic<uint64_t> sum;
+		std::atomic<bool> in_use;
+	};
+
+  private:
+	friend class registry;
+
+	histogram(const std::string &name, const std::string &help);
+
+	shard *acquire_shard();
+
+	const std::string m_name;
+	const std::string m_help;
+	const size_t m_id; //!< index into the per-thread shard table
+	mutable std::mutex m_shards_lock;
+	std::vector<std::unique_ptr<shard>> m_shards;
+};
+
+//! Monotonic counter
+class counter
+{
+  public:
+	counter(const std::string &name, const std::string &help) : m_name(name), m_help(help), m_value(0) {}
+
+	void inc(uint64_t n = 1) { m_value.fetch_add(n, std::memory_order_relaxed); }
+	uint64_t value() const { return m_value.load(std::memory_order_relaxed); }
+
+	const std::string &name() const { return m_name; }
+	const std::string &help() const { return m_help; }
+
+  private:
+	const std::string m_name;
+	const std::string m_help;
+	std::atomic<uint64_t> m_value;
+};
+
+//! Value that can go up and down
+class gauge
+{
+  public:
+	gauge(const std::string &name, const std::string &help) : m_name(name), m_help(help), m_value(0) {}
+
+	void set(int64_t v) { m_value.store(v, std::memory_order_relaxed); }
+	void add(int64_t n) { m_value.fetch_add(n, std::memory_order_relaxed); }
+	int64_t value() const { return m_value.load(std::memory_order_relaxed); }
+
+	const std::string &name() const { return m_name; }
+	const std::string &help() const { return m_help; }
+
+  private:
+	const std::string m_name;
+	const std::string m_help;
+	std::atomic<int64_t> m_value;
+};
+
+//! Process wide set of named metrics
+//
+// Metrics are created on first lookup and never freed, so call sites can keep
+// references to them (PERF_TIMER keeps one in a function local static). Lookups take a
+// lock, recording does not.
+class registry
+{
+  public:
+	static registry &instance()
+	{
+		// leaked on purpose, threads still running at exit may record into it
+		static registry *inst = new registry();
+		return *inst;
+	}
+
+	histogram &get_histogram(const std::string &name, const std::string &help = std::string());
+	counter &get_counter(const std::string &name, const std::string &help = std::string());
+	gauge &get_gauge(const std::string &name, const std::string &help = std::string());
+
+	//! All metrics in the Prometheus text exposition format, histograms as summaries in seconds
+	std::string to_prometheus() const;
+
+  private:
+	registry() {}
+
+	mutable std::mutex m_lock;
+	std::map<std::string, std::unique_ptr<histogram>> m_histograms;
+	std::map<std::string, std::unique_ptr<counter>> m_counters;
+	std::map<std::string, std::unique_ptr<gauge>> m_gauges;
+};
+}
+}
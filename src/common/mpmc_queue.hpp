@@ -0,0 +1,293 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <stdint.h>
+
+// Bounded multi-producer multi-consumer ring queue. Push and pop are lock-free, each cell
+// carries a sequence number telling whether it is ready to be written or read (D. Vyukov).
+// Blocking calls spin for a short while and then sleep on a condition variable, the mutex
+// is only touched when a thread actually has to sleep.
+//
+// Semantics follow thdq: after set_finish_flag() pushes are dropped and pop() keeps
+// returning the remaining items, then false once the queue is empty.
+template <typename T>
+class mpmc_queue
+{
+public:
+	// With a single cell a written and a free cell would carry the same sequence number,
+	// so the capacity is at least 2
+	explicit mpmc_queue(size_t capacity) : cap_(capacity > 2 ? capacity : 2), cells_(new cell[cap_])
+	{
+		for(size_t i = 0; i < cap_; i++)
+			cells_[i].seq.store(i, std::memory_order_relaxed);
+		enqueue_pos_.store(0, std::memory_order_relaxed);
+		dequeue_pos_.store(0, std::memory_order_relaxed);
+		finish_.store(false, std::memory_order_relaxed);
+		push_waiters_.store(0, std::memory_order_relaxed);
+		pop_waiters_.store(0, std::memory_order_relaxed);
+	}
+
+	~mpmc_queue()
+	{
+		T item;
+		while(try_pop_cell(item)) {}
+	}
+
+	mpmc_queue(const mpmc_queue&) = delete;
+	mpmc_queue& operator=(const mpmc_queue&) = delete;
+
+	// Returns false if the queue is full or finished, item is left untouched then
+	bool try_push(T&& item)
+	{
+		if(finish_.load(std::memory_order_acquire))
+			return false;
+		if(!try_push_cell(item))
+			return false;
+		wake(pop_waiters_, not_empty_);
+		return true;
+	}
+
+	// Blocks while the queue is full, returns false if the queue was finished
+	bool push(T&& item)
+	{
+		for(size_t spin = 0; ; spin++)
+		{
+			if(finish_.load(std::memory_order_acquire))
+				return false;
+			if(try_push_cell(item))
+			{
+				wake(pop_waiters_, not_empty_);
+				return true;
+			}
+			if(spin < spin_count)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lck(mutex_);
+			push_waiters_.fetch_add(1, std::memory_order_seq_cst);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			bool has_push = false;
+			while(!finish_.load(std::memory_order_acquire) && !(has_push = try_push_cell(item)))
+				not_full_.wait(lck);
+			push_waiters_.fetch_sub(1, std::memory_order_relaxed);
+			lck.unlock();
+
+			// an item that made it into a cell is queued even if the queue got finished meanwhile
+			if(!has_push)
+				return false;
+			wake(pop_waiters_, not_empty_);
+			return true;
+		}
+	}
+
+	bool push(const T& item)
+	{
+		T copy(item);
+		return push(std::move(copy));
+	}
+
+	// Returns false if the queue is empty
+	bool try_pop(T& item)
+	{
+		if(!try_pop_cell(item))
+			return false;
+		wake(push_waiters_, not_full_);
+		return true;
+	}
+
+	// Blocks while the queue is empty, returns false once it is empty and finished
+	bool pop(T& item)
+	{
+		for(size_t spin = 0; ; spin++)
+		{
+			if(try_pop_cell(item))
+			{
+				wake(push_waiters_, not_full_);
+				return true;
+			}
+			if(finish_.load(std::memory_order_acquire))
+				return try_pop(item);
+			if(spin < spin_count)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lck(mutex_);
+			pop_waiters_.fetch_add(1, std::memory_order_seq_cst);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			bool has_pop;
+			while(!(has_pop = try_pop_cell(item)) && !finish_.load(std::memory_order_acquire))
+				not_empty_.wait(lck);
+			pop_waiters_.fetch_sub(1, std::memory_order_relaxed);
+			lck.unlock();
+
+			if(!has_pop)
+				return try_pop(item);
+			wake(push_waiters_, not_full_);
+			return true;
+		}
+	}
+
+	void set_finish_flag()
+	{
+		std::unique_lock<std::mutex> lck(mutex_);
+		finish_.store(true, std::memory_order_seq_cst);
+		not_empty_.notify_all();
+		not_full_.notify_all();
+	}
+
+	bool is_finished() const { return finish_.load(std::memory_order_acquire); }
+
+	// Approximate while other threads are pushing or popping
+	size_t size() const
+	{
+		uint64_t deq = dequeue_pos_.load(std::memory_order_acquire);
+		uint64_t enq = enqueue_pos_.load(std::memory_order_acquire);
+		return enq > deq ? enq - deq : 0;
+	}
+
+	size_t capacity() const { return cap_; }
+
+private:
+	static constexpr size_t cache_line = 64;
+	static constexpr size_t spin_count = 32;
+
+	struct cell
+	{
+		std::atomic<uint64_t> seq;
+		typename std::aligned_storage<sizeof(T), alignof(T)>::type data;
+	};
+
+	bool try_push_cell(T& item)
+	{
+		uint64_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+		for(;;)
+		{
+			cell& c = cells_[pos % cap_];
+			uint64_t seq = c.seq.load(std::memory_order_acquire);
+			if(seq == pos)
+			{
+				if(enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					new(&c.data) T(std::move(item));
+					c.seq.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if(seq < pos)
+			{
+				return false; // full
+			}
+			else
+			{
+				pos = enqueue_pos_.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	bool try_pop_cell(T& item)
+	{
+		uint64_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+		for(;;)
+		{
+			cell& c = cells_[pos % cap_];
+			uint64_t seq = c.seq.load(std::memory_order_acquire);
+			if(seq == pos + 1)
+			{
+				if(dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					T* p = reinterpret_cast<T*>(&c.data);
+					item = std::move(*p);
+					p->~T();
+					c.seq.store(pos + cap_, std::memory_order_release);
+					return true;
+				}
+			}
+			else if(seq < pos + 1)
+			{
+				return false; // empty
+			}
+			else
+			{
+				pos = dequeue_pos_.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// Sleepers register under the mutex before re-checking the queue, so taking the mutex
+	// here guarantees the notification can't fall between their check and their wait
+	void wake(std::atomic<uint32_t>& waiters, std::condition_variable& cond)
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if(waiters.load(std::memory_order_relaxed) == 0)
+			return;
+		std::unique_lock<std::mutex> lck(mutex_);
+		lck.unlock();
+		cond.notify_all();
+	}
+
+	const size_t cap_;
+	std::unique_ptr<cell[]> cells_;
+
+	char pad0_[cache_line];
+	std::atomic<uint64_t> enqueue_pos_;
+	char pad1_[cache_line - sizeof(std::atomic<uint64_t>)];
+	std::atomic<uint64_t> dequeue_pos_;
+	char pad2_[cache_line - sizeof(std::atomic<uint64_t>)];
+	std::atomic<bool> finish_;
+	std::atomic<uint32_t> push_waiters_;
+	std::atomic<uint32_t> pop_waiters_;
+	char pad3_[cache_line];
+
+	std::mutex mutex_;
+	std::condition_variable not_empty_;
+	std::condition_variable not_full_;
+};
@@ -121,7 +121,7 @@ PerformanceTimer::PerformanceTimer(bool paused) : started(true), paused(paused)
 		ticks = get_tick_count();
 }
 
-LoggingPerformanceTimer::LoggingPerformanceTimer(const std::string &s, const std::string &cat, uint64_t unit, gulps::level l) : PerformanceTimer(), name(s), cat(cat), unit(unit)
+LoggingPerformanceTimer::LoggingPerformanceTimer(const std::string &s, const std::string &cat, uint64_t unit, gulps::level l, metrics::histogram *hist) : PerformanceTimer(), name(s), cat(cat), unit(unit), hist(hist)
 {
 	if(!performance_timers)
 	{
@@ -156,6 +156,8 @@ LoggingPerformanceTimer::~LoggingPerformanceTimer()
 {
 	pause();
 	performance_timers->pop_back();
+	if(hist != nullptr)
+		hist->record(ticks_to_ns(ticks));
 	char s[12];
 	snprintf(s, sizeof(s), "%8llu  ", (unsigned long long)(ticks_to_ns(ticks) / (1000000000 / unit)));
 	size_t size = 0;
@@ -45,6 +45,7 @@
 #pragma once
 
 #include "common/gulps.hpp"
+#include "common/metrics.h"
 #include <memory>
 #include <stdio.h>
 #include <string>
@@ -79,22 +80,31 @@ class PerformanceTimer
 class LoggingPerformanceTimer : public PerformanceTimer
 {
   public:
-	LoggingPerformanceTimer(const std::string &s, const std::string &cat, uint64_t unit, gulps::level l = gulps::LEVEL_DEBUG);
+	LoggingPerformanceTimer(const std::string &s, const std::string &cat, uint64_t unit, gulps::level l = gulps::LEVEL_DEBUG, metrics::histogram *hist = nullptr);
 	~LoggingPerformanceTimer();
 
   private:
 	std::string name;
 	std::string cat;
 	uint64_t unit;
+	metrics::histogram *hist; //!< fed with the timing in ns, if set
 };
 
 void set_performance_timer_log_level(gulps::level level);
 
-#define PERF_TIMER_UNIT(name, unit) tools::LoggingPerformanceTimer pt_##name(#name, "perf.oldlog", unit, tools::performance_timer_log_level)
-#define PERF_TIMER_UNIT_L(name, unit, l) tools::LoggingPerformanceTimer pt_##name(#name, "perf.oldlog", unit, l)
+// Every timer site also feeds the registry histogram of the same name
+#define PERF_TIMER_HISTOGRAM(name) static tools::metrics::histogram &pt_hist_##name = tools::metrics::registry::instance().get_histogram(#name, "PERF_TIMER " #name)
+#define PERF_TIMER_UNIT(name, unit) \
+	PERF_TIMER_HISTOGRAM(name);     \
+	tools::LoggingPerformanceTimer pt_##name(#name, "perf.oldlog", unit, tools::performance_timer_log_level, &pt_hist_##name)
+#define PERF_TIMER_UNIT_L(name, unit, l) \
+	PERF_TIMER_HISTOGRAM(name);          \
+	tools::LoggingPerformanceTimer pt_##name(#name, "perf.oldlog", unit, l, &pt_hist_##name)
 #define PERF_TIMER(name) PERF_TIMER_UNIT(name, 1000000)
 #define PERF_TIMER_L(name, l) PERF_TIMER_UNIT_L(name, 1000000, l)
-#define PERF_TIMER_START_UNIT(name, unit) std::unique_ptr<tools::LoggingPerformanceTimer> pt_##name(new tools::LoggingPerformanceTimer(#name, "perf.oldlog", unit, gulps::LEVEL_INFO))
+#define PERF_TIMER_START_UNIT(name, unit) \
+	PERF_TIMER_HISTOGRAM(name);           \
+	std::unique_ptr<tools::LoggingPerformanceTimer> pt_##name(new tools::LoggingPerformanceTimer(#name, "perf.oldlog", unit, gulps::LEVEL_INFO, &pt_hist_##name))
 #define PERF_TIMER_START(name) PERF_TIMER_START_UNIT(name, 1000000)
 #define PERF_TIMER_STOP(name)  \
 	do                         \
@@ -145,6 +145,28 @@ class t_rpc_client final
 		}
 	}
 
+	bool text_request(
+		std::string const &relative_url, std::string &body, std::string const &fail_msg)
+	{
+		t_http_connection connection(&m_http_client);
+
+		bool ok = connection.is_open();
+		if(!ok)
+		{
+			GULPSF_ERROR("Couldn't connect to daemon: {}:{}", m_http_client.get_host(), m_http_client.get_port());
+			return false;
+		}
+		const epee::net_utils::http::http_response_info *info = nullptr;
+		ok = m_http_client.invoke_get(relative_url, t_http_connection::TIMEOUT(), std::string(), &info);
+		if(!ok || !info || info->m_response_code != 200)
+		{
+			GULPSF_ERROR("{}-- text_request: {}", fail_msg, info ? info->m_response_code : 0);
+			return false;
+		}
+		body = info->m_body;
+		return true;
+	}
+
 	bool check_connection()
 	{
 		t_http_connection connection(&m_http_client);
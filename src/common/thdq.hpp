@@ -86,7 +86,7 @@ public:
 	size_t wait_for_size(size_t q_size)
 	{
 		std::unique_lock<std::mutex> mlock(mutex_);
-		while (queue_.size() > q_size) { size_cond_.wait(mlock); }
+		while (queue_.size() > q_size && !finish) { size_cond_.wait(mlock); }
 		return queue_.size();
 	}
 
@@ -122,6 +122,7 @@ public:
 		std::unique_lock<std::mutex> mlock(mutex_);
 		finish = true;
 		cond_.notify_all();
+		size_cond_.notify_all();
 	}
 
 private:
@@ -45,25 +45,33 @@
 #include "common/threadpool.h"
 
 #include <cassert>
+#include <chrono>
 #include <limits>
 #include <stdexcept>
 
 #include "common/util.h"
 #include "cryptonote_config.h"
 
-static __thread int depth = 0;
+// Index + 1 of the pool worker running on this thread, 0 outside the pool
+static __thread size_t worker_id = 0;
 
 namespace tools
 {
-threadpool::threadpool() : running(true), active(0)
+threadpool::threadpool() : next_worker(0), submitted(0), pending(0), sleeping(0), running(true)
 {
 	boost::thread::attributes attrs;
 	attrs.set_stack_size(THREAD_STACK_SIZE);
 	max = tools::get_max_concurrency();
-	size_t i = max;
-	while(i--)
+	workers.reset(new worker[max]);
+	for(int i = 0; i < max; i++)
 	{
-		threads.push_back(boost::thread(attrs, boost::bind(&threadpool::run, this)));
+		workers[i].executed = 0;
+		workers[i].steals = 0;
+		workers[i].idle_us = 0;
+	}
+	for(int i = 0; i < max; i++)
+	{
+		threads.push_back(boost::thread(attrs, boost::bind(&threadpool::run, this, i)));
 	}
 }
 
@@ -80,24 +88,78 @@ threadpool::~threadpool()
 	}
 }
 
-void threadpool::submit(waiter *obj, std::function<void()> f)
+void threadpool::work_deque::push_back(entry &&e)
 {
-	entry e = {obj, f};
 	boost::unique_lock<boost::mutex> lock(mutex);
-	if((active == max && !queue.empty()) || depth > 0)
+	if(tail - head == ring.size())
 	{
-		// if all available threads are already running
-		// and there's work waiting, just run in current thread
-		lock.unlock();
-		++depth;
-		f();
-		--depth;
+		std::vector<entry> grown(ring.size() * 2);
+		for(size_t i = head; i < tail; i++)
+			grown[i - head] = std::move(ring[i % ring.size()]);
+		ring.swap(grown);
+		tail -= head;
+		head = 0;
 	}
-	else
+	ring[tail % ring.size()] = std::move(e);
+	tail++;
+}
+
+bool threadpool::work_deque::pop_back(entry &e)
+{
+	boost::unique_lock<boost::mutex> lock(mutex);
+	if(head == tail)
+		return false;
+	tail--;
+	e = std::move(ring[tail % ring.size()]);
+	return true;
+}
+
+bool threadpool::work_deque::pop_front(entry &e)
+{
+	boost::unique_lock<boost::mutex> lock(mutex);
+	if(head == tail)
+		return false;
+	e = std::move(ring[head % ring.size()]);
+	head++;
+	return true;
+}
+
+bool threadpool::work_deque::take(const waiter *wo, entry &e)
+{
+	boost::unique_lock<boost::mutex> lock(mutex);
+	for(size_t i = tail; i != head; i--)
 	{
-		if(obj)
-			obj->inc();
-		queue.push_back(e);
+		if(ring[(i - 1) % ring.size()].wo != wo)
+			continue;
+		e = std::move(ring[(i - 1) % ring.size()]);
+		// close the gap, the entries after it move one step towards the front
+		for(size_t j = i; j != tail; j++)
+			ring[(j - 1) % ring.size()] = std::move(ring[j % ring.size()]);
+		tail--;
+		return true;
+	}
+	return false;
+}
+
+void threadpool::submit_task(waiter *obj, task &&f)
+{
+	// Tasks submitted from a worker stay local so that they are likely to run on
+	// the same core, anything else is spread over the pool
+	size_t idx = worker_id != 0 ? worker_id - 1 : next_worker.fetch_add(1, std::memory_order_relaxed) % max;
+
+	if(obj)
+		obj->inc();
+	entry e;
+	e.wo = obj;
+	e.f = std::move(f);
+	workers[idx].deque.push_back(std::move(e));
+	submitted.fetch_add(1, std::memory_order_relaxed);
+
+	// Sleepers re-check pending under the mutex, see run()
+	pending.fetch_add(1, std::memory_order_seq_cst);
+	if(sleeping.load(std::memory_order_seq_cst) > 0)
+	{
+		const boost::unique_lock<boost::mutex> lock(mutex);
 		has_work.notify_one();
 	}
 }
@@ -107,6 +169,86 @@ int threadpool::get_max_concurrency()
 	return max;
 }
 
+threadpool::stats threadpool::get_stats() const
+{
+	stats st;
+	st.submitted = submitted.load(std::memory_order_relaxed);
+	st.executed = 0;
+	st.steals = 0;
+	st.idle_us = 0;
+	for(int i = 0; i < max; i++)
+	{
+		st.executed += workers[i].executed.load(std::memory_order_relaxed);
+		st.steals += workers[i].steals.load(std::memory_order_relaxed);
+		st.idle_us += workers[i].idle_us.load(std::memory_order_relaxed);
+	}
+	int64_t p = pending.load(std::memory_order_relaxed);
+	st.queue_depth = p > 0 ? p : 0;
+	return st;
+}
+
+bool threadpool::find_task(size_t self, entry &e)
+{
+	if(self < (size_t)max && workers[self].deque.pop_back(e))
+	{
+		pending.fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	// Steal, starting with the worker after us so thieves don't all hit the same deque
+	size_t start = self < (size_t)max ? self + 1 : next_worker.load(std::memory_order_relaxed);
+	for(int i = 0; i < max; i++)
+	{
+		size_t victim = (start + i) % max;
+		if(victim == self)
+			continue;
+		if(workers[victim].deque.pop_front(e))
+		{
+			pending.fetch_sub(1, std::memory_order_relaxed);
+			if(self < (size_t)max)
+				workers[self].steals.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+	return false;
+}
+
+void threadpool::execute(entry &e)
+{
+	// The waiter is released even if the task throws, or its wait() would never return
+	struct release_waiter
+	{
+		waiter *wo;
+		~release_waiter()
+		{
+			if(wo)
+				wo->dec();
+		}
+	} release{e.wo};
+
+	if(worker_id != 0)
+		workers[worker_id - 1].executed.fetch_add(1, std::memory_order_relaxed);
+	task f(std::move(e.f));
+	f();
+}
+
+bool threadpool::run_one(const waiter *wo)
+{
+	// Our own tasks most likely sit in our deque or, submitted from outside, in any of them
+	size_t self = worker_id != 0 ? worker_id - 1 : 0;
+	entry e;
+	for(int i = 0; i < max; i++)
+	{
+		if(workers[(self + i) % max].deque.take(wo, e))
+		{
+			pending.fetch_sub(1, std::memory_order_relaxed);
+			execute(e);
+			return true;
+		}
+	}
+	return false;
+}
+
 threadpool::waiter::~waiter()
 {
 	{
@@ -126,9 +268,23 @@ threadpool::waiter::~waiter()
 
 void threadpool::waiter::wait()
 {
-	boost::unique_lock<boost::mutex> lock(mt);
-	while(num)
-		cv.wait(lock);
+	// Run our own queued tasks instead of blocking. Whatever is not queued is running on
+	// another thread, the timeout only matters if one of those submits more tasks for us.
+	threadpool &pool = threadpool::getInstance();
+	while(true)
+	{
+		{
+			boost::unique_lock<boost::mutex> lock(mt);
+			if(!num)
+				return;
+		}
+		if(pool.run_one(this))
+			continue;
+
+		boost::unique_lock<boost::mutex> lock(mt);
+		if(num)
+			cv.wait_for(lock, boost::chrono::milliseconds(10));
+	}
 }
 
 void threadpool::waiter::inc()
@@ -145,29 +301,38 @@ void threadpool::waiter::dec()
 		cv.notify_one();
 }
 
-void threadpool::run()
+void threadpool::run(size_t idx)
 {
-	boost::unique_lock<boost::mutex> lock(mutex);
-	while(running)
+	worker_id = idx + 1;
+	worker &self = workers[idx];
+	while(running.load(std::memory_order_relaxed))
 	{
 		entry e;
-		while(queue.empty() && running)
-			has_work.wait(lock);
-		if(!running)
-			break;
+		if(find_task(idx, e))
+		{
+			try
+			{
+				execute(e);
+			}
+			catch(const std::exception &ex)
+			{
+				GULPS_ERROR("Exception in threadpool task: ", ex.what());
+			}
+			catch(...)
+			{
+				GULPS_ERROR("Unknown exception in threadpool task");
+			}
+			continue;
+		}
 
-		active++;
-		e = queue.front();
-		queue.pop_front();
+		std::chrono::steady_clock::time_point idle_start = std::chrono::steady_clock::now();
+		boost::unique_lock<boost::mutex> lock(mutex);
+		sleeping.fetch_add(1, std::memory_order_seq_cst);
+		while(pending.load(std::memory_order_seq_cst) <= 0 && running.load(std::memory_order_relaxed))
+			has_work.wait(lock);
+		sleeping.fetch_sub(1, std::memory_order_relaxed);
 		lock.unlock();
-		++depth;
-		e.f();
-		--depth;
-
-		if(e.wo)
-			e.wo->dec();
-		lock.lock();
-		active--;
+		self.idle_us.fetch_add(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - idle_start).count(), std::memory_order_relaxed);
 	}
 }
 }
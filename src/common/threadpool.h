@@ -48,15 +48,25 @@
 #include <boost/thread/condition_variable.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/thread.hpp>
+#include <atomic>
 #include <cstddef>
 #include <functional>
+#include <memory>
+#include <new>
 #include <stdexcept>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
 namespace tools
 {
-//! A global thread pool
+//! A global work-stealing thread pool
+//
+// Every worker owns a deque, it pushes and pops its own tasks at the back while idle
+// workers steal from the front of the others. Submits from outside the pool are spread
+// round-robin. Waiting on a waiter runs its own queued tasks on the waiting thread, so
+// tasks may submit and wait on nested work without tying up the pool. Other tasks are
+// never run there, the waiting thread may hold locks unrelated work doesn't expect.
 class threadpool
 {
 	GULPS_CAT_MAJOR("thdpool");
@@ -83,28 +93,189 @@ class threadpool
 		~waiter();
 	};
 
+	// Type erased callable stored inline, only callables larger than
+	// inline_size end up on the heap
+	class task
+	{
+	  public:
+		static constexpr size_t inline_size = 64;
+
+		task() : vt(nullptr) {}
+
+		template <typename F, typename Fd = typename std::decay<F>::type,
+				  typename = typename std::enable_if<!std::is_same<Fd, task>::value>::type>
+		task(F &&f) : vt(&vtable_for<Fd>::table)
+		{
+			vtable_for<Fd>::create(&buf, std::forward<F>(f));
+		}
+
+		task(task &&o) noexcept : vt(o.vt)
+		{
+			if(vt)
+			{
+				vt->move(&buf, &o.buf);
+				o.vt = nullptr;
+			}
+		}
+
+		task &operator=(task &&o) noexcept
+		{
+			if(this != &o)
+			{
+				reset();
+				vt = o.vt;
+				if(vt)
+				{
+					vt->move(&buf, &o.buf);
+					o.vt = nullptr;
+				}
+			}
+			return *this;
+		}
+
+		task(const task &) = delete;
+		task &operator=(const task &) = delete;
+
+		~task() { reset(); }
+
+		void operator()() { vt->invoke(&buf); }
+		explicit operator bool() const { return vt != nullptr; }
+
+		void reset()
+		{
+			if(vt)
+			{
+				vt->destroy(&buf);
+				vt = nullptr;
+			}
+		}
+
+	  private:
+		typedef typename std::aligned_storage<inline_size, alignof(std::max_align_t)>::type storage;
+
+		struct vtable
+		{
+			void (*invoke)(void *);
+			void (*move)(void *dst, void *src);
+			void (*destroy)(void *);
+		};
+
+		template <typename F, bool Inline = (sizeof(F) <= inline_size && alignof(F) <= alignof(std::max_align_t))>
+		struct vtable_for
+		{
+			template <typename A>
+			static void create(void *p, A &&f) { new(p) F(std::forward<A>(f)); }
+			static void invoke(void *p) { (*static_cast<F *>(p))(); }
+			static void move(void *dst, void *src)
+			{
+				new(dst) F(std::move(*static_cast<F *>(src)));
+				static_cast<F *>(src)->~F();
+			}
+			static void destroy(void *p) { static_cast<F *>(p)->~F(); }
+			static const vtable table;
+		};
+
+		template <typename F>
+		struct vtable_for<F, false>
+		{
+			template <typename A>
+			static void create(void *p, A &&f) { *static_cast<F **>(p) = new F(std::forward<A>(f)); }
+			static void invoke(void *p) { (**static_cast<F **>(p))(); }
+			static void move(void *dst, void *src) { *static_cast<F **>(dst) = *static_cast<F **>(src); }
+			static void destroy(void *p) { delete *static_cast<F **>(p); }
+			static const vtable table;
+		};
+
+		const vtable *vt;
+		storage buf;
+	};
+
+	struct stats
+	{
+		uint64_t submitted;
+		uint64_t executed;   // by pool workers, the rest ran on threads blocked in waiter::wait()
+		uint64_t steals;
+		uint64_t idle_us;    // summed over all workers
+		uint64_t queue_depth; // tasks currently queued
+	};
+
 	// Submit a task to the pool. The waiter pointer may be
 	// NULL if the caller doesn't care to wait for the
 	// task to finish.
-	void submit(waiter *waiter, std::function<void()> f);
+	template <typename F>
+	void submit(waiter *waiter, F &&f)
+	{
+		submit_task(waiter, task(std::forward<F>(f)));
+	}
 
 	int get_max_concurrency();
 
+	stats get_stats() const;
+
   private:
 	threadpool();
 	~threadpool();
-	typedef struct entry
+
+	struct entry
 	{
 		waiter *wo;
-		std::function<void()> f;
-	} entry;
-	std::deque<entry> queue;
+		task f;
+	};
+
+	// Ring of entries guarded by a per-worker lock, grows by doubling
+	class work_deque
+	{
+	  public:
+		work_deque() : head(0), tail(0) { ring.resize(64); }
+
+		void push_back(entry &&e);
+		bool pop_back(entry &e);
+		bool pop_front(entry &e);
+		bool take(const waiter *wo, entry &e); // newest entry of that waiter
+
+	  private:
+		boost::mutex mutex;
+		std::vector<entry> ring;
+		size_t head;
+		size_t tail;
+	};
+
+	struct worker
+	{
+		work_deque deque;
+		std::atomic<uint64_t> executed;
+		std::atomic<uint64_t> steals;
+		std::atomic<uint64_t> idle_us;
+		char pad[64];
+	};
+
+	void submit_task(waiter *waiter, task &&f);
+	bool find_task(size_t self, entry &e);
+	void execute(entry &e);
+	bool run_one(const waiter *wo); // run a queued task of wo on the calling thread if there is one
+	void run(size_t idx);
+
+	std::unique_ptr<worker[]> workers;
+	std::vector<boost::thread> threads;
+	std::atomic<size_t> next_worker;
+	std::atomic<uint64_t> submitted;
+	std::atomic<int64_t> pending;
+	std::atomic<int> sleeping;
 	boost::condition_variable has_work;
 	boost::mutex mutex;
-	std::vector<boost::thread> threads;
-	int active;
 	int max;
-	bool running;
-	void run();
+	std::atomic<bool> running;
 };
+
+template <typename F, bool Inline>
+const threadpool::task::vtable threadpool::task::vtable_for<F, Inline>::table = {
+	&threadpool::task::vtable_for<F, Inline>::invoke,
+	&threadpool::task::vtable_for<F, Inline>::move,
+	&threadpool::task::vtable_for<F, Inline>::destroy};
+
+template <typename F>
+const threadpool::task::vtable threadpool::task::vtable_for<F, false>::table = {
+	&threadpool::task::vtable_for<F, false>::invoke,
+	&threadpool::task::vtable_for<F, false>::move,
+	&threadpool::task::vtable_for<F, false>::destroy};
 }
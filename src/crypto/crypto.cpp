@@ -369,6 +369,99 @@ bool crypto_ops::derive_subaddress_public_key_64(const public_key& out_key, cons
 
 #endif
 
+#ifdef HAVE_EC_64
+// Number of points sharing a single field inversion in the batched functions
+static constexpr size_t EC64_BATCH_SIZE = 64;
+#endif
+
+void crypto_ops::generate_key_derivations(const secret_key &view_key, tx_key_derivation *derivations, std::size_t count)
+{
+#ifdef HAVE_EC_64
+	ge64_p2 points[EC64_BATCH_SIZE];
+	fe64 recip[EC64_BATCH_SIZE];
+	unsigned char *out[EC64_BATCH_SIZE];
+	assert(sc_check(&view_key) == 0);
+
+	for(size_t i = 0; i < count;)
+	{
+		size_t n = 0;
+		for(; i < count && n < EC64_BATCH_SIZE; i++)
+		{
+			tx_key_derivation &d = derivations[i];
+			ge64_p3 point;
+			ge64_p1p1 point3;
+			d.valid = ge64_frombytes_vartime(&point, &d.tx_key) == 0;
+			if(!d.valid)
+				continue;
+			ge64_scalarmult(&points[n], &unwrap(view_key), &point);
+			ge64_mul8(&point3, &points[n]);
+			ge64_p1p1_to_p2(&points[n], &point3);
+			out[n++] = &d.derivation;
+		}
+		ge64_tobytes_batch(out, points, recip, n);
+	}
+#else
+	for(size_t i = 0; i < count; i++)
+	{
+		tx_key_derivation &d = derivations[i];
+		d.valid = generate_key_derivation(d.tx_key, view_key, d.derivation);
+	}
+#endif
+}
+
+void crypto_ops::derive_subaddress_public_keys(subaddress_derivation *derivations, std::size_t count)
+{
+#ifdef HAVE_EC_64
+	ge64_p2 points[EC64_BATCH_SIZE];
+	fe64 recip[EC64_BATCH_SIZE];
+	unsigned char *out[EC64_BATCH_SIZE];
+
+	for(size_t i = 0; i < count;)
+	{
+		size_t n = 0;
+		for(; i < count && n < EC64_BATCH_SIZE; i++)
+		{
+			subaddress_derivation &d = derivations[i];
+			ec_scalar scalar;
+			ge64_p3 point1;
+			ge64_p3 point3;
+			ge64_p1p1 point4;
+			d.valid = ge64_frombytes_vartime(&point1, &d.out_key) == 0;
+			if(!d.valid)
+				continue;
+			derivation_to_scalar(d.derivation, d.output_index, scalar);
+			ge64_scalarmult_base(&point3, &scalar);
+			ge64_sub(&point4, &point1, &point3);
+			ge64_p1p1_to_p2(&points[n], &point4);
+			out[n++] = &d.spend_key;
+		}
+		ge64_tobytes_batch(out, points, recip, n);
+	}
+#else
+	for(size_t i = 0; i < count; i++)
+	{
+		subaddress_derivation &d = derivations[i];
+		d.valid = derive_subaddress_public_key(d.out_key, d.derivation, d.output_index, d.spend_key);
+	}
+#endif
+}
+
+bool crypto_ops::check_keys(const public_key *keys, std::size_t count)
+{
+	for(size_t i = 0; i < count; i++)
+	{
+#ifdef HAVE_EC_64
+		ge64_p3 point;
+		if(ge64_frombytes_strict_vartime(&point, &keys[i]) != 0)
+			return false;
+#else
+		if(!check_key(keys[i]))
+			return false;
+#endif
+	}
+	return true;
+}
+
 struct s_comm
 {
 	hash h;
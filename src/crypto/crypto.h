@@ -126,6 +126,24 @@ struct signature
 	friend class crypto_ops;
 };
 
+// Batched key derivation, see generate_key_derivations
+struct tx_key_derivation
+{
+	public_key tx_key;
+	key_derivation derivation;
+	bool valid;
+};
+
+// Batched subaddress spend key derivation, see derive_subaddress_public_keys
+struct subaddress_derivation
+{
+	public_key out_key;
+	key_derivation derivation;
+	uint64_t output_index;
+	public_key spend_key;
+	bool valid;
+};
+
 // New payment id system
 struct uniform_payment_id
 {
@@ -159,6 +177,8 @@ class crypto_ops
 
 	static bool check_key(const public_key &);
 	friend bool check_key(const public_key &);
+	static bool check_keys(const public_key *, std::size_t);
+	friend bool check_keys(const public_key *, std::size_t);
 	static bool secret_key_to_public_key(const secret_key &, public_key &);
 	friend bool secret_key_to_public_key(const secret_key &, public_key &);
 	static bool generate_key_derivation(const public_key &, const secret_key &, key_derivation &);
@@ -177,6 +197,10 @@ class crypto_ops
 	static bool derive_subaddress_public_key_64(const public_key &, const key_derivation &, std::size_t, public_key &);
 	friend bool derive_subaddress_public_key_64(const public_key &, const key_derivation &, std::size_t, public_key &);
 #endif
+	static void generate_key_derivations(const secret_key &, tx_key_derivation *, std::size_t);
+	friend void generate_key_derivations(const secret_key &, tx_key_derivation *, std::size_t);
+	static void derive_subaddress_public_keys(subaddress_derivation *, std::size_t);
+	friend void derive_subaddress_public_keys(subaddress_derivation *, std::size_t);
 	static void generate_signature(const hash &, const public_key &, const secret_key &, signature &);
 	friend void generate_signature(const hash &, const public_key &, const secret_key &, signature &);
 	static bool check_signature(const hash &, const public_key &, const signature &);
@@ -247,6 +271,13 @@ inline bool check_key(const public_key &key)
 	return crypto_ops::check_key(key);
 }
 
+/* Check a set of public keys. Returns true if all of them are valid, false otherwise.
+   */
+inline bool check_keys(const public_key *keys, std::size_t count)
+{
+	return crypto_ops::check_keys(keys, count);
+}
+
 /* Checks a private key and computes the corresponding public key.
    */
 inline bool secret_key_to_public_key(const secret_key &sec, public_key &pub)
@@ -294,6 +325,20 @@ inline bool derive_subaddress_public_key_64(const public_key &out_key, const key
 }
 #endif
 
+/* Batched versions of generate_key_derivation and derive_subaddress_public_key used when scanning
+   * whole block ranges. Each entry carries its own inputs and output, valid is set to false if the
+   * input point could not be decoded. The 64bit curve implementation is used when available, it
+   * converts the results back to bytes with one field inversion per batch of points.
+   */
+inline void generate_key_derivations(const secret_key &view_key, tx_key_derivation *derivations, std::size_t count)
+{
+	crypto_ops::generate_key_derivations(view_key, derivations, count);
+}
+inline void derive_subaddress_public_keys(subaddress_derivation *derivations, std::size_t count)
+{
+	crypto_ops::derive_subaddress_public_keys(derivations, count);
+}
+
 /* Generation and checking of a standard signature.
    */
 inline void generate_signature(const hash &prefix_hash, const public_key &pub, const secret_key &sec, signature &sig)
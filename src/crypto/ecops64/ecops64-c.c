@@ -307,11 +307,10 @@ int ge64_frombytes_vartime(ge64_p3* h, const unsigned char p[32])
 	return 0;
 }
 
-void ge64_tobytes(unsigned char s[32], const ge64_p2* h)
+static inline void ge64_tobytes_recip(unsigned char s[32], const ge64_p2* h, const fe64 recip)
 {
-	fe64 recip, x, y;
+	fe64 x, y;
 
-	fe64_invert(recip, h->z);
 	fe64_mul(x, h->x, recip);
 	fe64_mul(y, h->y, recip);
 	fe64_pack(s, y);
@@ -319,6 +318,64 @@ void ge64_tobytes(unsigned char s[32], const ge64_p2* h)
 	s[31] ^= fe64_isnegative(x) << 7;
 }
 
+void ge64_tobytes(unsigned char s[32], const ge64_p2* h)
+{
+	fe64 recip;
+
+	fe64_invert(recip, h->z);
+	ge64_tobytes_recip(s, h, recip);
+}
+
+int ge64_frombytes_strict_vartime(ge64_p3* h, const unsigned char p[32])
+{
+	const uint64_t* v = (const uint64_t*)p;
+
+	/* Validate the number to be canonical, y < 2^255 - 19 */
+	if(v[0] >= 0xffffffffffffffedULL && v[1] == 0xffffffffffffffffULL &&
+	   v[2] == 0xffffffffffffffffULL && (v[3] & 0x7fffffffffffffffULL) == 0x7fffffffffffffffULL)
+		return -1;
+
+	return ge64_frombytes_vartime(h, p);
+}
+
+void ge64_tobytes_batch(unsigned char* const* s, const ge64_p2* h, fe64* recip, size_t count)
+{
+	fe64 acc, t, zero;
+	size_t i;
+
+	if(count == 0)
+		return;
+
+	/* recip[i] = z0 * ... * zi, a zero z is left out so it does not zero the whole product,
+	   that point is then encoded with a zero inverse like ge64_tobytes does */
+	fe64_setint(zero, 0);
+	fe64_setint(acc, 1);
+	for(i = 0; i < count; i++)
+	{
+		if(fe64_iszero_vartime(h[i].z))
+			fe64_copy(recip[i], acc);
+		else
+			fe64_mul(recip[i], acc, h[i].z);
+		fe64_copy(acc, recip[i]);
+	}
+
+	fe64_invert(acc, recip[count - 1]);
+
+	/* acc = 1 / (z0 * ... * zi) on entry of each step */
+	for(i = count - 1; i > 0; i--)
+	{
+		if(fe64_iszero_vartime(h[i].z))
+		{
+			ge64_tobytes_recip(s[i], &h[i], zero);
+			continue;
+		}
+		fe64_mul(t, acc, recip[i - 1]);
+		fe64_mul(acc, acc, h[i].z);
+		ge64_tobytes_recip(s[i], &h[i], t);
+	}
+	ge64_tobytes_recip(s[0], &h[0], fe64_iszero_vartime(h[0].z) ? zero : acc);
+}
+
 /* no overflow for this particular order */
 extern const uint64_t sc64_reduce_order[16];
 
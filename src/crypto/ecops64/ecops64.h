@@ -147,6 +147,12 @@ extern "C"
 
 	void ge64_sub(ge64_p1p1* r, const ge64_p3* p, const ge64_p3* q);
 
+	/* Same as ge64_frombytes_vartime but rejects non-canonical encodings like ge_frombytes_vartime does */
+	int ge64_frombytes_strict_vartime(ge64_p3* h, const unsigned char p[32]);
+	/* Converts count points to bytes sharing a single field inversion (Montgomery's trick),
+	   recip is scratch space of count elements. A point with z = 0 gives the same bytes as ge64_tobytes */
+	void ge64_tobytes_batch(unsigned char* const* s, const ge64_p2* h, fe64* recip, size_t count);
+
 #ifdef __cplusplus
 }
 #endif // __cplusplus
@@ -102,6 +102,31 @@ inline bool check_avx2()
 	const bool osxsave = (cpu_info[2] & (1 << 27)) != 0;
 	return has_avx2 && osxsave;
 }
+
+inline uint64_t xgetbv0()
+{
+#if defined(HAS_WIN_INTRIN_API)
+	return _xgetbv(0);
+#else
+	uint32_t lo, hi;
+	__asm__ __volatile__("xgetbv"
+						 : "=a"(lo), "=d"(hi)
+						 : "c"(0));
+	return (uint64_t(hi) << 32) | lo;
+#endif
+}
+
+inline bool check_vaes()
+{
+	int32_t cpu_info[4];
+	cpuid(7, 0, cpu_info);
+	const bool has_avx512f = (cpu_info[1] & (1 << 16)) != 0;
+	const bool has_vaes = (cpu_info[2] & (1 << 9)) != 0;
+	cpuid(1, 0, cpu_info);
+	const bool osxsave = (cpu_info[2] & (1 << 27)) != 0;
+	// The OS also has to save the opmask and the full ZMM registers (XCR0 bits 1, 2, 5, 6, 7)
+	return has_avx512f && has_vaes && osxsave && (xgetbv0() & 0xE6) == 0xE6;
+}
 #endif
 
 #ifdef HAS_ARM_HW
@@ -220,6 +245,23 @@ class cn_slow_hash
 		}
 	}
 
+	// Hashes N blobs at once, lane i using ctx[i] and with it its own scratchpad. With AES-NI the
+	// main loops of the lanes are interleaved so that the AES and scratchpad latency of one lane
+	// is hidden behind the work of the others. cn-gpu and the other back ends hash lane by lane.
+	template <size_t N>
+	static void hash_multi(cn_slow_hash* const* ctx, const void* const* in, const size_t* len, void* const* out)
+	{
+#if defined(HAS_INTEL_HW)
+		if(VERSION <= 1 && hw_check_aes() && !ctx[0]->check_override())
+		{
+			hardware_hash_multi<N>(ctx, in, len, out);
+			return;
+		}
+#endif
+		for(size_t i = 0; i < N; i++)
+			ctx[i]->hash(in[i], len[i], out[i]);
+	}
+
 	void software_hash(const void* in, size_t len, void* out);
 	void software_hash_3(const void* in, size_t len, void* pout);
 
@@ -234,6 +276,11 @@ class cn_slow_hash
 	void hardware_hash_3(const void* in, size_t len, void* pout);
 #endif
 
+#if defined(HAS_INTEL_HW)
+	template <size_t N>
+	static void hardware_hash_multi(cn_slow_hash* const* ctx, const void* const* in, const size_t* len, void* const* out);
+#endif
+
   private:
 	static constexpr size_t MASK = VERSION <= 1 ? ((MEMORY - 1) >> 4) << 4 : ((MEMORY - 1) >> 6) << 6;
 
@@ -294,6 +341,10 @@ class cn_slow_hash
 	void implode_scratchpad_hard();
 #endif
 
+	// AVX-512 + VAES variants, four AES blocks per instruction
+	void explode_scratchpad_vaes();
+	void implode_scratchpad_vaes();
+
 	void explode_scratchpad_3();
 	void explode_scratchpad_soft();
 	void implode_scratchpad_soft();
@@ -333,9 +333,13 @@ inline uint64_t xmm_extract_64(__m128i x)
 template <size_t MEMORY, size_t ITER, size_t VERSION>
 void cn_slow_hash<MEMORY, ITER, VERSION>::hardware_hash(const void* in, size_t len, void* out)
 {
+	const bool vaes = check_vaes();
 	keccak((const uint8_t*)in, len, spad.as_byte(), 200);
 
-	explode_scratchpad_hard();
+	if(vaes)
+		explode_scratchpad_vaes();
+	else
+		explode_scratchpad_hard();
 
 	uint64_t* h0 = spad.as_uqword();
 
@@ -381,7 +385,10 @@ void cn_slow_hash<MEMORY, ITER, VERSION>::hardware_hash(const void* in, size_t l
 		}
 	}
 
-	implode_scratchpad_hard();
+	if(vaes)
+		implode_scratchpad_vaes();
+	else
+		implode_scratchpad_hard();
 
 	keccakf(spad.as_uqword());
 
@@ -402,6 +409,100 @@ void cn_slow_hash<MEMORY, ITER, VERSION>::hardware_hash(const void* in, size_t l
 	}
 }
 
+template <size_t MEMORY, size_t ITER, size_t VERSION>
+template <size_t N>
+void cn_slow_hash<MEMORY, ITER, VERSION>::hardware_hash_multi(cn_slow_hash* const* ctx, const void* const* in, const size_t* len, void* const* out)
+{
+	uint64_t al[N], ah[N], idx[N];
+	__m128i bx[N];
+
+	const bool vaes = check_vaes();
+	for(size_t l = 0; l < N; l++)
+	{
+		keccak((const uint8_t*)in[l], len[l], ctx[l]->spad.as_byte(), 200);
+
+		if(vaes)
+			ctx[l]->explode_scratchpad_vaes();
+		else
+			ctx[l]->explode_scratchpad_hard();
+
+		uint64_t* h = ctx[l]->spad.as_uqword();
+		al[l] = h[0] ^ h[4];
+		ah[l] = h[1] ^ h[5];
+		bx[l] = _mm_set_epi64x(h[3] ^ h[7], h[2] ^ h[6]);
+		idx[l] = h[0] ^ h[4];
+	}
+
+	// Same loop as hardware_hash, but every step is issued for all lanes before moving on
+	// to the next one, so the lanes' dependency chains overlap in the pipeline
+	for(size_t i = 0; i < ITER; i++)
+	{
+		for(size_t l = 0; l < N; l++)
+		{
+			__m128i cx;
+			cx = _mm_load_si128(ctx[l]->scratchpad_ptr(idx[l]).template as_ptr<__m128i>());
+
+			cx = _mm_aesenc_si128(cx, _mm_set_epi64x(ah[l], al[l]));
+
+			_mm_store_si128(ctx[l]->scratchpad_ptr(idx[l]).template as_ptr<__m128i>(), _mm_xor_si128(bx[l], cx));
+			idx[l] = xmm_extract_64(cx);
+			bx[l] = cx;
+		}
+
+		for(size_t l = 0; l < N; l++)
+		{
+			uint64_t hi, lo, cl, ch;
+			cl = ctx[l]->scratchpad_ptr(idx[l]).as_uqword(0);
+			ch = ctx[l]->scratchpad_ptr(idx[l]).as_uqword(1);
+
+			lo = _umul128(idx[l], cl, &hi);
+
+			al[l] += hi;
+			ah[l] += lo;
+			ctx[l]->scratchpad_ptr(idx[l]).as_uqword(0) = al[l];
+			ctx[l]->scratchpad_ptr(idx[l]).as_uqword(1) = ah[l];
+			ah[l] ^= ch;
+			al[l] ^= cl;
+			idx[l] = al[l];
+		}
+
+		for(size_t l = 0; VERSION > 0 && l < N; l++)
+		{
+			int64_t n = ctx[l]->scratchpad_ptr(idx[l]).as_qword(0);
+			int32_t d = ctx[l]->scratchpad_ptr(idx[l]).as_dword(2);
+			int64_t q = n / (d | 5);
+			ctx[l]->scratchpad_ptr(idx[l]).as_qword(0) = n ^ q;
+			idx[l] = d ^ q;
+		}
+	}
+
+	for(size_t l = 0; l < N; l++)
+	{
+		if(vaes)
+			ctx[l]->implode_scratchpad_vaes();
+		else
+			ctx[l]->implode_scratchpad_hard();
+
+		keccakf(ctx[l]->spad.as_uqword());
+
+		switch(ctx[l]->spad.as_byte(0) & 3)
+		{
+		case 0:
+			blake256_hash(ctx[l]->spad.as_byte(), (uint8_t*)out[l]);
+			break;
+		case 1:
+			groestl_hash(ctx[l]->spad.as_byte(), (uint8_t*)out[l]);
+			break;
+		case 2:
+			jh_hash(ctx[l]->spad.as_byte(), (uint8_t*)out[l]);
+			break;
+		case 3:
+			skein_hash(ctx[l]->spad.as_byte(), (uint8_t*)out[l]);
+			break;
+		}
+	}
+}
+
 inline void prep_dv(cn_sptr& idx, __m128i& v, __m128& n)
 {
 	v = _mm_load_si128(idx.as_ptr<__m128i>());
@@ -590,7 +691,10 @@ void cn_slow_hash<MEMORY, ITER, VERSION>::hardware_hash_3(const void* in, size_t
 		inner_hash_3_avx();
 	else
 		inner_hash_3();
-	implode_scratchpad_hard();
+	if(check_vaes())
+		implode_scratchpad_vaes();
+	else
+		implode_scratchpad_hard();
 
 	keccakf(spad.as_uqword());
 	memcpy(pout, spad.as_byte(), 32);
@@ -615,4 +719,11 @@ void cn_slow_hash<MEMORY, ITER, VERSION>::software_hash_3(const void* in, size_t
 template class cn_v1_hash_t;
 template class cn_v2_hash_t;
 template class cn_v3_hash_t;
+
+template void cn_v1_hash_t::hardware_hash_multi<2>(cn_v1_hash_t* const*, const void* const*, const size_t*, void* const*);
+template void cn_v1_hash_t::hardware_hash_multi<4>(cn_v1_hash_t* const*, const void* const*, const size_t*, void* const*);
+template void cn_v2_hash_t::hardware_hash_multi<2>(cn_v2_hash_t* const*, const void* const*, const size_t*, void* const*);
+template void cn_v2_hash_t::hardware_hash_multi<4>(cn_v2_hash_t* const*, const void* const*, const size_t*, void* const*);
+template void cn_v3_hash_t::hardware_hash_multi<2>(cn_v3_hash_t* const*, const void* const*, const size_t*, void* const*);
+template void cn_v3_hash_t::hardware_hash_multi<4>(cn_v3_hash_t* const*, const void* const*, const size_t*, void* const*);
 #endif
@@ -0,0 +1,208 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Portions of this file are available under BSD-3 license. Please see ORIGINAL-LICENSE for details
+// All rights reserved.
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// Parts of this file are originally copyright (c) 2014-2017, SUMOKOIN
+
+#define CN_ADD_TARGETS_AND_HEADERS
+#define INTEL_VAES
+
+#include "cn_slow_hash.hpp"
+
+#ifdef HAS_INTEL_HW
+#if defined(__GNUC__) && !defined(__clang__)
+// GCC's AVX-512 headers seed some intrinsics with _mm512_undefined_epi32(), which trips -Wuninitialized
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#endif
+
+// The scratchpad is walked as in cn_slow_hash_hard_intel.cpp, but the eight AES states x0 - x7 are
+// held in two ZMM registers, x0 - x3 and x4 - x7, so each AES round takes two instructions instead of eight.
+// Helpers carry a _vaes suffix so they can never be merged with the SSE versions at link time.
+
+inline __m128i sl_xor_vaes(__m128i tmp1)
+{
+	__m128i tmp4;
+	tmp4 = _mm_slli_si128(tmp1, 0x04);
+	tmp1 = _mm_xor_si128(tmp1, tmp4);
+	tmp4 = _mm_slli_si128(tmp4, 0x04);
+	tmp1 = _mm_xor_si128(tmp1, tmp4);
+	tmp4 = _mm_slli_si128(tmp4, 0x04);
+	tmp1 = _mm_xor_si128(tmp1, tmp4);
+	return tmp1;
+}
+
+template <uint8_t rcon>
+inline void aes_genkey_sub_vaes(__m128i& xout0, __m128i& xout2)
+{
+	__m128i xout1 = _mm_aeskeygenassist_si128(xout2, rcon);
+	xout1 = _mm_shuffle_epi32(xout1, 0xFF);
+	xout0 = sl_xor_vaes(xout0);
+	xout0 = _mm_xor_si128(xout0, xout1);
+	xout1 = _mm_aeskeygenassist_si128(xout0, 0x00);
+	xout1 = _mm_shuffle_epi32(xout1, 0xAA);
+	xout2 = sl_xor_vaes(xout2);
+	xout2 = _mm_xor_si128(xout2, xout1);
+}
+
+// Expands the key as aes_genkey does and broadcasts every round key to all four 128-bit lanes
+inline void aes_genkey_vaes(const __m128i* memory, __m512i* k)
+{
+	__m128i xout0, xout2;
+
+	xout0 = _mm_load_si128(memory);
+	xout2 = _mm_load_si128(memory + 1);
+	k[0] = _mm512_broadcast_i32x4(xout0);
+	k[1] = _mm512_broadcast_i32x4(xout2);
+
+	aes_genkey_sub_vaes<0x01>(xout0, xout2);
+	k[2] = _mm512_broadcast_i32x4(xout0);
+	k[3] = _mm512_broadcast_i32x4(xout2);
+
+	aes_genkey_sub_vaes<0x02>(xout0, xout2);
+	k[4] = _mm512_broadcast_i32x4(xout0);
+	k[5] = _mm512_broadcast_i32x4(xout2);
+
+	aes_genkey_sub_vaes<0x04>(xout0, xout2);
+	k[6] = _mm512_broadcast_i32x4(xout0);
+	k[7] = _mm512_broadcast_i32x4(xout2);
+
+	aes_genkey_sub_vaes<0x08>(xout0, xout2);
+	k[8] = _mm512_broadcast_i32x4(xout0);
+	k[9] = _mm512_broadcast_i32x4(xout2);
+}
+
+inline void aes_round10_vaes(const __m512i* k, __m512i& x0, __m512i& x1)
+{
+	for(size_t i = 0; i < 10; i++)
+	{
+		x0 = _mm512_aesenc_epi128(x0, k[i]);
+		x1 = _mm512_aesenc_epi128(x1, k[i]);
+	}
+}
+
+// x0 ^= x1, x1 ^= x2, ..., x7 ^= x0
+inline void xor_shift_vaes(__m512i& x0, __m512i& x1)
+{
+	__m512i tmp0 = x0;
+	x0 = _mm512_xor_si512(x0, _mm512_alignr_epi64(x1, x0, 2));
+	x1 = _mm512_xor_si512(x1, _mm512_alignr_epi64(tmp0, x1, 2));
+}
+
+template <size_t MEMORY, size_t ITER, size_t VERSION>
+void cn_slow_hash<MEMORY, ITER, VERSION>::implode_scratchpad_vaes()
+{
+	__m512i x0, x1;
+	__m512i k[10];
+
+	aes_genkey_vaes(spad.as_ptr<__m128i>() + 2, k);
+
+	x0 = _mm512_load_si512(spad.as_ptr<__m512i>() + 1);
+	x1 = _mm512_load_si512(spad.as_ptr<__m512i>() + 2);
+
+	for(size_t i = 0; i < MEMORY / sizeof(__m512i); i += 2)
+	{
+		x0 = _mm512_xor_si512(_mm512_load_si512(lpad.as_ptr<__m512i>() + i + 0), x0);
+		x1 = _mm512_xor_si512(_mm512_load_si512(lpad.as_ptr<__m512i>() + i + 1), x1);
+
+		aes_round10_vaes(k, x0, x1);
+
+		if(VERSION > 0)
+			xor_shift_vaes(x0, x1);
+	}
+
+	for(size_t i = 0; VERSION > 0 && i < MEMORY / sizeof(__m512i); i += 2)
+	{
+		x0 = _mm512_xor_si512(_mm512_load_si512(lpad.as_ptr<__m512i>() + i + 0), x0);
+		x1 = _mm512_xor_si512(_mm512_load_si512(lpad.as_ptr<__m512i>() + i + 1), x1);
+
+		aes_round10_vaes(k, x0, x1);
+
+		xor_shift_vaes(x0, x1);
+	}
+
+	for(size_t i = 0; VERSION > 0 && i < 16; i++)
+	{
+		aes_round10_vaes(k, x0, x1);
+
+		xor_shift_vaes(x0, x1);
+	}
+
+	_mm512_store_si512(spad.as_ptr<__m512i>() + 1, x0);
+	_mm512_store_si512(spad.as_ptr<__m512i>() + 2, x1);
+}
+
+template <size_t MEMORY, size_t ITER, size_t VERSION>
+void cn_slow_hash<MEMORY, ITER, VERSION>::explode_scratchpad_vaes()
+{
+	__m512i x0, x1;
+	__m512i k[10];
+
+	aes_genkey_vaes(spad.as_ptr<__m128i>(), k);
+
+	x0 = _mm512_load_si512(spad.as_ptr<__m512i>() + 1);
+	x1 = _mm512_load_si512(spad.as_ptr<__m512i>() + 2);
+
+	for(size_t i = 0; VERSION > 0 && i < 16; i++)
+	{
+		aes_round10_vaes(k, x0, x1);
+
+		xor_shift_vaes(x0, x1);
+	}
+
+	for(size_t i = 0; i < MEMORY / sizeof(__m512i); i += 2)
+	{
+		aes_round10_vaes(k, x0, x1);
+
+		_mm512_store_si512(lpad.as_ptr<__m512i>() + i + 0, x0);
+		_mm512_store_si512(lpad.as_ptr<__m512i>() + i + 1, x1);
+	}
+}
+
+// Only the members defined here are instantiated, so that nothing shared with the
+// other back ends is ever emitted with AVX-512 code in it
+template void cn_v1_hash_t::explode_scratchpad_vaes();
+template void cn_v1_hash_t::implode_scratchpad_vaes();
+template void cn_v2_hash_t::explode_scratchpad_vaes();
+template void cn_v2_hash_t::implode_scratchpad_vaes();
+template void cn_v3_hash_t::explode_scratchpad_vaes();
+template void cn_v3_hash_t::implode_scratchpad_vaes();
+#endif
@@ -93,6 +93,10 @@
 #pragma GCC target("fpu=vfpv4")
 #endif
 #include "arm_vfp.hpp"
+#elif defined(HAS_INTEL_HW) && defined(INTEL_VAES)
+#ifndef __clang__
+#pragma GCC target("aes,avx2,avx512f,vaes")
+#endif
 #elif defined(HAS_INTEL_HW) && defined(INTEL_AVX2)
 #ifndef __clang__
 #pragma GCC target("aes,avx2")
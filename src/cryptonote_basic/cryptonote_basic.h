@@ -53,6 +53,7 @@
 #include "misc_language.h"
 #include "ringct/rctTypes.h"
 #include "serialization/binary_archive.h"
+#include "serialization/binary_span_archive.h"
 #include "serialization/crypto.h"
 #include "serialization/debug_archive.h"
 #include "serialization/json_archive.h"
@@ -204,9 +204,7 @@ bool expand_transaction_1(transaction &tx, bool base_only)
 //---------------------------------------------------------------
 bool parse_and_validate_tx_from_blob(const blobdata &tx_blob, transaction &tx)
 {
-	std::stringstream ss;
-	ss << tx_blob;
-	binary_archive<false> ba(ss);
+	binary_span_archive<false> ba(tx_blob);
 	bool r = ::serialization::serialize(ba, tx);
 	GULPS_CHECK_AND_ASSERT_MES(r, false, "Failed to parse transaction from blob");
 	GULPS_CHECK_AND_ASSERT_MES(expand_transaction_1(tx, false), false, "Failed to expand transaction data");
@@ -216,9 +214,7 @@ bool parse_and_validate_tx_from_blob(const blobdata &tx_blob, transaction &tx)
 //---------------------------------------------------------------
 bool parse_and_validate_tx_base_from_blob(const blobdata &tx_blob, transaction &tx)
 {
-	std::stringstream ss;
-	ss << tx_blob;
-	binary_archive<false> ba(ss);
+	binary_span_archive<false> ba(tx_blob);
 	bool r = tx.serialize_base(ba);
 	GULPS_CHECK_AND_ASSERT_MES(r, false, "Failed to parse transaction from blob");
 	GULPS_CHECK_AND_ASSERT_MES(expand_transaction_1(tx, true), false, "Failed to expand transaction data");
@@ -227,9 +223,7 @@ bool parse_and_validate_tx_base_from_blob(const blobdata &tx_blob, transaction &
 //---------------------------------------------------------------
 bool parse_and_validate_tx_from_blob(const blobdata &tx_blob, transaction &tx, crypto::hash &tx_hash, crypto::hash &tx_prefix_hash)
 {
-	std::stringstream ss;
-	ss << tx_blob;
-	binary_archive<false> ba(ss);
+	binary_span_archive<false> ba(tx_blob);
 	bool r = ::serialization::serialize(ba, tx);
 	GULPS_CHECK_AND_ASSERT_MES(r, false, "Failed to parse transaction from blob");
 	GULPS_CHECK_AND_ASSERT_MES(expand_transaction_1(tx, false), false, "Failed to expand transaction data");
@@ -383,9 +377,7 @@ bool parse_tx_extra(const std::vector<uint8_t> &tx_extra, std::vector<tx_extra_f
 	if(tx_extra.empty())
 		return true;
 
-	std::string extra_str(reinterpret_cast<const char *>(tx_extra.data()), tx_extra.size());
-	std::istringstream iss(extra_str);
-	binary_archive<false> ar(iss);
+	binary_span_archive<false> ar(epee::to_span(tx_extra));
 
 	bool eof = false;
 	while(!eof)
@@ -398,9 +390,9 @@ bool parse_tx_extra(const std::vector<uint8_t> &tx_extra, std::vector<tx_extra_f
 
 		tx_extra_fields.push_back(field);
 
-		std::ios_base::iostate state = iss.rdstate();
-		eof = (EOF == iss.peek());
-		iss.clear(state);
+		std::ios_base::iostate state = ar.stream().rdstate();
+		eof = (EOF == ar.stream().peek());
+		ar.stream().clear(state);
 	}
 	GULPS_CHECK_AND_NO_ASSERT_MES_L1(::serialization::check_stream_state(ar), false, "failed to deserialize extra field. extra = " , string_tools::buff_to_hex_nodelimer(std::string(reinterpret_cast<const char *>(tx_extra.data()), tx_extra.size())));
 
@@ -501,9 +493,7 @@ bool remove_field_from_tx_extra(std::vector<uint8_t> &tx_extra, const std::type_
 {
 	if(tx_extra.empty())
 		return true;
-	std::string extra_str(reinterpret_cast<const char *>(tx_extra.data()), tx_extra.size());
-	std::istringstream iss(extra_str);
-	binary_archive<false> ar(iss);
+	binary_span_archive<false> ar(epee::to_span(tx_extra));
 	std::ostringstream oss;
 	binary_archive<true> newar(oss);
 
@@ -516,9 +506,9 @@ bool remove_field_from_tx_extra(std::vector<uint8_t> &tx_extra, const std::type_
 		if(field.type() != type)
 			::do_serialize(newar, field);
 
-		std::ios_base::iostate state = iss.rdstate();
-		eof = (EOF == iss.peek());
-		iss.clear(state);
+		std::ios_base::iostate state = ar.stream().rdstate();
+		eof = (EOF == ar.stream().peek());
+		ar.stream().clear(state);
 	}
 	GULPS_CHECK_AND_NO_ASSERT_MES_L1(::serialization::check_stream_state(ar), false, "failed to deserialize extra field. extra = " , string_tools::buff_to_hex_nodelimer(std::string(reinterpret_cast<const char *>(tx_extra.data()), tx_extra.size())));
 	tx_extra.clear();
@@ -987,27 +977,82 @@ crypto::hash get_block_hash(const block &b)
 	return p;
 }
 //---------------------------------------------------------------
-bool get_block_longhash(network_type nettype, const block &b, cn_pow_hash_v2 &ctx, crypto::hash &res)
+// 1 - cryptonight, 2 - cn-heavy, 3 - cn-gpu
+static int get_block_pow_variant(network_type nettype, const block &b)
 {
-	block b_local = b; //workaround to avoid const errors with do_serialize
-	blobdata bd = get_block_hashing_blob(b);
-
 	uint8_t cn_heavy_v = get_fork_v(nettype, FORK_POW_CN_HEAVY);
 	uint8_t cn_gpu_v = get_fork_v(nettype, FORK_POW_CN_GPU);
 
-	if(cn_gpu_v != hardfork_conf::FORK_ID_DISABLED && b_local.major_version >= cn_gpu_v)
+	if(cn_gpu_v != hardfork_conf::FORK_ID_DISABLED && b.major_version >= cn_gpu_v)
+		return 3;
+	else if(cn_heavy_v != hardfork_conf::FORK_ID_DISABLED && b.major_version >= cn_heavy_v)
+		return 2;
+	else
+		return 1;
+}
+//---------------------------------------------------------------
+bool get_block_longhash(network_type nettype, const block &b, cn_pow_hash_v2 &ctx, crypto::hash &res)
+{
+	blobdata bd = get_block_hashing_blob(b);
+
+	switch(get_block_pow_variant(nettype, b))
+	{
+	case 3:
 	{
 		cn_pow_hash_v3 ctx_v3 = cn_pow_hash_v3::make_borrowed_v3(ctx);
 		ctx_v3.hash(bd.data(), bd.size(), res.data);
+		break;
 	}
-	else if(cn_heavy_v != hardfork_conf::FORK_ID_DISABLED && b_local.major_version >= cn_heavy_v)
-	{
+	case 2:
 		ctx.hash(bd.data(), bd.size(), res.data);
-	}
-	else
+		break;
+	default:
 	{
 		cn_pow_hash_v1 ctx_v1 = cn_pow_hash_v1::make_borrowed(ctx);
 		ctx_v1.hash(bd.data(), bd.size(), res.data);
+		break;
+	}
+	}
+	return true;
+}
+//---------------------------------------------------------------
+bool get_block_longhash(network_type nettype, const block &b0, const block &b1, cn_pow_hash_v2 &ctx0, cn_pow_hash_v2 &ctx1, crypto::hash &res0, crypto::hash &res1)
+{
+	const int variant = get_block_pow_variant(nettype, b0);
+	// Only a pair straddling a PoW fork can mix variants
+	if(variant != get_block_pow_variant(nettype, b1))
+		return get_block_longhash(nettype, b0, ctx0, res0) && get_block_longhash(nettype, b1, ctx1, res1);
+
+	blobdata bd0 = get_block_hashing_blob(b0);
+	blobdata bd1 = get_block_hashing_blob(b1);
+	const void *in[2] = {bd0.data(), bd1.data()};
+	size_t len[2] = {bd0.size(), bd1.size()};
+	void *out[2] = {res0.data, res1.data};
+
+	switch(variant)
+	{
+	case 3:
+	{
+		cn_pow_hash_v3 ctx0_v3 = cn_pow_hash_v3::make_borrowed_v3(ctx0);
+		cn_pow_hash_v3 ctx1_v3 = cn_pow_hash_v3::make_borrowed_v3(ctx1);
+		cn_pow_hash_v3 *ctx[2] = {&ctx0_v3, &ctx1_v3};
+		cn_pow_hash_v3::hash_multi<2>(ctx, in, len, out);
+		break;
+	}
+	case 2:
+	{
+		cn_pow_hash_v2 *ctx[2] = {&ctx0, &ctx1};
+		cn_pow_hash_v2::hash_multi<2>(ctx, in, len, out);
+		break;
+	}
+	default:
+	{
+		cn_pow_hash_v1 ctx0_v1 = cn_pow_hash_v1::make_borrowed(ctx0);
+		cn_pow_hash_v1 ctx1_v1 = cn_pow_hash_v1::make_borrowed(ctx1);
+		cn_pow_hash_v1 *ctx[2] = {&ctx0_v1, &ctx1_v1};
+		cn_pow_hash_v1::hash_multi<2>(ctx, in, len, out);
+		break;
+	}
 	}
 	return true;
 }
@@ -1034,9 +1079,7 @@ std::vector<uint64_t> absolute_output_offsets_to_relative(const std::vector<uint
 //---------------------------------------------------------------
 bool parse_and_validate_block_from_blob(const blobdata &b_blob, block &b)
 {
-	std::stringstream ss;
-	ss << b_blob;
-	binary_archive<false> ba(ss);
+	binary_span_archive<false> ba(b_blob);
 	bool r = ::serialization::serialize(ba, b);
 	GULPS_CHECK_AND_ASSERT_MES(r, false, "Failed to parse block from blob");
 	b.invalidate_hashes();
@@ -129,6 +129,8 @@ bool calculate_block_hash(const block &b, crypto::hash &res);
 bool get_block_hash(const block &b, crypto::hash &res);
 crypto::hash get_block_hash(const block &b);
 bool get_block_longhash(network_type nettype, const block &b, cn_pow_hash_v2 &ctx, crypto::hash &res);
+// Hashes two blocks at once through cn_slow_hash::hash_multi, each in its own ctx
+bool get_block_longhash(network_type nettype, const block &b0, const block &b1, cn_pow_hash_v2 &ctx0, cn_pow_hash_v2 &ctx1, crypto::hash &res0, crypto::hash &res1);
 bool parse_and_validate_block_from_blob(const blobdata &b_blob, block &b);
 bool get_inputs_money_amount(const transaction &tx, uint64_t &money);
 uint64_t get_outs_money_amount(const transaction &tx);
@@ -156,8 +156,7 @@ struct tx_extra_merge_mining_tag
 		if(!::do_serialize(ar, field))
 			return false;
 
-		std::istringstream iss(field);
-		binary_archive<false> iar(iss);
+		binary_span_archive<false> iar(field);
 		serialize_helper helper(*this);
 		return ::serialization::serialize(iar, helper);
 	}
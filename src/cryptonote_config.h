@@ -124,6 +124,7 @@
 #define HASH_OF_HASHES_STEP 256
 
 #define DEFAULT_TXPOOL_MAX_SIZE 648000000ull // 3 days at 300000, in bytes
+#define TXPOOL_PARSED_CACHE_MAX_SIZE 128000000ull // parsed txpool txes kept in RAM, in estimated parsed + JSON bytes
 
 // coin emission change interval/speed configs
 #define COIN_EMISSION_MONTH_INTERVAL 6																										// months to change emission speed
@@ -82,6 +82,9 @@ GULPS_CAT_MAJOR("blockchain");
 
 #define FIND_BLOCKCHAIN_SUPPLEMENT_MAX_SIZE (100 * 1024 * 1024) // 100 MB
 
+// blocks checked per precompute task, also the batch size for their rct semantics
+#define PRECOMPUTE_BLOCKS_PER_TASK 4
+
 using namespace crypto;
 
 //#include "serialization/json_archive.h"
@@ -157,7 +160,7 @@ static const struct
 
 //------------------------------------------------------------------
 Blockchain::Blockchain(tx_memory_pool &tx_pool) : m_db(), m_tx_pool(tx_pool), m_hardfork(NULL), m_timestamps_and_difficulties_height(0), m_current_block_cumul_sz_limit(0), m_current_block_cumul_sz_median(0),
-												  m_enforce_dns_checkpoints(false), m_max_prepare_blocks_threads(4), m_db_blocks_per_sync(1), m_db_sync_mode(db_async), m_db_default_sync(false), m_fast_sync(true), m_show_time_stats(false), m_sync_counter(0), m_cancel(false)
+												  m_enforce_dns_checkpoints(false), m_max_prepare_blocks_threads(4), m_db_blocks_per_sync(1), m_db_sync_mode(db_async), m_db_default_sync(false), m_fast_sync(true), m_show_time_stats(false), m_pow_hash_cache(false), m_sync_counter(0), m_precompute_next(0), m_cancel(false)
 {
 	GULPS_LOG_L3("Blockchain::", __func__);
 }
@@ -554,6 +557,9 @@ bool Blockchain::deinit()
 
 	GULPS_LOG_L2("Stopping blockchain read/write activity");
 
+	// let the background checks of the next span run out
+	m_precompute_waiter.wait();
+
 	// stop async service
 	m_async_work_idle.reset();
 	m_async_pool.join_all();
@@ -641,7 +647,7 @@ block Blockchain::pop_block_from_blockchain()
 	m_blocks_longhash_table.clear();
 	m_scan_table.clear();
 	m_blocks_txs_check.clear();
-	m_check_txin_table.clear();
+	m_rct_semantics_verified.clear();
 
 	update_next_cumulative_size_limit();
 	m_tx_pool.on_blockchain_dec(m_db->height() - 1, get_tail_id());
@@ -1636,7 +1642,9 @@ bool Blockchain::handle_alternative_block(const block &b, const crypto::hash &id
 		difficulty_type current_diff = get_next_difficulty_for_alternative_chain(alt_chain, bei);
 		GULPS_CHECK_AND_ASSERT_MES(current_diff, false, "!!!!!!! DIFFICULTY OVERHEAD !!!!!!!");
 		crypto::hash proof_of_work = null_hash;
-		get_block_longhash(m_nettype, bei.bl, m_pow_ctx, proof_of_work);
+		bool pow_cached = m_pow_hash_cache && m_db->get_block_pow_hash(id, proof_of_work);
+		if(!pow_cached)
+			get_block_longhash(m_nettype, bei.bl, m_pow_ctx, proof_of_work);
 		if(!check_hash(proof_of_work, current_diff))
 		{
 			GULPSF_VERIFY_ERR_BLK("Block with id: {}\nfor alternative chain, does not have enough proof of work: {}\nexpected difficulty: {}", id, proof_of_work, current_diff);
@@ -1644,6 +1652,10 @@ bool Blockchain::handle_alternative_block(const block &b, const crypto::hash &id
 			return false;
 		}
 
+		// saves the slow hash when this chain is switched to
+		if(m_pow_hash_cache && !pow_cached)
+			m_db->add_block_pow_hash(id, proof_of_work);
+
 		if(!prevalidate_miner_transaction(b, bei.height))
 		{
 			GULPSF_VERIFY_ERR_BLK("Block with id: {} (as alternative) has incorrect miner transaction.", epee::string_tools::pod_to_hex(id) );
@@ -2398,28 +2410,36 @@ bool Blockchain::find_blockchain_supplement_indexed(const uint64_t req_start_blo
 			std::vector<COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices>& out_idx, uint64_t &total_height, uint64_t &start_height, size_t max_count) const
 {
 	GULPS_LOG_L3("Blockchain::", __func__);
-	CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
-	// if a specific start height has been requested
-	if(req_start_block > 0)
+	// The lock is only held while the split point is resolved and the read
+	// snapshot is opened. Everything after reads from that snapshot, so block
+	// processing can carry on while the blocks are read and parsed.
 	{
-		// if requested height is higher than our chain, return false -- we can't help
-		if(req_start_block >= m_db->height())
+		CRITICAL_REGION_LOCAL(m_blockchain_lock);
+
+		// if a specific start height has been requested
+		if(req_start_block > 0)
 		{
-			return false;
+			// if requested height is higher than our chain, return false -- we can't help
+			if(req_start_block >= m_db->height())
+			{
+				return false;
+			}
+			start_height = req_start_block;
 		}
-		start_height = req_start_block;
-	}
-	else
-	{
-		if(!find_blockchain_supplement(qblock_ids, start_height))
+		else
 		{
-			return false;
+			if(!find_blockchain_supplement(qblock_ids, start_height))
+			{
+				return false;
+			}
 		}
+
+		m_db->block_txn_start(true);
 	}
+	epee::misc_utils::auto_scope_leave_caller txn_dtor = epee::misc_utils::create_scope_leave_handler([this]() { m_db->block_txn_stop(); });
 
-	m_db->block_txn_start(true);
-	total_height = get_current_blockchain_height();
+	total_height = m_db->height();
 	size_t end_height = std::min(total_height, start_height + max_count);
 	size_t count = 0, size = 0;
 	blocks.reserve(end_height - start_height);
@@ -2475,7 +2495,9 @@ bool Blockchain::find_blockchain_supplement_indexed(const uint64_t req_start_blo
 			size_t tx_cnt = bl.tx_hashes.size();
 			idx[bi]->indices.resize(tx_cnt+1);
 
-			get_tx_outputs_gindexs(get_transaction_hash(bl.miner_tx), idx[bi]->indices[0].indices);
+			uint64_t miner_tx_index;
+			GULPS_CHECK_AND_ASSERT_MES(m_db->tx_exists(get_transaction_hash(bl.miner_tx), miner_tx_index), false, "internal error, miner transaction not found");
+			idx[bi]->indices[0].indices = m_db->get_tx_amount_output_indices(miner_tx_index);
 
 			total_tx_cnt += tx_cnt;
 			if(tx.size() < total_tx_cnt)
@@ -2525,7 +2547,6 @@ bool Blockchain::find_blockchain_supplement_indexed(const uint64_t req_start_blo
 		i += batch_size;
 	}
 
-	m_db->block_txn_stop();
 	return true;
 }
 //------------------------------------------------------------------
@@ -2753,17 +2774,18 @@ bool Blockchain::check_tx_outputs(const transaction &tx, tx_verification_context
 		}
 	}
 
+	std::vector<crypto::public_key> out_keys;
+	out_keys.reserve(tx.vout.size());
 	for(const auto &o : tx.vout)
 	{
 		if(o.target.type() == typeid(txout_to_key))
-		{
-			const txout_to_key &out_to_key = boost::get<txout_to_key>(o.target);
-			if(!crypto::check_key(out_to_key.key))
-			{
-				tvc.m_invalid_output = true;
-				return false;
-			}
-		}
+			out_keys.push_back(boost::get<txout_to_key>(o.target).key);
+	}
+
+	if(!crypto::check_keys(out_keys.data(), out_keys.size()))
+	{
+		tvc.m_invalid_output = true;
+		return false;
 	}
 
 	bool has_bulletproofs = tx.rct_signatures.type == rct::RCTTypeBulletproof;
@@ -3029,14 +3051,6 @@ bool Blockchain::check_tx_inputs(transaction &tx, tx_verification_context &tvc,
 		return false;
 	}
 
-	auto it = m_check_txin_table.find(tx_prefix_hash);
-	if(it == m_check_txin_table.end())
-	{
-		m_check_txin_table.emplace(tx_prefix_hash, std::unordered_map<crypto::key_image, bool>());
-		it = m_check_txin_table.find(tx_prefix_hash);
-		assert(it != m_check_txin_table.end());
-	}
-
 	std::vector<std::vector<rct::ctkey>> pubkeys(tx.vin.size());
 	std::vector<uint64_t> results;
 	results.resize(tx.vin.size(), 0);
@@ -3062,7 +3076,6 @@ bool Blockchain::check_tx_inputs(transaction &tx, tx_verification_context &tvc,
 		// signature spending it.
 		if(!check_tx_input(tx.version, in_to_key, tx_prefix_hash, std::vector<crypto::signature>(), tx.rct_signatures, pubkeys[sig_index], pmax_used_block_height))
 		{
-			it->second[in_to_key.k_image] = false;
 			GULPS_VERIFY_ERR_TX("Failed to check ring signature for tx ", get_transaction_hash(tx), " vin key with k_image: ", in_to_key.k_image, " sig_index: ", sig_index);
 			if(pmax_used_block_height) // a default value of NULL is used when called from Blockchain::handle_block_to_main_chain()
 			{
@@ -3143,8 +3156,15 @@ bool Blockchain::check_tx_inputs(transaction &tx, tx_verification_context &tvc,
 			}
 		}
 
-		if(!rct::verRctNonSemanticsSimple(rv))
+		// MGs of all inputs are verified in parallel, the per input outcome names the bad inputs
+		std::vector<uint8_t> mg_results;
+		if(!rct::verRctNonSemanticsSimple(rv, mg_results))
 		{
+			for(size_t n = 0; n < mg_results.size(); ++n)
+			{
+				if(!mg_results[n])
+					GULPSF_VERIFY_ERR_TX("Failed to check ringct signature at vin {}", n);
+			}
 			GULPS_VERIFY_ERR_TX("Failed to check ringct signatures!");
 			return false;
 		}
@@ -3602,6 +3622,10 @@ bool Blockchain::handle_block_to_main_chain(const block &bl, const crypto::hash
 			precomputed = true;
 			proof_of_work = it->second;
 		}
+		else if(m_pow_hash_cache && m_db->get_block_pow_hash(id, proof_of_work))
+		{
+			precomputed = true;
+		}
 		else
 		{
 			get_block_longhash(m_nettype, bl, m_pow_ctx, proof_of_work);
@@ -3810,6 +3834,8 @@ bool Blockchain::handle_block_to_main_chain(const block &bl, const crypto::hash
 		try
 		{
 			new_height = m_db->add_block(bl, block_size, cumulative_difficulty, already_generated_coins, txs);
+			if(m_pow_hash_cache && !fast_check)
+				m_db->add_block_pow_hash(id, proof_of_work);
 		}
 		catch(const KEY_IMAGE_EXISTS &e)
 		{
@@ -3852,8 +3878,8 @@ bool Blockchain::handle_block_to_main_chain(const block &bl, const crypto::hash
 	bvc.m_added_to_main_chain = true;
 	++m_sync_counter;
 
-	// appears to be a NOP *and* is called elsewhere.  wat?
-	m_tx_pool.on_blockchain_inc(new_height, id);
+	// lets the pool keep the block template verdicts of txes this block did not conflict with
+	m_tx_pool.on_blockchain_inc(new_height, id, txs);
 
 	return true;
 }
@@ -3878,6 +3904,7 @@ bool Blockchain::update_next_cumulative_size_limit()
 bool Blockchain::add_new_block(const block &bl_, block_verification_context &bvc)
 {
 	GULPS_LOG_L3("Blockchain::", __func__);
+	PERF_TIMER(add_block);
 	//copy block here to let modify block.target
 	block bl = bl_;
 	crypto::hash id = get_block_hash(bl);
@@ -3989,18 +4016,24 @@ void Blockchain::set_enforce_dns_checkpoints(bool enforce_checkpoints)
 }
 
 //------------------------------------------------------------------
-void Blockchain::block_longhash_worker(cn_pow_hash_v2 &hash_ctx, const std::vector<block> &blocks, std::unordered_map<crypto::hash, crypto::hash> &map)
+void Blockchain::block_longhash_worker(cn_pow_hash_v2 &hash_ctx0, cn_pow_hash_v2 &hash_ctx1, const std::vector<block> &blocks, std::unordered_map<crypto::hash, crypto::hash> &map)
 {
 	TIME_MEASURE_START(t);
 
-	for(const auto &block : blocks)
+	// Blocks go two at a time through the interleaved hash, an odd one out is hashed alone
+	for(size_t i = 0; i < blocks.size(); i += 2)
 	{
 		if(m_cancel)
 			break;
-		crypto::hash id = get_block_hash(block);
-		crypto::hash pow;
-		get_block_longhash(m_nettype, block, hash_ctx, pow);
-		map.emplace(id, pow);
+		crypto::hash pow0, pow1;
+		if(i + 1 < blocks.size())
+		{
+			get_block_longhash(m_nettype, blocks[i], blocks[i + 1], hash_ctx0, hash_ctx1, pow0, pow1);
+			map.emplace(get_block_hash(blocks[i + 1]), pow1);
+		}
+		else
+			get_block_longhash(m_nettype, blocks[i], hash_ctx0, pow0);
+		map.emplace(get_block_hash(blocks[i]), pow0);
 	}
 
 	TIME_MEASURE_FINISH(t);
@@ -4055,7 +4088,7 @@ bool Blockchain::cleanup_handle_incoming_blocks(bool force_sync)
 	m_blocks_longhash_table.clear();
 	m_scan_table.clear();
 	m_blocks_txs_check.clear();
-	m_check_txin_table.clear();
+	m_rct_semantics_verified.clear();
 
 	// when we're well clear of the precomputed hashes, free the memory
 	if(!m_blocks_hash_check.empty() && m_db->height() > m_blocks_hash_check.size() + 4096)
@@ -4215,6 +4248,24 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::list<block_complete_e
 	m_tx_pool.lock();
 	CRITICAL_REGION_LOCAL1(m_blockchain_lock);
 
+	// Collect what precompute_incoming_blocks checked while the previous span was
+	// being added. Everything is keyed by block or tx hash, so results for blocks
+	// that are not in this span are simply never looked up.
+	m_precompute_waiter.wait();
+	std::unordered_map<crypto::hash, crypto::hash> precomputed_longhash;
+	std::unordered_set<crypto::hash> precomputed_rct;
+	for(size_t i = 0; i < m_precompute_blocks.size(); i++)
+	{
+		if(m_precompute_longhash[i] != null_hash)
+			precomputed_longhash.emplace(get_block_hash(m_precompute_blocks[i]), m_precompute_longhash[i]);
+	}
+	for(const auto &verified : m_precompute_rct_verified)
+		precomputed_rct.insert(verified.begin(), verified.end());
+	m_precompute_blocks.clear();
+	m_precompute_txs.clear();
+	m_precompute_longhash.clear();
+	m_precompute_rct_verified.clear();
+
 	if(blocks_entry.size() == 0)
 		return false;
 
@@ -4242,6 +4293,8 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::list<block_complete_e
 	tools::threadpool &tpool = tools::threadpool::getInstance();
 	uint64_t threads = tpool.get_max_concurrency();
 
+	m_blocks_longhash_table = std::move(precomputed_longhash);
+
 	if(blocks_entry.size() > 1 && threads > 1 && m_max_prepare_blocks_threads > 1)
 	{
 		// limit threads, default limit = 4
@@ -4278,13 +4331,15 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::list<block_complete_e
 						return true;
 					}
 				}
-				if(have_block(get_block_hash(block)))
+				const crypto::hash id = get_block_hash(block);
+				if(have_block(id))
 				{
 					blocks_exist = true;
 					break;
 				}
 
-				blocks[i].push_back(block);
+				if(!find_known_longhash(id))
+					blocks[i].push_back(block);
 				std::advance(it, 1);
 			}
 		}
@@ -4299,26 +4354,29 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::list<block_complete_e
 				continue;
 			}
 
-			if(have_block(get_block_hash(block)))
+			const crypto::hash id = get_block_hash(block);
+			if(have_block(id))
 			{
 				blocks_exist = true;
 				break;
 			}
 
-			blocks[i].push_back(block);
+			if(!find_known_longhash(id))
+				blocks[i].push_back(block);
 			std::advance(it, 1);
 		}
 
 		if(!blocks_exist)
 		{
-			m_blocks_longhash_table.clear();
 			tools::threadpool::waiter waiter;
 
-			if(m_hash_ctxes_multi.size() < threads)
-				m_hash_ctxes_multi.resize(threads);
+			if(m_hash_ctxes_multi.size() < threads * 2)
+				m_hash_ctxes_multi.resize(threads * 2);
 			for(uint64_t i = 0; i < threads; i++)
 			{
-				tpool.submit(&waiter, boost::bind(&Blockchain::block_longhash_worker, this, std::ref(m_hash_ctxes_multi[i]), std::cref(blocks[i]), std::ref(maps[i])));
+				if(blocks[i].empty())
+					continue;
+				tpool.submit(&waiter, boost::bind(&Blockchain::block_longhash_worker, this, std::ref(m_hash_ctxes_multi[i * 2]), std::ref(m_hash_ctxes_multi[i * 2 + 1]), std::cref(blocks[i]), std::ref(maps[i])));
 			}
 
 			waiter.wait();
@@ -4346,7 +4404,6 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::list<block_complete_e
 	m_fake_pow_calc_time = 0;
 
 	m_scan_table.clear();
-	m_check_txin_table.clear();
 
 	TIME_MEASURE_FINISH(prepare);
 	m_fake_pow_calc_time = prepare / blocks_entry.size();
@@ -4470,6 +4527,8 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::list<block_complete_e
 	}
 
 	int total_txs = 0;
+	std::vector<transaction> span_txes;
+	std::vector<crypto::hash> span_tx_hashes;
 
 	// now generate a table for each tx_prefix and k_image hashes
 	for(const auto &entry : blocks_entry)
@@ -4521,6 +4580,9 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::list<block_complete_e
 
 				its->second.emplace(in_to_key.k_image, outputs);
 			}
+
+			span_tx_hashes.push_back(tx_hash);
+			span_txes.push_back(std::move(tx));
 		}
 	}
 
@@ -4532,9 +4594,184 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::list<block_complete_e
 			GULPSF_LOG_L1("Prepare scantable took: {} ms", scantable );
 	}
 
+	TIME_MEASURE_START(rct_batch);
+	batch_verify_rct_semantics(span_txes, span_tx_hashes, precomputed_rct);
+	TIME_MEASURE_FINISH(rct_batch);
+	if(total_txs > 0 && m_show_time_stats)
+		GULPSF_LOG_L1("Prepare rct batch verification took: {} ms", rct_batch);
+
 	return true;
 }
 
+// Runs one batch over the simple and bulletproof signatures among txes and, if it
+// passes, appends their hashes to verified. Txes already in skip are left out.
+static void verify_rct_semantics_batch(const std::vector<const transaction *> &txes, const std::vector<crypto::hash> &tx_hashes,
+									   const std::unordered_set<crypto::hash> &skip, std::vector<crypto::hash> &verified)
+{
+	std::vector<const rct::rctSig *> rvv;
+	std::vector<size_t> idx;
+	rvv.reserve(txes.size());
+	idx.reserve(txes.size());
+	for(size_t i = 0; i < txes.size(); i++)
+	{
+		const rct::rctSig &rv = txes[i]->rct_signatures;
+		if(rv.type != rct::RCTTypeSimple && rv.type != rct::RCTTypeBulletproof)
+			continue;
+		if(skip.find(tx_hashes[i]) != skip.end())
+			continue;
+		rvv.push_back(&rv);
+		idx.push_back(i);
+	}
+
+	if(rvv.empty())
+		return;
+
+	// All range proofs of the batch go through a single multiexp. If anything in it
+	// is bad nothing gets marked and every tx is checked on its own in check_tx_semantic
+	if(!rct::verRctSemanticsSimple(rvv))
+	{
+		GULPSF_LOG_L1("Batch rct semantics check failed for {} txes, falling back to per tx checks", rvv.size());
+		return;
+	}
+
+	for(size_t i : idx)
+		verified.push_back(tx_hashes[i]);
+}
+
+void Blockchain::batch_verify_rct_semantics(const std::vector<transaction> &txes, const std::vector<crypto::hash> &tx_hashes, const std::unordered_set<crypto::hash> &precomputed)
+{
+	m_rct_semantics_verified.clear();
+
+	std::vector<const transaction *> ptxes;
+	ptxes.reserve(txes.size());
+	for(size_t i = 0; i < txes.size(); i++)
+	{
+		ptxes.push_back(&txes[i]);
+		if(precomputed.find(tx_hashes[i]) != precomputed.end())
+			m_rct_semantics_verified.insert(tx_hashes[i]);
+	}
+
+	std::vector<crypto::hash> verified;
+	verify_rct_semantics_batch(ptxes, tx_hashes, precomputed, verified);
+	m_rct_semantics_verified.insert(verified.begin(), verified.end());
+}
+
+bool Blockchain::find_known_longhash(const crypto::hash &id)
+{
+	if(m_blocks_longhash_table.find(id) != m_blocks_longhash_table.end())
+		return true;
+
+	crypto::hash pow;
+	if(!m_pow_hash_cache || !m_db->get_block_pow_hash(id, pow))
+		return false;
+
+	m_blocks_longhash_table.emplace(id, pow);
+	return true;
+}
+
+void Blockchain::precompute_incoming_blocks(uint64_t height, const std::list<block_complete_entry> &blocks_entry)
+{
+	GULPS_LOG_L2("Blockchain::", __func__);
+	CRITICAL_REGION_LOCAL(m_blockchain_lock);
+
+	// only one span is checked ahead, drop it if prepare_handle_incoming_blocks did not pick it up
+	m_precompute_waiter.wait();
+	m_precompute_blocks.clear();
+	m_precompute_txs.clear();
+
+	// blocks below the precomputed hashes are not pow checked
+	if(blocks_entry.empty() || height + blocks_entry.size() < m_blocks_hash_check.size())
+		return;
+
+	m_precompute_blocks.reserve(blocks_entry.size());
+	m_precompute_txs.reserve(blocks_entry.size());
+	for(const auto &entry : blocks_entry)
+	{
+		block b;
+		if(!parse_and_validate_block_from_blob(entry.block, b))
+			break;
+		m_precompute_blocks.push_back(std::move(b));
+		m_precompute_txs.push_back(entry.txs);
+	}
+
+	m_precompute_longhash.assign(m_precompute_blocks.size(), null_hash);
+	if(m_pow_hash_cache)
+	{
+		for(size_t i = 0; i < m_precompute_blocks.size(); i++)
+			m_db->get_block_pow_hash(get_block_hash(m_precompute_blocks[i]), m_precompute_longhash[i]);
+	}
+	m_precompute_rct_verified.assign((m_precompute_blocks.size() + PRECOMPUTE_BLOCKS_PER_TASK - 1) / PRECOMPUTE_BLOCKS_PER_TASK, std::vector<crypto::hash>());
+	m_precompute_next = 0;
+
+	tools::threadpool &tpool = tools::threadpool::getInstance();
+	size_t threads = std::min<size_t>(tpool.get_max_concurrency(), m_max_prepare_blocks_threads);
+	threads = std::max<size_t>(1, std::min<size_t>(threads, m_precompute_rct_verified.size()));
+	if(m_hash_ctxes_multi.size() < threads * 2)
+		m_hash_ctxes_multi.resize(threads * 2);
+
+	GULPSF_LOG_L1("Precomputing {} blocks from height {} on {} threads", m_precompute_blocks.size(), height, threads);
+	for(size_t i = 0; i < threads; i++)
+		tpool.submit(&m_precompute_waiter, boost::bind(&Blockchain::precompute_worker, this, i));
+}
+
+void Blockchain::precompute_worker(size_t ctx_idx)
+{
+	const size_t start = m_precompute_next.fetch_add(PRECOMPUTE_BLOCKS_PER_TASK);
+	if(m_cancel || start >= m_precompute_blocks.size())
+		return;
+	const size_t end = std::min<size_t>(start + PRECOMPUTE_BLOCKS_PER_TASK, m_precompute_blocks.size());
+
+	cn_pow_hash_v2 &hash_ctx0 = m_hash_ctxes_multi[ctx_idx * 2];
+	cn_pow_hash_v2 &hash_ctx1 = m_hash_ctxes_multi[ctx_idx * 2 + 1];
+	std::vector<size_t> to_hash;
+	for(size_t i = start; i < end; i++)
+	{
+		if(m_precompute_longhash[i] == null_hash)
+			to_hash.push_back(i);
+	}
+	for(size_t j = 0; j < to_hash.size(); j += 2)
+	{
+		const size_t i = to_hash[j];
+		if(j + 1 < to_hash.size())
+		{
+			const size_t i1 = to_hash[j + 1];
+			get_block_longhash(m_nettype, m_precompute_blocks[i], m_precompute_blocks[i1], hash_ctx0, hash_ctx1, m_precompute_longhash[i], m_precompute_longhash[i1]);
+		}
+		else
+			get_block_longhash(m_nettype, m_precompute_blocks[i], hash_ctx0, m_precompute_longhash[i]);
+	}
+
+	std::vector<transaction> txes;
+	std::vector<crypto::hash> tx_hashes;
+	for(size_t i = start; i < end; i++)
+	{
+		for(const auto &tx_blob : m_precompute_txs[i])
+		{
+			transaction tx;
+			crypto::hash tx_hash, tx_prefix_hash;
+			if(!parse_and_validate_tx_from_blob(tx_blob, tx, tx_hash, tx_prefix_hash))
+				continue;
+			txes.push_back(std::move(tx));
+			tx_hashes.push_back(tx_hash);
+		}
+	}
+
+	std::vector<const transaction *> ptxes;
+	ptxes.reserve(txes.size());
+	for(const transaction &tx : txes)
+		ptxes.push_back(&tx);
+	verify_rct_semantics_batch(ptxes, tx_hashes, std::unordered_set<crypto::hash>(), m_precompute_rct_verified[start / PRECOMPUTE_BLOCKS_PER_TASK]);
+
+	// Hand the hash ctxes on to a fresh task rather than looping here, so a thread that
+	// helps out while waiting on the pool is never stuck with more than a few blocks
+	tools::threadpool::getInstance().submit(&m_precompute_waiter, boost::bind(&Blockchain::precompute_worker, this, ctx_idx));
+}
+
+bool Blockchain::is_rct_semantics_batch_verified(const crypto::hash &tx_hash) const
+{
+	return m_rct_semantics_verified.find(tx_hash) != m_rct_semantics_verified.end();
+}
+
 void Blockchain::add_txpool_tx(transaction &tx, const txpool_tx_meta_t &meta)
 {
 	m_db->add_txpool_tx(tx, meta);
@@ -4659,6 +4896,64 @@ void Blockchain::cancel()
 
 #if defined(PER_BLOCK_CHECKPOINT)
 static const char expected_block_hashes_hash[] = "0924bc1c47aae448321fde949554be192878dd800e6489379865218f84eacbca";
+bool Blockchain::get_compiled_in_block_hashes(std::vector<crypto::hash> &hashes) const
+{
+	const bool testnet = m_nettype == TESTNET;
+	const bool stagenet = m_nettype == STAGENET;
+	hashes.clear();
+	if(get_blocks_dat_start(testnet, stagenet) == nullptr || get_blocks_dat_size(testnet, stagenet) == 0)
+		return false;
+
+	if(m_nettype == MAINNET)
+	{
+		// first check hash
+		crypto::hash hash;
+		if(!tools::sha256sum(get_blocks_dat_start(testnet, stagenet), get_blocks_dat_size(testnet, stagenet), hash))
+		{
+			GULPS_ERROR("Failed to hash precomputed blocks data");
+			return false;
+		}
+		GULPSF_INFO("precomputed blocks hash: {}, expected {}", hash , expected_block_hashes_hash);
+		cryptonote::blobdata expected_hash_data;
+		if(!epee::string_tools::parse_hexstr_to_binbuff(std::string(expected_block_hashes_hash), expected_hash_data) || expected_hash_data.size() != sizeof(crypto::hash))
+		{
+			GULPS_ERROR("Failed to parse expected block hashes hash");
+			return false;
+		}
+		const crypto::hash expected_hash = *reinterpret_cast<const crypto::hash *>(expected_hash_data.data());
+		if(hash != expected_hash)
+		{
+			GULPS_ERROR("Block hash data does not match expected hash");
+			return false;
+		}
+	}
+
+	if(get_blocks_dat_size(testnet, stagenet) <= 4)
+		return false;
+
+	const unsigned char *p = get_blocks_dat_start(testnet, stagenet);
+	const uint32_t nblocks = *p | ((*(p + 1)) << 8) | ((*(p + 2)) << 16) | ((*(p + 3)) << 24);
+	if(nblocks > (std::numeric_limits<uint32_t>::max() - 4) / sizeof(crypto::hash))
+	{
+		GULPS_ERROR("Block hash data is too large");
+		return false;
+	}
+	const size_t size_needed = 4 + nblocks * sizeof(crypto::hash);
+	if(get_blocks_dat_size(testnet, stagenet) < size_needed)
+		return false;
+
+	p += sizeof(uint32_t);
+	hashes.reserve(nblocks);
+	for(uint32_t i = 0; i < nblocks; i++)
+	{
+		crypto::hash hash;
+		memcpy(hash.data, p, sizeof(hash.data));
+		p += sizeof(hash.data);
+		hashes.push_back(hash);
+	}
+	return true;
+}
+
 void Blockchain::load_compiled_in_block_hashes()
 {
 	const bool testnet = m_nettype == TESTNET;
@@ -4667,78 +4962,77 @@ void Blockchain::load_compiled_in_block_hashes()
 	{
 		GULPSF_INFO("Loading precomputed blocks ({} bytes)", get_blocks_dat_size(testnet, stagenet) );
 
-		if(m_nettype == MAINNET)
+		std::vector<crypto::hash> hashes;
+		if(!get_compiled_in_block_hashes(hashes))
+			return;
+
+		const size_t nblocks = hashes.size();
+		if(nblocks > 0 && nblocks > (m_db->height() + HASH_OF_HASHES_STEP - 1) / HASH_OF_HASHES_STEP)
 		{
-			// first check hash
-			crypto::hash hash;
-			if(!tools::sha256sum(get_blocks_dat_start(testnet, stagenet), get_blocks_dat_size(testnet, stagenet), hash))
-			{
-				GULPS_ERROR("Failed to hash precomputed blocks data");
-				return;
-			}
-			GULPSF_INFO("precomputed blocks hash: {}, expected {}", hash , expected_block_hashes_hash);
-			cryptonote::blobdata expected_hash_data;
-			if(!epee::string_tools::parse_hexstr_to_binbuff(std::string(expected_block_hashes_hash), expected_hash_data) || expected_hash_data.size() != sizeof(crypto::hash))
-			{
-				GULPS_ERROR("Failed to parse expected block hashes hash");
-				return;
-			}
-			const crypto::hash expected_hash = *reinterpret_cast<const crypto::hash *>(expected_hash_data.data());
-			if(hash != expected_hash)
+			m_blocks_hash_of_hashes = std::move(hashes);
+			m_blocks_hash_check.resize(m_blocks_hash_of_hashes.size() * HASH_OF_HASHES_STEP, crypto::null_hash);
+			GULPSF_INFO("{} block hashes loaded", nblocks);
+
+			// FIXME: clear tx_pool because the process might have been
+			// terminated and caused it to store txs kept by blocks.
+			// The core will not call check_tx_inputs(..) for these
+			// transactions in this case. Consequently, the sanity check
+			// for tx hashes will fail in handle_block_to_main_chain(..)
+			CRITICAL_REGION_LOCAL(m_tx_pool);
+
+			std::list<transaction> txs;
+			m_tx_pool.get_transactions(txs);
+
+			size_t blob_size;
+			uint64_t fee;
+			bool relayed, do_not_relay, double_spend_seen;
+			transaction pool_tx;
+			for(const transaction &tx : txs)
 			{
-				GULPS_ERROR("Block hash data does not match expected hash");
-				return;
+				crypto::hash tx_hash = get_transaction_hash(tx);
+				m_tx_pool.take_tx(tx_hash, pool_tx, blob_size, fee, relayed, do_not_relay, double_spend_seen);
 			}
 		}
+	}
+}
+#endif
+
+bool Blockchain::check_compiled_in_block_hashes(uint64_t &checked_height) const
+{
+	checked_height = 0;
+#if defined(PER_BLOCK_CHECKPOINT)
+	std::vector<crypto::hash> hashes;
+	if(!get_compiled_in_block_hashes(hashes))
+		return true;
 
-		if(get_blocks_dat_size(testnet, stagenet) > 4)
+	// only whole groups that are already in the db can be compared. The hashes are computed
+	// from the blocks themselves, the ones stored next to them may not match the blocks.
+	const uint64_t groups = std::min<uint64_t>(hashes.size(), m_db->height() / HASH_OF_HASHES_STEP);
+	std::vector<crypto::hash> data(HASH_OF_HASHES_STEP);
+	for(uint64_t n = 0; n < groups; ++n)
+	{
+		for(uint64_t i = 0; i < HASH_OF_HASHES_STEP; ++i)
 		{
-			const unsigned char *p = get_blocks_dat_start(testnet, stagenet);
-			const uint32_t nblocks = *p | ((*(p + 1)) << 8) | ((*(p + 2)) << 16) | ((*(p + 3)) << 24);
-			if(nblocks > (std::numeric_limits<uint32_t>::max() - 4) / sizeof(hash))
-			{
-				GULPS_ERROR("Block hash data is too large");
-				return;
-			}
-			const size_t size_needed = 4 + nblocks * sizeof(crypto::hash);
-			if(nblocks > 0 && nblocks > (m_db->height() + HASH_OF_HASHES_STEP - 1) / HASH_OF_HASHES_STEP && get_blocks_dat_size(testnet, stagenet) >= size_needed)
+			const uint64_t height = n * HASH_OF_HASHES_STEP + i;
+			data[i] = get_block_hash(m_db->get_block_from_height(height));
+			if(data[i] != m_db->get_block_hash_from_height(height))
 			{
-				p += sizeof(uint32_t);
-				m_blocks_hash_of_hashes.reserve(nblocks);
-				for(uint32_t i = 0; i < nblocks; i++)
-				{
-					crypto::hash hash;
-					memcpy(hash.data, p, sizeof(hash.data));
-					p += sizeof(hash.data);
-					m_blocks_hash_of_hashes.push_back(hash);
-				}
-				m_blocks_hash_check.resize(m_blocks_hash_of_hashes.size() * HASH_OF_HASHES_STEP, crypto::null_hash);
-				GULPSF_INFO("{} block hashes loaded", nblocks);
-
-				// FIXME: clear tx_pool because the process might have been
-				// terminated and caused it to store txs kept by blocks.
-				// The core will not call check_tx_inputs(..) for these
-				// transactions in this case. Consequently, the sanity check
-				// for tx hashes will fail in handle_block_to_main_chain(..)
-				CRITICAL_REGION_LOCAL(m_tx_pool);
-
-				std::list<transaction> txs;
-				m_tx_pool.get_transactions(txs);
-
-				size_t blob_size;
-				uint64_t fee;
-				bool relayed, do_not_relay, double_spend_seen;
-				transaction pool_tx;
-				for(const transaction &tx : txs)
-				{
-					crypto::hash tx_hash = get_transaction_hash(tx);
-					m_tx_pool.take_tx(tx_hash, pool_tx, blob_size, fee, relayed, do_not_relay, double_spend_seen);
-				}
+				GULPSF_ERROR("Stored hash of block {} does not match the block", height);
+				return false;
 			}
 		}
+		crypto::hash hash;
+		cn_fast_hash(data.data(), HASH_OF_HASHES_STEP * sizeof(crypto::hash), hash);
+		if(hash != hashes[n])
+		{
+			GULPSF_ERROR("Block hashes {} - {} do not match the compiled-in data", n * HASH_OF_HASHES_STEP, n * HASH_OF_HASHES_STEP + HASH_OF_HASHES_STEP - 1);
+			return false;
+		}
+		checked_height = (n + 1) * HASH_OF_HASHES_STEP;
 	}
-}
 #endif
+	return true;
+}
 
 bool Blockchain::is_within_compiled_block_hash_area(uint64_t height) const
 {
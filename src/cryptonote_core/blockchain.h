@@ -59,6 +59,7 @@
 
 #include "blockchain_db/blockchain_db.h"
 #include "checkpoints/checkpoints.h"
+#include "common/threadpool.h"
 #include "common/util.h"
 #include "crypto/hash.h"
 #include "cryptonote_basic/cryptonote_basic.h"
@@ -240,6 +241,31 @@ class Blockchain
      */
 	bool cleanup_handle_incoming_blocks(bool force_sync = false);
 
+	/**
+     * @brief starts the proof of work and rct semantics checks of the next span in the background
+     *
+     * The checks only depend on the block and tx blobs, so they run on the threadpool
+     * without the blockchain lock while the current span is being added. The next call
+     * to prepare_handle_incoming_blocks waits for them and uses whatever matches its span,
+     * anything else is dropped.
+     *
+     * The background state is set up and collected under m_blockchain_lock, the tasks
+     * only touch it while m_precompute_waiter is pending.
+     *
+     * @param height the height of the first block of the span
+     * @param blocks_entry the blocks of the next span
+     */
+	void precompute_incoming_blocks(uint64_t height, const std::list<block_complete_entry> &blocks_entry);
+
+	/**
+     * @brief checks if a tx had its rct semantics verified by the batch check in prepare_handle_incoming_blocks
+     *
+     * @param tx_hash the hash of the transaction
+     *
+     * @return true if the tx is part of the incoming span and the batch check passed
+     */
+	bool is_rct_semantics_batch_verified(const crypto::hash &tx_hash) const;
+
 	/**
      * @brief search the blockchain for a transaction by hash
      *
@@ -437,6 +463,15 @@ class Blockchain
      */
 	bool find_blockchain_supplement(const uint64_t req_start_block, const std::list<crypto::hash> &qblock_ids, std::list<std::pair<cryptonote::blobdata, std::list<cryptonote::blobdata>>> &blocks, uint64_t &total_height, uint64_t &start_height, size_t max_count) const;
 
+	/**
+     * @brief get recent pruned blocks and their output indices for a foreign chain
+     *
+     * As find_blockchain_supplement, except that m_blockchain_lock is only held
+     * while the start height is resolved. The blocks are then read from a DB read
+     * snapshot taken at that point, so incoming blocks are not held up.
+     *
+     * @param out_idx return-by-reference the output indices of each returned block's transactions
+     */
 	bool find_blockchain_supplement_indexed(const uint64_t req_start_block, const std::list<crypto::hash> &qblock_ids, std::vector<block_complete_entry_v>& blocks,
 			std::vector<COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices>& out_idx, uint64_t &total_height, uint64_t &start_height, size_t max_count) const;
 
@@ -748,6 +783,18 @@ class Blockchain
      */
 	void set_show_time_stats(bool stats) { m_show_time_stats = stats; }
 
+	/**
+     * @brief set whether verified proof of work hashes are kept in the db
+     *
+     * When enabled, the pow hash of each block that passes its pow check is
+     * stored, and looked up before the slow hash is computed for a block seen
+     * before, e.g. on re-import, when re-adding blocks after a reorg, or when an
+     * alternative chain becomes the main chain.
+     *
+     * @param cache the new pow hash cache setting
+     */
+	void set_pow_hash_cache(bool cache) { m_pow_hash_cache = cache; }
+
 	/**
      * @brief gets the hardfork voting state object
      *
@@ -927,11 +974,14 @@ class Blockchain
 	/**
      * @brief computes the "short" and "long" hashes for a set of blocks
      *
-     * @param hash_ctx pow hash ctx
+     * Blocks are hashed in pairs, one per ctx, through the interleaved cn_slow_hash::hash_multi.
+     *
+     * @param hash_ctx0 pow hash ctx for the first block of each pair
+     * @param hash_ctx1 pow hash ctx for the second block of each pair
      * @param blocks the blocks to be hashed
      * @param map return-by-reference the hashes for each block
      */
-	void block_longhash_worker(cn_pow_hash_v2 &hash_ctx, const std::vector<block> &blocks, std::unordered_map<crypto::hash, crypto::hash> &map);
+	void block_longhash_worker(cn_pow_hash_v2 &hash_ctx0, cn_pow_hash_v2 &hash_ctx1, const std::vector<block> &blocks, std::unordered_map<crypto::hash, crypto::hash> &map);
 
 	/**
      * @brief returns a set of known alternate chains
@@ -951,6 +1001,18 @@ class Blockchain
 
 	bool is_within_compiled_block_hash_area(uint64_t height) const;
 	bool is_within_compiled_block_hash_area() const { return is_within_compiled_block_hash_area(m_db->height()); }
+
+	/**
+     * @brief checks the blocks in the db against the compiled-in block hashes
+     *
+     * Unlike the fast sync path this also covers a chain that is already
+     * past the compiled-in area, e.g. after bulk loading a snapshot.
+     *
+     * @param checked_height return-by-reference the height up to which blocks were checked
+     *
+     * @return false if a group of blocks does not match, otherwise true
+     */
+	bool check_compiled_in_block_hashes(uint64_t &checked_height) const;
 	uint64_t prevalidate_block_hashes(uint64_t height, const std::list<crypto::hash> &hashes);
 
 	void lock();
@@ -967,6 +1029,42 @@ class Blockchain
 	void on_new_tx_from_block(const cryptonote::transaction &tx);
 
   private:
+	/**
+     * @brief verifies the rct semantics of all txes of an incoming span in one batch
+     *
+     * On success the tx hashes are recorded so that check_tx_semantic can skip the
+     * per tx check, on failure nothing is recorded.
+     *
+     * @param txes the parsed transactions of the span
+     * @param tx_hashes their hashes, in the same order
+     * @param precomputed tx hashes already verified by precompute_incoming_blocks
+     */
+	void batch_verify_rct_semantics(const std::vector<transaction> &txes, const std::vector<crypto::hash> &tx_hashes, const std::unordered_set<crypto::hash> &precomputed);
+
+	/**
+     * @brief checks the next few blocks queued by precompute_incoming_blocks
+     *
+     * Computes the long hashes and batch verifies the rct semantics of the txes of
+     * PRECOMPUTE_BLOCKS_PER_TASK blocks, then resubmits itself with the same hash ctx
+     * until all blocks are claimed. Keeping the tasks short matters because threads
+     * waiting on the pool help with queued tasks, including these.
+     *
+     * @param ctx_idx the index of the pow hash ctx owned by this chain of tasks
+     */
+	void precompute_worker(size_t ctx_idx);
+
+	/**
+     * @brief looks for an already known pow hash of a block being prepared
+     *
+     * Checks m_blocks_longhash_table, then the db pow hash cache if enabled,
+     * and adds what the cache had to m_blocks_longhash_table.
+     *
+     * @param id the block's hash
+     *
+     * @return true if the pow hash is known, false if it needs to be computed
+     */
+	bool find_known_longhash(const crypto::hash &id);
+
 	// TODO: evaluate whether or not each of these typedefs are left over from blockchain_storage
 	typedef std::unordered_map<crypto::hash, size_t> blocks_by_id_index;
 
@@ -996,7 +1094,16 @@ class Blockchain
 	// metadata containers
 	std::unordered_map<crypto::hash, std::unordered_map<crypto::key_image, std::vector<output_data_t>>> m_scan_table;
 	std::unordered_map<crypto::hash, crypto::hash> m_blocks_longhash_table;
-	std::unordered_map<crypto::hash, std::unordered_map<crypto::key_image, bool>> m_check_txin_table;
+	std::unordered_set<crypto::hash> m_rct_semantics_verified;
+
+	// next span, checked in the background by precompute_incoming_blocks; only touched with
+	// m_blockchain_lock held and m_precompute_waiter waited on, or by the pending tasks
+	tools::threadpool::waiter m_precompute_waiter;
+	std::vector<block> m_precompute_blocks;
+	std::vector<std::list<blobdata>> m_precompute_txs;
+	std::vector<crypto::hash> m_precompute_longhash;
+	std::vector<std::vector<crypto::hash>> m_precompute_rct_verified;
+	std::atomic<size_t> m_precompute_next;
 
 	// SHA-3 hashes for each block and for fast pow checking
 	std::vector<crypto::hash> m_blocks_hash_of_hashes;
@@ -1009,6 +1116,7 @@ class Blockchain
 	blockchain_db_sync_mode m_db_sync_mode;
 	bool m_fast_sync;
 	bool m_show_time_stats;
+	bool m_pow_hash_cache;
 	bool m_db_default_sync;
 	uint64_t m_db_blocks_per_sync;
 	uint64_t m_max_prepare_blocks_threads;
@@ -1398,6 +1506,15 @@ class Blockchain
      */
 	void load_compiled_in_block_hashes();
 
+	/**
+     * @brief parses the compiled-in block hashes, checking the mainnet data against its expected hash
+     *
+     * @param hashes return-by-reference the hash of each HASH_OF_HASHES_STEP group of block hashes
+     *
+     * @return false if there is no usable compiled-in data, otherwise true
+     */
+	bool get_compiled_in_block_hashes(std::vector<crypto::hash> &hashes) const;
+
 	/**
      * @brief expands v2 transaction data from blockchain
      *
@@ -112,6 +112,8 @@ static const command_line::arg_descriptor<uint64_t> arg_prep_blocks_threads = {
 	"prep-blocks-threads", "Max number of threads to use when preparing block hashes in groups.", 4};
 static const command_line::arg_descriptor<uint64_t> arg_show_time_stats = {
 	"show-time-stats", "Show time-stats when processing blocks/txs and disk synchronization.", 0};
+static const command_line::arg_descriptor<bool> arg_db_pow_cache = {
+	"db-pow-cache", "Keep the PoW hash of verified blocks in the database, so that resyncs, re-imports and reorgs skip the slow hash.", false};
 static const command_line::arg_descriptor<size_t> arg_block_sync_size = {
 	"block-sync-size", "How many blocks to sync at once during chain synchronization (0 = adaptive).", 0};
 static const command_line::arg_descriptor<std::string> arg_check_updates = {
@@ -222,6 +224,7 @@ void core::init_options(boost::program_options::options_description &desc)
 	command_line::add_arg(desc, arg_prep_blocks_threads);
 	command_line::add_arg(desc, arg_fast_block_sync);
 	command_line::add_arg(desc, arg_show_time_stats);
+	command_line::add_arg(desc, arg_db_pow_cache);
 	command_line::add_arg(desc, arg_block_sync_size);
 	command_line::add_arg(desc, arg_check_updates);
 	command_line::add_arg(desc, arg_fluffy_blocks);
@@ -456,6 +459,7 @@ bool core::init(const boost::program_options::variables_map &vm, const char *con
 
 	m_blockchain_storage.set_user_options(blocks_threads,
 										  blocks_per_sync, sync_mode, fast_sync);
+	m_blockchain_storage.set_pow_hash_cache(command_line::get_arg(vm, arg_db_pow_cache));
 
 	r = m_blockchain_storage.init(db.release(), m_nettype, m_offline, test_options);
 
@@ -801,6 +805,13 @@ bool core::check_tx_semantic(const transaction &tx, bool keeped_by_block) const
 	}
 
 	const rct::rctSig &rv = tx.rct_signatures;
+	if(keeped_by_block && (rv.type == rct::RCTTypeSimple || rv.type == rct::RCTTypeBulletproof) &&
+	   m_blockchain_storage.is_rct_semantics_batch_verified(get_transaction_hash(tx)))
+	{
+		GULPS_LOG_L2("rct semantics already verified in block span batch");
+		return true;
+	}
+
 	switch(rv.type)
 	{
 	case rct::RCTTypeNull:
@@ -1151,6 +1162,12 @@ bool core::cleanup_handle_incoming_blocks(bool force_sync)
 	return success;
 }
 
+//-----------------------------------------------------------------------------------------------
+void core::precompute_incoming_blocks(uint64_t height, const std::list<block_complete_entry> &blocks)
+{
+	m_blockchain_storage.precompute_incoming_blocks(height, blocks);
+}
+
 //-----------------------------------------------------------------------------------------------
 bool core::handle_incoming_block(const blobdata &block_blob, block_verification_context &bvc, bool update_miner_blocktemplate)
 {
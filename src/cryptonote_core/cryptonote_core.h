@@ -182,6 +182,13 @@ class core : public i_miner_handler
       */
 	bool cleanup_handle_incoming_blocks(bool force_sync = false);
 
+	/**
+      * @copydoc Blockchain::precompute_incoming_blocks
+      *
+      * @note see Blockchain::precompute_incoming_blocks
+      */
+	void precompute_incoming_blocks(uint64_t height, const std::list<block_complete_entry> &blocks);
+
 	/**
       * @brief check the size of a block against the current maximum
       *
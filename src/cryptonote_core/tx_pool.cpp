@@ -246,6 +246,8 @@ bool tx_memory_pool::add_tx(transaction &tx, /*const crypto::hash& tx_prefix_has
 				if(!insert_key_images(tx, kept_by_block))
 					return false;
 				m_txs_by_fee_and_receive_time.emplace(std::pair<double, std::time_t>(fee / (double)blob_size, receive_time), id);
+				add_template_candidate(id, tx, blob_size, fee, false);
+				m_parsed_txes.add(id, tx, blob_size);
 			}
 			catch(const std::exception &e)
 			{
@@ -289,6 +291,9 @@ bool tx_memory_pool::add_tx(transaction &tx, /*const crypto::hash& tx_prefix_has
 			if(!insert_key_images(tx, kept_by_block))
 				return false;
 			m_txs_by_fee_and_receive_time.emplace(std::pair<double, std::time_t>(fee / (double)blob_size, receive_time), id);
+			// inputs were just checked against the current top, and key images against the chain unless kept by block
+			add_template_candidate(id, tx, blob_size, fee, !kept_by_block);
+			m_parsed_txes.add(id, tx, blob_size);
 		}
 		catch(const std::exception &e)
 		{
@@ -361,9 +366,8 @@ void tx_memory_pool::prune(size_t bytes)
 				--it;
 				continue;
 			}
-			cryptonote::blobdata txblob = m_blockchain.get_txpool_tx_blob(txid);
-			cryptonote::transaction tx;
-			if(!parse_and_validate_tx_from_blob(txblob, tx))
+			const parsed_tx_ptr ptx = get_parsed_tx(txid);
+			if(!ptx)
 			{
 				GULPS_ERROR("Failed to parse tx from txpool");
 				return;
@@ -371,9 +375,11 @@ void tx_memory_pool::prune(size_t bytes)
 			// remove first, in case this throws, so key images aren't removed
 			GULPSF_INFO("Pruning tx {} from txpool: size: {}, fee/byte: {}", txid , it->first.second , it->first.first);
 			m_blockchain.remove_txpool_tx(txid);
-			m_txpool_size -= txblob.size();
-			remove_transaction_keyimages(tx);
+			m_txpool_size -= ptx->blob_size;
+			remove_transaction_keyimages(ptx->tx);
 			GULPSF_INFO("Pruned tx {} from txpool: size: {}, fee/byte: {}", txid , it->first.second , it->first.first);
+			m_template_candidates.erase(txid);
+			m_parsed_txes.forget(txid);
 			m_txs_by_fee_and_receive_time.erase(it--);
 		}
 		catch(const std::exception &e)
@@ -452,12 +458,13 @@ bool tx_memory_pool::take_tx(const crypto::hash &id, transaction &tx, size_t &bl
 			GULPS_ERROR("Failed to find tx in txpool");
 			return false;
 		}
-		cryptonote::blobdata txblob = m_blockchain.get_txpool_tx_blob(id);
-		if(!parse_and_validate_tx_from_blob(txblob, tx))
+		const parsed_tx_ptr ptx = get_parsed_tx(id);
+		if(!ptx)
 		{
 			GULPS_ERROR("Failed to parse tx from txpool");
 			return false;
 		}
+		tx = ptx->tx;
 		blob_size = meta.blob_size;
 		fee = meta.fee;
 		relayed = meta.relayed;
@@ -476,6 +483,8 @@ bool tx_memory_pool::take_tx(const crypto::hash &id, transaction &tx, size_t &bl
 	}
 
 	m_txs_by_fee_and_receive_time.erase(sorted_it);
+	m_template_candidates.erase(id);
+	m_parsed_txes.forget(id);
 	return true;
 }
 //---------------------------------------------------------------------------------
@@ -513,6 +522,7 @@ bool tx_memory_pool::remove_stuck_transactions()
 			{
 				m_txs_by_fee_and_receive_time.erase(sorted_it);
 			}
+			m_template_candidates.erase(txid);
 			m_timed_out_transactions.insert(txid);
 			remove.insert(txid);
 		}
@@ -527,9 +537,8 @@ bool tx_memory_pool::remove_stuck_transactions()
 		{
 			try
 			{
-				cryptonote::blobdata bd = m_blockchain.get_txpool_tx_blob(txid);
-				cryptonote::transaction tx;
-				if(!parse_and_validate_tx_from_blob(bd, tx))
+				const parsed_tx_ptr ptx = get_parsed_tx(txid);
+				if(!ptx)
 				{
 					GULPS_ERROR("Failed to parse tx from txpool");
 					// continue
@@ -538,8 +547,9 @@ bool tx_memory_pool::remove_stuck_transactions()
 				{
 					// remove first, so we only remove key images if the tx removal succeeds
 					m_blockchain.remove_txpool_tx(txid);
-					m_txpool_size -= bd.size();
-					remove_transaction_keyimages(tx);
+					m_txpool_size -= ptx->blob_size;
+					remove_transaction_keyimages(ptx->tx);
+					m_parsed_txes.forget(txid);
 				}
 			}
 			catch(const std::exception &e)
@@ -623,18 +633,18 @@ void tx_memory_pool::get_transactions(std::list<transaction> &txs, bool include_
 {
 	CRITICAL_REGION_LOCAL(m_transactions_lock);
 	CRITICAL_REGION_LOCAL1(m_blockchain);
-	m_blockchain.for_all_txpool_txes([&txs](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *bd) {
-		transaction tx;
-		if(!parse_and_validate_tx_from_blob(*bd, tx))
+	m_blockchain.for_all_txpool_txes([this, &txs](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *bd) {
+		const parsed_tx_ptr ptx = get_parsed_tx(txid);
+		if(!ptx)
 		{
 			GULPS_ERROR("Failed to parse tx from txpool");
 			// continue
 			return true;
 		}
-		txs.push_back(tx);
+		txs.push_back(ptx->tx);
 		return true;
 	},
-									 true, include_unrelayed_txes);
+									 false, include_unrelayed_txes);
 }
 //------------------------------------------------------------------
 void tx_memory_pool::get_transaction_hashes(std::vector<crypto::hash> &txs, bool include_unrelayed_txes) const
@@ -745,18 +755,18 @@ bool tx_memory_pool::get_transactions_and_spent_keys_info(std::vector<tx_info> &
 {
 	CRITICAL_REGION_LOCAL(m_transactions_lock);
 	CRITICAL_REGION_LOCAL1(m_blockchain);
-	m_blockchain.for_all_txpool_txes([&tx_infos, key_image_infos, include_sensitive_data](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *bd) {
+	m_blockchain.for_all_txpool_txes([this, &tx_infos, key_image_infos, include_sensitive_data](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *bd) {
 		tx_info txi;
 		txi.id_hash = epee::string_tools::pod_to_hex(txid);
 		txi.tx_blob = *bd;
-		transaction tx;
-		if(!parse_and_validate_tx_from_blob(*bd, tx))
+		const parsed_tx_ptr ptx = get_parsed_tx(txid, bd);
+		if(!ptx)
 		{
 			GULPS_ERROR("Failed to parse tx from txpool");
 			// continue
 			return true;
 		}
-		txi.tx_json = obj_to_json_str(tx);
+		txi.tx_json = m_parsed_txes.get_json(ptx);
 		txi.blob_size = meta.blob_size;
 		txi.fee = meta.fee;
 		txi.kept_by_block = meta.kept_by_block;
@@ -817,17 +827,17 @@ bool tx_memory_pool::get_pool_for_rpc(std::vector<cryptonote::rpc::tx_in_pool> &
 {
 	CRITICAL_REGION_LOCAL(m_transactions_lock);
 	CRITICAL_REGION_LOCAL1(m_blockchain);
-	m_blockchain.for_all_txpool_txes([&tx_infos, key_image_infos](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *bd) {
+	m_blockchain.for_all_txpool_txes([this, &tx_infos, key_image_infos](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *bd) {
 		cryptonote::rpc::tx_in_pool txi;
 		txi.tx_hash = txid;
-		transaction tx;
-		if(!parse_and_validate_tx_from_blob(*bd, tx))
+		const parsed_tx_ptr ptx = get_parsed_tx(txid);
+		if(!ptx)
 		{
 			GULPS_ERROR("Failed to parse tx from txpool");
 			// continue
 			return true;
 		}
-		txi.tx = tx;
+		txi.tx = ptx->tx;
 		txi.blob_size = meta.blob_size;
 		txi.fee = meta.fee;
 		txi.kept_by_block = meta.kept_by_block;
@@ -843,7 +853,7 @@ bool tx_memory_pool::get_pool_for_rpc(std::vector<cryptonote::rpc::tx_in_pool> &
 		tx_infos.push_back(txi);
 		return true;
 	},
-									 true, false);
+									 false, false);
 
 	for(const key_images_container::value_type &kee : m_spent_key_images)
 	{
@@ -889,13 +899,34 @@ bool tx_memory_pool::get_transaction(const crypto::hash &id, cryptonote::blobdat
 	}
 }
 //---------------------------------------------------------------------------------
-bool tx_memory_pool::on_blockchain_inc(uint64_t new_block_height, const crypto::hash &top_block_id)
+bool tx_memory_pool::on_blockchain_inc(uint64_t new_block_height, const crypto::hash &top_block_id, const std::vector<transaction> &block_txs)
 {
+	CRITICAL_REGION_LOCAL(m_transactions_lock);
+	CRITICAL_REGION_LOCAL1(m_blockchain);
+	if(new_block_height < 2)
+		return true;
+
+	std::unordered_set<crypto::key_image> spent;
+	for(const transaction &tx : block_txs)
+	{
+		for(const txin_v &in : tx.vin)
+		{
+			if(in.type() == typeid(txin_to_key))
+				spent.insert(boost::get<txin_to_key>(in).k_image);
+		}
+	}
+
+	const crypto::hash prev_id = m_blockchain.get_block_id_by_height(new_block_height - 2);
+	const uint8_t hf_version = m_blockchain.get_current_hard_fork_version_num();
+	m_template_candidates.on_block_added(prev_id, top_block_id, hf_version, spent);
 	return true;
 }
 //---------------------------------------------------------------------------------
 bool tx_memory_pool::on_blockchain_dec(uint64_t new_block_height, const crypto::hash &top_block_id)
 {
+	CRITICAL_REGION_LOCAL(m_transactions_lock);
+	CRITICAL_REGION_LOCAL1(m_blockchain);
+	m_template_candidates.on_blocks_removed();
 	return true;
 }
 //---------------------------------------------------------------------------------
@@ -983,26 +1014,67 @@ bool tx_memory_pool::is_transaction_ready_to_go(txpool_tx_meta_t &txd, transacti
 	return true;
 }
 //---------------------------------------------------------------------------------
-bool tx_memory_pool::have_key_images(const std::unordered_set<crypto::key_image> &k_images, const transaction &tx)
+void tx_memory_pool::add_template_candidate(const crypto::hash &id, const transaction &tx, size_t blob_size, uint64_t fee, bool ready)
 {
-	for(size_t i = 0; i != tx.vin.size(); i++)
+	const crypto::hash top_id = ready ? m_blockchain.get_tail_id() : null_hash;
+	m_template_candidates.set(id, tx, blob_size, fee, ready, top_id, m_blockchain.get_current_hard_fork_version_num());
+}
+//---------------------------------------------------------------------------------
+bool tx_memory_pool::refresh_template_candidate(const crypto::hash &id, template_candidate &candidate, const crypto::hash &top_id, uint8_t hf_version)
+{
+	txpool_tx_meta_t meta;
+	if(!m_blockchain.get_txpool_tx_meta(id, meta))
 	{
-		CHECKED_GET_SPECIFIC_VARIANT(tx.vin[i], const txin_to_key, itk, false);
-		if(k_images.count(itk.k_image))
-			return true;
+		GULPS_ERROR("  failed to find tx meta");
+		return false;
 	}
-	return false;
+	const parsed_tx_ptr ptx = get_parsed_tx(id);
+	if(!ptx)
+	{
+		GULPS_ERROR("Failed to parse tx from txpool");
+		return false;
+	}
+	// check_tx_inputs expands the rct signatures in place, so check a copy of the cached tx
+	transaction tx = ptx->tx;
+
+	const cryptonote::txpool_tx_meta_t original_meta = meta;
+	bool ready = is_transaction_ready_to_go(meta, tx);
+	if(memcmp(&original_meta, &meta, sizeof(meta)))
+	{
+		try
+		{
+			m_blockchain.update_txpool_tx(id, meta);
+		}
+		catch(const std::exception &e)
+		{
+			GULPSF_ERROR("Failed to update tx meta: {}" , e.what());
+			// continue, not fatal
+		}
+	}
+
+	add_template_candidate(id, tx, meta.blob_size, meta.fee, ready);
+	candidate.checked_top_id = top_id;
+	candidate.checked_hf_version = hf_version;
+	return true;
 }
 //---------------------------------------------------------------------------------
-bool tx_memory_pool::append_key_images(std::unordered_set<crypto::key_image> &k_images, const transaction &tx)
+parsed_tx_ptr tx_memory_pool::get_parsed_tx(const crypto::hash &id, const cryptonote::blobdata *blob) const
 {
-	for(size_t i = 0; i != tx.vin.size(); i++)
+	parsed_tx_ptr ptx = m_parsed_txes.get(id);
+	if(ptx)
+		return ptx;
+
+	cryptonote::blobdata txblob;
+	if(!blob)
 	{
-		CHECKED_GET_SPECIFIC_VARIANT(tx.vin[i], const txin_to_key, itk, false);
-		auto i_res = k_images.insert(itk.k_image);
-		GULPS_CHECK_AND_ASSERT_MES(i_res.second, false, "internal error: key images pool cache - inserted duplicate image in set: " , itk.k_image);
+		if(!m_blockchain.get_txpool_tx_blob(id, txblob))
+			return nullptr;
+		blob = &txblob;
 	}
-	return true;
+	transaction tx;
+	if(!parse_and_validate_tx_from_blob(*blob, tx))
+		return nullptr;
+	return m_parsed_txes.add(id, std::move(tx), blob->size());
 }
 //---------------------------------------------------------------------------------
 void tx_memory_pool::mark_double_spend(const transaction &tx)
@@ -1049,17 +1121,17 @@ std::string tx_memory_pool::print_pool(bool short_format) const
 	std::stringstream ss;
 	CRITICAL_REGION_LOCAL(m_transactions_lock);
 	CRITICAL_REGION_LOCAL1(m_blockchain);
-	m_blockchain.for_all_txpool_txes([&ss, short_format](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *txblob) {
+	m_blockchain.for_all_txpool_txes([this, &ss, short_format](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *txblob) {
 		ss << "id: " << txid << std::endl;
 		if(!short_format)
 		{
-			cryptonote::transaction tx;
-			if(!parse_and_validate_tx_from_blob(*txblob, tx))
+			const parsed_tx_ptr ptx = get_parsed_tx(txid);
+			if(!ptx)
 			{
 				GULPS_ERROR("Failed to parse tx from txpool");
 				return true; // continue
 			}
-			ss << obj_to_json_str(tx) << std::endl;
+			ss << m_parsed_txes.get_json(ptx) << std::endl;
 		}
 		ss << "blob_size: " << meta.blob_size << std::endl
 		   << "fee: " << print_money(meta.fee) << std::endl
@@ -1100,18 +1172,18 @@ bool tx_memory_pool::fill_block_template(block &bl, size_t median_size, uint64_t
 
 	LockedTXN lock(m_blockchain);
 
+	// Candidates are only reloaded from the db when the chain moved since their last check
+	const crypto::hash top_id = m_blockchain.get_tail_id();
+	const uint8_t hf_version = m_blockchain.get_current_hard_fork_version_num();
 	for(auto& tx_hash : m_txs_by_fee_and_receive_time)
 	{
-		txpool_tx_meta_t meta;
-		if(!m_blockchain.get_txpool_tx_meta(tx_hash.second, meta))
-		{
-			GULPS_ERROR("  failed to find tx meta");
+		template_candidate &candidate = m_template_candidates[tx_hash.second];
+		if(candidate.blob_size == 0 && !refresh_template_candidate(tx_hash.second, candidate, top_id, hf_version))
 			continue;
-		}
-		GULPSF_LOG_L2("Considering {}, size {}, current block size {}/{}, current coinbase {}", tx_hash.second, meta.blob_size, total_size, max_total_size, print_money(best_coinbase));
+		GULPSF_LOG_L2("Considering {}, size {}, current block size {}/{}, current coinbase {}", tx_hash.second, candidate.blob_size, total_size, max_total_size, print_money(best_coinbase));
 
 		// Can not exceed maximum block size
-		if(max_total_size < total_size + meta.blob_size)
+		if(max_total_size < total_size + candidate.blob_size)
 		{
 			GULPS_LOG_L2("  would exceed maximum block size");
 			continue;
@@ -1120,59 +1192,40 @@ bool tx_memory_pool::fill_block_template(block &bl, size_t median_size, uint64_t
 		// If we're getting lower coinbase tx,
 		// stop including more tx
 		uint64_t block_reward;
-		if(!get_block_reward(m_blockchain.get_nettype(), median_size, total_size + meta.blob_size + CRYPTONOTE_COINBASE_BLOB_RESERVED_SIZE, already_generated_coins, block_reward, height))
+		if(!get_block_reward(m_blockchain.get_nettype(), median_size, total_size + candidate.blob_size + CRYPTONOTE_COINBASE_BLOB_RESERVED_SIZE, already_generated_coins, block_reward, height))
 		{
 			GULPS_LOG_L2("  would exceed maximum block size");
 			continue;
 		}
-		uint64_t coinbase = block_reward + fee + meta.fee;
+		uint64_t coinbase = block_reward + fee + candidate.fee;
 		if(coinbase < template_accept_threshold(best_coinbase))
 		{
 			GULPS_LOG_L2("  would decrease coinbase to ", print_money(coinbase));
 			continue;
 		}
 
-		cryptonote::blobdata txblob = m_blockchain.get_txpool_tx_blob(tx_hash.second);
-		cryptonote::transaction tx;
-		if(!parse_and_validate_tx_from_blob(txblob, tx))
-		{
-			GULPS_ERROR("Failed to parse tx from txpool");
-			continue;
-		}
-
 		// Skip transactions that are not ready to be
 		// included into the blockchain or that are
 		// missing key images
-		const cryptonote::txpool_tx_meta_t original_meta = meta;
-		bool ready = is_transaction_ready_to_go(meta, tx);
-		if(memcmp(&original_meta, &meta, sizeof(meta)))
-		{
-			try
-			{
-				m_blockchain.update_txpool_tx(tx_hash.second, meta);
-			}
-			catch(const std::exception &e)
-			{
-				GULPSF_ERROR("Failed to update tx meta: {}" , e.what());
-				// continue, not fatal
-			}
-		}
-		if(!ready)
+		if(!candidate.is_current(top_id, hf_version) &&
+		   !refresh_template_candidate(tx_hash.second, candidate, top_id, hf_version))
+			continue;
+		if(!candidate.ready)
 		{
 			GULPS_LOG_L2("  not ready to go");
 			continue;
 		}
-		if(have_key_images(k_images, tx))
+		if(std::any_of(candidate.key_images.begin(), candidate.key_images.end(), [&k_images](const crypto::key_image &ki) { return k_images.count(ki) != 0; }))
 		{
 			GULPS_LOG_L2("  key images already seen");
 			continue;
 		}
 
 		bl.tx_hashes.push_back(tx_hash.second);
-		total_size += meta.blob_size;
-		fee += meta.fee;
+		total_size += candidate.blob_size;
+		fee += candidate.fee;
 		best_coinbase = coinbase;
-		append_key_images(k_images, tx);
+		k_images.insert(candidate.key_images.begin(), candidate.key_images.end());
 		GULPSF_LOG_L2("  added, new block size {}/{}, coinbase {}", total_size, max_total_size, print_money(best_coinbase));
 	}
 
@@ -1214,17 +1267,16 @@ size_t tx_memory_pool::validate()
 		{
 			try
 			{
-				cryptonote::blobdata txblob = m_blockchain.get_txpool_tx_blob(txid);
-				cryptonote::transaction tx;
-				if(!parse_and_validate_tx_from_blob(txblob, tx))
+				const parsed_tx_ptr ptx = get_parsed_tx(txid);
+				if(!ptx)
 				{
 					GULPS_ERROR("Failed to parse tx from txpool");
 					continue;
 				}
 				// remove tx from db first
 				m_blockchain.remove_txpool_tx(txid);
-				m_txpool_size -= txblob.size();
-				remove_transaction_keyimages(tx);
+				m_txpool_size -= ptx->blob_size;
+				remove_transaction_keyimages(ptx->tx);
 				auto sorted_it = find_tx_in_sorted_container(txid);
 				if(sorted_it == m_txs_by_fee_and_receive_time.end())
 				{
@@ -1234,6 +1286,8 @@ size_t tx_memory_pool::validate()
 				{
 					m_txs_by_fee_and_receive_time.erase(sorted_it);
 				}
+				m_template_candidates.erase(txid);
+				m_parsed_txes.forget(txid);
 				++n_removed;
 			}
 			catch(const std::exception &e)
@@ -1253,6 +1307,8 @@ bool tx_memory_pool::init(size_t max_txpool_size)
 
 	m_txpool_max_size = max_txpool_size ? max_txpool_size : DEFAULT_TXPOOL_MAX_SIZE;
 	m_txs_by_fee_and_receive_time.clear();
+	m_template_candidates.clear();
+	m_parsed_txes.clear();
 	m_spent_key_images.clear();
 	m_txpool_size = 0;
 	std::vector<crypto::hash> remove;
@@ -1277,6 +1333,8 @@ bool tx_memory_pool::init(size_t max_txpool_size)
 				return false;
 			}
 			m_txs_by_fee_and_receive_time.emplace(std::pair<double, time_t>(meta.fee / (double)meta.blob_size, meta.receive_time), txid);
+			add_template_candidate(txid, tx, meta.blob_size, meta.fee, false);
+			m_parsed_txes.add(txid, tx, meta.blob_size);
 			m_txpool_size += meta.blob_size;
 			return true;
 		},
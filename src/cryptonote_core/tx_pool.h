@@ -49,6 +49,8 @@
 
 #include <boost/serialization/version.hpp>
 #include <boost/utility.hpp>
+#include <list>
+#include <memory>
 #include <queue>
 #include <set>
 #include <unordered_map>
@@ -63,6 +65,7 @@
 #include "rpc/message_data_structs.h"
 #include "string_tools.h"
 #include "syncobj.h"
+#include "tx_pool_cache.h"
 
 namespace cryptonote
 {
@@ -176,19 +179,21 @@ class tx_memory_pool : boost::noncopyable
 	/**
      * @brief action to take when notified of a block added to the blockchain
      *
-     * Currently does nothing
+     * Carries the ready verdicts of block template candidates over to the
+     * new top block when the block spent none of their key images
      *
      * @param new_block_height the height of the blockchain after the change
      * @param top_block_id the hash of the new top block
+     * @param block_txs the transactions of the new top block
      *
      * @return true
      */
-	bool on_blockchain_inc(uint64_t new_block_height, const crypto::hash &top_block_id);
+	bool on_blockchain_inc(uint64_t new_block_height, const crypto::hash &top_block_id, const std::vector<transaction> &block_txs);
 
 	/**
      * @brief action to take when notified of a block removed from the blockchain
      *
-     * Currently does nothing
+     * Drops the ready verdicts of all block template candidates
      *
      * @param new_block_height the height of the blockchain after the change
      * @param top_block_id the hash of the new top block
@@ -496,33 +501,48 @@ class tx_memory_pool : boost::noncopyable
 	bool remove_transaction_keyimages(const transaction &tx);
 
 	/**
-     * @brief check if any of a transaction's spent key images are present in a given set
+     * @brief check if a transaction is a valid candidate for inclusion in a block
      *
-     * @param kic the set of key images to check against
-     * @param tx the transaction to check
+     * @param txd the transaction to check (and info about it)
      *
-     * @return true if any key images present in the set, otherwise false
+     * @return true if the transaction is good to go, otherwise false
      */
-	static bool have_key_images(const std::unordered_set<crypto::key_image> &kic, const transaction &tx);
+	bool is_transaction_ready_to_go(txpool_tx_meta_t &txd, transaction &tx) const;
 
 	/**
-     * @brief append the key images from a transaction to the given set
+     * @brief caches a transaction entering the pool as a block template candidate
      *
-     * @param kic the set of key images to append to
+     * @param id the transaction hash
      * @param tx the transaction
+     * @param blob_size the transaction's size
+     * @param fee the transaction's fee
+     * @param ready whether the transaction's inputs were just verified against the current chain top
+     */
+	void add_template_candidate(const crypto::hash &id, const transaction &tx, size_t blob_size, uint64_t fee, bool ready);
+
+	/**
+     * @brief reloads a candidate from the pool and runs is_transaction_ready_to_go on it
      *
-     * @return false if any append fails, otherwise true
+     * @param id the transaction hash
+     * @param candidate the candidate to refresh
+     * @param top_id the current chain top
+     * @param hf_version the current hard fork version
+     *
+     * @return false if the transaction could not be loaded, otherwise true
      */
-	static bool append_key_images(std::unordered_set<crypto::key_image> &kic, const transaction &tx);
+	bool refresh_template_candidate(const crypto::hash &id, template_candidate &candidate, const crypto::hash &top_id, uint8_t hf_version);
 
 	/**
-     * @brief check if a transaction is a valid candidate for inclusion in a block
+     * @brief gets a pool transaction from the parsed transaction cache
      *
-     * @param txd the transaction to check (and info about it)
+     * On a miss, the blob is parsed and the result cached.
      *
-     * @return true if the transaction is good to go, otherwise false
+     * @param id the transaction hash
+     * @param blob the transaction blob if the caller has it, otherwise it is read from the pool
+     *
+     * @return the parsed transaction, or nullptr if it could not be loaded
      */
-	bool is_transaction_ready_to_go(txpool_tx_meta_t &txd, transaction &tx) const;
+	parsed_tx_ptr get_parsed_tx(const crypto::hash &id, const cryptonote::blobdata *blob = nullptr) const;
 
 	/**
      * @brief mark all transactions double spending the one passed
@@ -566,6 +586,12 @@ class tx_memory_pool : boost::noncopyable
 	//!< container for transactions organized by fee per size and receive time
 	sorted_tx_container m_txs_by_fee_and_receive_time;
 
+	//! block template candidates, one per pooled transaction
+	template_candidate_cache m_template_candidates;
+
+	//! parsed pool transactions
+	mutable parsed_tx_cache m_parsed_txes;
+
 	/**
      * @brief get an iterator to a transaction in the sorted container
      *
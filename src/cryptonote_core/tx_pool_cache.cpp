@@ -0,0 +1,188 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+
+#include "tx_pool_cache.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+
+namespace cryptonote
+{
+//---------------------------------------------------------------------------------
+size_t get_parsed_tx_mem_size(const transaction &tx)
+{
+	size_t size = sizeof(parsed_tx) + tx.vin.size() * sizeof(txin_v) + tx.vout.size() * sizeof(tx_out) + tx.extra.size();
+	for(const txin_v &in : tx.vin)
+	{
+		if(in.type() == typeid(txin_to_key))
+			size += boost::get<txin_to_key>(in).key_offsets.size() * sizeof(uint64_t);
+	}
+	for(const std::vector<crypto::signature> &sigs : tx.signatures)
+		size += sizeof(sigs) + sigs.size() * sizeof(crypto::signature);
+
+	const rct::rctSig &rv = tx.rct_signatures;
+	for(const rct::ctkeyV &ring : rv.mixRing)
+		size += sizeof(ring) + ring.size() * sizeof(rct::ctkey);
+	size += rv.pseudoOuts.size() * sizeof(rct::key) + rv.ecdhInfo.size() * sizeof(rct::ecdhTuple) + rv.outPk.size() * sizeof(rct::ctkey);
+	size += rv.p.rangeSigs.size() * sizeof(rct::rangeSig) + rv.p.pseudoOuts.size() * sizeof(rct::key);
+	for(const rct::Bulletproof &bp : rv.p.bulletproofs)
+		size += sizeof(bp) + (bp.V.size() + bp.L.size() + bp.R.size()) * sizeof(rct::key);
+	for(const rct::mgSig &mg : rv.p.MGs)
+	{
+		size += sizeof(mg) + mg.II.size() * sizeof(rct::key);
+		for(const rct::keyV &ss : mg.ss)
+			size += sizeof(ss) + ss.size() * sizeof(rct::key);
+	}
+	return size;
+}
+//---------------------------------------------------------------------------------
+parsed_tx_ptr parsed_tx_cache::get(const crypto::hash &id)
+{
+	auto it = m_index.find(id);
+	if(it == m_index.end())
+		return nullptr;
+	m_entries.splice(m_entries.begin(), m_entries, it->second);
+	return it->second->second;
+}
+//---------------------------------------------------------------------------------
+parsed_tx_ptr parsed_tx_cache::add(const crypto::hash &id, transaction tx, size_t blob_size)
+{
+	forget(id);
+
+	std::shared_ptr<parsed_tx> ptx = std::make_shared<parsed_tx>();
+	ptx->tx = std::move(tx);
+	ptx->blob_size = blob_size;
+	ptx->tx_mem_size = get_parsed_tx_mem_size(ptx->tx);
+	get_transaction_hash(ptx->tx);
+	m_entries.emplace_front(id, ptx);
+	m_index[id] = m_entries.begin();
+	m_size += ptx->mem_size();
+	trim();
+	return ptx;
+}
+//---------------------------------------------------------------------------------
+const std::string &parsed_tx_cache::get_json(const parsed_tx_ptr &ptx)
+{
+	if(ptx->json.empty())
+	{
+		// serializing does not modify the transaction, the archive just takes it by reference
+		ptx->json = obj_to_json_str(const_cast<transaction &>(ptx->tx));
+		auto it = m_index.find(get_transaction_hash(ptx->tx));
+		if(it != m_index.end() && it->second->second == ptx)
+		{
+			m_size += ptx->json.size();
+			trim();
+		}
+	}
+	return ptx->json;
+}
+//---------------------------------------------------------------------------------
+void parsed_tx_cache::forget(const crypto::hash &id)
+{
+	auto it = m_index.find(id);
+	if(it == m_index.end())
+		return;
+	m_size -= it->second->second->mem_size();
+	m_entries.erase(it->second);
+	m_index.erase(it);
+}
+//---------------------------------------------------------------------------------
+void parsed_tx_cache::clear()
+{
+	m_entries.clear();
+	m_index.clear();
+	m_size = 0;
+}
+//---------------------------------------------------------------------------------
+void parsed_tx_cache::trim()
+{
+	while(m_size > m_max_size && !m_entries.empty())
+	{
+		const entry_list::value_type &last = m_entries.back();
+		m_size -= last.second->mem_size();
+		m_index.erase(last.first);
+		m_entries.pop_back();
+	}
+}
+//---------------------------------------------------------------------------------
+const template_candidate *template_candidate_cache::find(const crypto::hash &id) const
+{
+	auto it = m_candidates.find(id);
+	return it == m_candidates.end() ? nullptr : &it->second;
+}
+//---------------------------------------------------------------------------------
+void template_candidate_cache::set(const crypto::hash &id, const transaction &tx, size_t blob_size, uint64_t fee, bool ready, const crypto::hash &top_id, uint8_t hf_version)
+{
+	template_candidate &candidate = m_candidates[id];
+	candidate.blob_size = blob_size;
+	candidate.fee = fee;
+	candidate.key_images.clear();
+	for(const txin_v &in : tx.vin)
+	{
+		if(in.type() == typeid(txin_to_key))
+			candidate.key_images.push_back(boost::get<txin_to_key>(in).k_image);
+	}
+	candidate.ready = ready;
+	candidate.checked_top_id = top_id;
+	candidate.checked_hf_version = hf_version;
+}
+//---------------------------------------------------------------------------------
+void template_candidate_cache::on_block_added(const crypto::hash &prev_id, const crypto::hash &top_id, uint8_t hf_version, const std::unordered_set<crypto::key_image> &spent)
+{
+	// Inputs that were valid below the new block stay valid on top of it under the same
+	// fork rules, so a ready candidate only has to be checked against the key images the
+	// block spent. Everything else is rechecked by the next fill_block_template.
+	for(auto &c : m_candidates)
+	{
+		template_candidate &candidate = c.second;
+		if(!candidate.ready || !candidate.is_current(prev_id, hf_version))
+			continue;
+		if(std::none_of(candidate.key_images.begin(), candidate.key_images.end(), [&spent](const crypto::key_image &ki) { return spent.count(ki) != 0; }))
+			candidate.checked_top_id = top_id;
+	}
+}
+//---------------------------------------------------------------------------------
+void template_candidate_cache::on_blocks_removed()
+{
+	// a verdict may have been reached on one of the removed blocks
+	for(auto &c : m_candidates)
+		c.second.checked_top_id = crypto::null_hash;
+}
+}
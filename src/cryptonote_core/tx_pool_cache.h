@@ -0,0 +1,207 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "crypto/hash.h"
+#include "cryptonote_basic/cryptonote_basic.h"
+#include "cryptonote_config.h"
+
+namespace cryptonote
+{
+//! a pool transaction kept parsed in memory next to its txpool_blob
+struct parsed_tx
+{
+	transaction tx; //!< with its hash already computed
+	size_t blob_size;
+	size_t tx_mem_size; //!< estimated bytes held in memory by tx
+	mutable std::string json; //!< JSON form for the pool RPCs, filled on first use
+
+	size_t mem_size() const { return tx_mem_size + json.size(); }
+};
+//! entries are shared with the cache, so callers that need to modify the transaction copy it
+typedef std::shared_ptr<const parsed_tx> parsed_tx_ptr;
+
+/**
+ * @brief estimates the memory a parsed transaction holds, including its vectors
+ *
+ * @param tx the transaction
+ *
+ * @return the estimated size in bytes
+ */
+size_t get_parsed_tx_mem_size(const transaction &tx);
+
+/**
+ * @brief parsed pool transactions, evicting the least recently used first
+ *
+ * The size bound covers the estimated memory of the parsed transactions and of their JSON.
+ */
+class parsed_tx_cache
+{
+  public:
+	parsed_tx_cache(size_t max_size = TXPOOL_PARSED_CACHE_MAX_SIZE) : m_max_size(max_size), m_size(0) {}
+
+	/**
+	 * @brief looks a transaction up, making it the most recently used
+	 *
+	 * @param id the transaction hash
+	 *
+	 * @return the cached transaction, or nullptr on a miss
+	 */
+	parsed_tx_ptr get(const crypto::hash &id);
+
+	/**
+	 * @brief adds a transaction, replacing any previous entry with the same hash
+	 *
+	 * @param id the transaction hash
+	 * @param tx the transaction
+	 * @param blob_size the transaction's size
+	 *
+	 * @return the new entry, which is not kept if it is larger than the whole cache
+	 */
+	parsed_tx_ptr add(const crypto::hash &id, transaction tx, size_t blob_size);
+
+	/**
+	 * @brief gets the JSON form of a transaction, serializing it on first use
+	 *
+	 * @param ptx the transaction, as returned by get or add
+	 *
+	 * @return the transaction as JSON
+	 */
+	const std::string &get_json(const parsed_tx_ptr &ptx);
+
+	/**
+	 * @brief drops a transaction
+	 *
+	 * @param id the transaction hash
+	 */
+	void forget(const crypto::hash &id);
+
+	void clear();
+
+	size_t size() const { return m_size; } //!< estimated bytes held by the cached entries
+	size_t count() const { return m_index.size(); }
+
+  private:
+	typedef std::list<std::pair<crypto::hash, parsed_tx_ptr>> entry_list;
+
+	void trim();
+
+	entry_list m_entries; //!< most recently used first
+	std::unordered_map<crypto::hash, entry_list::iterator> m_index;
+	size_t m_max_size;
+	size_t m_size;
+};
+
+//! what fill_block_template needs to know about a pooled transaction
+struct template_candidate
+{
+	size_t blob_size;
+	uint64_t fee;
+	std::vector<crypto::key_image> key_images;
+	crypto::hash checked_top_id; //!< chain top the ready verdict holds for, null_hash if unchecked
+	uint8_t checked_hf_version;
+	bool ready;
+
+	//! whether the ready verdict was reached on the given chain top, otherwise it has to be refreshed
+	bool is_current(const crypto::hash &top_id, uint8_t hf_version) const
+	{
+		return checked_top_id == top_id && checked_hf_version == hf_version;
+	}
+};
+
+/**
+ * @brief block template candidates, one per pooled transaction
+ *
+ * A ready verdict only holds on the chain top it was reached on. A new block carries it
+ * over unless the block spent one of the candidate's key images, removing blocks drops
+ * all of them.
+ */
+class template_candidate_cache
+{
+  public:
+	//! gets a candidate, adding an empty one (blob_size 0) if there is none
+	template_candidate &operator[](const crypto::hash &id) { return m_candidates[id]; }
+
+	//! @return the candidate, or nullptr if there is none
+	const template_candidate *find(const crypto::hash &id) const;
+
+	/**
+	 * @brief adds or replaces a candidate
+	 *
+	 * @param id the transaction hash
+	 * @param tx the transaction
+	 * @param blob_size the transaction's size
+	 * @param fee the transaction's fee
+	 * @param ready whether the transaction's inputs were verified against top_id
+	 * @param top_id the chain top the verdict was reached on
+	 * @param hf_version the hard fork version the verdict was reached on
+	 */
+	void set(const crypto::hash &id, const transaction &tx, size_t blob_size, uint64_t fee, bool ready, const crypto::hash &top_id, uint8_t hf_version);
+
+	/**
+	 * @brief carries the ready verdicts reached on prev_id over to the block added on top of it
+	 *
+	 * @param prev_id the previous chain top
+	 * @param top_id the new chain top
+	 * @param hf_version the hard fork version of the new chain top
+	 * @param spent the key images spent by the transactions of the new block
+	 */
+	void on_block_added(const crypto::hash &prev_id, const crypto::hash &top_id, uint8_t hf_version, const std::unordered_set<crypto::key_image> &spent);
+
+	//! drops all verdicts, the next fill_block_template rechecks every candidate
+	void on_blocks_removed();
+
+	void erase(const crypto::hash &id) { m_candidates.erase(id); }
+	void clear() { m_candidates.clear(); }
+	size_t size() const { return m_candidates.size(); }
+
+  private:
+	std::unordered_map<crypto::hash, template_candidate> m_candidates;
+};
+}
@@ -306,6 +306,20 @@ bool block_queue::get_next_span(uint64_t &height, std::list<cryptonote::block_co
 	return false;
 }
 
+bool block_queue::get_filled_span_at(uint64_t height, std::list<cryptonote::block_complete_entry> &bcel) const
+{
+	boost::unique_lock<boost::recursive_mutex> lock(mutex);
+	for(const span &span : blocks)
+	{
+		if(span.start_block_height == height && !span.blocks.empty() && !is_blockchain_placeholder(span))
+		{
+			bcel = span.blocks;
+			return true;
+		}
+	}
+	return false;
+}
+
 bool block_queue::has_next_span(const boost::uuids::uuid &connection_id, bool &filled) const
 {
 	boost::unique_lock<boost::recursive_mutex> lock(mutex);
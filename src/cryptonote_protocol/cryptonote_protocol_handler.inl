@@ -1025,6 +1025,12 @@ int t_cryptonote_protocol_handler<t_core>::try_add_next_blocks(cryptonote_connec
 
 				m_core.prepare_handle_incoming_blocks(blocks);
 
+				// check the pow and rct semantics of the following span on the threadpool
+				// while this one is verified and written to the db
+				std::list<cryptonote::block_complete_entry> next_blocks;
+				if(m_block_queue.get_filled_span_at(start_height + blocks.size(), next_blocks))
+					m_core.precompute_incoming_blocks(start_height + blocks.size(), next_blocks);
+
 				uint64_t block_process_time_full = 0, transactions_process_time_full = 0;
 				size_t num_txs = 0;
 				for(const block_complete_entry &block_entry : blocks)
@@ -110,6 +110,8 @@ bool t_command_parser_executor::show_difficulty(const std::vector<std::string> &
 
 bool t_command_parser_executor::show_status(const std::vector<std::string> &args)
 {
+	if(args.size() == 1 && args[0] == "metrics")
+		return m_executor.show_metrics();
 	if(!args.empty())
 		return false;
 
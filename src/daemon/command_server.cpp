@@ -98,7 +98,7 @@ t_command_server::t_command_server(
 	m_command_lookup.set_handler(
 		"diff", std::bind(&t_command_parser_executor::show_difficulty, &m_parser, p::_1), "Show the current difficulty.");
 	m_command_lookup.set_handler(
-		"status", std::bind(&t_command_parser_executor::show_status, &m_parser, p::_1), "Show the current status.");
+		"status", std::bind(&t_command_parser_executor::show_status, &m_parser, p::_1), "status [metrics]", "Show the current status, or the daemon metrics in Prometheus text format.");
 	m_command_lookup.set_handler(
 		"stop_daemon", std::bind(&t_command_parser_executor::stop_daemon, &m_parser, p::_1), "Stop the daemon.");
 	m_command_lookup.set_handler(
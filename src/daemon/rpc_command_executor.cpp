@@ -490,6 +490,31 @@ bool t_rpc_command_executor::show_status()
 	return true;
 }
 
+bool t_rpc_command_executor::show_metrics()
+{
+	std::string metrics;
+	std::string fail_message = "Problem fetching metrics";
+
+	if(m_is_rpc)
+	{
+		if(!m_rpc_client->text_request("/metrics", metrics, fail_message))
+		{
+			return true;
+		}
+	}
+	else
+	{
+		if(!m_rpc_server->on_get_metrics(metrics))
+		{
+			GULPS_PRINT_FAIL( fail_message.c_str());
+			return true;
+		}
+	}
+
+	GULPS_PRINT_OK(metrics);
+	return true;
+}
+
 bool t_rpc_command_executor::print_connections()
 {
 	cryptonote::COMMAND_RPC_GET_CONNECTIONS::request req;
@@ -93,6 +93,8 @@ class t_rpc_command_executor final
 
 	bool show_status();
 
+	bool show_metrics();
+
 	bool print_connections();
 
 	bool print_blockchain_info(uint64_t start_block_index, uint64_t end_block_index);
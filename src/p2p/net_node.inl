@@ -1459,9 +1459,11 @@ void node_server<t_payload_net_handler>::request_callback(const epee::net_utils:
 template <class t_payload_net_handler>
 bool node_server<t_payload_net_handler>::relay_notify_to_list(int command, const std::string &data_buff, const std::list<boost::uuids::uuid> &connections)
 {
+	// framed once, every connection queues the same buffer
+	const epee::net_utils::shared_buffer message = epee::levin::make_notify_message(command, data_buff);
 	for(const auto &c_id : connections)
 	{
-		m_net_server.get_config_object().notify(command, data_buff, c_id);
+		m_net_server.get_config_object().send(message, c_id);
 	}
 	return true;
 }
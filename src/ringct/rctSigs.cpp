@@ -965,9 +965,9 @@ bool verRct(const rctSig &rv, bool semantics)
 	{
 		if(semantics)
 		{
+			std::deque<bool> results(rv.outPk.size(), false);
 			tools::threadpool &tpool = tools::threadpool::getInstance();
 			tools::threadpool::waiter waiter;
-			std::deque<bool> results(rv.outPk.size(), false);
 			DP("range proofs verified?");
 			for(size_t i = 0; i < rv.outPk.size(); i++)
 				tpool.submit(&waiter, [&, i] { results[i] = verRange(rv.outPk[i].mask, rv.p.rangeSigs[i]); });
@@ -1019,9 +1019,11 @@ bool verRctSemanticsSimple(const std::vector<const rctSig *> &rvv)
 	{
 		PERF_TIMER(verRctSemanticsSimple);
 
+		// results is written by the range proof tasks, it has to outlive the waiter,
+		// whose destructor waits for them on every early return
+		std::deque<bool> results;
 		tools::threadpool &tpool = tools::threadpool::getInstance();
 		tools::threadpool::waiter waiter;
-		std::deque<bool> results;
 		std::vector<const Bulletproof *> proofs;
 		size_t max_non_bp_proofs = 0, offset = 0;
 
@@ -1087,7 +1089,7 @@ bool verRctSemanticsSimple(const std::vector<const rctSig *> &rvv)
 			else
 			{
 				for(size_t i = 0; i < rv.p.rangeSigs.size(); i++)
-					tpool.submit(&waiter, [&, i, offset] { results[i + offset] = verRange(rv.outPk[i].mask, rv.p.rangeSigs[i]); });
+					tpool.submit(&waiter, [&results, rvp, i, offset] { results[i + offset] = verRange(rvp->outPk[i].mask, rvp->p.rangeSigs[i]); });
 				offset += rv.p.rangeSigs.size();
 			}
 		}
@@ -1131,6 +1133,14 @@ bool verRctSemanticsSimple(const rctSig &rv)
 //assumes only post-rct style inputs (at least for max anonymity)
 bool verRctNonSemanticsSimple(const rctSig &rv)
 {
+	std::vector<uint8_t> input_results;
+	return verRctNonSemanticsSimple(rv, input_results);
+}
+
+//input_results receives one entry per input, MGs of several inputs are checked in parallel
+bool verRctNonSemanticsSimple(const rctSig &rv, std::vector<uint8_t> &input_results)
+{
+	input_results.clear();
 	try
 	{
 		PERF_TIMER(verRctNonSemanticsSimple);
@@ -1142,37 +1152,41 @@ bool verRctNonSemanticsSimple(const rctSig &rv)
 			GULPS_CHECK_AND_ASSERT_MES(rv.p.pseudoOuts.size() == rv.mixRing.size(), false, "Mismatched sizes of rv.p.pseudoOuts and mixRing");
 		else
 			GULPS_CHECK_AND_ASSERT_MES(rv.pseudoOuts.size() == rv.mixRing.size(), false, "Mismatched sizes of rv.pseudoOuts and mixRing");
-
-		const size_t threads = std::max(rv.outPk.size(), rv.mixRing.size());
-
-		std::deque<bool> results(threads);
-		tools::threadpool &tpool = tools::threadpool::getInstance();
-		tools::threadpool::waiter waiter;
+		GULPS_CHECK_AND_ASSERT_MES(rv.p.MGs.size() == rv.mixRing.size(), false, "Mismatched sizes of rv.p.MGs and mixRing");
 
 		const keyV &pseudoOuts = bulletproof ? rv.p.pseudoOuts : rv.pseudoOuts;
 
 		const key message = get_pre_mlsag_hash(rv, hw::get_device("default"));
 
-		results.clear();
-		results.resize(rv.mixRing.size());
-		for(size_t i = 0; i < rv.mixRing.size(); i++)
+		input_results.resize(rv.mixRing.size(), 0);
+		if(rv.mixRing.size() == 1)
 		{
-			tpool.submit(&waiter, [&, i] {
-				results[i] = verRctMGSimple(message, rv.p.MGs[i], rv.mixRing[i], pseudoOuts[i]);
-			});
+			input_results[0] = verRctMGSimple(message, rv.p.MGs[0], rv.mixRing[0], pseudoOuts[0]);
+		}
+		else
+		{
+			tools::threadpool &tpool = tools::threadpool::getInstance();
+			tools::threadpool::waiter waiter;
+			for(size_t i = 0; i < rv.mixRing.size(); i++)
+			{
+				tpool.submit(&waiter, [&, i] {
+					input_results[i] = verRctMGSimple(message, rv.p.MGs[i], rv.mixRing[i], pseudoOuts[i]);
+				});
+			}
+			waiter.wait();
 		}
-		waiter.wait();
 
-		for(size_t i = 0; i < results.size(); ++i)
+		bool ok = true;
+		for(size_t i = 0; i < input_results.size(); ++i)
 		{
-			if(!results[i])
+			if(!input_results[i])
 			{
 				GULPSF_LOG_L1("verRctMGSimple failed for input {}", i);
-				return false;
+				ok = false;
 			}
 		}
 
-		return true;
+		return ok;
 	}
 	// we can get deep throws from ge_frombytes_vartime if input isn't valid
 	catch(const std::exception &e)
@@ -117,6 +117,7 @@ mgSig proveRctMG(const ctkeyM &pubs, const ctkeyV &inSk, const keyV &outMasks, c
 mgSig proveRctMGSimple(const key &message, const ctkeyV &pubs, const ctkey &inSk, const key &a, const key &Cout, const multisig_kLRki *kLRki, key *mscout, unsigned int index, hw::device &hwdev);
 bool verRctMG(const mgSig &mg, const ctkeyM &pubs, const ctkeyV &outPk, key txnFee, const key &message);
 bool verRctMGSimple(const key &message, const mgSig &mg, const ctkeyV &pubs, const key &C);
+key get_pre_mlsag_hash(const rctSig &rv, hw::device &hwdev);
 
 //These functions get keys from blockchain
 //replace these when connecting blockchain
@@ -144,6 +145,7 @@ bool verRct(const rctSig & rv, bool semantics);
 bool verRctSemanticsSimple(const rctSig & rv);
 bool verRctSemanticsSimple(const std::vector<const rctSig*> & rv);
 bool verRctNonSemanticsSimple(const rctSig & rv);
+bool verRctNonSemanticsSimple(const rctSig & rv, std::vector<uint8_t> & input_results);
 ryo_amount decodeRct(const rctSig & rv, const key & sk, unsigned int i, key & mask, hw::device &hwdev);
 ryo_amount decodeRct(const rctSig & rv, const key & sk, unsigned int i, hw::device &hwdev);
 ryo_amount decodeRctSimple(const rctSig & rv, const key & sk, unsigned int i, key & mask, hw::device &hwdev);
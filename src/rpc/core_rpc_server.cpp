@@ -50,6 +50,7 @@ using namespace epee;
 
 #include "common/command_line.h"
 #include "common/download.h"
+#include "common/metrics.h"
 #include "common/perf_timer.h"
 #include "common/updates.h"
 #include "common/util.h"
@@ -59,7 +60,6 @@ using namespace epee;
 #include "cryptonote_basic/account.h"
 #include "cryptonote_basic/cryptonote_basic_impl.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
-#include "get_output_distribution_cache.h"
 #include "misc_language.h"
 #include "p2p/net_node.h"
 #include "rpc/rpc_args.h"
@@ -95,6 +95,8 @@ void core_rpc_server::init_options(boost::program_options::options_description &
 	command_line::add_arg(desc, arg_restricted_rpc);
 	command_line::add_arg(desc, arg_bootstrap_daemon_address);
 	command_line::add_arg(desc, arg_bootstrap_daemon_login);
+	command_line::add_arg(desc, arg_getblocks_cache_size);
+	command_line::add_arg(desc, arg_getblocks_cache_depth);
 	cryptonote::rpc_args::init_options(desc);
 }
 //------------------------------------------------------------------------------------------------------------------------------
@@ -139,6 +141,8 @@ bool core_rpc_server::init(
 	}
 	m_was_bootstrap_ever_used = false;
 
+	m_get_blocks_cache.init(command_line::get_arg(vm, arg_getblocks_cache_size) * 1024 * 1024, command_line::get_arg(vm, arg_getblocks_cache_depth));
+
 	boost::optional<epee::net_utils::http::login> http_login{};
 
 	if(rpc_config->login)
@@ -228,6 +232,11 @@ bool core_rpc_server::on_get_info(const COMMAND_RPC_GET_INFO::request &req, COMM
 		boost::shared_lock<boost::shared_mutex> lock(m_bootstrap_daemon_mutex);
 		res.was_bootstrap_ever_used = m_was_bootstrap_ever_used;
 	}
+	const get_blocks_cache::stats cache_stats = m_get_blocks_cache.get_stats();
+	res.getblocks_cache_hits = cache_stats.hits;
+	res.getblocks_cache_misses = cache_stats.misses;
+	res.getblocks_cache_entries = cache_stats.entries;
+	res.getblocks_cache_size = cache_stats.size;
 	return true;
 }
 //------------------------------------------------------------------------------------------------------------------------------
@@ -254,6 +263,64 @@ bool core_rpc_server::on_get_blocks(const COMMAND_RPC_GET_BLOCKS_FAST::request &
 	res.status = CORE_RPC_STATUS_OK;
 	return true;
 }
+//------------------------------------------------------------------------------------------------------------------------------
+bool core_rpc_server::on_get_blocks_bin(const COMMAND_RPC_GET_BLOCKS_FAST::request &req, std::string &body)
+{
+	PERF_TIMER(on_get_blocks_bin);
+	COMMAND_RPC_GET_BLOCKS_FAST::response res = AUTO_VAL_INIT(res);
+	if(!m_get_blocks_cache.enabled() || !req.prune)
+	{
+		if(!on_get_blocks(req, res))
+			return false;
+		epee::serialization::store_t_to_binary(res, body);
+		return true;
+	}
+
+	bool r;
+	if(use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_BLOCKS_FAST>(invoke_http_mode::BIN, "/getblocks.bin", req, res, r))
+	{
+		if(r)
+			epee::serialization::store_t_to_binary(res, body);
+		return r;
+	}
+
+	uint64_t start_height = req.start_height;
+	if(start_height == 0 && !m_core.get_blockchain_storage().find_blockchain_supplement(req.block_ids, start_height))
+	{
+		res.status = "Failed";
+		return false;
+	}
+
+	uint64_t end_height;
+	crypto::hash end_id;
+	const uint64_t current_height = m_core.get_current_blockchain_height();
+	if(m_get_blocks_cache.find(start_height, COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT, req.prune, current_height, body, end_height, end_id))
+	{
+		// the last block still being ours means the whole chunk is
+		if(end_height <= current_height && m_core.get_block_id_by_height(end_height - 1) == end_id)
+			return true;
+		GULPSF_LOG_L1("Dropping cached blocks {}-{}, the chain changed under them", start_height, end_height - 1);
+		m_get_blocks_cache.remove(start_height, COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT, req.prune);
+	}
+
+	if(!m_core.find_blockchain_supplement_indexed(start_height, req.block_ids, res.blocks, res.output_indices,
+		res.current_height, res.start_height, COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT))
+	{
+		res.status = "Failed";
+		return false;
+	}
+	res.status = CORE_RPC_STATUS_OK;
+	epee::serialization::store_t_to_binary(res, body);
+
+	end_height = res.start_height + res.blocks.size();
+	if(!res.blocks.empty() && end_height + m_get_blocks_cache.depth() <= res.current_height)
+	{
+		block b;
+		if(parse_and_validate_block_from_blob(res.blocks.back().block, b))
+			m_get_blocks_cache.add(res.start_height, COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT, req.prune, body, res.current_height, end_height, get_block_hash(b));
+	}
+	return true;
+}
 bool core_rpc_server::on_get_alt_blocks_hashes(const COMMAND_RPC_GET_ALT_BLOCKS_HASHES::request &req, COMMAND_RPC_GET_ALT_BLOCKS_HASHES::response &res)
 {
 	PERF_TIMER(on_get_alt_blocks_hashes);
@@ -1573,6 +1640,11 @@ bool core_rpc_server::on_get_info_json(const COMMAND_RPC_GET_INFO::request &req,
 		boost::shared_lock<boost::shared_mutex> lock(m_bootstrap_daemon_mutex);
 		res.was_bootstrap_ever_used = m_was_bootstrap_ever_used;
 	}
+	const get_blocks_cache::stats cache_stats = m_get_blocks_cache.get_stats();
+	res.getblocks_cache_hits = cache_stats.hits;
+	res.getblocks_cache_misses = cache_stats.misses;
+	res.getblocks_cache_entries = cache_stats.entries;
+	res.getblocks_cache_size = cache_stats.size;
 	return true;
 }
 //------------------------------------------------------------------------------------------------------------------------------
@@ -1947,6 +2019,22 @@ bool core_rpc_server::on_update(const COMMAND_RPC_UPDATE::request &req, COMMAND_
 	return true;
 }
 //------------------------------------------------------------------------------------------------------------------------------
+bool core_rpc_server::on_get_metrics(std::string &metrics)
+{
+	tools::metrics::registry &reg = tools::metrics::registry::instance();
+	const uint64_t total_conn = m_p2p.get_connections_count();
+	const uint64_t outgoing_conn = m_p2p.get_outgoing_connections_count();
+	reg.get_gauge("height", "Blockchain height").set(m_core.get_current_blockchain_height());
+	reg.get_gauge("target_height", "Height of the best chain seen on the network").set(m_core.get_target_blockchain_height());
+	reg.get_gauge("txpool_transactions", "Transactions in the pool").set(m_core.get_pool_transactions_count());
+	reg.get_gauge("outgoing_connections", "Outgoing p2p connections").set(outgoing_conn);
+	reg.get_gauge("incoming_connections", "Incoming p2p connections").set(total_conn - outgoing_conn);
+	reg.get_gauge("rpc_connections", "RPC connections").set(get_connections_count());
+
+	metrics = reg.to_prometheus();
+	return true;
+}
+//------------------------------------------------------------------------------------------------------------------------------
 bool core_rpc_server::on_relay_tx(const COMMAND_RPC_RELAY_TX::request &req, COMMAND_RPC_RELAY_TX::response &res, epee::json_rpc::error &error_resp)
 {
 	PERF_TIMER(on_relay_tx);
@@ -2047,50 +2135,7 @@ bool core_rpc_server::on_get_output_distribution(const COMMAND_RPC_GET_OUTPUT_DI
 	{
 		for(uint64_t amount : req.amounts)
 		{
-			static struct D
-			{
-				boost::mutex mutex;
-				std::vector<uint64_t> cached_distribution;
-				uint64_t cached_from, cached_to, cached_start_height, cached_base;
-				bool cached;
-				D() : cached_from(0), cached_to(0), cached_start_height(0), cached_base(0), cached(false) {}
-			} d;
-			boost::unique_lock<boost::mutex> lock(d.mutex);
-
-			if(d.cached && amount == 0 && d.cached_from == req.from_height && d.cached_to == req.to_height)
-			{
-				res.distributions.push_back({amount, d.cached_start_height, d.cached_distribution, d.cached_base});
-				if(req.cumulative)
-				{
-					auto &distribution = res.distributions.back().distribution;
-					distribution[0] += d.cached_base;
-					for(size_t n = 1; n < distribution.size(); ++n)
-						distribution[n] += distribution[n - 1];
-				}
-				continue;
-			}
-
-			// this is a slow operation, so we have precomputed caches of common cases
-			bool found = false;
-			for(const auto &slot : get_output_distribution_cache)
-			{
-				if(slot.amount == amount && slot.from_height == req.from_height && slot.to_height == req.to_height)
-				{
-					res.distributions.push_back({amount, slot.start_height, slot.distribution, slot.base});
-					found = true;
-					if(req.cumulative)
-					{
-						auto &distribution = res.distributions.back().distribution;
-						distribution[0] += slot.base;
-						for(size_t n = 1; n < distribution.size(); ++n)
-							distribution[n] += distribution[n - 1];
-					}
-					break;
-				}
-			}
-			if(found)
-				continue;
-
+			// amount 0 is a range read of the per block RCT output counts, no caching needed
 			std::vector<uint64_t> distribution;
 			uint64_t start_height, base;
 			if(!m_core.get_output_distribution(amount, req.from_height, req.to_height, start_height, distribution, base))
@@ -2106,16 +2151,6 @@ bool core_rpc_server::on_get_output_distribution(const COMMAND_RPC_GET_OUTPUT_DI
 					distribution.resize(req.to_height - offset + 1);
 			}
 
-			if(amount == 0)
-			{
-				d.cached_from = req.from_height;
-				d.cached_to = req.to_height;
-				d.cached_distribution = distribution;
-				d.cached_start_height = start_height;
-				d.cached_base = base;
-				d.cached = true;
-			}
-
 			if(req.cumulative)
 			{
 				distribution[0] += base;
@@ -2157,4 +2192,10 @@ const command_line::arg_descriptor<std::string> core_rpc_server::arg_bootstrap_d
 
 const command_line::arg_descriptor<std::string> core_rpc_server::arg_bootstrap_daemon_login = {
 	"bootstrap-daemon-login", "Specify username:password for the bootstrap daemon login", ""};
+
+const command_line::arg_descriptor<size_t> core_rpc_server::arg_getblocks_cache_size = {
+	"rpc-getblocks-cache-size", "Size in MB of the cache of serialized /getblocks.bin responses, 0 to disable", 64};
+
+const command_line::arg_descriptor<uint64_t> core_rpc_server::arg_getblocks_cache_depth = {
+	"rpc-getblocks-cache-depth", "Only cache /getblocks.bin responses ending at least this many blocks below the chain tip", 720};
 } // namespace cryptonote
@@ -50,6 +50,7 @@
 #include <boost/program_options/variables_map.hpp>
 
 #include "core_rpc_server_commands_defs.h"
+#include "get_blocks_cache.h"
 #include "cryptonote_core/cryptonote_core.h"
 #include "cryptonote_protocol/cryptonote_protocol_handler.h"
 #include "net/http_client.h"
@@ -76,6 +77,8 @@ class core_rpc_server : public epee::http_server_impl_base<core_rpc_server>
 	static const command_line::arg_descriptor<bool> arg_restricted_rpc;
 	static const command_line::arg_descriptor<std::string> arg_bootstrap_daemon_address;
 	static const command_line::arg_descriptor<std::string> arg_bootstrap_daemon_login;
+	static const command_line::arg_descriptor<size_t> arg_getblocks_cache_size;
+	static const command_line::arg_descriptor<uint64_t> arg_getblocks_cache_depth;
 
 	typedef epee::net_utils::connection_context_base connection_context;
 
@@ -95,8 +98,8 @@ class core_rpc_server : public epee::http_server_impl_base<core_rpc_server>
 	BEGIN_URI_MAP2()
 	MAP_URI_AUTO_JON2("/get_height", on_get_height, COMMAND_RPC_GET_HEIGHT)
 	MAP_URI_AUTO_JON2("/getheight", on_get_height, COMMAND_RPC_GET_HEIGHT)
-	MAP_URI_AUTO_BIN2("/get_blocks.bin", on_get_blocks, COMMAND_RPC_GET_BLOCKS_FAST)
-	MAP_URI_AUTO_BIN2("/getblocks.bin", on_get_blocks, COMMAND_RPC_GET_BLOCKS_FAST)
+	MAP_URI_AUTO_BIN2_RAW("/get_blocks.bin", on_get_blocks_bin, COMMAND_RPC_GET_BLOCKS_FAST)
+	MAP_URI_AUTO_BIN2_RAW("/getblocks.bin", on_get_blocks_bin, COMMAND_RPC_GET_BLOCKS_FAST)
 	MAP_URI_AUTO_BIN2("/get_blocks_by_height.bin", on_get_blocks_by_height, COMMAND_RPC_GET_BLOCKS_BY_HEIGHT)
 	MAP_URI_AUTO_BIN2("/getblocks_by_height.bin", on_get_blocks_by_height, COMMAND_RPC_GET_BLOCKS_BY_HEIGHT)
 	MAP_URI_AUTO_BIN2("/get_hashes.bin", on_get_hashes, COMMAND_RPC_GET_HASHES_FAST)
@@ -133,6 +136,7 @@ class core_rpc_server : public epee::http_server_impl_base<core_rpc_server>
 	MAP_URI_AUTO_JON2_IF("/in_peers", on_in_peers, COMMAND_RPC_IN_PEERS, !m_restricted)
 	MAP_URI_AUTO_JON2("/get_outs", on_get_outs, COMMAND_RPC_GET_OUTPUTS)
 	MAP_URI_AUTO_JON2_IF("/update", on_update, COMMAND_RPC_UPDATE, !m_restricted)
+	MAP_URI_TEXT2_IF("/metrics", on_get_metrics, !m_restricted)
 	BEGIN_JSON_RPC_MAP("/json_rpc")
 	MAP_JON_RPC("get_block_count", on_getblockcount, COMMAND_RPC_GETBLOCKCOUNT)
 	MAP_JON_RPC("getblockcount", on_getblockcount, COMMAND_RPC_GETBLOCKCOUNT)
@@ -171,6 +175,7 @@ class core_rpc_server : public epee::http_server_impl_base<core_rpc_server>
 
 	bool on_get_height(const COMMAND_RPC_GET_HEIGHT::request &req, COMMAND_RPC_GET_HEIGHT::response &res);
 	bool on_get_blocks(const COMMAND_RPC_GET_BLOCKS_FAST::request &req, COMMAND_RPC_GET_BLOCKS_FAST::response &res);
+	bool on_get_blocks_bin(const COMMAND_RPC_GET_BLOCKS_FAST::request &req, std::string &body);
 	bool on_get_alt_blocks_hashes(const COMMAND_RPC_GET_ALT_BLOCKS_HASHES::request &req, COMMAND_RPC_GET_ALT_BLOCKS_HASHES::response &res);
 	bool on_get_blocks_by_height(const COMMAND_RPC_GET_BLOCKS_BY_HEIGHT::request &req, COMMAND_RPC_GET_BLOCKS_BY_HEIGHT::response &res);
 	bool on_get_hashes(const COMMAND_RPC_GET_HASHES_FAST::request &req, COMMAND_RPC_GET_HASHES_FAST::response &res);
@@ -200,6 +205,7 @@ class core_rpc_server : public epee::http_server_impl_base<core_rpc_server>
 	bool on_out_peers(const COMMAND_RPC_OUT_PEERS::request &req, COMMAND_RPC_OUT_PEERS::response &res);
 	bool on_in_peers(const COMMAND_RPC_IN_PEERS::request &req, COMMAND_RPC_IN_PEERS::response &res);
 	bool on_update(const COMMAND_RPC_UPDATE::request &req, COMMAND_RPC_UPDATE::response &res);
+	bool on_get_metrics(std::string &metrics);
 
 	//json_rpc
 	bool on_getblockcount(const COMMAND_RPC_GETBLOCKCOUNT::request &req, COMMAND_RPC_GETBLOCKCOUNT::response &res);
@@ -253,6 +259,7 @@ class core_rpc_server : public epee::http_server_impl_base<core_rpc_server>
 	bool m_was_bootstrap_ever_used;
 	network_type m_nettype;
 	bool m_restricted;
+	get_blocks_cache m_get_blocks_cache;
 };
 }
 
@@ -65,7 +65,7 @@ namespace cryptonote
 // advance which version they will stop working with
 // Don't go over 32767 for any of these
 #define CORE_RPC_VERSION_MAJOR 1
-#define CORE_RPC_VERSION_MINOR 19
+#define CORE_RPC_VERSION_MINOR 20
 #define MAKE_CORE_RPC_VERSION(major, minor) (((major) << 16) | (minor))
 #define CORE_RPC_VERSION MAKE_CORE_RPC_VERSION(CORE_RPC_VERSION_MAJOR, CORE_RPC_VERSION_MINOR)
 
@@ -976,6 +976,10 @@ struct COMMAND_RPC_GET_INFO
 		std::string bootstrap_daemon_address;
 		uint64_t height_without_bootstrap;
 		bool was_bootstrap_ever_used;
+		uint64_t getblocks_cache_hits;
+		uint64_t getblocks_cache_misses;
+		uint64_t getblocks_cache_entries;
+		uint64_t getblocks_cache_size;
 
 		BEGIN_KV_SERIALIZE_MAP(response)
 		KV_SERIALIZE(status)
@@ -1006,6 +1010,10 @@ struct COMMAND_RPC_GET_INFO
 		KV_SERIALIZE(bootstrap_daemon_address)
 		KV_SERIALIZE(height_without_bootstrap)
 		KV_SERIALIZE(was_bootstrap_ever_used)
+		KV_SERIALIZE(getblocks_cache_hits)
+		KV_SERIALIZE(getblocks_cache_misses)
+		KV_SERIALIZE(getblocks_cache_entries)
+		KV_SERIALIZE(getblocks_cache_size)
 		END_KV_SERIALIZE_MAP()
 	};
 };
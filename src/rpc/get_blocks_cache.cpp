@@ -0,0 +1,154 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "get_blocks_cache.h"
+
+#include <cstring>
+#include <iterator>
+
+#include "common/int-util.h"
+#include "storages/portable_storage_base.h"
+
+namespace cryptonote
+{
+namespace
+{
+// A uint64 field in epee's binary format is stored as the one byte name length,
+// the name, the type byte and then the raw little endian value.
+const std::string current_height_key = std::string("\x0e" "current_height", 15) + char(SERIALIZE_TYPE_UINT64);
+
+// The root section's fields are written in name order, so current_height comes
+// after the blocks. Nothing after it holds anything but small integers and short
+// strings, so the last match is the field itself even if a block blob happens to
+// contain the same bytes.
+bool find_current_height(const std::string &body, uint64_t current_height, size_t &offset)
+{
+	size_t pos = body.rfind(current_height_key);
+	if(pos == std::string::npos || pos + current_height_key.size() + sizeof(uint64_t) > body.size())
+		return false;
+	offset = pos + current_height_key.size();
+
+	uint64_t value;
+	memcpy(&value, body.data() + offset, sizeof(value));
+	return SWAP64LE(value) == current_height;
+}
+}
+
+get_blocks_cache::get_blocks_cache() : m_max_size(0), m_size(0), m_depth(0), m_hits(0), m_misses(0)
+{
+}
+
+void get_blocks_cache::init(size_t max_size, uint64_t depth)
+{
+	boost::lock_guard<boost::mutex> lock(m_lock);
+	m_max_size = max_size;
+	m_depth = depth;
+	while(m_size > m_max_size)
+		remove(std::prev(m_entries.end()));
+}
+
+bool get_blocks_cache::find(uint64_t start_height, size_t max_count, bool prune, uint64_t current_height, std::string &body, uint64_t &end_height, crypto::hash &end_id)
+{
+	boost::lock_guard<boost::mutex> lock(m_lock);
+	auto it = m_index.find(key_t(start_height, max_count, prune));
+	if(it == m_index.end())
+	{
+		++m_misses;
+		return false;
+	}
+
+	++m_hits;
+	m_entries.splice(m_entries.begin(), m_entries, it->second);
+
+	const entry &e = *it->second;
+	body = e.body;
+	uint64_t value = SWAP64LE(current_height);
+	memcpy(&body[e.height_offset], &value, sizeof(value));
+	end_height = e.end_height;
+	end_id = e.end_id;
+	return true;
+}
+
+bool get_blocks_cache::add(uint64_t start_height, size_t max_count, bool prune, const std::string &body, uint64_t current_height, uint64_t end_height, const crypto::hash &end_id)
+{
+	boost::lock_guard<boost::mutex> lock(m_lock);
+	if(body.size() > m_max_size)
+		return false;
+
+	size_t offset;
+	if(!find_current_height(body, current_height, offset))
+		return false;
+
+	const key_t key(start_height, max_count, prune);
+	auto it = m_index.find(key);
+	if(it != m_index.end())
+		remove(it->second);
+
+	while(m_size + body.size() > m_max_size)
+		remove(std::prev(m_entries.end()));
+
+	m_entries.push_front({key, body, offset, end_height, end_id});
+	m_index.emplace(key, m_entries.begin());
+	m_size += body.size();
+	return true;
+}
+
+void get_blocks_cache::remove(uint64_t start_height, size_t max_count, bool prune)
+{
+	boost::lock_guard<boost::mutex> lock(m_lock);
+	auto it = m_index.find(key_t(start_height, max_count, prune));
+	if(it != m_index.end())
+		remove(it->second);
+}
+
+void get_blocks_cache::remove(std::list<entry>::iterator it)
+{
+	m_size -= it->body.size();
+	m_index.erase(it->key);
+	m_entries.erase(it);
+}
+
+get_blocks_cache::stats get_blocks_cache::get_stats() const
+{
+	boost::lock_guard<boost::mutex> lock(m_lock);
+	return {m_hits, m_misses, m_entries.size(), m_size};
+}
+}
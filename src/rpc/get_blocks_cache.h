@@ -0,0 +1,133 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#pragma once
+
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <list>
+#include <map>
+#include <string>
+#include <tuple>
+
+#include "crypto/hash.h"
+
+namespace cryptonote
+{
+/**
+ * @brief size-bounded LRU cache of serialized /getblocks.bin response bodies
+ *
+ * Only chunks that end at least the configured number of blocks below the
+ * chain tip are stored. Each entry keeps the id of its last block, which the
+ * caller checks against the chain before serving it, so a reorg deep enough
+ * to reach a cached chunk drops that chunk instead of serving it. The response
+ * is kept fully serialized; the only field that changes between requests,
+ * current_height, is patched in place on every hit.
+ */
+class get_blocks_cache
+{
+  public:
+	struct stats
+	{
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t entries;
+		uint64_t size;
+	};
+
+	get_blocks_cache();
+
+	void init(size_t max_size, uint64_t depth);
+	bool enabled() const { return m_max_size > 0; }
+	uint64_t depth() const { return m_depth; }
+
+	/**
+	 * @brief look up the chunk starting at start_height
+	 *
+	 * @param current_height the chain height to write into the returned body
+	 * @param body return-by-reference the serialized response
+	 * @param end_height return-by-reference the height after the last block in the chunk
+	 * @param end_id return-by-reference the id of the last block in the chunk
+	 *
+	 * @return true if the chunk was found
+	 */
+	bool find(uint64_t start_height, size_t max_count, bool prune, uint64_t current_height, std::string &body, uint64_t &end_height, crypto::hash &end_id);
+
+	/**
+	 * @brief store a serialized response
+	 *
+	 * @param body the response as sent by the server
+	 * @param current_height the current_height value serialized in body
+	 * @param end_height the height after the last block in the chunk
+	 * @param end_id the id of the last block in the chunk
+	 *
+	 * @return false if the body could not be stored
+	 */
+	bool add(uint64_t start_height, size_t max_count, bool prune, const std::string &body, uint64_t current_height, uint64_t end_height, const crypto::hash &end_id);
+
+	//! drop the chunk starting at start_height, after finding it no longer matches the chain
+	void remove(uint64_t start_height, size_t max_count, bool prune);
+
+	stats get_stats() const;
+
+  private:
+	typedef std::tuple<uint64_t, size_t, bool> key_t;
+
+	struct entry
+	{
+		key_t key;
+		std::string body;
+		size_t height_offset;
+		uint64_t end_height;
+		crypto::hash end_id;
+	};
+
+	void remove(std::list<entry>::iterator it);
+
+	mutable boost::mutex m_lock;
+	std::list<entry> m_entries; // most recently used first
+	std::map<key_t, std::list<entry>::iterator> m_index;
+	size_t m_max_size;
+	size_t m_size;
+	uint64_t m_depth;
+	uint64_t m_hits;
+	uint64_t m_misses;
+};
+}
@@ -0,0 +1,225 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/*! \file binary_span_archive.h
+ *
+ * Portable (low-endian) binary input archive over contiguous memory */
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <ios>
+#include <limits>
+#include <string>
+
+#include "binary_archive.h"
+#include "serialization.h"
+#include "span.h"
+
+/*! \class binary_span_stream
+ *
+ * \brief read cursor over a byte range
+ *
+ * \detailed Carries the parts of the std::istream interface the
+ * serializers rely on (good, eof, setstate, rdstate, clear, peek) with the
+ * same state semantics, so they work unchanged on the span archive.
+ */
+class binary_span_stream
+{
+  public:
+	binary_span_stream(const std::uint8_t *begin, const std::uint8_t *end) : pos_(begin), end_(end), state_(std::ios_base::goodbit) {}
+
+	bool good() const { return state_ == std::ios_base::goodbit; }
+	bool eof() const { return (state_ & std::ios_base::eofbit) != 0; }
+	std::ios_base::iostate rdstate() const { return state_; }
+	void setstate(std::ios_base::iostate s) { state_ |= s; }
+	void clear(std::ios_base::iostate s = std::ios_base::goodbit) { state_ = s; }
+
+	int peek()
+	{
+		if(!good())
+			return EOF;
+		if(pos_ == end_)
+		{
+			state_ |= std::ios_base::eofbit;
+			return EOF;
+		}
+		return *pos_;
+	}
+
+	size_t remaining() const { return end_ - pos_; }
+
+	/*! \brief copies len bytes out, failing like std::istream::read when short */
+	bool read(void *buf, size_t len)
+	{
+		if(!good())
+		{
+			state_ |= std::ios_base::failbit;
+			return false;
+		}
+		if(remaining() < len)
+		{
+			pos_ = end_;
+			state_ |= std::ios_base::eofbit | std::ios_base::failbit;
+			return false;
+		}
+		memcpy(buf, pos_, len);
+		pos_ += len;
+		return true;
+	}
+
+	const std::uint8_t *&pos() { return pos_; }
+	const std::uint8_t *end() const { return end_; }
+
+  private:
+	const std::uint8_t *pos_;
+	const std::uint8_t *end_;
+	std::ios_base::iostate state_;
+};
+
+/* \struct binary_span_archive
+ *
+ * \brief binary input archive reading straight from a byte span
+ *
+ * \detailed Reads exactly what binary_archive<false> reads from an
+ * istream holding the same bytes and fails in the same places, without
+ * copying the blob into a stream first. Only the loading side exists.
+ */
+template <bool W>
+struct binary_span_archive;
+
+template <>
+struct binary_span_archive<false>
+{
+	typedef binary_span_stream stream_type;
+	typedef boost::mpl::bool_<false> is_saving;
+	typedef uint8_t variant_tag_type;
+
+	explicit binary_span_archive(epee::span<const std::uint8_t> bytes) : stream_(bytes.data(), bytes.data() + bytes.size()) {}
+	explicit binary_span_archive(const std::string &blob) : binary_span_archive(epee::span<const std::uint8_t>(reinterpret_cast<const std::uint8_t *>(blob.data()), blob.size())) {}
+
+	/* definition of standard API functions */
+	void tag(const char *) {}
+	void begin_object() {}
+	void end_object() {}
+	void begin_variant() {}
+	void end_variant() {}
+	stream_type &stream() { return stream_; }
+
+	template <class T>
+	void serialize_int(T &v)
+	{
+		serialize_uint(*(typename boost::make_unsigned<T>::type *)&v);
+	}
+
+	template <class T>
+	void serialize_uint(T &v, size_t width = sizeof(T))
+	{
+		std::uint8_t buf[sizeof(T)] = {};
+		stream_.read(buf, width);
+		T ret = 0;
+		for(size_t i = width; i-- > 0;)
+			ret = (ret << 8) | buf[i];
+		v = ret;
+	}
+
+	void serialize_blob(void *buf, size_t len, const char *delimiter = "")
+	{
+		stream_.read(buf, len);
+	}
+
+	template <class T>
+	void serialize_varint(T &v)
+	{
+		serialize_uvarint(*(typename boost::make_unsigned<T>::type *)(&v));
+	}
+
+	/*! \brief reads a varint, never past the end of the span
+	 *
+	 * As with the istream archive, a malformed varint only shows up
+	 * through the bytes it consumed, so both accept the same blobs.
+	 */
+	template <class T>
+	void serialize_uvarint(T &v)
+	{
+		const std::uint8_t *&pos = stream_.pos();
+		const std::uint8_t *end = stream_.end();
+		if(std::numeric_limits<T>::digits >= 7 && pos != end && *pos < 0x80)
+		{
+			v = *pos++;
+			return;
+		}
+		tools::read_varint<std::numeric_limits<T>::digits>(pos, end, v);
+	}
+
+	void begin_array(size_t &s)
+	{
+		serialize_varint(s);
+	}
+
+	void begin_array() {}
+	void delimit_array() {}
+	void end_array() {}
+
+	void begin_string(const char *delimiter /*="\""*/) {}
+	void end_string(const char *delimiter /*="\""*/) {}
+
+	void read_variant_tag(variant_tag_type &t)
+	{
+		serialize_int(t);
+	}
+
+	size_t remaining_bytes()
+	{
+		if(!stream_.good())
+			return 0;
+		return stream_.remaining();
+	}
+
+  protected:
+	stream_type stream_;
+};
+
+/* The span archive reads the same variant tags as binary_archive */
+template <>
+struct variant_tag_archive<binary_span_archive<false>>
+{
+	typedef binary_archive<false> type;
+};
@@ -47,6 +47,7 @@
 #pragma once
 
 #include "binary_archive.h"
+#include "binary_span_archive.h"
 #include <sstream>
 
 namespace serialization
@@ -56,8 +57,7 @@ namespace serialization
 template <class T>
 bool parse_binary(const std::string &blob, T &v)
 {
-	std::istringstream istr(blob);
-	binary_archive<false> iar(istr);
+	binary_span_archive<false> iar(blob);
 	return ::serialization::serialize(iar, v);
 }
 
@@ -200,6 +200,16 @@ inline bool do_serialize(Archive &ar, bool &v)
 		typedef boost::true_type type; \
 	}
 
+/*! \struct variant_tag_archive
+ *
+ * \brief the archive whose VARIANT_TAGs \a Archive reads, itself unless specialized
+ */
+template <class Archive>
+struct variant_tag_archive
+{
+	typedef Archive type;
+};
+
 /*! \macro VARIANT_TAG
  *
  * \brief Adds the tag \tag to the \a Archive of \a Type
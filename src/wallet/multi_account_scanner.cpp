@@ -0,0 +1,263 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+
+#include "multi_account_scanner.h"
+#include "common/gulps.hpp"
+#include "common/threadpool.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "device/device_default.hpp"
+#include "ringct/rctSigs.h"
+
+namespace tools
+{
+GULPS_CAT_MAJOR("multi_acc_scan");
+
+multi_account_scanner::subaddress_map multi_account_scanner::make_subaddresses(const cryptonote::account_keys &keys, uint32_t major, uint32_t minor)
+{
+	hw::core::device_default dev;
+	subaddress_map map;
+	map.reserve(size_t(major) * minor);
+	for(uint32_t i = 0; i < major; i++)
+	{
+		const std::vector<crypto::public_key> pkeys = dev.get_subaddress_spend_public_keys(keys, i, 0, minor);
+		for(uint32_t j = 0; j < minor; j++)
+			map.emplace(pkeys[j], cryptonote::subaddress_index(i, j));
+	}
+	return map;
+}
+
+size_t multi_account_scanner::add_account(const crypto::secret_key &view_secret_key, const subaddress_map &subaddresses)
+{
+	const size_t account = m_view_keys.size();
+	m_view_keys.push_back(view_secret_key);
+	m_spend_keys.reserve(m_spend_keys.size() + subaddresses.size());
+	for(const auto &sub : subaddresses)
+		m_spend_keys.emplace(sub.first, owner{account, sub.second});
+	return account;
+}
+
+void multi_account_scanner::prepare_chunk(const tx_entry *txes, size_t count, chunk_keys &keys) const
+{
+	keys.txes.clear();
+	keys.tx_keys.clear();
+	keys.output_count = 0;
+
+	std::vector<cryptonote::tx_extra_field> tx_extra_fields;
+	for(size_t i = 0; i < count; i++)
+	{
+		const cryptonote::transaction &tx = *txes[i].tx;
+		tx_extra_fields.clear();
+		if(!parse_tx_extra(tx.extra, tx_extra_fields))
+		{
+			// Extra may only be partially parsed, it's OK if tx_extra_fields contains public key
+			GULPS_LOG_L1("Transaction extra has unsupported format: ", txes[i].txid);
+		}
+
+		cryptonote::tx_extra_pub_key pub_key_field;
+		if(!find_tx_extra_field_by_type(tx_extra_fields, pub_key_field))
+		{
+			GULPS_LOG_L1("Public key wasn't found in the transaction extra. Skipping transaction ", txes[i].txid);
+			continue;
+		}
+
+		keys.txes.push_back(chunk_tx{&txes[i], keys.tx_keys.size(), 0});
+		keys.tx_keys.push_back(pub_key_field.pub_key);
+		keys.output_count += tx.vout.size();
+
+		cryptonote::tx_extra_additional_pub_keys additional_pub_keys;
+		if(find_tx_extra_field_by_type(tx_extra_fields, additional_pub_keys))
+		{
+			keys.txes.back().additional_count = additional_pub_keys.data.size();
+			keys.tx_keys.insert(keys.tx_keys.end(), additional_pub_keys.data.begin(), additional_pub_keys.data.end());
+		}
+	}
+}
+
+bool multi_account_scanner::match_output(size_t account, const chunk_tx &ctx, const crypto::subaddress_derivation &der, std::vector<found_output> &found, bool decode_amounts) const
+{
+	auto range = m_spend_keys.equal_range(der.spend_key);
+	for(auto it = range.first; it != range.second; ++it)
+	{
+		if(it->second.account != account)
+			continue;
+
+		const cryptonote::transaction &tx = *ctx.entry->tx;
+		found_output out;
+		out.account = account;
+		out.index = it->second.index;
+		out.txid = ctx.entry->txid;
+		out.height = ctx.entry->height;
+		out.output_index = der.output_index;
+		out.out_key = der.out_key;
+		out.derivation = der.derivation;
+		out.amount = tx.vout[der.output_index].amount;
+
+		if(decode_amounts && tx.rct_signatures.type != rct::RCTTypeNull)
+		{
+			hw::core::device_default dev;
+			crypto::secret_key scalar;
+			rct::key mask;
+			dev.derivation_to_scalar(der.derivation, der.output_index, scalar);
+			try
+			{
+				if(tx.rct_signatures.type == rct::RCTTypeFull)
+					out.amount = rct::decodeRct(tx.rct_signatures, rct::sk2rct(scalar), der.output_index, mask, dev);
+				else
+					out.amount = rct::decodeRctSimple(tx.rct_signatures, rct::sk2rct(scalar), der.output_index, mask, dev);
+			}
+			catch(const std::exception &e)
+			{
+				GULPS_LOG_ERROR("Failed to decode output ", der.output_index, " of tx ", out.txid, ": ", e.what());
+				out.amount = 0;
+			}
+		}
+
+		found.push_back(out);
+		return true;
+	}
+	return false;
+}
+
+void multi_account_scanner::scan_account(size_t account, const chunk_keys &keys, scratch &s, std::vector<found_output> &found, bool decode_amounts) const
+{
+	// Pass 1 - tx public keys of the whole chunk
+	s.derivations.resize(keys.tx_keys.size());
+	for(size_t i = 0; i < keys.tx_keys.size(); i++)
+		s.derivations[i].tx_key = keys.tx_keys[i];
+
+	crypto::generate_key_derivations(m_view_keys[account], s.derivations.data(), s.derivations.size());
+	for(crypto::tx_key_derivation &d : s.derivations)
+	{
+		if(!d.valid)
+			memcpy(&d.derivation, rct::identity().bytes, sizeof(d.derivation));
+	}
+
+	// Pass 2 - every output against the main tx pubkey
+	s.outputs.clear();
+	s.output_tx.clear();
+	s.outputs.reserve(keys.output_count);
+	s.output_tx.reserve(keys.output_count);
+	for(size_t i = 0; i < keys.txes.size(); i++)
+	{
+		const cryptonote::transaction &tx = *keys.txes[i].entry->tx;
+		for(size_t out_idx = 0; out_idx < tx.vout.size(); out_idx++)
+		{
+			if(tx.vout[out_idx].target.type() != typeid(cryptonote::txout_to_key))
+				continue;
+
+			s.outputs.emplace_back();
+			crypto::subaddress_derivation &der = s.outputs.back();
+			der.out_key = boost::get<cryptonote::txout_to_key>(tx.vout[out_idx].target).key;
+			der.derivation = s.derivations[keys.txes[i].key_idx].derivation;
+			der.output_index = out_idx;
+			s.output_tx.push_back(i);
+		}
+	}
+
+	crypto::derive_subaddress_public_keys(s.outputs.data(), s.outputs.size());
+
+	// Pass 3 - outputs that didn't match try the additional tx pubkeys if available
+	size_t n_additional = 0;
+	for(size_t i = 0; i < s.outputs.size(); i++)
+	{
+		crypto::subaddress_derivation &der = s.outputs[i];
+		const chunk_tx &ctx = keys.txes[s.output_tx[i]];
+		if(!der.valid)
+			continue;
+
+		if(match_output(account, ctx, der, found, decode_amounts))
+			continue;
+
+		if(der.output_index >= ctx.additional_count)
+			continue;
+
+		der.derivation = s.derivations[ctx.key_idx + 1 + der.output_index].derivation;
+		s.outputs[n_additional] = der;
+		s.output_tx[n_additional] = s.output_tx[i];
+		n_additional++;
+	}
+
+	crypto::derive_subaddress_public_keys(s.outputs.data(), n_additional);
+
+	for(size_t i = 0; i < n_additional; i++)
+	{
+		if(s.outputs[i].valid)
+			match_output(account, keys.txes[s.output_tx[i]], s.outputs[i], found, decode_amounts);
+	}
+}
+
+void multi_account_scanner::scan(const tx_entry *txes, size_t count, std::vector<found_output> &found, bool decode_amounts) const
+{
+	if(m_view_keys.empty() || count == 0)
+		return;
+
+	chunk_keys keys;
+	prepare_chunk(txes, count, keys);
+	if(keys.txes.empty())
+		return;
+
+	threadpool &tpool = threadpool::getInstance();
+	const size_t groups = std::min<size_t>(m_view_keys.size(), std::max(tpool.get_max_concurrency(), 1));
+	std::vector<std::vector<found_output>> group_found(groups);
+
+	threadpool::waiter waiter;
+	for(size_t g = 0; g < groups; g++)
+	{
+		tpool.submit(&waiter, [this, g, groups, &keys, &group_found, decode_amounts]() {
+			scratch s;
+			for(size_t account = g; account < m_view_keys.size(); account += groups)
+				scan_account(account, keys, s, group_found[g], decode_amounts);
+		});
+	}
+	waiter.wait();
+
+	// Accounts were dealt round robin, restore account order
+	std::vector<size_t> pos(groups, 0);
+	for(size_t account = 0; account < m_view_keys.size(); account++)
+	{
+		std::vector<found_output> &gf = group_found[account % groups];
+		size_t &p = pos[account % groups];
+		while(p < gf.size() && gf[p].account == account)
+			found.push_back(gf[p++]);
+	}
+}
+}
@@ -0,0 +1,142 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+#include "crypto/crypto.h"
+#include "cryptonote_basic/account.h"
+#include "cryptonote_basic/cryptonote_basic.h"
+#include "cryptonote_basic/subaddress_index.h"
+
+namespace tools
+{
+/*!
+ * \brief View-key scanner for many accounts at once. The subaddress spend keys of every
+ * account go into a single table keyed on spend public key, and a chunk of transactions has
+ * its tx public keys extracted once for all accounts. Each account then derives against the
+ * whole chunk in a batch and looks the candidate spend keys up in the merged table.
+ */
+class multi_account_scanner
+{
+  public:
+	typedef std::unordered_map<crypto::public_key, cryptonote::subaddress_index> subaddress_map;
+
+	struct tx_entry
+	{
+		crypto::hash txid;
+		const cryptonote::transaction *tx;
+		uint64_t height;
+	};
+
+	struct found_output
+	{
+		size_t account;
+		cryptonote::subaddress_index index;
+		crypto::hash txid;
+		uint64_t height;
+		uint64_t output_index;
+		crypto::public_key out_key;
+		crypto::key_derivation derivation;
+		uint64_t amount;
+	};
+
+	/*!
+	 * \brief  Spend public keys of subaddresses [0, major) x [0, minor) of an account,
+	 *         needs only the address and the view secret key
+	 */
+	static subaddress_map make_subaddresses(const cryptonote::account_keys &keys, uint32_t major, uint32_t minor);
+
+	/*!
+	 * \brief  Registers an account, returns the number reported in found_output::account
+	 */
+	size_t add_account(const crypto::secret_key &view_secret_key, const subaddress_map &subaddresses);
+
+	size_t account_count() const { return m_view_keys.size(); }
+	size_t subaddress_count() const { return m_spend_keys.size(); }
+
+	/*!
+	 * \brief  Scans count transactions for outputs of all accounts, accounts are spread over
+	 *         the thread pool. Found outputs are appended grouped by account, in chunk order.
+	 * \param  decode_amounts  also decode the amount of ringct outputs
+	 */
+	void scan(const tx_entry *txes, size_t count, std::vector<found_output> &found, bool decode_amounts = true) const;
+
+  private:
+	struct owner
+	{
+		size_t account;
+		cryptonote::subaddress_index index;
+	};
+
+	struct chunk_tx
+	{
+		const tx_entry *entry;
+		size_t key_idx; // main tx pubkey, followed by the additional ones
+		size_t additional_count;
+	};
+
+	// Tx public keys of a chunk, shared by all accounts
+	struct chunk_keys
+	{
+		std::vector<chunk_tx> txes;
+		std::vector<crypto::public_key> tx_keys;
+		size_t output_count;
+	};
+
+	// Per account scratch space
+	struct scratch
+	{
+		std::vector<crypto::tx_key_derivation> derivations;
+		std::vector<crypto::subaddress_derivation> outputs;
+		std::vector<size_t> output_tx;
+	};
+
+	void prepare_chunk(const tx_entry *txes, size_t count, chunk_keys &keys) const;
+	void scan_account(size_t account, const chunk_keys &keys, scratch &s, std::vector<found_output> &found, bool decode_amounts) const;
+	bool match_output(size_t account, const chunk_tx &ctx, const crypto::subaddress_derivation &der, std::vector<found_output> &found, bool decode_amounts) const;
+
+	std::vector<crypto::secret_key> m_view_keys;
+	std::unordered_multimap<crypto::public_key, owner> m_spend_keys;
+};
+}
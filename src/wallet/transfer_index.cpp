@@ -0,0 +1,192 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <limits>
+
+#include "cryptonote_config.h"
+#include "transfer_index.h"
+
+namespace tools
+{
+uint64_t transfer_index::unlock_height(uint64_t unlock_time, uint64_t block_height)
+{
+	// spendable once height - 1 + CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_BLOCKS >= unlock_time
+	// and the output is CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE blocks deep
+	uint64_t time_height = unlock_time >= CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_BLOCKS ? unlock_time - CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_BLOCKS + 1 : 0;
+	return std::max(time_height, block_height + CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE);
+}
+
+void transfer_index::clear()
+{
+	m_entries.clear();
+	m_accounts.clear();
+	m_count = 0;
+}
+
+void transfer_index::resize(size_t count)
+{
+	for(size_t idx = count; idx < m_entries.size(); ++idx)
+		erase(idx);
+	if(count < m_entries.size())
+		m_entries.resize(count);
+}
+
+void transfer_index::insert(size_t idx, const cryptonote::subaddress_index &index, uint64_t amount, uint64_t unlock_height)
+{
+	if(idx >= m_entries.size())
+		m_entries.resize(idx + 1, entry{false, {0, 0}, 0, 0});
+
+	erase(idx);
+
+	entry &e = m_entries[idx];
+	e.indexed = true;
+	e.index = index;
+	e.amount = amount;
+	e.unlock_height = unlock_height;
+
+	bucket &b = m_accounts[index.major][index.minor];
+	b.balance += amount;
+	b.by_unlock.emplace(unlock_height, idx);
+	++m_count;
+}
+
+void transfer_index::erase(size_t idx)
+{
+	if(idx >= m_entries.size() || !m_entries[idx].indexed)
+		return;
+
+	entry &e = m_entries[idx];
+	e.indexed = false;
+
+	auto account = m_accounts.find(e.index.major);
+	auto b = account->second.find(e.index.minor);
+	b->second.balance -= e.amount;
+	b->second.by_unlock.erase(std::make_pair(e.unlock_height, idx));
+	--m_count;
+
+	// empty subaddresses are dropped so that balance maps only list subaddresses with outputs
+	if(b->second.by_unlock.empty())
+	{
+		account->second.erase(b);
+		if(account->second.empty())
+			m_accounts.erase(account);
+	}
+}
+
+std::map<uint32_t, uint64_t> transfer_index::balance_per_subaddress(uint32_t index_major) const
+{
+	std::map<uint32_t, uint64_t> amount_per_subaddr;
+	auto account = m_accounts.find(index_major);
+	if(account == m_accounts.end())
+		return amount_per_subaddr;
+
+	for(const auto &b : account->second)
+		amount_per_subaddr.emplace_hint(amount_per_subaddr.end(), b.first, b.second.balance);
+	return amount_per_subaddr;
+}
+
+std::map<uint32_t, uint64_t> transfer_index::unlocked_balance_per_subaddress(uint32_t index_major, uint64_t height) const
+{
+	std::map<uint32_t, uint64_t> amount_per_subaddr;
+	auto account = m_accounts.find(index_major);
+	if(account == m_accounts.end())
+		return amount_per_subaddr;
+
+	for(const auto &b : account->second)
+	{
+		// outputs still locked are the few most recent ones, subtract them from the running balance
+		const auto locked = b.second.by_unlock.upper_bound(std::make_pair(height, std::numeric_limits<size_t>::max()));
+		if(locked == b.second.by_unlock.begin())
+			continue;
+
+		uint64_t amount = b.second.balance;
+		for(auto it = locked; it != b.second.by_unlock.end(); ++it)
+			amount -= m_entries[it->second].amount;
+		amount_per_subaddr.emplace_hint(amount_per_subaddr.end(), b.first, amount);
+	}
+	return amount_per_subaddr;
+}
+
+void transfer_index::collect_unlocked(const bucket &b, uint64_t height, std::vector<size_t> &outputs)
+{
+	const auto locked = b.by_unlock.upper_bound(std::make_pair(height, std::numeric_limits<size_t>::max()));
+	for(auto it = b.by_unlock.begin(); it != locked; ++it)
+		outputs.push_back(it->second);
+}
+
+std::vector<size_t> transfer_index::unlocked_outputs(uint32_t index_major, const std::set<uint32_t> &index_minors, uint64_t height) const
+{
+	std::vector<size_t> outputs;
+	auto account = m_accounts.find(index_major);
+	if(account == m_accounts.end())
+		return outputs;
+
+	if(index_minors.empty())
+	{
+		for(const auto &b : account->second)
+			collect_unlocked(b.second, height, outputs);
+	}
+	else
+	{
+		for(uint32_t minor : index_minors)
+		{
+			auto b = account->second.find(minor);
+			if(b != account->second.end())
+				collect_unlocked(b->second, height, outputs);
+		}
+	}
+
+	// callers rely on the order of the transfer container
+	std::sort(outputs.begin(), outputs.end());
+	return outputs;
+}
+
+std::vector<size_t> transfer_index::unlocked_outputs(uint64_t height) const
+{
+	std::vector<size_t> outputs;
+	for(const auto &account : m_accounts)
+		for(const auto &b : account.second)
+			collect_unlocked(b.second, height, outputs);
+
+	std::sort(outputs.begin(), outputs.end());
+	return outputs;
+}
+}
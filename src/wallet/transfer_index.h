@@ -0,0 +1,124 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <map>
+#include <set>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+#include "cryptonote_basic/cryptonote_basic.h"
+#include "cryptonote_basic/subaddress_index.h"
+
+namespace tools
+{
+/*!
+ * \brief Unspent outputs of a wallet, partitioned by subaddress and kept sorted by the height at
+ * which they unlock, with a running balance per subaddress. Outputs are identified by their
+ * position in the wallet's transfer container, which owns them; the index only mirrors what
+ * balance queries and input selection need.
+ */
+class transfer_index
+{
+  public:
+	/*!
+	 * \brief  Lowest wallet height at which an output can be spent
+	 * \param  unlock_time  unlock_time of the transaction that created the output
+	 * \param  block_height height of the block that mined it
+	 */
+	static uint64_t unlock_height(uint64_t unlock_time, uint64_t block_height);
+
+	void clear();
+	/*!
+	 * \brief  Drops the outputs at position count and above, for transfers removed by a reorg
+	 */
+	void resize(size_t count);
+	/*!
+	 * \brief  Adds an unspent output, or refreshes it if it was already indexed
+	 */
+	void insert(size_t idx, const cryptonote::subaddress_index &index, uint64_t amount, uint64_t unlock_height);
+	/*!
+	 * \brief  Removes an output that was spent, does nothing if it wasn't indexed
+	 */
+	void erase(size_t idx);
+
+	size_t size() const { return m_count; }
+
+	std::map<uint32_t, uint64_t> balance_per_subaddress(uint32_t index_major) const;
+	std::map<uint32_t, uint64_t> unlocked_balance_per_subaddress(uint32_t index_major, uint64_t height) const;
+
+	/*!
+	 * \brief  Outputs of an account that are spendable at the given height, in container order
+	 * \param  index_minors subaddresses to pick from, all of the account if empty
+	 */
+	std::vector<size_t> unlocked_outputs(uint32_t index_major, const std::set<uint32_t> &index_minors, uint64_t height) const;
+	/*!
+	 * \brief  Outputs of all accounts that are spendable at the given height, in container order
+	 */
+	std::vector<size_t> unlocked_outputs(uint64_t height) const;
+
+  private:
+	struct entry
+	{
+		bool indexed;
+		cryptonote::subaddress_index index;
+		uint64_t amount;
+		uint64_t unlock_height;
+	};
+
+	struct bucket
+	{
+		bucket() : balance(0) {}
+
+		uint64_t balance;
+		std::set<std::pair<uint64_t, size_t>> by_unlock; // <unlock height, position>
+	};
+
+	typedef std::map<uint32_t, bucket> account_buckets;
+
+	static void collect_unlocked(const bucket &b, uint64_t height, std::vector<size_t> &outputs);
+
+	std::vector<entry> m_entries;
+	std::map<uint32_t, account_buckets> m_accounts;
+	size_t m_count = 0;
+};
+}
@@ -165,6 +165,11 @@ struct options
 	const command_line::arg_descriptor<bool> stagenet = {"stagenet", tools::wallet2::tr("For stagenet. Daemon must also be launched with --stagenet flag"), false};
 	const command_line::arg_descriptor<bool> force_network = {"force-network", tools::wallet2::tr("Disregard mainnet/testnet/stagenet network checks. Don't use this option."), false};
 	const command_line::arg_descriptor<bool> restricted = {"restricted-rpc", tools::wallet2::tr("Restricts to view-only commands"), false};
+	const command_line::arg_descriptor<uint32_t> refresh_parse_threads = {"refresh-parse-threads", tools::wallet2::tr("Number of block parsing threads during refresh (0 = auto)"), 0};
+	const command_line::arg_descriptor<uint32_t> refresh_scan_threads = {"refresh-scan-threads", tools::wallet2::tr("Number of output scanning threads during refresh (0 = auto)"), 0};
+	const command_line::arg_descriptor<uint32_t> refresh_parse_queue = {"refresh-parse-queue", tools::wallet2::tr("Max downloaded block chunks waiting to be parsed (0 = auto)"), 0};
+	const command_line::arg_descriptor<uint32_t> refresh_scan_queue = {"refresh-scan-queue", tools::wallet2::tr("Max parsed block chunks waiting to be scanned (0 = auto)"), 0};
+	const command_line::arg_descriptor<uint32_t> refresh_apply_queue = {"refresh-apply-queue", tools::wallet2::tr("Max scanned block chunks waiting to be applied to the wallet (0 = auto)"), 0};
 	const command_line::arg_descriptor<std::string, false, true> shared_ringdb_dir = {
 		"shared-ringdb-dir", tools::wallet2::tr("Set shared ring database path"),
 		get_default_ringdb_path(),
@@ -253,6 +258,14 @@ std::unique_ptr<tools::wallet2> make_basic(const boost::program_options::variabl
 	if(command_line::get_arg(vm, opts.force_network))
 		wallet->set_force_network();
 
+	tools::wallet2::refresh_pipeline_config refresh_cfg;
+	refresh_cfg.parse_threads = command_line::get_arg(vm, opts.refresh_parse_threads);
+	refresh_cfg.scan_threads = command_line::get_arg(vm, opts.refresh_scan_threads);
+	refresh_cfg.parse_queue_depth = command_line::get_arg(vm, opts.refresh_parse_queue);
+	refresh_cfg.scan_queue_depth = command_line::get_arg(vm, opts.refresh_scan_queue);
+	refresh_cfg.apply_queue_depth = command_line::get_arg(vm, opts.refresh_apply_queue);
+	wallet->set_refresh_pipeline_config(refresh_cfg);
+
 	wallet->init(std::move(daemon_address), std::move(login));
 	boost::filesystem::path ringdb_path = command_line::get_arg(vm, opts.shared_ringdb_dir);
 	wallet->set_ring_database(ringdb_path.string());
@@ -667,6 +680,11 @@ void wallet2::init_options(boost::program_options::options_description &desc_par
 	command_line::add_arg(desc_params, opts.stagenet);
 	command_line::add_arg(desc_params, opts.force_network);
 	command_line::add_arg(desc_params, opts.restricted);
+	command_line::add_arg(desc_params, opts.refresh_parse_threads);
+	command_line::add_arg(desc_params, opts.refresh_scan_threads);
+	command_line::add_arg(desc_params, opts.refresh_parse_queue);
+	command_line::add_arg(desc_params, opts.refresh_scan_queue);
+	command_line::add_arg(desc_params, opts.refresh_apply_queue);
 	command_line::add_arg(desc_params, opts.shared_ringdb_dir);
 }
 
@@ -962,6 +980,7 @@ void wallet2::set_spent(size_t idx, uint64_t height)
 	GULPS_LOG_L2("Setting SPENT at ", height, ": ki ", td.m_key_image, ", amount ", print_money(td.m_amount));
 	td.m_spent = true;
 	td.m_spent_height = height;
+	update_transfer_index(idx);
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::set_unspent(size_t idx)
@@ -970,6 +989,23 @@ void wallet2::set_unspent(size_t idx)
 	GULPS_LOG_L2("Setting UNSPENT: ki ", td.m_key_image, ", amount ", print_money(td.m_amount));
 	td.m_spent = false;
 	td.m_spent_height = 0;
+	update_transfer_index(idx);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::update_transfer_index(size_t idx)
+{
+	const transfer_details &td = m_transfers[idx];
+	if(td.m_spent)
+		m_transfer_index.erase(idx);
+	else
+		m_transfer_index.insert(idx, td.m_subaddr_index, td.amount(), transfer_index::unlock_height(td.m_tx.unlock_time, td.m_block_height));
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::rebuild_transfer_index()
+{
+	m_transfer_index.clear();
+	for(size_t i = 0; i < m_transfers.size(); ++i)
+		update_transfer_index(i);
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::check_acc_out_precomp(const tx_out &o, const crypto::key_derivation &derivation, const std::vector<crypto::key_derivation> &additional_derivations, size_t i, tx_scan_info_t &tx_scan_info) const
@@ -1317,6 +1353,7 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
 						}
 						THROW_WALLET_EXCEPTION_IF(td.get_public_key() != tx_scan_info[o].in_ephemeral.pub, error::wallet_internal_error, "Inconsistent public keys");
 						THROW_WALLET_EXCEPTION_IF(td.m_spent, error::wallet_internal_error, "Inconsistent spent status");
+						update_transfer_index(kit->second);
 
 						GULPS_LOG_L0("Received money: ", print_money(td.amount()), ", with tx: ", txid);
 						if(0 != m_callback)
@@ -1353,6 +1390,7 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
 					//   2) the wallet set the highest amount among them to transfer_details::m_amount, and
 					//   3) the wallet somehow spent that output with an amount smaller than the above amount, causing inconsistency
 					td.m_amount = amount;
+					update_transfer_index(it->second);
 				}
 			}
 			else
@@ -1486,7 +1524,10 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
 					m_callback->on_unconfirmed_money_received(height, txid, tx, payment.m_amount, payment.m_subaddr_index);
 			}
 			else
+			{
 				m_payments.emplace(payment_id, payment);
+				m_cache_journal.add_payment(payment_id, payment);
+			}
 			GULPS_LOG_L2("Payment found in ", (pool ? "pool" : "block"), ": ", payment_id, " / ", payment.m_tx_hash, " / ", payment.m_amount);
 		}
 	}
@@ -1505,6 +1546,7 @@ void wallet2::process_unconfirmed(const crypto::hash &txid, const cryptonote::tr
 			try
 			{
 				m_confirmed_txs.insert(std::make_pair(txid, confirmed_transfer_details(unconf_it->second, height)));
+				m_cache_journal.touch_confirmed_tx(txid);
 			}
 			catch(...)
 			{
@@ -1519,6 +1561,7 @@ void wallet2::process_unconfirmed(const crypto::hash &txid, const cryptonote::tr
 void wallet2::process_outgoing(const crypto::hash &txid, const cryptonote::transaction &tx, uint64_t height, uint64_t ts, uint64_t spent, uint64_t received, uint32_t subaddr_account, const std::set<uint32_t> &subaddr_indices)
 {
 	std::pair<std::unordered_map<crypto::hash, confirmed_transfer_details>::iterator, bool> entry = m_confirmed_txs.insert(std::make_pair(txid, confirmed_transfer_details()));
+	m_cache_journal.touch_confirmed_tx(txid);
 	// fill with the info we know, some info might already be there
 	if(entry.second)
 	{
@@ -1966,18 +2009,19 @@ bool wallet2::delete_address_book_row(std::size_t row_id)
 }
 
 //----------------------------------------------------------------------------------------------------
-void wallet2::integrate_scanned_result(std::unique_ptr<wallet_rpc_scan_data>& res)
+void wallet2::integrate_scanned_result(const wallet_rpc_scan_data& data, wallet_rpc_scan_data::scan_result& res)
 {
 	// First things, first, check for any forks, our data is new so it overrides anything else
 	// Including previous data (can happen if there is a fork during the scan)
+	THROW_WALLET_EXCEPTION_IF(data.blocks_parsed.size() == 0, error::wallet_internal_error, "Integrated blocks vector is empty");
 	GULPSF_LOG_L1("m_blockchain top: {} - {}", m_blockchain.size()-1, m_blockchain[m_blockchain.size()-1]);
-	GULPSF_LOG_L1("blocks_parsed front: {} - {}", res->blocks_parsed.front().block_height, res->blocks_parsed.front().block_hash);
-	THROW_WALLET_EXCEPTION_IF(res->blocks_parsed.size() == 0, error::wallet_internal_error, "Integrated blocks vector is empty");
-	THROW_WALLET_EXCEPTION_IF(!m_blockchain.is_in_bounds(res->blocks_parsed.front().block_height), error::wallet_internal_error, "Index out of bounds of hashchain");
-	GULPSF_LOG_L1("Integrating results blocks: {} - {}", res->blocks_parsed.front().block_height, res->blocks_parsed.back().block_height);
+	GULPSF_LOG_L1("blocks_parsed front: {} - {}", data.blocks_parsed.front().block_height, data.blocks_parsed.front().block_hash);
+	THROW_WALLET_EXCEPTION_IF(!m_blockchain.is_in_bounds(data.blocks_parsed.front().block_height), error::wallet_internal_error, "Index out of bounds of hashchain");
+	GULPSF_LOG_L1("Integrating results blocks: {} - {}", data.blocks_parsed.front().block_height, data.blocks_parsed.back().block_height);
 	
-	for(auto& bl : res->blocks_parsed)
+	for(size_t blk_idx = 0; blk_idx < data.blocks_parsed.size(); blk_idx++)
 	{
+		const wallet_rpc_scan_data::block_complete_entry_parsed& bl = data.blocks_parsed[blk_idx];
 		if(bl.block_height < m_blockchain.size())
 		{
 			if(m_blockchain[bl.block_height] != bl.block_hash)
@@ -1988,7 +2032,7 @@ void wallet2::integrate_scanned_result(std::unique_ptr<wallet_rpc_scan_data>& re
 			else
 			{
 				GULPSF_LOG_L1("Block is already in blockchain: {}", bl.block_hash);
-				bl.skipped = true;
+				res.skipped[blk_idx] = true;
 				continue;
 			}
 		}
@@ -2005,23 +2049,23 @@ void wallet2::integrate_scanned_result(std::unique_ptr<wallet_rpc_scan_data>& re
 
 	tx_call_map tx_calls;
 	// Now, process incoming funds
-	for(const auto& i : res->indices_found)
+	for(const auto& i : res.indices_found)
 	{
-		if(res->blocks_parsed[i.block_idx].skipped)
+		if(res.skipped[i.block_idx])
 			continue;
 
-		const cryptonote::block& b = res->blocks_parsed[i.block_idx].block;
-		const std::vector<uint64_t>& tx_indices = res->o_indices[i.block_idx].indices[i.tx_idx].indices;
-		size_t height = res->blocks_parsed[i.block_idx].block_height;
+		const cryptonote::block& b = data.blocks_parsed[i.block_idx].block;
+		const std::vector<uint64_t>& tx_indices = data.o_indices[i.block_idx].indices[i.tx_idx].indices;
+		size_t height = data.blocks_parsed[i.block_idx].block_height;
 
 		if(i.tx_idx == 0)
 		{
-			const crypto::hash& tx_id = res->blocks_parsed[i.block_idx].miner_tx_hash;
+			const crypto::hash& tx_id = data.blocks_parsed[i.block_idx].miner_tx_hash;
 			add_new_tx_call(tx_calls, tx_id, b.miner_tx, tx_indices, height, b.timestamp, true);
 		}
 		else
 		{
-			const cryptonote::transaction& tx = res->blocks_parsed[i.block_idx].txes[i.tx_idx-1];
+			const cryptonote::transaction& tx = data.blocks_parsed[i.block_idx].txes[i.tx_idx-1];
 			add_new_tx_call(tx_calls, b.tx_hashes[i.tx_idx-1], tx, tx_indices, height, b.timestamp, false);
 		}
 	}
@@ -2030,7 +2074,7 @@ void wallet2::integrate_scanned_result(std::unique_ptr<wallet_rpc_scan_data>& re
 	bool needs_full_scan = false;
 	for(const auto& n : m_key_images)
 	{
-		if(!res->key_images.not_present(&n.first, sizeof(crypto::key_image)))
+		if(!data.key_images.not_present(&n.first, sizeof(crypto::key_image)))
 		{
 			needs_full_scan = true;
 			break;
@@ -2039,9 +2083,9 @@ void wallet2::integrate_scanned_result(std::unique_ptr<wallet_rpc_scan_data>& re
 
 	if(!needs_full_scan)
 	{
-		for(const auto& n : res->incoming_kimg)
+		for(const auto& n : res.incoming_kimg)
 		{
-			if(!res->key_images.not_present(&n, sizeof(crypto::key_image)))
+			if(!data.key_images.not_present(&n, sizeof(crypto::key_image)))
 			{
 				needs_full_scan = true;
 				break;
@@ -2051,25 +2095,25 @@ void wallet2::integrate_scanned_result(std::unique_ptr<wallet_rpc_scan_data>& re
 
 	if(needs_full_scan)
 	{
-		for(size_t blk_idx = 0; blk_idx < res->blocks_parsed.size(); blk_idx++)
+		for(size_t blk_idx = 0; blk_idx < data.blocks_parsed.size(); blk_idx++)
 		{
-			if(res->blocks_parsed[blk_idx].skipped)
+			if(res.skipped[blk_idx])
 				continue;
 
-			for(size_t tx_idx = 0; tx_idx < res->blocks_parsed[blk_idx].txes.size(); tx_idx++)
+			for(size_t tx_idx = 0; tx_idx < data.blocks_parsed[blk_idx].txes.size(); tx_idx++)
 			{
-				for(const auto& in : res->blocks_parsed[blk_idx].txes[tx_idx].vin)
+				for(const auto& in : data.blocks_parsed[blk_idx].txes[tx_idx].vin)
 				{
 					if(in.type() != typeid(cryptonote::txin_to_key))
 						continue;
 
 					const crypto::key_image& ki = boost::get<cryptonote::txin_to_key>(in).k_image;
-					if(m_key_images.find(ki) != m_key_images.end() || res->incoming_kimg.find(ki) != res->incoming_kimg.end())
+					if(m_key_images.find(ki) != m_key_images.end() || res.incoming_kimg.find(ki) != res.incoming_kimg.end())
 					{
-						const cryptonote::block& b = res->blocks_parsed[blk_idx].block;
-						size_t height = res->blocks_parsed[blk_idx].block_height;
-						const std::vector<uint64_t>& tx_indices = res->o_indices[blk_idx].indices[tx_idx+1].indices;
-						const cryptonote::transaction& tx = res->blocks_parsed[blk_idx].txes[tx_idx];
+						const cryptonote::block& b = data.blocks_parsed[blk_idx].block;
+						size_t height = data.blocks_parsed[blk_idx].block_height;
+						const std::vector<uint64_t>& tx_indices = data.o_indices[blk_idx].indices[tx_idx+1].indices;
+						const cryptonote::transaction& tx = data.blocks_parsed[blk_idx].txes[tx_idx];
 						add_new_tx_call(tx_calls, b.tx_hashes[tx_idx], tx, tx_indices, height, b.timestamp, false);
 					}
 				}
@@ -2101,14 +2145,8 @@ void wallet2::integrate_scanned_result(std::unique_ptr<wallet_rpc_scan_data>& re
 		p.first();
 }
 
-void wallet2::refresh(uint64_t start_height, uint64_t &blocks_fetched, bool &received_money)
+bool wallet2::refresh_begin(uint64_t& start_height, std::list<crypto::hash>& short_chain_history)
 {
-	received_money = false;
-	blocks_fetched = 0;
-	size_t entry_height = m_local_bc_height;
-	crypto::hash last_tx_hash_id = m_transfers.size() ? m_transfers.back().m_txid : null_hash;
-	std::list<crypto::hash> short_chain_history;
-
 	uint64_t blocks_start_height;
 
 	// pull the first set of blocks
@@ -2128,38 +2166,69 @@ void wallet2::refresh(uint64_t start_height, uint64_t &blocks_fetched, bool &rec
 	}
 
 	// If stop() is called during fast refresh we don't need to continue
-	if(!m_run.load(std::memory_order_relaxed))
+	return m_run.load(std::memory_order_relaxed);
+}
+
+void wallet2::refresh(uint64_t start_height, uint64_t &blocks_fetched, bool &received_money)
+{
+	received_money = false;
+	blocks_fetched = 0;
+	size_t entry_height = m_local_bc_height;
+	crypto::hash last_tx_hash_id = m_transfers.size() ? m_transfers.back().m_txid : null_hash;
+	std::list<crypto::hash> short_chain_history;
+
+	if(!refresh_begin(start_height, short_chain_history))
 		return;
 
 	//Download thread will likely be network or disk bound, so it should be in addition to max_conurrency
-	wallet_refresh_ctx refresh_ctx;
-	wallet_block_dl_ctx ctx(refresh_ctx);
 	size_t thd_max = std::min<size_t>(tools::get_max_concurrency(), 8);
-	ctx.scan_thd_cnt = thd_max;
+	size_t scan_thds_cnt = m_refresh_config.scan_threads != 0 ? m_refresh_config.scan_threads : thd_max;
+	size_t parse_thds_cnt = m_refresh_config.parse_threads != 0 ? m_refresh_config.parse_threads : std::max<size_t>(1, thd_max / 4);
+
+	size_t parse_depth = m_refresh_config.parse_queue_depth != 0 ? m_refresh_config.parse_queue_depth : parse_thds_cnt + 1;
+	size_t scan_depth = m_refresh_config.scan_queue_depth != 0 ? m_refresh_config.scan_queue_depth : scan_thds_cnt + 1;
+	size_t apply_depth = m_refresh_config.apply_queue_depth != 0 ? m_refresh_config.apply_queue_depth : scan_thds_cnt * 2;
+
+	wallet_refresh_ctx refresh_ctx(m_refresh_stats, parse_depth, scan_depth, apply_depth);
+	refresh_ctx.m_running_parse_thd_cnt = parse_thds_cnt;
+	refresh_ctx.m_running_scan_thd_cnt = scan_thds_cnt;
+
+	m_refresh_stats[RefreshStageDownload].begin(1, 0);
+	m_refresh_stats[RefreshStageParse].begin(parse_thds_cnt, parse_depth);
+	m_refresh_stats[RefreshStageScan].begin(scan_thds_cnt, scan_depth);
+	m_refresh_stats[RefreshStageApply].begin(1, apply_depth);
+	refresh_stage_counters& apply_stats = m_refresh_stats[RefreshStageApply];
+	const std::chrono::steady_clock::time_point pipeline_start = std::chrono::steady_clock::now();
+
+	wallet_block_dl_ctx ctx(refresh_ctx);
 	ctx.short_chain_history = std::move(short_chain_history);
 	ctx.start_height = start_height;
 	ctx.thd = std::thread(&wallet2::block_download_thd, this, std::ref(ctx));
 
 	wallet_scan_ctx ct(*this, refresh_ctx);
-	refresh_ctx.m_running_scan_thd_cnt = thd_max;
 
-	GULPSF_LOG_L1("Running {} scanning threads", refresh_ctx.m_running_scan_thd_cnt);
+	GULPSF_LOG_L1("Running {} parsing and {} scanning threads", parse_thds_cnt, scan_thds_cnt);
 
 	std::vector<std::thread> scan_thds;
-	scan_thds.reserve(thd_max);
-	for(size_t i=0; i < thd_max; i++)
+	scan_thds.reserve(parse_thds_cnt + scan_thds_cnt);
+	for(size_t i=0; i < parse_thds_cnt; i++)
+		scan_thds.emplace_back(&wallet2::block_parse_thd, this, std::cref(ct));
+	for(size_t i=0; i < scan_thds_cnt; i++)
 		scan_thds.emplace_back(&wallet2::block_scan_thd, this, std::cref(ct));
 
 	size_t result_idx=0;
 	std::list<std::unique_ptr<wallet2::wallet_rpc_scan_data>> result_list;
-	std::unique_lock<std::mutex> lck = refresh_ctx.m_scan_out_queue.get_lock();
-	while(refresh_ctx.m_scan_out_queue.wait_for_pop(lck))
+	std::unique_ptr<wallet2::wallet_rpc_scan_data> scan_res;
+	std::chrono::steady_clock::time_point wait_start = std::chrono::steady_clock::now();
+	while(refresh_ctx.m_scan_out_queue.pop(scan_res))
 	{
-		result_list.emplace_back(refresh_ctx.m_scan_out_queue.pop(lck));
+		result_list.emplace_back(std::move(scan_res));
+		apply_stats.wait_in_us += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - wait_start).count();
 
 		if(!m_run)
 			break;
 
+		std::chrono::steady_clock::time_point busy_start = std::chrono::steady_clock::now();
 		bool processed;
 		do
 		{
@@ -2177,7 +2246,8 @@ void wallet2::refresh(uint64_t start_height, uint64_t &blocks_fetched, bool &rec
 				processed = true;
 				try
 				{
-					integrate_scanned_result(res);
+					integrate_scanned_result(*res, res->result);
+					apply_stats.items++;
 				}
 				catch(std::exception &e)
 				{
@@ -2191,13 +2261,24 @@ void wallet2::refresh(uint64_t start_height, uint64_t &blocks_fetched, bool &rec
 			}
 		}
 		while(processed);
+		apply_stats.busy_us += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - busy_start).count();
+		wait_start = std::chrono::steady_clock::now();
 	}
 
+	// Release any stage still blocked on a full queue if we stopped early
+	refresh_ctx.m_parse_queue.set_finish_flag();
+	refresh_ctx.m_scan_in_queue.set_finish_flag();
+	refresh_ctx.m_scan_out_queue.set_finish_flag();
+
 	GULPS_LOG_L1("Joining threads...");
 	ctx.thd.join();
 	for(auto& t :scan_thds)
 		t.join();
 
+	const uint64_t wall_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - pipeline_start).count();
+	for(refresh_stage_counters& c : m_refresh_stats)
+		c.capacity_us += c.threads * wall_us;
+
 	if(last_tx_hash_id != (m_transfers.size() ? m_transfers.back().m_txid : null_hash))
 		received_money = true;
 
@@ -2217,6 +2298,28 @@ void wallet2::refresh(uint64_t start_height, uint64_t &blocks_fetched, bool &rec
 	GULPS_LOG_L1("Refresh done, blocks received: ", blocks_fetched, ", balance (all accounts): ", print_money(balance_all()), ", unlocked: ", print_money(unlocked_balance_all()));
 }
 //----------------------------------------------------------------------------------------------------
+std::vector<wallet2::refresh_stage_stats> wallet2::get_refresh_stats() const
+{
+	static const char* const stage_names[RefreshStageCount] = { "download", "parse", "scan", "apply" };
+
+	std::vector<refresh_stage_stats> ret(RefreshStageCount);
+	for(size_t i = 0; i < RefreshStageCount; i++)
+	{
+		const refresh_stage_counters& c = m_refresh_stats[i];
+		refresh_stage_stats& st = ret[i];
+		st.name = stage_names[i];
+		st.threads = c.threads;
+		st.queue_depth = c.queue_depth;
+		st.queue_peak = c.queue_peak;
+		st.items = c.items;
+		st.busy_us = c.busy_us;
+		st.wait_in_us = c.wait_in_us;
+		st.wait_out_us = c.wait_out_us;
+		st.capacity_us = c.capacity_us;
+	}
+	return ret;
+}
+//----------------------------------------------------------------------------------------------------
 bool wallet2::refresh(uint64_t &blocks_fetched, bool &received_money, bool &ok)
 {
 	try
@@ -2301,6 +2404,7 @@ bool wallet2::get_output_distribution(uint64_t &start_height, std::vector<uint64
 void wallet2::detach_blockchain(uint64_t height)
 {
 	GULPS_LOG_L0("Detaching blockchain on height ", height);
+	m_cache_journal.reset();
 
 	// size  1 2 3 4 5 6 7 8 9
 	// block 0 1 2 3 4 5 6 7 8
@@ -2339,6 +2443,7 @@ void wallet2::detach_blockchain(uint64_t height)
 		m_pub_keys.erase(it_pk);
 	}
 	m_transfers.erase(it, m_transfers.end());
+	m_transfer_index.resize(m_transfers.size());
 
 	size_t blocks_detached = m_blockchain.size() - height;
 	m_blockchain.crop(height);
@@ -2373,6 +2478,7 @@ bool wallet2::clear()
 {
 	m_blockchain.clear();
 	m_transfers.clear();
+	m_transfer_index.clear();
 	m_key_images.clear();
 	m_pub_keys.clear();
 	m_unconfirmed_txs.clear();
@@ -2387,6 +2493,7 @@ bool wallet2::clear()
 	m_local_bc_height = 1;
 	m_subaddresses.clear();
 	m_subaddress_labels.clear();
+	m_cache_journal.reset();
 	return true;
 }
 
@@ -3709,6 +3816,11 @@ void wallet2::load(const std::string &wallet_, const epee::wipeable_string &pass
 	}
 	GULPS_LOG_L0("Loaded wallet keys file, with public address: ", m_account.get_public_address_str(m_nettype));
 
+	// the cache journal only extends a cache file that was read through the current format
+	bool journal_base = false;
+	crypto::chacha_iv journal_base_iv = crypto::chacha_iv{};
+	uint64_t journal_base_size = 0;
+
 	//keys loaded ok!
 	//try to load wallet file. but even if we failed, it is not big problem
 	if(!boost::filesystem::exists(m_wallet_file, e) || e)
@@ -3742,6 +3854,9 @@ void wallet2::load(const std::string &wallet_, const epee::wipeable_string &pass
 				iss << cache_data;
 				boost::archive::portable_binary_iarchive ar(iss);
 				ar >> *this;
+				journal_base = true;
+				journal_base_iv = cache_file_data.iv;
+				journal_base_size = buf.size();
 			}
 			catch(...)
 			{
@@ -3823,6 +3938,10 @@ void wallet2::load(const std::string &wallet_, const epee::wipeable_string &pass
 		check_genesis(genesis_hash);
 	}
 
+	if(journal_base)
+		load_cache_journal(journal_base_iv, journal_base_size);
+	rebuild_transfer_index();
+
 	trim_hashchain();
 
 	if(get_num_subaddress_accounts() == 0)
@@ -3913,6 +4032,10 @@ void wallet2::store_to(const std::string &path, const epee::wipeable_string &pas
 		same_file = pos != std::string::npos;
 	}
 
+	// small changes since the last store only get appended to the cache journal
+	if(same_file && store_cache_journal())
+		return;
+
 	if(!same_file)
 	{
 		// check if we want to store to directory which doesn't exists yet
@@ -3980,6 +4103,10 @@ void wallet2::store_to(const std::string &path, const epee::wipeable_string &pas
 		{
 			GULPS_LOG_ERROR("error removing file: ", old_address_file);
 		}
+		// the cache journal belongs to the old wallet file
+		m_cache_journal.reset();
+		boost::system::error_code ec;
+		boost::filesystem::remove(old_file + ".journal", ec);
 	}
 	else
 	{
@@ -4007,6 +4134,8 @@ void wallet2::store_to(const std::string &path, const epee::wipeable_string &pas
 		// here we have "*.new" file, we need to rename it to be without ".new"
 		std::error_code e = tools::replace_file(new_file, m_wallet_file);
 		THROW_WALLET_EXCEPTION_IF(e, error::file_save_error, m_wallet_file, e);
+
+		reset_cache_journal(cache_file_data.iv, cache_file_data.cache_data.size());
 	}
 }
 //----------------------------------------------------------------------------------------------------
@@ -4028,18 +4157,7 @@ uint64_t wallet2::unlocked_balance(uint32_t index_major) const
 //----------------------------------------------------------------------------------------------------
 std::map<uint32_t, uint64_t> wallet2::balance_per_subaddress(uint32_t index_major) const
 {
-	std::map<uint32_t, uint64_t> amount_per_subaddr;
-	for(const auto &td : m_transfers)
-	{
-		if(td.m_subaddr_index.major == index_major && !td.m_spent)
-		{
-			auto found = amount_per_subaddr.find(td.m_subaddr_index.minor);
-			if(found == amount_per_subaddr.end())
-				amount_per_subaddr[td.m_subaddr_index.minor] = td.amount();
-			else
-				found->second += td.amount();
-		}
-	}
+	std::map<uint32_t, uint64_t> amount_per_subaddr = m_transfer_index.balance_per_subaddress(index_major);
 	for(const auto &utx : m_unconfirmed_txs)
 	{
 		if(utx.second.m_subaddr_account == index_major && utx.second.m_state != wallet2::unconfirmed_transfer_details::failed)
@@ -4057,19 +4175,7 @@ std::map<uint32_t, uint64_t> wallet2::balance_per_subaddress(uint32_t index_majo
 //----------------------------------------------------------------------------------------------------
 std::map<uint32_t, uint64_t> wallet2::unlocked_balance_per_subaddress(uint32_t index_major) const
 {
-	std::map<uint32_t, uint64_t> amount_per_subaddr;
-	for(const transfer_details &td : m_transfers)
-	{
-		if(td.m_subaddr_index.major == index_major && !td.m_spent && is_transfer_unlocked(td))
-		{
-			auto found = amount_per_subaddr.find(td.m_subaddr_index.minor);
-			if(found == amount_per_subaddr.end())
-				amount_per_subaddr[td.m_subaddr_index.minor] = td.amount();
-			else
-				found->second += td.amount();
-		}
-	}
-	return amount_per_subaddr;
+	return m_transfer_index.unlocked_balance_per_subaddress(index_major, m_local_bc_height);
 }
 //----------------------------------------------------------------------------------------------------
 uint64_t wallet2::balance_all() const
@@ -4230,18 +4336,8 @@ bool wallet2::is_transfer_unlocked(const transfer_details &td) const
 //----------------------------------------------------------------------------------------------------
 bool wallet2::is_transfer_unlocked(uint64_t unlock_time, uint64_t block_height) const
 {
-	if(!is_tx_spendtime_unlocked(unlock_time, block_height))
-		return false;
-
-	if(block_height + CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE > m_local_bc_height)
-		return false;
-
-	return true;
-}
-//----------------------------------------------------------------------------------------------------
-bool wallet2::is_tx_spendtime_unlocked(uint64_t unlock_time, uint64_t block_height) const
-{
-	return m_local_bc_height - 1 + CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_BLOCKS >= unlock_time;
+	// shared with the transfer index so that balances and input selection agree
+	return m_local_bc_height >= transfer_index::unlock_height(unlock_time, block_height);
 }
 //----------------------------------------------------------------------------------------------------
 namespace
@@ -4518,6 +4614,7 @@ void wallet2::commit_tx(pending_tx &ptx)
 	{
 		m_tx_keys.insert(std::make_pair(txid, ptx.tx_key));
 		m_additional_tx_keys.insert(std::make_pair(txid, ptx.additional_tx_keys));
+		m_cache_journal.touch_tx_key(txid);
 	}
 
 	GULPS_LOG_L2("transaction ", txid, " generated ok and sent to daemon, key_images: [", ptx.key_images, "]");
@@ -4700,6 +4797,7 @@ bool wallet2::sign_tx(unsigned_tx_set &exported_txs, const std::string &signed_f
 			const crypto::hash txid = get_transaction_hash(ptx.tx);
 			m_tx_keys.insert(std::make_pair(txid, tx_key));
 			m_additional_tx_keys.insert(std::make_pair(txid, additional_tx_keys));
+			m_cache_journal.touch_tx_key(txid);
 		}
 
 		std::string key_images;
@@ -5008,6 +5106,7 @@ bool wallet2::load_multisig_tx(cryptonote::blobdata s, multisig_tx_set &exported
 			{
 				m_tx_keys.insert(std::make_pair(txid, ptx.tx_key));
 				m_additional_tx_keys.insert(std::make_pair(txid, ptx.additional_tx_keys));
+				m_cache_journal.touch_tx_key(txid);
 			}
 		}
 	}
@@ -5129,6 +5228,7 @@ bool wallet2::sign_multisig_tx(multisig_tx_set &exported_txs, std::vector<crypto
 			{
 				m_tx_keys.insert(std::make_pair(txid, ptx.tx_key));
 				m_additional_tx_keys.insert(std::make_pair(txid, ptx.additional_tx_keys));
+				m_cache_journal.touch_tx_key(txid);
 			}
 			txids.push_back(txid);
 		}
@@ -6295,11 +6395,10 @@ std::vector<size_t> wallet2::pick_preferred_rct_inputs(uint64_t needed_money, ui
 	bool sorted = true;
 
 	// try to find a rct input of enough size
-	for(size_t i = 0; i < m_transfers.size(); ++i)
+	for(size_t i : m_transfer_index.unlocked_outputs(subaddr_account, subaddr_indices, m_local_bc_height))
 	{
 		const transfer_details &td = m_transfers[i];
-		if(!td.m_spent && !td.m_key_image_partial && td.is_rct() && is_transfer_unlocked(td) &&
-				td.m_subaddr_index.major == subaddr_account && subaddr_indices.count(td.m_subaddr_index.minor) == 1)
+		if(!td.m_key_image_partial && td.is_rct())
 		{
 			uint64_t amt = td.amount();
 			if(amt >= needed_money)
@@ -6544,10 +6643,10 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions_2(std::vector<cryp
 	// gather all dust and non-dust outputs belonging to specified subaddresses
 	size_t num_nondust_outputs = 0;
 	size_t num_dust_outputs = 0;
-	for(size_t i = 0; i < m_transfers.size(); ++i)
+	for(size_t i : m_transfer_index.unlocked_outputs(subaddr_account, subaddr_indices, m_local_bc_height))
 	{
 		const transfer_details &td = m_transfers[i];
-		if(!td.m_spent && !td.m_key_image_partial && is_transfer_unlocked(td) && td.m_subaddr_index.major == subaddr_account && subaddr_indices.count(td.m_subaddr_index.minor) == 1)
+		if(!td.m_key_image_partial)
 		{
 			const uint32_t index_minor = td.m_subaddr_index.minor;
 			auto find_predicate = [&index_minor](const std::pair<uint32_t, std::vector<size_t>> &x) { return x.first == index_minor; };
@@ -6942,10 +7041,10 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions_all(uint64_t below
 
 	// gather all dust and non-dust outputs of specified subaddress (if any) and below specified threshold (if any)
 	bool fund_found = false;
-	for(size_t i = 0; i < m_transfers.size(); ++i)
+	for(size_t i : m_transfer_index.unlocked_outputs(subaddr_account, subaddr_indices, m_local_bc_height))
 	{
 		const transfer_details &td = m_transfers[i];
-		if(!td.m_spent && !td.m_key_image_partial && is_transfer_unlocked(td) && td.m_subaddr_index.major == subaddr_account && (subaddr_indices.empty() || subaddr_indices.count(td.m_subaddr_index.minor) == 1))
+		if(!td.m_key_image_partial)
 		{
 			fund_found = true;
 			if(below == 0 || td.amount() < below)
@@ -7194,16 +7293,12 @@ uint64_t wallet2::get_upper_transaction_size_limit() const
 std::vector<size_t> wallet2::select_available_outputs(const std::function<bool(const transfer_details &td)> &f) const
 {
 	std::vector<size_t> outputs;
-	size_t n = 0;
-	for(transfer_container::const_iterator i = m_transfers.begin(); i != m_transfers.end(); ++i, ++n)
+	for(size_t n : m_transfer_index.unlocked_outputs(m_local_bc_height))
 	{
-		if(i->m_spent)
-			continue;
-		if(i->m_key_image_partial)
-			continue;
-		if(!is_transfer_unlocked(*i))
+		const transfer_details &td = m_transfers[n];
+		if(td.m_key_image_partial)
 			continue;
-		if(f(*i))
+		if(f(td))
 			outputs.push_back(n);
 	}
 	return outputs;
@@ -8478,6 +8573,9 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
 		return 0;
 	}
 
+	// key images and spent payments are rewritten in place
+	m_cache_journal.reset();
+
 	for(size_t n = 0; n < signed_key_images.size(); ++n)
 	{
 		const transfer_details &td = m_transfers[n];
@@ -8528,6 +8626,7 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
 	{
 		transfer_details &td = m_transfers[n];
 		td.m_spent = daemon_resp.spent_status[n] != COMMAND_RPC_IS_KEY_IMAGE_SPENT::UNSPENT;
+		update_transfer_index(n);
 	}
 
 	std::unordered_set<crypto::hash> spent_txids; // For each spent key image, search for a tx in m_transfers that uses it as input.
@@ -8708,6 +8807,7 @@ wallet2::payment_container wallet2::export_payments() const
 }
 void wallet2::import_payments(const payment_container &payments)
 {
+	m_cache_journal.reset();
 	m_payments.clear();
 	for(auto const &p : payments)
 	{
@@ -8716,6 +8816,7 @@ void wallet2::import_payments(const payment_container &payments)
 }
 void wallet2::import_payments_out(const std::list<std::pair<crypto::hash, wallet2::confirmed_transfer_details>> &confirmed_payments)
 {
+	m_cache_journal.reset();
 	m_confirmed_txs.clear();
 	for(auto const &p : confirmed_payments)
 	{
@@ -8737,6 +8838,7 @@ std::tuple<size_t, crypto::hash, std::vector<crypto::hash>> wallet2::export_bloc
 
 void wallet2::import_blockchain(const std::tuple<size_t, crypto::hash, std::vector<crypto::hash>> &bc)
 {
+	m_cache_journal.reset();
 	m_blockchain.clear();
 	if(std::get<0>(bc))
 	{
@@ -8772,6 +8874,7 @@ std::vector<tools::wallet2::transfer_details> wallet2::export_outputs() const
 //----------------------------------------------------------------------------------------------------
 size_t wallet2::import_outputs(const std::vector<tools::wallet2::transfer_details> &outputs)
 {
+	m_cache_journal.reset();
 	m_transfers.clear();
 	m_transfers.reserve(outputs.size());
 	for(size_t i = 0; i < outputs.size(); ++i)
@@ -8798,6 +8901,7 @@ size_t wallet2::import_outputs(const std::vector<tools::wallet2::transfer_detail
 		m_pub_keys[td.get_public_key()] = m_transfers.size();
 		m_transfers.push_back(td);
 	}
+	rebuild_transfer_index();
 
 	return m_transfers.size();
 }
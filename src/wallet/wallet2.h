@@ -73,11 +73,14 @@
 #include "storages/http_abstract_invoke.h"
 
 #include "common/bloom_filter.hpp"
+#include "common/mpmc_queue.hpp"
 #include "common/password.h"
 #include "node_rpc_proxy.h"
+#include "transfer_index.h"
 #include "wallet_errors.h"
 
 class Serialization_portability_wallet_Test;
+class wallet_shared_refresh;
 
 namespace tools
 {
@@ -159,6 +162,7 @@ public:
 class wallet2
 {
 	friend class ::Serialization_portability_wallet_Test;
+	friend class ::wallet_shared_refresh;
 
   public:
 	static constexpr const std::chrono::seconds rpc_timeout = std::chrono::minutes(3) + std::chrono::seconds(30);
@@ -665,10 +669,54 @@ class wallet2
 	void refresh(uint64_t start_height, uint64_t &blocks_fetched);
 	void refresh(uint64_t start_height, uint64_t &blocks_fetched, bool &received_money);
 	bool refresh(uint64_t &blocks_fetched, bool &received_money, bool &ok);
+	// Refreshes several wallets of the same daemon together. Each chunk is downloaded and
+	// parsed once, then every wallet scans and applies it on the thread pool.
+	static void refresh_shared(const std::vector<wallet2 *> &wallets);
 
 	void set_refresh_type(RefreshType refresh_type) { m_refresh_type = refresh_type; }
 	RefreshType get_refresh_type() const { return m_refresh_type; }
 
+	// Refresh runs as a pipeline: download -> parse -> scan -> apply. Zero means automatic.
+	struct refresh_pipeline_config
+	{
+		refresh_pipeline_config() : parse_threads(0), scan_threads(0), parse_queue_depth(0), scan_queue_depth(0), apply_queue_depth(0) {}
+
+		size_t parse_threads;
+		size_t scan_threads;
+		size_t parse_queue_depth; // chunks waiting for the parse stage
+		size_t scan_queue_depth;  // chunks waiting for the scan stage
+		size_t apply_queue_depth; // chunks waiting to be applied to m_transfers
+	};
+
+	enum refresh_stage
+	{
+		RefreshStageDownload = 0,
+		RefreshStageParse,
+		RefreshStageScan,
+		RefreshStageApply,
+		RefreshStageCount
+	};
+
+	// Times are summed over all threads of a stage, wait_in is time spent waiting for
+	// input, wait_out time spent blocked on a full output queue
+	struct refresh_stage_stats
+	{
+		std::string name;
+		uint64_t threads;
+		uint64_t queue_depth;
+		uint64_t queue_peak;
+		uint64_t items;
+		uint64_t busy_us;
+		uint64_t wait_in_us;
+		uint64_t wait_out_us;
+		uint64_t capacity_us; // threads * wall time of every refresh, busy_us / capacity_us is the occupancy
+	};
+
+	void set_refresh_pipeline_config(const refresh_pipeline_config &cfg) { m_refresh_config = cfg; }
+	const refresh_pipeline_config &get_refresh_pipeline_config() const { return m_refresh_config; }
+	// Stage stats summed over every refresh since the wallet was loaded, threads and queue_depth are those of the latest one
+	std::vector<refresh_stage_stats> get_refresh_stats() const;
+
 	void set_force_network() { m_force_network = true; }
 	cryptonote::network_type nettype() const { return m_nettype; }
 	bool restricted() const { return m_restricted; }
@@ -1092,7 +1140,6 @@ class wallet2
 	void process_new_transaction(const crypto::hash &txid, const cryptonote::transaction &tx, const std::vector<uint64_t> &o_indices, uint64_t height, uint64_t ts, bool miner_tx, bool pool, bool double_spend_seen);
 	void detach_blockchain(uint64_t height);
 	void get_short_chain_history(std::list<crypto::hash> &ids) const;
-	bool is_tx_spendtime_unlocked(uint64_t unlock_time, uint64_t block_height) const;
 	bool clear();
 	void pull_hashes(uint64_t start_height, uint64_t &blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::list<crypto::hash> &hashes);
 	void fast_refresh(uint64_t stop_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history);
@@ -1114,6 +1161,8 @@ class wallet2
 	std::vector<size_t> pick_preferred_rct_inputs(uint64_t needed_money, uint32_t subaddr_account, const std::set<uint32_t> &subaddr_indices) const;
 	void set_spent(size_t idx, uint64_t height);
 	void set_unspent(size_t idx);
+	void update_transfer_index(size_t idx);
+	void rebuild_transfer_index();
 	void get_outs(std::vector<std::vector<get_outs_entry>> &outs, const std::vector<size_t> &selected_transfers, size_t fake_outputs_count);
 	bool tx_add_fake_output(std::vector<std::vector<tools::wallet2::get_outs_entry>> &outs, uint64_t global_index, const crypto::public_key &tx_public_key, const rct::key &mask, uint64_t real_index, bool unlocked) const;
 	crypto::public_key get_tx_pub_key_from_received_outs(const tools::wallet2::transfer_details &td) const;
@@ -1135,6 +1184,80 @@ class wallet2
 
 	uint64_t get_segregation_fork_height() const;
 
+	// Changes written to the cache journal since the last full store of the cache file
+	struct cache_journal_state
+	{
+		cache_journal_state() { reset(); }
+
+		void reset()
+		{
+			valid = false;
+			base_iv = crypto::chacha_iv{};
+			base_size = 0;
+			journal_size = 0;
+			records = 0;
+			transfer_state.clear();
+			blockchain_size = 0;
+			blockchain_offset = 0;
+			subaddresses = 0;
+			payments.clear();
+			confirmed_txs.clear();
+			tx_keys.clear();
+		}
+
+		// Changes that can't be found by comparing the wallet against the state below
+		void add_payment(const crypto::hash &payment_id, const payment_details &pd)
+		{
+			if(valid)
+				payments.emplace(payment_id, pd);
+		}
+
+		void touch_confirmed_tx(const crypto::hash &txid)
+		{
+			if(valid)
+				confirmed_txs.insert(txid);
+		}
+
+		void touch_tx_key(const crypto::hash &txid)
+		{
+			if(valid)
+				tx_keys.insert(txid);
+		}
+
+		bool valid; // false when the next store has to write the full cache file
+		crypto::chacha_iv base_iv;
+		uint64_t base_size;
+		uint64_t journal_size;
+		size_t records;
+		std::vector<uint64_t> transfer_state; // fingerprint of every stored transfer
+		uint64_t blockchain_size;
+		uint64_t blockchain_offset;
+		size_t subaddresses;
+		payment_container payments;
+		std::unordered_set<crypto::hash> confirmed_txs;
+		std::unordered_set<crypto::hash> tx_keys;
+	};
+	struct cache_journal_record;
+
+	/*!
+     * \brief  Appends the changes since the last store to the cache journal
+     * \return false if the full cache file has to be stored instead
+     */
+	bool store_cache_journal();
+	/*!
+     * \brief  Replays the cache journal over a freshly loaded cache file
+     * \param  base_iv    IV of the loaded cache file, journal records written against another one are ignored
+     * \param  base_size  Size of the loaded cache file
+     */
+	void load_cache_journal(const crypto::chacha_iv &base_iv, uint64_t base_size);
+	/*!
+     * \brief  Drops the cache journal after the full cache file has been stored
+     */
+	void reset_cache_journal(const crypto::chacha_iv &base_iv, uint64_t base_size);
+	bool apply_cache_journal_record(cache_journal_record &record);
+	void set_cache_journal_watermarks();
+	std::string cache_journal_file() const { return m_wallet_file + ".journal"; }
+
 	cryptonote::account_base m_account;
 	boost::optional<epee::net_utils::http::login> m_daemon_login;
 	std::string m_daemon_address;
@@ -1151,6 +1274,7 @@ class wallet2
 	std::unordered_map<crypto::hash, std::vector<crypto::secret_key>> m_additional_tx_keys;
 
 	transfer_container m_transfers;
+	transfer_index m_transfer_index; // unspent part of m_transfers
 	payment_container m_payments;
 	std::unordered_map<crypto::key_image, size_t> m_key_images;
 	std::unordered_map<crypto::public_key, size_t> m_pub_keys;
@@ -1226,6 +1350,8 @@ class wallet2
 	std::string m_ring_database;
 	bool m_ring_history_saved;
 	std::unique_ptr<ringdb> m_ringdb;
+	refresh_pipeline_config m_refresh_config;
+	cache_journal_state m_cache_journal;
 
 	struct wallet_rpc_scan_data
 	{
@@ -1236,7 +1362,7 @@ class wallet2
 			cryptonote::block block;
 			crypto::hash miner_tx_hash;
 			std::vector<cryptonote::transaction> txes;
-			bool skipped;
+			bool skipped; // txes were not parsed, the block is too old for every wallet scanning it
 		};
 
 		struct found_output_idx
@@ -1246,6 +1372,15 @@ class wallet2
 			size_t tx_idx;
 		};
 
+		// What a single wallet found in the chunk. Kept apart from the parsed chunk, which
+		// is read only once parsed, so that several wallets can scan the same chunk at once
+		struct scan_result
+		{
+			std::vector<found_output_idx> indices_found;
+			std::unordered_set<crypto::key_image> incoming_kimg;
+			std::vector<bool> skipped; // per block, not scanned or already in m_blockchain
+		};
+
 		size_t dl_order;
 		uint64_t blocks_start_height;
 		const std::list<crypto::hash> short_chain_history;
@@ -1253,37 +1388,101 @@ class wallet2
 		std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> o_indices;
 
 		std::vector<block_complete_entry_parsed> blocks_parsed;
-		std::vector<found_output_idx> indices_found;
-		bloom_filter key_images;
-		std::unordered_set<crypto::key_image> incoming_kimg;
+		bloom_filter key_images; // inputs of every parsed transaction
+		scan_result result; // of the wallet refreshing on its own
 	};
 
 	std::unique_ptr<wallet_rpc_scan_data> pull_blocks(uint64_t start_height, const std::list<crypto::hash> &short_chain_history);
 
+	struct refresh_stage_counters
+	{
+		refresh_stage_counters()
+		{
+			begin(0, 0);
+			queue_peak = 0;
+			items = 0;
+			busy_us = 0;
+			wait_in_us = 0;
+			wait_out_us = 0;
+			capacity_us = 0;
+		}
+
+		// Totals carry over from earlier refreshes, only the configuration is replaced
+		void begin(size_t thds, size_t depth)
+		{
+			threads = thds;
+			queue_depth = depth;
+		}
+
+		void update_peak(uint64_t size)
+		{
+			uint64_t peak = queue_peak.load(std::memory_order_relaxed);
+			while(size > peak && !queue_peak.compare_exchange_weak(peak, size, std::memory_order_relaxed));
+		}
+
+		std::atomic<uint64_t> threads;
+		std::atomic<uint64_t> queue_depth;
+		std::atomic<uint64_t> queue_peak;
+		std::atomic<uint64_t> items;
+		std::atomic<uint64_t> busy_us;
+		std::atomic<uint64_t> wait_in_us;
+		std::atomic<uint64_t> wait_out_us;
+		std::atomic<uint64_t> capacity_us;
+	};
+
 	struct wallet_refresh_ctx
 	{
-		wallet_refresh_ctx() : m_scan_error(false) {};
+		wallet_refresh_ctx(refresh_stage_counters* stats, size_t parse_depth, size_t scan_depth, size_t apply_depth) :
+			m_parse_queue(parse_depth), m_scan_in_queue(scan_depth), m_scan_out_queue(apply_depth), m_scan_error(false), m_stop(false), m_stats(stats) {};
 
-		thdq<std::unique_ptr<wallet_rpc_scan_data>> m_scan_in_queue;
-		thdq<std::unique_ptr<wallet_rpc_scan_data>> m_scan_out_queue;
+		// Each queue holds chunks waiting for the stage named
+		mpmc_queue<std::unique_ptr<wallet_rpc_scan_data>> m_parse_queue;
+		mpmc_queue<std::unique_ptr<wallet_rpc_scan_data>> m_scan_in_queue;
+		mpmc_queue<std::unique_ptr<wallet_rpc_scan_data>> m_scan_out_queue;
+		std::atomic<size_t> m_running_parse_thd_cnt;
 		std::atomic<size_t> m_running_scan_thd_cnt;
 		std::atomic<bool> m_scan_error;
+		std::atomic<bool> m_stop; // stops the download without cancelling the wallet's refresh
+		refresh_stage_counters* m_stats;
 	};
 
-	struct wallet_scan_ctx
+	// Blocks older than the wallet don't need their transactions parsed nor scanned
+	struct block_skip_filter
 	{
-		wallet_scan_ctx(const wallet2& parent, wallet_refresh_ctx& refresh_ctx) : 
+		block_skip_filter(const wallet2& parent) :
 			explicit_refresh(parent.m_explicit_refresh_from_block_height),
 			wallet_create_time(parent.m_account.get_createtime()),
-			refresh_height(parent.m_refresh_from_block_height),
-			account(parent.m_account),
-			scan_type(parent.m_refresh_type),
-			refresh_ctx(refresh_ctx)
+			refresh_height(parent.m_refresh_from_block_height)
 			{}
 
+		bool skip(const wallet_rpc_scan_data::block_complete_entry_parsed& blke) const
+		{
+			return !explicit_refresh && (blke.block.timestamp + 60 * 60 * 24 <= wallet_create_time || blke.block_height < refresh_height);
+		}
+
+		// Only skips what all the wallets would skip
+		void merge(const block_skip_filter& o)
+		{
+			explicit_refresh = explicit_refresh || o.explicit_refresh;
+			wallet_create_time = std::min(wallet_create_time, o.wallet_create_time);
+			refresh_height = std::min(refresh_height, o.refresh_height);
+		}
+
 		bool explicit_refresh;
 		uint64_t wallet_create_time;
 		uint64_t refresh_height;
+	};
+
+	struct wallet_scan_ctx
+	{
+		wallet_scan_ctx(const wallet2& parent, wallet_refresh_ctx& refresh_ctx) : 
+			filter(parent),
+			account(parent.m_account),
+			scan_type(parent.m_refresh_type),
+			refresh_ctx(refresh_ctx)
+			{}
+
+		block_skip_filter filter;
 		const cryptonote::account_base& account;
 		RefreshType scan_type;
 		wallet_refresh_ctx& refresh_ctx;
@@ -1294,7 +1493,6 @@ class wallet2
 		wallet_block_dl_ctx(wallet_refresh_ctx& refresh_ctx) : 
 			refresh_ctx(refresh_ctx) {}
 
-		size_t scan_thd_cnt;
 		size_t start_height;
 		std::list<crypto::hash> short_chain_history;
 
@@ -1305,10 +1503,58 @@ class wallet2
 		wallet_refresh_ctx& refresh_ctx;
 	};
 
-	void integrate_scanned_result(std::unique_ptr<wallet_rpc_scan_data>& res);
+	refresh_stage_counters m_refresh_stats[RefreshStageCount];
+
+	bool refresh_begin(uint64_t& start_height, std::list<crypto::hash>& short_chain_history);
+	void integrate_scanned_result(const wallet_rpc_scan_data& data, wallet_rpc_scan_data::scan_result& res);
 	void block_download_thd(wallet2::wallet_block_dl_ctx& ctx);
+	void block_parse_thd(const wallet_scan_ctx& ctx);
 	void block_scan_thd(const wallet_scan_ctx& ctx);
-	bool block_scan_tx(const wallet_scan_ctx& ctx, const crypto::hash& txid, const cryptonote::transaction& tx, bloom_filter& in_kimg, std::unordered_set<crypto::key_image>& inc_kimg);
+	static size_t block_parse_range(wallet_rpc_scan_data& data, const block_skip_filter& filter, size_t begin, size_t end);
+	static void block_parse_key_images(wallet_rpc_scan_data& data, size_t in_count);
+
+	// Derivation work of a whole scan chunk, gathered so that it can be processed in one pass
+	struct block_scan_batch
+	{
+		struct tx_entry
+		{
+			tx_entry() : tx(nullptr), derivation_idx(0), additional_count(0), found_idx(0, 0), found(false), malformed(false) {}
+
+			const cryptonote::transaction* tx;
+			size_t derivation_idx; // main tx pubkey derivation, followed by the additional ones
+			size_t additional_count;
+			wallet_rpc_scan_data::found_output_idx found_idx;
+			bool found;
+			bool malformed;
+		};
+
+		struct found_output
+		{
+			crypto::subaddress_derivation der;
+			cryptonote::subaddress_index index;
+			size_t tx_idx;
+		};
+
+		void clear()
+		{
+			txes.clear();
+			derivations.clear();
+			outputs.clear();
+			output_tx.clear();
+			found.clear();
+		}
+
+		std::vector<tx_entry> txes;
+		std::vector<crypto::tx_key_derivation> derivations;
+		std::vector<crypto::subaddress_derivation> outputs;
+		std::vector<size_t> output_tx;
+		std::vector<found_output> found; // key images are taken once the tx is known to be well-formed
+	};
+
+	bool block_scan_prepare_tx(const crypto::hash& txid, const cryptonote::transaction& tx, block_scan_batch& batch);
+	void block_scan_chunk(const wallet_scan_ctx& ctx, const wallet_rpc_scan_data& data, block_scan_batch& batch, wallet_rpc_scan_data::scan_result& res);
+	void block_scan_run(const wallet_scan_ctx& ctx, block_scan_batch& batch, std::unordered_set<crypto::key_image>& inc_kimg);
+	void block_scan_found_output(const wallet_scan_ctx& ctx, const crypto::subaddress_derivation& der, const cryptonote::subaddress_index& index, std::unordered_set<crypto::key_image>& inc_kimg);
 	using tx_call_map = std::unordered_map<crypto::hash, std::pair<std::function<void()>, uint64_t>>;
 	inline void add_new_tx_call(tx_call_map& map, const crypto::hash& txid, const cryptonote::transaction& tx, const std::vector<uint64_t>& o_indices, 
 								uint64_t height, uint64_t ts, bool miner_tx)
@@ -0,0 +1,447 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <boost/filesystem.hpp>
+#include <boost/serialization/map.hpp>
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/utility.hpp>
+#include <boost/utility/value_init.hpp>
+
+#include "wallet2.h"
+#include "common/boost_serialization_helper.h"
+#include "crypto/crypto.h"
+#include "file_io_utils.h"
+#include "serialization/binary_utils.h"
+#include "serialization/string.h"
+
+namespace tools
+{
+GULPS_CAT_MAJOR("wallet_cache");
+
+namespace
+{
+// Past either limit the next store compacts the journal back into the cache file
+constexpr size_t CACHE_JOURNAL_MAX_RECORDS = 100;
+constexpr uint64_t CACHE_JOURNAL_MAX_BASE_RATIO = 2;
+
+template <typename T>
+inline void fingerprint_append(std::string &buf, const T &v)
+{
+	buf.append(reinterpret_cast<const char *>(&v), sizeof(T));
+}
+
+// Covers every field a transfer can change after it was first received
+uint64_t transfer_fingerprint(const wallet2::transfer_details &td)
+{
+	std::string buf;
+	buf.reserve(256);
+	fingerprint_append(buf, td.m_block_height);
+	fingerprint_append(buf, td.m_txid);
+	fingerprint_append(buf, uint64_t(td.m_internal_output_index));
+	fingerprint_append(buf, td.m_global_output_index);
+	fingerprint_append(buf, uint8_t(td.m_spent));
+	fingerprint_append(buf, td.m_spent_height);
+	fingerprint_append(buf, td.m_key_image);
+	fingerprint_append(buf, td.m_mask);
+	fingerprint_append(buf, td.m_amount);
+	fingerprint_append(buf, uint8_t(td.m_rct));
+	fingerprint_append(buf, uint8_t(td.m_key_image_known));
+	fingerprint_append(buf, uint8_t(td.m_key_image_partial));
+	fingerprint_append(buf, uint64_t(td.m_pk_index));
+	fingerprint_append(buf, td.m_subaddr_index.major);
+	fingerprint_append(buf, td.m_subaddr_index.minor);
+
+	crypto::hash h = crypto::cn_fast_hash(buf.data(), buf.size());
+	uint64_t fp;
+	memcpy(&fp, &h, sizeof(fp));
+	return fp;
+}
+
+std::string journal_base_tag(const crypto::chacha_iv &iv)
+{
+	return std::string(reinterpret_cast<const char *>(&iv), sizeof(iv));
+}
+
+bool is_valid_transfer(const wallet2::transfer_details &td)
+{
+	return td.m_internal_output_index < td.m_tx.vout.size() &&
+		td.m_tx.vout[td.m_internal_output_index].target.type() == typeid(cryptonote::txout_to_key);
+}
+}
+
+// One journal record holds everything that changed between two stores. Append-only containers
+// carry only their new entries, the small ones are written whole.
+struct wallet2::cache_journal_record
+{
+	std::string base_tag;
+	uint64_t transfers_start;
+	std::vector<uint64_t> changed_idx;
+	std::vector<transfer_details> changed_transfers;
+	std::vector<transfer_details> new_transfers;
+	uint64_t blockchain_start;
+	uint64_t blockchain_offset;
+	std::vector<crypto::hash> new_blocks;
+	payment_container payments;
+	std::unordered_map<crypto::hash, confirmed_transfer_details> confirmed_txs;
+	std::unordered_map<crypto::hash, crypto::secret_key> tx_keys;
+	std::unordered_map<crypto::hash, std::vector<crypto::secret_key>> additional_tx_keys;
+	bool has_subaddresses;
+	std::unordered_map<crypto::public_key, cryptonote::subaddress_index> subaddresses;
+	std::vector<std::vector<std::string>> subaddress_labels;
+	std::unordered_map<crypto::hash, unconfirmed_transfer_details> unconfirmed_txs;
+	std::unordered_multimap<crypto::hash, pool_payment_details> unconfirmed_payments;
+	std::unordered_set<crypto::hash> scanned_pool_txs[2];
+	std::unordered_map<crypto::hash, std::string> tx_notes;
+	std::unordered_map<std::string, std::string> attributes;
+	std::vector<address_book_row> address_book;
+	std::pair<std::map<std::string, std::string>, std::vector<std::string>> account_tags;
+	bool ring_history_saved;
+
+	template <class t_archive>
+	inline void serialize(t_archive &a, const unsigned int ver)
+	{
+		a &base_tag;
+		a &transfers_start;
+		a &changed_idx;
+		a &changed_transfers;
+		a &new_transfers;
+		a &blockchain_start;
+		a &blockchain_offset;
+		a &new_blocks;
+		a &payments;
+		a &confirmed_txs;
+		a &tx_keys;
+		a &additional_tx_keys;
+		a &has_subaddresses;
+		a &subaddresses;
+		a &subaddress_labels;
+		a &unconfirmed_txs;
+		a &unconfirmed_payments;
+		a &scanned_pool_txs[0];
+		a &scanned_pool_txs[1];
+		a &tx_notes;
+		a &attributes;
+		a &address_book;
+		a &account_tags;
+		a &ring_history_saved;
+	}
+};
+
+//----------------------------------------------------------------------------------------------------
+void wallet2::set_cache_journal_watermarks()
+{
+	m_cache_journal.transfer_state.clear();
+	m_cache_journal.transfer_state.reserve(m_transfers.size());
+	for(const transfer_details &td : m_transfers)
+		m_cache_journal.transfer_state.push_back(transfer_fingerprint(td));
+	m_cache_journal.blockchain_size = m_blockchain.size();
+	m_cache_journal.blockchain_offset = m_blockchain.offset();
+	m_cache_journal.subaddresses = m_subaddresses.size();
+	m_cache_journal.payments.clear();
+	m_cache_journal.confirmed_txs.clear();
+	m_cache_journal.tx_keys.clear();
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::reset_cache_journal(const crypto::chacha_iv &base_iv, uint64_t base_size)
+{
+	m_cache_journal.reset();
+
+	boost::system::error_code e;
+	boost::filesystem::remove(cache_journal_file(), e);
+	if(e)
+	{
+		// leave the journal disarmed so that the next store retries
+		GULPS_LOG_ERROR("error removing file: ", cache_journal_file());
+		return;
+	}
+
+	m_cache_journal.valid = true;
+	m_cache_journal.base_iv = base_iv;
+	m_cache_journal.base_size = base_size;
+	set_cache_journal_watermarks();
+}
+//----------------------------------------------------------------------------------------------------
+bool wallet2::store_cache_journal()
+{
+	cache_journal_state &cj = m_cache_journal;
+
+	if(!cj.valid || m_multisig)
+		return false;
+	if(cj.records >= CACHE_JOURNAL_MAX_RECORDS || cj.journal_size * CACHE_JOURNAL_MAX_BASE_RATIO > cj.base_size)
+	{
+		GULPS_LOG_L1("Compacting cache journal, ", cj.records, " records, ", cj.journal_size, " bytes");
+		return false;
+	}
+	// shrinking state only happens through paths that disarm the journal, but better safe than sorry
+	if(m_transfers.size() < cj.transfer_state.size() || m_blockchain.size() < cj.blockchain_size ||
+		m_blockchain.offset() < cj.blockchain_offset || m_subaddresses.size() < cj.subaddresses)
+		return false;
+
+	cache_journal_record record = boost::value_initialized<cache_journal_record>();
+	record.base_tag = journal_base_tag(cj.base_iv);
+
+	std::vector<uint64_t> changed_fp;
+	record.transfers_start = cj.transfer_state.size();
+	for(size_t i = 0; i < cj.transfer_state.size(); ++i)
+	{
+		uint64_t fp = transfer_fingerprint(m_transfers[i]);
+		if(fp != cj.transfer_state[i])
+		{
+			record.changed_idx.push_back(i);
+			record.changed_transfers.push_back(m_transfers[i]);
+			changed_fp.push_back(fp);
+		}
+	}
+	record.new_transfers.assign(m_transfers.begin() + cj.transfer_state.size(), m_transfers.end());
+
+	// hashes trimmed since the last store are not available anymore, replay pads them before trimming
+	record.blockchain_start = cj.blockchain_size;
+	record.blockchain_offset = m_blockchain.offset();
+	for(size_t n = std::max<uint64_t>(cj.blockchain_size, m_blockchain.offset()); n < m_blockchain.size(); ++n)
+		record.new_blocks.push_back(m_blockchain[n]);
+
+	record.payments = cj.payments;
+	for(const crypto::hash &txid : cj.confirmed_txs)
+	{
+		auto it = m_confirmed_txs.find(txid);
+		if(it != m_confirmed_txs.end())
+			record.confirmed_txs.insert(*it);
+	}
+	for(const crypto::hash &txid : cj.tx_keys)
+	{
+		auto it = m_tx_keys.find(txid);
+		if(it != m_tx_keys.end())
+			record.tx_keys.insert(*it);
+		auto ait = m_additional_tx_keys.find(txid);
+		if(ait != m_additional_tx_keys.end())
+			record.additional_tx_keys.insert(*ait);
+	}
+
+	record.has_subaddresses = m_subaddresses.size() != cj.subaddresses;
+	if(record.has_subaddresses)
+		record.subaddresses = m_subaddresses;
+	record.subaddress_labels = m_subaddress_labels;
+	record.unconfirmed_txs = m_unconfirmed_txs;
+	record.unconfirmed_payments = m_unconfirmed_payments;
+	record.scanned_pool_txs[0] = m_scanned_pool_txs[0];
+	record.scanned_pool_txs[1] = m_scanned_pool_txs[1];
+	record.tx_notes = m_tx_notes;
+	record.attributes = m_attributes;
+	record.address_book = m_address_book;
+	record.account_tags = m_account_tags;
+	record.ring_history_saved = m_ring_history_saved;
+
+	std::stringstream oss;
+	{
+		boost::archive::portable_binary_oarchive ar(oss);
+		ar << record;
+	}
+
+	cache_file_data cache_file_data = boost::value_initialized<wallet2::cache_file_data>();
+	cache_file_data.cache_data = oss.str();
+	crypto::chacha_key key;
+	generate_chacha_key_from_secret_keys(key);
+	std::string cipher;
+	cipher.resize(cache_file_data.cache_data.size());
+	cache_file_data.iv = crypto::rand<crypto::chacha_iv>();
+	crypto::chacha20(cache_file_data.cache_data.data(), cache_file_data.cache_data.size(), key, cache_file_data.iv, &cipher[0]);
+	cache_file_data.cache_data = cipher;
+
+	std::ostringstream blob;
+	binary_archive<true> oar(blob);
+	if(!::serialization::serialize(oar, cache_file_data))
+		return false;
+
+	// a torn append is dropped on replay, the full store that follows replaces the journal anyway
+	if(!epee::file_io_utils::append_string_to_file(cache_journal_file(), blob.str()))
+	{
+		GULPS_LOG_ERROR("Failed to append to cache journal ", cache_journal_file(), ", storing full cache");
+		return false;
+	}
+
+	for(size_t i = 0; i < record.changed_idx.size(); ++i)
+		cj.transfer_state[record.changed_idx[i]] = changed_fp[i];
+	for(const transfer_details &td : record.new_transfers)
+		cj.transfer_state.push_back(transfer_fingerprint(td));
+	cj.blockchain_size = m_blockchain.size();
+	cj.blockchain_offset = m_blockchain.offset();
+	cj.subaddresses = m_subaddresses.size();
+	cj.payments.clear();
+	cj.confirmed_txs.clear();
+	cj.tx_keys.clear();
+	cj.journal_size += blob.str().size();
+	++cj.records;
+
+	GULPS_LOG_L1("Stored cache journal record ", cj.records, ": ", record.new_transfers.size(), " new transfers, ",
+		record.changed_idx.size(), " changed transfers, ", record.new_blocks.size(), " blocks, ", blob.str().size(), " bytes");
+	return true;
+}
+//----------------------------------------------------------------------------------------------------
+bool wallet2::apply_cache_journal_record(cache_journal_record &record)
+{
+	if(record.transfers_start != m_transfers.size() || record.changed_idx.size() != record.changed_transfers.size())
+		return false;
+	if(record.blockchain_start != m_blockchain.size() || record.blockchain_offset < m_blockchain.offset() || m_blockchain.empty())
+		return false;
+	for(uint64_t idx : record.changed_idx)
+		if(idx >= m_transfers.size())
+			return false;
+	for(const transfer_details &td : record.changed_transfers)
+		if(!is_valid_transfer(td))
+			return false;
+	for(const transfer_details &td : record.new_transfers)
+		if(!is_valid_transfer(td))
+			return false;
+
+	for(size_t i = 0; i < record.changed_idx.size(); ++i)
+	{
+		const size_t idx = record.changed_idx[i];
+		m_transfers[idx] = std::move(record.changed_transfers[i]);
+		const transfer_details &td = m_transfers[idx];
+		if(td.m_key_image_known && !td.m_key_image_partial)
+			m_key_images[td.m_key_image] = idx;
+		m_pub_keys[td.get_public_key()] = idx;
+	}
+	for(transfer_details &ntd : record.new_transfers)
+	{
+		m_transfers.push_back(std::move(ntd));
+		const transfer_details &td = m_transfers.back();
+		if(td.m_key_image_known && !td.m_key_image_partial)
+			m_key_images[td.m_key_image] = m_transfers.size() - 1;
+		m_pub_keys[td.get_public_key()] = m_transfers.size() - 1;
+	}
+
+	while(m_blockchain.size() < record.blockchain_offset)
+		m_blockchain.push_back(crypto::null_hash);
+	for(const crypto::hash &h : record.new_blocks)
+		m_blockchain.push_back(h);
+	m_blockchain.trim(record.blockchain_offset);
+
+	for(const auto &p : record.payments)
+		m_payments.emplace(p);
+	for(auto &p : record.confirmed_txs)
+		m_confirmed_txs[p.first] = std::move(p.second);
+	for(const auto &p : record.tx_keys)
+		m_tx_keys[p.first] = p.second;
+	for(auto &p : record.additional_tx_keys)
+		m_additional_tx_keys[p.first] = std::move(p.second);
+
+	if(record.has_subaddresses)
+		m_subaddresses = std::move(record.subaddresses);
+	m_subaddress_labels = std::move(record.subaddress_labels);
+	m_unconfirmed_txs = std::move(record.unconfirmed_txs);
+	m_unconfirmed_payments = std::move(record.unconfirmed_payments);
+	m_scanned_pool_txs[0] = std::move(record.scanned_pool_txs[0]);
+	m_scanned_pool_txs[1] = std::move(record.scanned_pool_txs[1]);
+	m_tx_notes = std::move(record.tx_notes);
+	m_attributes = std::move(record.attributes);
+	m_address_book = std::move(record.address_book);
+	m_account_tags = std::move(record.account_tags);
+	m_ring_history_saved = record.ring_history_saved;
+	return true;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::load_cache_journal(const crypto::chacha_iv &base_iv, uint64_t base_size)
+{
+	m_cache_journal.reset();
+
+	boost::system::error_code e;
+	const std::string journal_file = cache_journal_file();
+	std::string buf;
+	if(boost::filesystem::exists(journal_file, e) && !e && !epee::file_io_utils::load_file_to_string(journal_file, buf))
+	{
+		GULPS_LOG_ERROR("Failed to read cache journal ", journal_file, ", it will be replaced on the next store");
+		return;
+	}
+
+	crypto::chacha_key key;
+	generate_chacha_key_from_secret_keys(key);
+	const std::string base_tag = journal_base_tag(base_iv);
+
+	std::istringstream iss(buf);
+	binary_archive<false> ar(iss);
+	size_t records = 0;
+	uint64_t consumed = 0;
+	while(ar.remaining_bytes() > 0)
+	{
+		cache_file_data cache_file_data;
+		if(!::do_serialize(ar, cache_file_data) || !iss.good())
+			break;
+
+		cache_journal_record record = boost::value_initialized<cache_journal_record>();
+		try
+		{
+			std::string cache_data;
+			cache_data.resize(cache_file_data.cache_data.size());
+			crypto::chacha20(cache_file_data.cache_data.data(), cache_file_data.cache_data.size(), key, cache_file_data.iv, &cache_data[0]);
+
+			std::stringstream rss;
+			rss << cache_data;
+			boost::archive::portable_binary_iarchive rar(rss);
+			rar >> record;
+		}
+		catch(...)
+		{
+			break;
+		}
+
+		// records left over from an older cache file end the journal too
+		if(record.base_tag != base_tag || !apply_cache_journal_record(record))
+			break;
+
+		consumed = buf.size() - ar.remaining_bytes();
+		++records;
+	}
+
+	if(records > 0)
+		GULPS_LOG_L0("Replayed ", records, " cache journal records, ", consumed, " bytes");
+
+	m_cache_journal.base_iv = base_iv;
+	m_cache_journal.base_size = base_size;
+	m_cache_journal.journal_size = consumed;
+	m_cache_journal.records = records;
+	set_cache_journal_watermarks();
+
+	// anything past the last good record is garbage that new records must not be appended after
+	m_cache_journal.valid = consumed == buf.size();
+	if(!m_cache_journal.valid)
+		GULPS_LOG_L0("Dropping ", buf.size() - consumed, " trailing bytes of the cache journal on the next store");
+}
+}
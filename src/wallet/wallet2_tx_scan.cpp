@@ -38,7 +38,10 @@
 // STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <chrono>
+
 #include "wallet2.h"
+#include "common/threadpool.h"
 #include "crypto/crypto.h"
 #include "device/device_default.hpp"
 
@@ -46,6 +49,16 @@ namespace tools
 {
 GULPS_CAT_MAJOR("wallet_tx_scan");
 
+namespace
+{
+typedef std::chrono::steady_clock stage_clock;
+
+inline uint64_t usec_since(const stage_clock::time_point& start)
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(stage_clock::now() - start).count();
+}
+}
+
 std::unique_ptr<wallet2::wallet_rpc_scan_data> wallet2::pull_blocks(uint64_t start_height, const std::list<crypto::hash> &short_chain_history)
 {
 	cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::request req = AUTO_VAL_INIT(req);
@@ -83,13 +96,17 @@ void wallet2::block_download_thd(wallet2::wallet_block_dl_ctx& ctx)
 	ctx.error = false;
 	ctx.cancelled = false;
 	size_t dl_order = 0;
+	wallet_refresh_ctx& rctx = ctx.refresh_ctx;
+	refresh_stage_counters& stats = rctx.m_stats[RefreshStageDownload];
 
-	while(m_run.load(std::memory_order_relaxed))
+	while(m_run.load(std::memory_order_relaxed) && !rctx.m_stop.load(std::memory_order_relaxed))
 	{
 		try
 		{
 			GULPS_LOG_L1("Pulling blocks...");
+			stage_clock::time_point start = stage_clock::now();
 			pull_res = pull_blocks(ctx.start_height, ctx.short_chain_history);
+			stats.busy_us += usec_since(start);
 
 			if(pull_res->blocks_bin.empty())
 			{
@@ -103,7 +120,7 @@ void wallet2::block_download_thd(wallet2::wallet_block_dl_ctx& ctx)
 			if(last_top_height == current_top_height)
 			{
 				GULPS_LOG_L1("No more blocks from daemon.");
-				ctx.refresh_ctx.m_scan_in_queue.set_finish_flag();
+				rctx.m_parse_queue.set_finish_flag();
 				ctx.refreshed = true;
 				return;
 			}
@@ -119,6 +136,8 @@ void wallet2::block_download_thd(wallet2::wallet_block_dl_ctx& ctx)
 
 			drop_from_short_history(ctx.short_chain_history, 3);
 			// prepend the last 3 blocks, should be enough to guard against a block or two's reorg
+			// the next request depends on them, so they are parsed here rather than in the parse stage
+			start = stage_clock::now();
 			cryptonote::block bl;
 			for(auto it=pull_res->blocks_bin.rbegin(); it != pull_res->blocks_bin.rend() && std::distance(pull_res->blocks_bin.rbegin(), it) < 3; ++it)
 			{
@@ -126,9 +145,13 @@ void wallet2::block_download_thd(wallet2::wallet_block_dl_ctx& ctx)
 				THROW_WALLET_EXCEPTION_IF(!ok, error::block_parse_error, it->block);
 				ctx.short_chain_history.push_front(cryptonote::get_block_hash(bl));
 			}
+			stats.busy_us += usec_since(start);
 
-			ctx.refresh_ctx.m_scan_in_queue.wait_for_size(ctx.scan_thd_cnt + 1);
-			ctx.refresh_ctx.m_scan_in_queue.push(std::move(pull_res));
+			start = stage_clock::now();
+			rctx.m_parse_queue.push(std::move(pull_res));
+			stats.wait_out_us += usec_since(start);
+			rctx.m_stats[RefreshStageParse].update_peak(rctx.m_parse_queue.size());
+			stats.items++;
 			GULPS_LOG_L1("Pushed blocks...");
 		}
 		catch(...)
@@ -143,18 +166,22 @@ void wallet2::block_download_thd(wallet2::wallet_block_dl_ctx& ctx)
 				GULPS_LOG_ERROR("pull_blocks failed, try_count=", try_count);
 
 				// Exit due to an error
-				ctx.refresh_ctx.m_scan_in_queue.set_finish_flag();
+				rctx.m_parse_queue.set_finish_flag();
 				ctx.error = true;
 				return;
 			}
 		}
 	}
 
-	ctx.refresh_ctx.m_scan_in_queue.set_finish_flag();
+	rctx.m_parse_queue.set_finish_flag();
 	if(ctx.error)
 	{
 		GULPS_LOG_L1("Stop downloading blocks due to an error");
 	}
+	else if(rctx.m_stop.load(std::memory_order_relaxed))
+	{
+		GULPS_LOG_L1("Stop downloading blocks, no longer needed");
+	}
 	else
 	{
 		ctx.cancelled = true;
@@ -162,20 +189,9 @@ void wallet2::block_download_thd(wallet2::wallet_block_dl_ctx& ctx)
 	}
 }
 
-bool wallet2::block_scan_tx(const wallet_scan_ctx& ctx, const crypto::hash& txid, const cryptonote::transaction& tx, bloom_filter& in_kimg, std::unordered_set<crypto::key_image>& inc_kimg)
+bool wallet2::block_scan_prepare_tx(const crypto::hash& txid, const cryptonote::transaction& tx, block_scan_batch& batch)
 {
-	hw::core::device_default dummy_dev;
-	const cryptonote::account_keys &keys = ctx.account.get_keys();
 	GULPS_LOG_L2("Scanning tx ", txid);
-	for(const auto& tx_in : tx.vin)
-	{
-		if(tx_in.type() != typeid(cryptonote::txin_to_key))
-			continue;
-
-		const crypto::key_image& ki = boost::get<cryptonote::txin_to_key>(tx_in).k_image;
-		in_kimg.add_element(&ki, sizeof(crypto::key_image));
-	}
-
 	std::vector<cryptonote::tx_extra_field> tx_extra_fields;
 	if(!parse_tx_extra(tx.extra, tx_extra_fields))
 	{
@@ -190,227 +206,569 @@ bool wallet2::block_scan_tx(const wallet_scan_ctx& ctx, const crypto::hash& txid
 		return false;
 	}
 
-	const crypto::public_key& tx_pub_key = pub_key_field.pub_key;
-	crypto::key_derivation derivation;
-	bool derivation_res;
-#ifdef HAVE_EC_64
-	derivation_res = crypto::generate_key_derivation_64(tx_pub_key, keys.m_view_secret_key, derivation);
-#else
-	derivation_res = crypto::generate_key_derivation(tx_pub_key, keys.m_view_secret_key, derivation);
-#endif
+	batch.txes.emplace_back();
+	block_scan_batch::tx_entry& txe = batch.txes.back();
+	txe.tx = &tx;
+	txe.derivation_idx = batch.derivations.size();
+
+	batch.derivations.emplace_back();
+	batch.derivations.back().tx_key = pub_key_field.pub_key;
 
-	if(!derivation_res)
+	// additional tx pubkeys and derivations for multi-destination transfers involving one or more subaddresses
+	cryptonote::tx_extra_additional_pub_keys additional_pub_keys;
+	if(find_tx_extra_field_by_type(tx_extra_fields, additional_pub_keys))
 	{
-		GULPS_WARN("Failed to generate key derivation from tx pubkey, skipping");
-		memcpy(&derivation, rct::identity().bytes, sizeof(derivation));
+		txe.additional_count = additional_pub_keys.data.size();
+		for(const crypto::public_key& pk : additional_pub_keys.data)
+		{
+			batch.derivations.emplace_back();
+			batch.derivations.back().tx_key = pk;
+		}
 	}
 
-	std::vector<crypto::public_key> additional_tx_pub_keys = get_additional_tx_pub_keys_from_extra(tx);
-	std::vector<crypto::key_derivation> additional_derivations;
-	additional_derivations.resize(additional_tx_pub_keys.size());
+	return true;
+}
 
-	// additional tx pubkeys and derivations for multi-destination transfers involving one or more subaddresses
-	for(size_t i = 0; i < additional_tx_pub_keys.size(); ++i)
+void wallet2::block_scan_found_output(const wallet_scan_ctx& ctx, const crypto::subaddress_derivation& der, const cryptonote::subaddress_index& index, std::unordered_set<crypto::key_image>& inc_kimg)
+{
+	const cryptonote::account_keys &keys = ctx.account.get_keys();
+	if(keys.m_spend_secret_key == crypto::null_skey || !keys.m_multisig_keys.empty())
+		return;
+
+	hw::core::device_default dummy_dev;
+	cryptonote::keypair eph;
+	crypto::key_image ki;
+	bool r = cryptonote::generate_key_image_helper_precomp(keys, der.out_key, der.derivation, der.output_index, index, eph, ki, dummy_dev);
+	THROW_WALLET_EXCEPTION_IF(!r, error::wallet_internal_error, "Failed to generate key image");
+	THROW_WALLET_EXCEPTION_IF(eph.pub != der.out_key,
+						error::wallet_internal_error, "key_image generated ephemeral public key not matched with output_key");
+	THROW_WALLET_EXCEPTION_IF(!inc_kimg.insert(ki).second, error::wallet_internal_error, "Duplicate key image");
+}
+
+void wallet2::block_scan_run(const wallet_scan_ctx& ctx, block_scan_batch& batch, std::unordered_set<crypto::key_image>& inc_kimg)
+{
+	const cryptonote::account_keys &keys = ctx.account.get_keys();
+
+	// Pass 1 - tx public keys of the whole chunk
+	crypto::generate_key_derivations(keys.m_view_secret_key, batch.derivations.data(), batch.derivations.size());
+	for(crypto::tx_key_derivation& d : batch.derivations)
 	{
-#ifdef HAVE_EC_64
-		derivation_res = crypto::generate_key_derivation_64(additional_tx_pub_keys[i], keys.m_view_secret_key, additional_derivations[i]);
-#else
-		derivation_res = crypto::generate_key_derivation(additional_tx_pub_keys[i], keys.m_view_secret_key, additional_derivations[i]);
-#endif
-		if(!derivation_res)
+		if(!d.valid)
 		{
-			GULPS_WARN("Failed to generate key derivation from extra pubkey ", i, ", skipping");
-			memcpy(&additional_derivations[i], rct::identity().bytes, sizeof(additional_derivations[i]));
+			GULPS_WARN("Failed to generate key derivation from tx pubkey, skipping");
+			memcpy(&d.derivation, rct::identity().bytes, sizeof(d.derivation));
 		}
 	}
 
-	bool spend_unknown = keys.m_spend_secret_key == crypto::null_skey || !keys.m_multisig_keys.empty();
-	bool ret = false;
-	for(size_t out_idx = 0; out_idx < tx.vout.size(); out_idx++)
+	// Pass 2 - every output against the shared tx pubkey
+	batch.outputs.clear();
+	batch.output_tx.clear();
+	batch.found.clear();
+	for(size_t i = 0; i < batch.txes.size(); i++)
 	{
-		if(tx.vout[out_idx].target.type() != typeid(cryptonote::txout_to_key))
+		const cryptonote::transaction& tx = *batch.txes[i].tx;
+		for(size_t out_idx = 0; out_idx < tx.vout.size(); out_idx++)
 		{
-			GULPS_LOG_L0("Wrong type id in transaction out");
-			continue;
+			if(tx.vout[out_idx].target.type() != typeid(cryptonote::txout_to_key))
+			{
+				GULPS_LOG_L0("Wrong type id in transaction out");
+				continue;
+			}
+
+			batch.outputs.emplace_back();
+			crypto::subaddress_derivation& der = batch.outputs.back();
+			der.out_key = boost::get<cryptonote::txout_to_key>(tx.vout[out_idx].target).key;
+			der.derivation = batch.derivations[batch.txes[i].derivation_idx].derivation;
+			der.output_index = out_idx;
+			batch.output_tx.push_back(i);
 		}
+	}
 
-		// try the shared tx pubkey
-		crypto::public_key subaddress_spendkey;
-		const crypto::public_key& out_pubkey = boost::get<cryptonote::txout_to_key>(tx.vout[out_idx].target).key;
-#ifdef HAVE_EC_64
-		derivation_res = crypto::derive_subaddress_public_key_64(out_pubkey, derivation, out_idx, subaddress_spendkey);
-#else
-		derivation_res = crypto::derive_subaddress_public_key(out_pubkey, derivation, out_idx, subaddress_spendkey);
-#endif
+	crypto::derive_subaddress_public_keys(batch.outputs.data(), batch.outputs.size());
 
-		if(!derivation_res)
+	// Pass 3 - outputs that didn't match try the additional tx pubkeys if available
+	size_t n_additional = 0;
+	for(size_t i = 0; i < batch.outputs.size(); i++)
+	{
+		crypto::subaddress_derivation& der = batch.outputs[i];
+		block_scan_batch::tx_entry& txe = batch.txes[batch.output_tx[i]];
+		if(!der.valid)
 		{
 			GULPS_WARN("Failed to derive main addresses public key, skipping...");
 			continue;
 		}
 
-		auto found = m_subaddresses.find(subaddress_spendkey);
+		auto found = m_subaddresses.find(der.spend_key);
 		if(found != m_subaddresses.end())
 		{
-			if(!spend_unknown)
-			{
-				cryptonote::keypair eph;
-				crypto::key_image ki;
-				bool r = cryptonote::generate_key_image_helper_precomp(keys, out_pubkey, derivation, out_idx, found->second, eph, ki, dummy_dev);
-				THROW_WALLET_EXCEPTION_IF(!r, error::wallet_internal_error, "Failed to generate key image");
-				THROW_WALLET_EXCEPTION_IF(eph.pub != out_pubkey,
-									error::wallet_internal_error, "key_image generated ephemeral public key not matched with output_key");
-				THROW_WALLET_EXCEPTION_IF(!inc_kimg.insert(ki).second, error::wallet_internal_error, "Duplicate key image");
-			}
-			ret = true;
+			batch.found.push_back({der, found->second, batch.output_tx[i]});
+			txe.found = true;
 			continue;
 		}
 
-		// try additional tx pubkeys if available
-		if(!additional_derivations.empty())
+		if(txe.additional_count == 0 || txe.malformed)
+			continue;
+
+		if(der.output_index >= txe.additional_count)
 		{
-			if(out_idx >= additional_derivations.size())
-			{
-				GULPS_LOG_L0("Wrong number of additional derivations");
-				return false;
-			}
+			GULPS_LOG_L0("Wrong number of additional derivations");
+			txe.malformed = true;
+			continue;
+		}
+
+		der.derivation = batch.derivations[txe.derivation_idx + 1 + der.output_index].derivation;
+		batch.outputs[n_additional] = der;
+		batch.output_tx[n_additional] = batch.output_tx[i];
+		n_additional++;
+	}
+
+	crypto::derive_subaddress_public_keys(batch.outputs.data(), n_additional);
+
+	for(size_t i = 0; i < n_additional; i++)
+	{
+		const crypto::subaddress_derivation& der = batch.outputs[i];
+		block_scan_batch::tx_entry& txe = batch.txes[batch.output_tx[i]];
+		if(!der.valid)
+		{
+			GULPS_WARN("Failed to derive subaddresses public key, skipping...");
+			continue;
+		}
+
+		auto found = m_subaddresses.find(der.spend_key);
+		if(found != m_subaddresses.end())
+		{
+			batch.found.push_back({der, found->second, batch.output_tx[i]});
+			txe.found = true;
+		}
+	}
+
+	// A later output can still flag the tx malformed, block_scan_chunk drops those txes
+	for(const block_scan_batch::found_output& f : batch.found)
+	{
+		if(!batch.txes[f.tx_idx].malformed)
+			block_scan_found_output(ctx, f.der, f.index, inc_kimg);
+	}
+}
+
+void wallet2::block_scan_chunk(const wallet_scan_ctx& ctx, const wallet_rpc_scan_data& data, block_scan_batch& batch, wallet_rpc_scan_data::scan_result& res)
+{
+	batch.clear();
+	res.skipped.assign(data.blocks_parsed.size(), false);
+	for(size_t i=0; i < data.blocks_parsed.size(); i++)
+	{
+		const wallet_rpc_scan_data::block_complete_entry_parsed& blke = data.blocks_parsed[i];
 
-#ifdef HAVE_EC_64
-			derivation_res = crypto::derive_subaddress_public_key_64(out_pubkey, additional_derivations[out_idx], out_idx, subaddress_spendkey);
-#else
-			derivation_res = crypto::derive_subaddress_public_key(out_pubkey, additional_derivations[out_idx], out_idx, subaddress_spendkey);
-#endif
+		// A chunk parsed for several wallets may still be too old for this one
+		if(blke.skipped || ctx.filter.skip(blke))
+		{
+			res.skipped[i] = true;
+			continue;
+		}
 
-			if(!derivation_res)
+		if(ctx.scan_type != RefreshNoCoinbase)
+		{
+			if(block_scan_prepare_tx(blke.miner_tx_hash, blke.block.miner_tx, batch))
+				batch.txes.back().found_idx = wallet_rpc_scan_data::found_output_idx(i, 0);
+		}
+
+		for(size_t txi=0; txi < blke.txes.size(); txi++)
+		{
+			if(block_scan_prepare_tx(blke.block.tx_hashes[txi], blke.txes[txi], batch))
+				batch.txes.back().found_idx = wallet_rpc_scan_data::found_output_idx(i, txi+1);
+		}
+	}
+
+	// All derivations of the chunk are done in one go
+	block_scan_run(ctx, batch, res.incoming_kimg);
+	for(const block_scan_batch::tx_entry& txe : batch.txes)
+	{
+		if(txe.found && !txe.malformed)
+			res.indices_found.push_back(txe.found_idx);
+	}
+}
+
+size_t wallet2::block_parse_range(wallet_rpc_scan_data& data, const block_skip_filter& filter, size_t begin, size_t end)
+{
+	size_t in_count = 0;
+	for(size_t blk_i = begin; blk_i < end; blk_i++)
+	{
+		const cryptonote::block_complete_entry_v& bl = data.blocks_bin[blk_i];
+		wallet_rpc_scan_data::block_complete_entry_parsed& blke = data.blocks_parsed[blk_i];
+		const cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices& blk_o_idx = data.o_indices[blk_i];
+		blke.block_height = data.blocks_start_height + blk_i;
+
+		bool r = cryptonote::parse_and_validate_block_from_blob(bl.block, blke.block);
+		THROW_WALLET_EXCEPTION_IF(!r, error::block_parse_error, bl.block);
+		blke.block_hash = get_block_hash(blke.block);
+		THROW_WALLET_EXCEPTION_IF(bl.txs.size() + 1 != blk_o_idx.indices.size(), error::wallet_internal_error,
+			"block transactions=" + std::to_string(bl.txs.size()) + " not match with daemon response size=" +
+			std::to_string(blk_o_idx.indices.size()) + " for block " + std::to_string(blke.block_height));
+		THROW_WALLET_EXCEPTION_IF(bl.txs.size() != blke.block.tx_hashes.size(), error::wallet_internal_error,
+								  "Wrong amount of transactions for block");
+
+		if(filter.skip(blke))
+		{
+			if(blke.block_height % 100 == 0)
+				GULPS_LOG_L2("Skipped block by timestamp, height: ", blke.block_height, ", block time ",
+							 blke.block.timestamp, ", account time ", filter.wallet_create_time);
+			blke.skipped = true;
+			continue;
+		}
+		blke.skipped = false;
+
+		blke.miner_tx_hash = cryptonote::get_transaction_hash(blke.block.miner_tx);
+		size_t tx_i =0;
+		blke.txes.resize(bl.txs.size());
+		for(const cryptonote::blobdata& tx_blob : bl.txs)
+		{
+			cryptonote::transaction& tx = blke.txes[tx_i];
+			bool r = parse_and_validate_tx_base_from_blob(tx_blob, tx);
+			THROW_WALLET_EXCEPTION_IF(!r, error::tx_parse_error, tx_blob);
+			in_count += tx.vin.size();
+			tx_i++;
+		}
+	}
+	return in_count;
+}
+
+void wallet2::block_parse_key_images(wallet_rpc_scan_data& data, size_t in_count)
+{
+	data.key_images.init(in_count);
+	for(const wallet_rpc_scan_data::block_complete_entry_parsed& blke : data.blocks_parsed)
+	{
+		for(const cryptonote::transaction& tx : blke.txes)
+		{
+			for(const auto& tx_in : tx.vin)
 			{
-				GULPS_WARN("Failed to derive subaddresses public key, skipping...");
-				continue;
+				if(tx_in.type() != typeid(cryptonote::txin_to_key))
+					continue;
+
+				const crypto::key_image& ki = boost::get<cryptonote::txin_to_key>(tx_in).k_image;
+				data.key_images.add_element(&ki, sizeof(crypto::key_image));
 			}
+		}
+	}
+}
+
+void wallet2::block_parse_thd(const wallet_scan_ctx& ctx)
+{
+	wallet_refresh_ctx& rctx = ctx.refresh_ctx;
+	refresh_stage_counters& stats = rctx.m_stats[RefreshStageParse];
+	try
+	{
+		std::unique_ptr<wallet2::wallet_rpc_scan_data> pull_res;
+		stage_clock::time_point start = stage_clock::now();
+		while(rctx.m_parse_queue.pop(pull_res))
+		{
+			stats.wait_in_us += usec_since(start);
 
-			found = m_subaddresses.find(subaddress_spendkey);
-			if(found != m_subaddresses.end())
+			if(rctx.m_scan_error || !m_run.load(std::memory_order_relaxed))
 			{
-				if(!spend_unknown)
-				{
-					cryptonote::keypair eph;
-					crypto::key_image ki;
-					bool r = cryptonote::generate_key_image_helper_precomp(keys, out_pubkey, additional_derivations[out_idx], out_idx, found->second, eph, ki, dummy_dev);
-					THROW_WALLET_EXCEPTION_IF(!r, error::wallet_internal_error, "Failed to generate key image");
-					THROW_WALLET_EXCEPTION_IF(eph.pub != out_pubkey,
-										error::wallet_internal_error, "key_image generated ephemeral public key not matched with output_key");
-					THROW_WALLET_EXCEPTION_IF(!inc_kimg.insert(ki).second, error::wallet_internal_error, "Duplicate key image");
-				}
-				ret = true;
-				continue;
+				GULPS_LOG_L1("block_parse_thd exits due to m_scan_error.");
+				break;
 			}
+
+			GULPSF_LOG_L1("Parsing blocks {} - {}", pull_res->blocks_start_height, pull_res->blocks_start_height+pull_res->blocks_bin.size()-1);
+			start = stage_clock::now();
+
+			THROW_WALLET_EXCEPTION_IF(pull_res->blocks_bin.size() != pull_res->o_indices.size(), error::wallet_internal_error, "size mismatch");
+
+			pull_res->blocks_parsed.resize(pull_res->blocks_bin.size());
+			size_t in_count = block_parse_range(*pull_res, ctx.filter, 0, pull_res->blocks_bin.size());
+			block_parse_key_images(*pull_res, in_count);
+			stats.busy_us += usec_since(start);
+			stats.items++;
+
+			start = stage_clock::now();
+			rctx.m_scan_in_queue.push(std::move(pull_res));
+			stats.wait_out_us += usec_since(start);
+			rctx.m_stats[RefreshStageScan].update_peak(rctx.m_scan_in_queue.size());
+			start = stage_clock::now();
 		}
 	}
+	catch(std::exception& e)
+	{
+		rctx.m_scan_error = true;
+		m_run = false;
+		GULPSF_LOG_ERROR("Blocks parsing thread exception: {}", e.what());
+	}
 
-	return ret;
+	if(rctx.m_running_parse_thd_cnt.fetch_sub(1)-1 == 0)
+	{
+		GULPS_LOG_L1("Blocks parsing threads complete");
+		rctx.m_scan_in_queue.set_finish_flag();
+	}
 }
 
 void wallet2::block_scan_thd(const wallet_scan_ctx& ctx)
 {
+	wallet_refresh_ctx& rctx = ctx.refresh_ctx;
+	refresh_stage_counters& stats = rctx.m_stats[RefreshStageScan];
 	try
 	{
-		std::unique_lock<std::mutex> lck = ctx.refresh_ctx.m_scan_in_queue.get_lock();
-		while(ctx.refresh_ctx.m_scan_in_queue.wait_for_pop(lck))
+		block_scan_batch batch;
+		std::unique_ptr<wallet2::wallet_rpc_scan_data> pull_res;
+		stage_clock::time_point start = stage_clock::now();
+		while(rctx.m_scan_in_queue.pop(pull_res))
 		{
-			std::unique_ptr<wallet2::wallet_rpc_scan_data> pull_res = ctx.refresh_ctx.m_scan_in_queue.pop(lck);
+			stats.wait_in_us += usec_since(start);
 
 			GULPSF_LOG_L1("Scanning blocks {} - {}", pull_res->blocks_start_height, pull_res->blocks_start_height+pull_res->blocks_bin.size()-1);
 
-			if(ctx.refresh_ctx.m_scan_error)
+			if(rctx.m_scan_error || !m_run.load(std::memory_order_relaxed))
 			{
 				GULPS_LOG_L1("block_scan_thd exits due to m_scan_error.");
 				break;
 			}
 
-			THROW_WALLET_EXCEPTION_IF(pull_res->blocks_bin.size() != pull_res->o_indices.size(), error::wallet_internal_error, "size mismatch");
+			start = stage_clock::now();
+			block_scan_chunk(ctx, *pull_res, batch, pull_res->result);
+			stats.busy_us += usec_since(start);
+			stats.items++;
 
-			size_t blk_i=0;
-			size_t in_count = 0;
-			pull_res->blocks_parsed.resize(pull_res->blocks_bin.size());
-			for(const cryptonote::block_complete_entry_v& bl : pull_res->blocks_bin)
-			{
-				wallet_rpc_scan_data::block_complete_entry_parsed& blke = pull_res->blocks_parsed[blk_i];
-				const cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices& blk_o_idx = pull_res->o_indices[blk_i];
-				blke.block_height = pull_res->blocks_start_height + blk_i;
-
-				bool r = cryptonote::parse_and_validate_block_from_blob(bl.block, blke.block);
-				THROW_WALLET_EXCEPTION_IF(!r, error::block_parse_error, bl.block);
-				blke.block_hash = get_block_hash(blke.block);
-				THROW_WALLET_EXCEPTION_IF(bl.txs.size() + 1 != blk_o_idx.indices.size(), error::wallet_internal_error,
-					"block transactions=" + std::to_string(bl.txs.size()) + " not match with daemon response size=" +
-					std::to_string(blk_o_idx.indices.size()) + " for block " + std::to_string(blke.block_height));
-				THROW_WALLET_EXCEPTION_IF(bl.txs.size() != blke.block.tx_hashes.size(), error::wallet_internal_error,
-										  "Wrong amount of transactions for block");
-
-				blk_i++;
-				if(!ctx.explicit_refresh && (blke.block.timestamp + 60 * 60 * 24 <= ctx.wallet_create_time || blke.block_height  < ctx.refresh_height))
+			start = stage_clock::now();
+			rctx.m_scan_out_queue.push(std::move(pull_res));
+			stats.wait_out_us += usec_since(start);
+			rctx.m_stats[RefreshStageApply].update_peak(rctx.m_scan_out_queue.size());
+			start = stage_clock::now();
+		}
+	}
+	catch(std::exception& e)
+	{
+		rctx.m_scan_error = true;
+		m_run = false;
+		GULPSF_LOG_ERROR("Blocks scanning thread exception: {}", e.what());
+	}
+
+	if(rctx.m_running_scan_thd_cnt.fetch_sub(1)-1 == 0)
+	{
+		GULPS_LOG_L1("Blocks scanning threads complete");
+		rctx.m_scan_out_queue.set_finish_flag();
+	}
+	else
+	{
+		size_t left = rctx.m_running_scan_thd_cnt;
+		bool error = rctx.m_scan_error;
+		GULPSF_LOG_L1("block_scan_thd exits {} left, m_scan_error state", left, error);
+	}
+}
+
+void wallet2::refresh_shared(const std::vector<wallet2*>& wallets)
+{
+	if(wallets.empty())
+		return;
+
+	if(wallets.size() == 1)
+	{
+		wallets.front()->refresh();
+		return;
+	}
+
+	struct member
+	{
+		member(wallet2* w, wallet_refresh_ctx& rctx) : w(w), ctx(*w, rctx), failed(false) {}
+
+		wallet2* w;
+		wallet_scan_ctx ctx;
+		block_scan_batch batch;
+		std::list<crypto::hash> short_chain_history;
+		uint64_t entry_height;
+		bool failed;
+	};
+
+	tools::threadpool& tpool = tools::threadpool::getInstance();
+	size_t thd_max = std::min<size_t>(tools::get_max_concurrency(), 8);
+
+	refresh_stage_counters stats[RefreshStageCount];
+	wallet_refresh_ctx rctx(stats, 2, 1, 1);
+	stats[RefreshStageDownload].begin(1, 0);
+	stats[RefreshStageParse].begin(thd_max, 2);
+
+	std::vector<std::unique_ptr<member>> members;
+	members.reserve(wallets.size());
+	member* lead = nullptr;
+	for(wallet2* w : wallets)
+	{
+		members.emplace_back(new member(w, rctx));
+		member& m = *members.back();
+		m.entry_height = w->m_local_bc_height;
+		uint64_t start_height = 0;
+		try
+		{
+			m.failed = !w->refresh_begin(start_height, m.short_chain_history);
+		}
+		catch(const std::exception& e)
+		{
+			GULPSF_LOG_ERROR("Shared refresh failed to start a wallet: {}", e.what());
+			m.failed = true;
+		}
+
+		// The least synced wallet drives the download, the others catch up as it passes them
+		if(!m.failed && (lead == nullptr || w->m_blockchain.size() < lead->w->m_blockchain.size()))
+			lead = &m;
+	}
+
+	if(lead == nullptr)
+		return;
+
+	block_skip_filter filter(*lead->w);
+	for(const std::unique_ptr<member>& m : members)
+	{
+		if(!m->failed)
+			filter.merge(m->ctx.filter);
+	}
+
+	wallet_block_dl_ctx dl_ctx(rctx);
+	dl_ctx.short_chain_history = std::move(lead->short_chain_history);
+	dl_ctx.start_height = 0;
+	dl_ctx.thd = std::thread(&wallet2::block_download_thd, lead->w, std::ref(dl_ctx));
+
+	GULPSF_LOG_L1("Refreshing {} wallets from one download", members.size());
+
+	std::unique_ptr<wallet_rpc_scan_data> chunk;
+	bool stopped = false;
+	bool parse_failed = false;
+	stage_clock::time_point start = stage_clock::now();
+	while(rctx.m_parse_queue.pop(chunk))
+	{
+		stats[RefreshStageParse].wait_in_us += usec_since(start);
+		start = stage_clock::now();
+
+		// Parse once, split across the pool
+		std::atomic<size_t> in_count(0);
+		std::atomic<bool> parse_error(false);
+		size_t blocks = chunk->blocks_bin.size();
+		size_t per_task = (blocks + thd_max - 1) / thd_max;
+		if(blocks != chunk->o_indices.size())
+		{
+			GULPS_LOG_ERROR("Shared refresh got mismatched blocks and output indices");
+			stopped = parse_failed = true;
+			break;
+		}
+		chunk->blocks_parsed.resize(blocks);
+		tools::threadpool::waiter parse_waiter;
+		for(size_t begin = 0; begin < blocks; begin += per_task)
+		{
+			size_t end = std::min(begin + per_task, blocks);
+			wallet_rpc_scan_data* data = chunk.get();
+			tpool.submit(&parse_waiter, [data, &filter, begin, end, &in_count, &parse_error]() {
+				try
 				{
-					if(blke.block_height % 100 == 0)
-						GULPS_LOG_L2("Skipped block by timestamp, height: ", blke.block_height, ", block time ",
-									 blke.block.timestamp, ", account time ", ctx.wallet_create_time);
-					blke.skipped = true;
-					continue;
+					in_count += block_parse_range(*data, filter, begin, end);
 				}
-				blke.skipped = false;
-
-				blke.miner_tx_hash = cryptonote::get_transaction_hash(blke.block.miner_tx);
-				size_t tx_i =0;
-				blke.txes.resize(bl.txs.size());
-				for(const cryptonote::blobdata& tx_blob : bl.txs)
+				catch(const std::exception& e)
 				{
-					cryptonote::transaction& tx = blke.txes[tx_i];
-					bool r = parse_and_validate_tx_base_from_blob(tx_blob, tx);
-					THROW_WALLET_EXCEPTION_IF(!r, error::tx_parse_error, tx_blob);
-					in_count += tx.vin.size();
-					tx_i++;
+					GULPSF_LOG_ERROR("Shared refresh parse exception: {}", e.what());
+					parse_error = true;
 				}
-			}
+			});
+		}
+		parse_waiter.wait();
+		if(parse_error)
+		{
+			stopped = parse_failed = true;
+			break;
+		}
+		block_parse_key_images(*chunk, in_count);
+		stats[RefreshStageParse].busy_us += usec_since(start);
+		stats[RefreshStageParse].items++;
+
+		// Fan out the view key scans, each wallet applies what it found right away
+		const wallet_rpc_scan_data::block_complete_entry_parsed& top = chunk->blocks_parsed.back();
+		const wallet_rpc_scan_data* data = chunk.get();
+		tools::threadpool::waiter scan_waiter;
+		size_t active = 0;
+		for(const std::unique_ptr<member>& mp : members)
+		{
+			member* m = mp.get();
+			if(m->failed || !m->w->m_run.load(std::memory_order_relaxed))
+				continue;
 
-			pull_res->key_images.init(in_count);
-			for(size_t i=0; i < blk_i; i++)
-			{
-				wallet_rpc_scan_data::block_complete_entry_parsed& blke = pull_res->blocks_parsed[i];
+			active++;
 
-				if(blke.skipped)
-					continue;
+			// Already past this chunk, the hash chain being the same up to its top
+			const hashchain& bc = m->w->m_blockchain;
+			if(top.block_height < bc.offset() || (top.block_height < bc.size() && bc[top.block_height] == top.block_hash))
+				continue;
 
-				if(ctx.scan_type != RefreshNoCoinbase)
+			tpool.submit(&scan_waiter, [m, data]() {
+				try
 				{
-					if(block_scan_tx(ctx, blke.miner_tx_hash, blke.block.miner_tx, pull_res->key_images, pull_res->incoming_kimg))
-						pull_res->indices_found.emplace_back(i, 0);
+					wallet_rpc_scan_data::scan_result res;
+					m->w->block_scan_chunk(m->ctx, *data, m->batch, res);
+					m->w->integrate_scanned_result(*data, res);
 				}
-
-				for(size_t txi=0; txi < blke.txes.size(); txi++)
+				catch(const std::exception& e)
 				{
-					if(block_scan_tx(ctx, blke.block.tx_hashes[txi], blke.txes[txi], pull_res->key_images, pull_res->incoming_kimg))
-						pull_res->indices_found.emplace_back(i, txi+1);
+					GULPSF_LOG_ERROR("Shared refresh scan exception: {}", e.what());
+					m->failed = true;
 				}
-			}
+			});
+		}
+		scan_waiter.wait();
 
-			ctx.refresh_ctx.m_scan_out_queue.push(std::move(pull_res));
+		// Nobody left to download for
+		if(active == 0)
+		{
+			stopped = true;
+			break;
 		}
+		start = stage_clock::now();
 	}
-	catch(std::exception& e)
+
+	// Stop the download thread if we stopped early, otherwise it has finished already
+	if(stopped)
+		rctx.m_stop = true;
+	rctx.m_parse_queue.set_finish_flag();
+	dl_ctx.thd.join();
+
+	// The chain past the chunk that failed to parse is still to be scanned
+	if(parse_failed)
 	{
-		ctx.refresh_ctx.m_scan_error = true;
-		m_run = false;
-		GULPSF_LOG_ERROR("Blocks scanning thread exception: {}", e.what());
+		for(const std::unique_ptr<member>& m : members)
+			m->failed = true;
 	}
 
-	if(ctx.refresh_ctx.m_running_scan_thd_cnt.fetch_sub(1)-1 == 0)
+	tools::threadpool::waiter pool_waiter;
+	for(const std::unique_ptr<member>& mp : members)
 	{
-		GULPS_LOG_L1("Blocks scanning threads complete");
-		ctx.refresh_ctx.m_scan_out_queue.set_finish_flag();
+		member* m = mp.get();
+		if(m->failed)
+			continue;
+
+		bool refreshed = dl_ctx.refreshed;
+		tpool.submit(&pool_waiter, [m, refreshed]() {
+			try
+			{
+				if(m->w->m_run.load(std::memory_order_relaxed))
+					m->w->update_pool_state(refreshed);
+			}
+			catch(...)
+			{
+				GULPS_LOG_L1("Failed to check pending transactions");
+			}
+		});
 	}
-	else
+	pool_waiter.wait();
+
+	// Wallets the shared pass couldn't bring up to date, say from a chain of their own, refresh on their own
+	for(const std::unique_ptr<member>& m : members)
 	{
-		size_t left = ctx.refresh_ctx.m_running_scan_thd_cnt;
-		bool error = ctx.refresh_ctx.m_scan_error;
-		GULPSF_LOG_L1("block_scan_thd exits {} left, m_scan_error state", left, error);
+		if(m->failed && m->w->m_run.load(std::memory_order_relaxed))
+		{
+			try
+			{
+				m->w->refresh();
+			}
+			catch(const std::exception& e)
+			{
+				GULPSF_LOG_ERROR("Wallet refresh failed: {}", e.what());
+			}
+		}
+		else if(!m->failed)
+		{
+			GULPS_LOG_L1("Refresh done, blocks received: ", m->w->m_local_bc_height - std::min<uint64_t>(m->entry_height, m->w->m_local_bc_height));
+		}
 	}
 }
 }
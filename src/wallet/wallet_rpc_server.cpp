@@ -78,6 +78,7 @@ const command_line::arg_descriptor<bool> arg_disable_rpc_login = {"disable-rpc-l
 const command_line::arg_descriptor<bool> arg_trusted_daemon = {"trusted-daemon", "Enable commands which rely on a trusted daemon", false};
 const command_line::arg_descriptor<std::string> arg_wallet_dir = {"wallet-dir", "Directory for newly created wallets"};
 const command_line::arg_descriptor<bool> arg_prompt_for_password = {"prompt-for-password", "Prompts for password when not provided", false};
+const command_line::arg_descriptor<bool> arg_multi_wallet = {"multi-wallet", "Keep every wallet opened in --wallet-dir, each served at /wallet/<filename>/json_rpc, and refresh them from one block download", false};
 
 constexpr const char default_rpc_username[] = "ryo";
 
@@ -101,7 +102,7 @@ const char *wallet_rpc_server::tr(const char *str)
 }
 
 //------------------------------------------------------------------------------------------------------------------------------
-wallet_rpc_server::wallet_rpc_server(cryptonote::network_type nettype) : m_wallet(nullptr), rpc_login_file(), m_stop(false), m_trusted_daemon(false), m_vm(NULL), m_nettype(nettype)
+wallet_rpc_server::wallet_rpc_server(cryptonote::network_type nettype) : m_wallet(nullptr), m_multi_wallet(false), rpc_login_file(), m_stop(false), m_trusted_daemon(false), m_vm(NULL), m_nettype(nettype)
 {
 }
 //------------------------------------------------------------------------------------------------------------------------------
@@ -116,8 +117,7 @@ bool wallet_rpc_server::run()
 	m_net_server.add_idle_handler([this]() {
 		try
 		{
-			if(m_wallet)
-				m_wallet->refresh();
+			refresh_wallets();
 		}
 		catch(const std::exception &ex)
 		{
@@ -161,6 +161,7 @@ bool wallet_rpc_server::init(const boost::program_options::variables_map *vm)
 	std::string bind_port = command_line::get_arg(*m_vm, arg_rpc_bind_port);
 	const bool disable_auth = command_line::get_arg(*m_vm, arg_disable_rpc_login);
 	m_trusted_daemon = command_line::get_arg(*m_vm, arg_trusted_daemon);
+	m_multi_wallet = command_line::get_arg(*m_vm, arg_multi_wallet);
 	if(!command_line::has_arg(*m_vm, arg_trusted_daemon))
 	{
 		if(tools::is_local_address(walvars->get_daemon_address()))
@@ -188,6 +189,12 @@ bool wallet_rpc_server::init(const boost::program_options::variables_map *vm)
 		}
 	}
 
+	if(m_multi_wallet && (m_wallet_dir.empty() || m_wallet))
+	{
+		GULPSF_ERROR(tr("--{} needs --{} and no wallet loaded at startup"), arg_multi_wallet.name, arg_wallet_dir.name);
+		return false;
+	}
+
 	if(disable_auth)
 	{
 		if(rpc_config->login)
@@ -240,6 +247,78 @@ bool wallet_rpc_server::init(const boost::program_options::variables_map *vm)
 		rng, std::move(bind_port), std::move(rpc_config->bind_ip), std::move(rpc_config->access_control_origins), std::move(http_login));
 }
 //------------------------------------------------------------------------------------------------------------------------------
+bool wallet_rpc_server::handle_http_request(const epee::net_utils::http::http_request_info &query_info, epee::net_utils::http::http_response_info &response, connection_context &m_conn_context)
+{
+	GULPSF_LOG_L2("HTTP [{}] {} {}", m_conn_context.m_remote_address.host_str(), query_info.m_http_method_str, query_info.m_URI);
+	response.m_response_code = 200;
+	response.m_response_comment = "Ok";
+
+	bool handled = false;
+	static const std::string wallet_prefix = "/wallet/";
+	static const std::string json_rpc_suffix = "/json_rpc";
+	const std::string &uri = query_info.m_URI;
+	if(m_multi_wallet && uri.size() > wallet_prefix.size() + json_rpc_suffix.size() &&
+		uri.compare(0, wallet_prefix.size(), wallet_prefix) == 0 &&
+		uri.compare(uri.size() - json_rpc_suffix.size(), json_rpc_suffix.size(), json_rpc_suffix) == 0)
+	{
+		std::string name = uri.substr(wallet_prefix.size(), uri.size() - wallet_prefix.size() - json_rpc_suffix.size());
+		auto it = m_wallets.find(name);
+		if(it != m_wallets.end())
+		{
+			// The server runs a single thread, so the handlers can be pointed at the wallet for this request
+			epee::net_utils::http::http_request_info wallet_query = query_info;
+			wallet_query.m_URI = json_rpc_suffix;
+			m_wallet = it->second.get();
+			m_wallet_name = std::move(name);
+			try
+			{
+				handled = handle_http_request_map(wallet_query, response, m_conn_context);
+			}
+			catch(...)
+			{
+				m_wallet = nullptr;
+				throw;
+			}
+			m_wallet = nullptr;
+		}
+	}
+	else
+	{
+		handled = handle_http_request_map(query_info, response, m_conn_context);
+	}
+
+	if(!handled)
+	{
+		response.m_response_code = 404;
+		response.m_response_comment = "Not found";
+	}
+	return true;
+}
+//------------------------------------------------------------------------------------------------------------------------------
+void wallet_rpc_server::refresh_wallets()
+{
+	if(!m_multi_wallet)
+	{
+		if(m_wallet)
+			m_wallet->refresh();
+		return;
+	}
+
+	std::vector<wallet2 *> wallets;
+	wallets.reserve(m_wallets.size());
+	for(auto &w : m_wallets)
+		wallets.push_back(w.second.get());
+	wallet2::refresh_shared(wallets);
+}
+//------------------------------------------------------------------------------------------------------------------------------
+void wallet_rpc_server::host_wallet_backend(const std::string &name, std::unique_ptr<wallet2> &&wal)
+{
+	if(m_multi_wallet)
+		m_wallets[name] = std::move(wal);
+	else
+		start_wallet_backend(std::move(wal));
+}
+//------------------------------------------------------------------------------------------------------------------------------
 bool wallet_rpc_server::not_open(epee::json_rpc::error &er)
 {
 	er.code = WALLET_RPC_ERROR_CODE_NOT_OPEN;
@@ -586,6 +665,36 @@ bool wallet_rpc_server::on_getheight(const wallet_rpc::COMMAND_RPC_GET_HEIGHT::r
 	return true;
 }
 //------------------------------------------------------------------------------------------------------------------------------
+bool wallet_rpc_server::on_get_refresh_stats(const wallet_rpc::COMMAND_RPC_GET_REFRESH_STATS::request &req, wallet_rpc::COMMAND_RPC_GET_REFRESH_STATS::response &res, epee::json_rpc::error &er)
+{
+	if(!m_wallet)
+		return not_open(er);
+	try
+	{
+		std::vector<tools::wallet2::refresh_stage_stats> stats = m_wallet->get_refresh_stats();
+		for(const tools::wallet2::refresh_stage_stats &st : stats)
+		{
+			wallet_rpc::COMMAND_RPC_GET_REFRESH_STATS::stage stage;
+			stage.name = st.name;
+			stage.threads = st.threads;
+			stage.queue_depth = st.queue_depth;
+			stage.queue_peak = st.queue_peak;
+			stage.items = st.items;
+			stage.busy_us = st.busy_us;
+			stage.wait_in_us = st.wait_in_us;
+			stage.wait_out_us = st.wait_out_us;
+			stage.occupancy = st.capacity_us != 0 ? std::min<uint64_t>(100, st.busy_us * 100 / st.capacity_us) : 0;
+			res.stages.push_back(std::move(stage));
+		}
+	}
+	catch(const std::exception &e)
+	{
+		handle_rpc_exception(std::current_exception(), er, WALLET_RPC_ERROR_CODE_UNKNOWN_ERROR);
+		return false;
+	}
+	return true;
+}
+//------------------------------------------------------------------------------------------------------------------------------
 bool wallet_rpc_server::validate_transfer(const std::list<wallet_rpc::transfer_destination> &destinations, const std::string &s_payment_id, std::vector<cryptonote::tx_destination_entry> &dsts,  crypto::uniform_payment_id& payment_id, bool at_least_one_destination, epee::json_rpc::error &er)
 {
 	payment_id.zero = (-1); // lack of id
@@ -2249,6 +2358,13 @@ bool wallet_rpc_server::wallet_path_helper(const std::string& filename, epee::js
 		return false;
 	}
 
+	if(m_multi_wallet && m_wallets.find(filename) != m_wallets.end())
+	{
+		er.code = WALLET_RPC_ERROR_CODE_WALLET_ALREADY_EXISTS;
+		er.message = "Wallet is already open";
+		return false;
+	}
+
 	return true;
 }
 //------------------------------------------------------------------------------------------------------------------------------
@@ -2304,7 +2420,7 @@ bool wallet_rpc_server::on_create_wallet(const wallet_rpc::COMMAND_RPC_CREATE_WA
 			return false;
 		}
 
-		start_wallet_backend(std::move(wal));
+		host_wallet_backend(req.filename, std::move(wal));
 	}
 	catch(const std::exception &e)
 	{
@@ -2350,7 +2466,7 @@ bool wallet_rpc_server::on_restore_view_wallet(const wallet_rpc::COMMAND_RPC_RES
 	try
 	{
 		wallet->generate(wallet_file, req.password, info.address, viewkey, false);
-		start_wallet_backend(std::move(wallet));
+		host_wallet_backend(req.filename, std::move(wallet));
 	}
 	catch(const std::exception &e)
 	{
@@ -2423,7 +2539,7 @@ bool wallet_rpc_server::on_restore_wallet(const wallet_rpc::COMMAND_RPC_RESTORE_
 			wallet->generate_new(wallet_file, req.password, seed_extra, &seed_14, false);
 		else
 			wallet->generate_legacy(wallet_file, req.password, seed_25, false);
-		start_wallet_backend(std::move(wallet));
+		host_wallet_backend(req.filename, std::move(wallet));
 	}
 	catch(const std::exception &e)
 	{
@@ -2452,7 +2568,7 @@ bool wallet_rpc_server::on_open_wallet(const wallet_rpc::COMMAND_RPC_OPEN_WALLET
 			return false;
 		}
 
-		start_wallet_backend(std::move(wal));
+		host_wallet_backend(req.filename, std::move(wal));
 	}
 	catch(const std::exception &e)
 	{
@@ -2473,7 +2589,14 @@ bool wallet_rpc_server::on_close_wallet(const wallet_rpc::COMMAND_RPC_CLOSE_WALL
 
 	try
 	{
-		stop_wallet_backend();
+		if(m_multi_wallet)
+		{
+			m_wallet->store();
+			m_wallet = nullptr;
+			m_wallets.erase(m_wallet_name);
+		}
+		else
+			stop_wallet_backend();
 	}
 	catch(const std::exception &e)
 	{
@@ -3041,11 +3164,12 @@ int main(int argc, char **argv)
 	command_line::add_arg(desc_params, arg_from_json);
 	command_line::add_arg(desc_params, arg_wallet_dir);
 	command_line::add_arg(desc_params, arg_prompt_for_password);
+	command_line::add_arg(desc_params, arg_multi_wallet);
 
 	int vm_error_code = 1;
 	const auto vm = wallet_args::main(
 		argc, argv,
-		"ryo-wallet-rpc [--wallet-file=<file>|--generate-from-json=<file>|--wallet-dir=<directory>] [--rpc-bind-port=<port>]",
+		"ryo-wallet-rpc [--wallet-file=<file>|--generate-from-json=<file>|--wallet-dir=<directory> [--multi-wallet]] [--rpc-bind-port=<port>]",
 		tools::wallet_rpc_server::tr("This is the RPC ryo wallet. It needs to connect to a ryo daemon to work correctly."),
 		desc_params,
 		po::positional_options_description(),
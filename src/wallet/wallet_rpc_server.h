@@ -55,6 +55,8 @@
 #include "cryptonote_config.h"
 #include <boost/program_options/options_description.hpp>
 #include <boost/program_options/variables_map.hpp>
+#include <map>
+#include <memory>
 #include <string>
 
 namespace tools
@@ -78,6 +80,9 @@ class wallet_rpc_server : public epee::http_server_impl_base<wallet_rpc_server>
 
 	inline void stop_wallet_backend()
 	{
+		for(auto &w : m_wallets)
+			w.second->store();
+		m_wallets.clear();
 		if(m_wallet == nullptr) return;
 		m_wallet->store();
 		delete m_wallet;
@@ -91,7 +96,8 @@ class wallet_rpc_server : public epee::http_server_impl_base<wallet_rpc_server>
 	};
 
   private:
-	CHAIN_HTTP_TO_MAP2(connection_context); //forward http requests to uri map
+	// With --multi-wallet, requests to /wallet/<name>/json_rpc are served by that wallet
+	bool handle_http_request(const epee::net_utils::http::http_request_info &query_info, epee::net_utils::http::http_response_info &response, connection_context &m_conn_context);
 
 	BEGIN_URI_MAP2()
 	BEGIN_JSON_RPC_MAP("/json_rpc")
@@ -110,6 +116,7 @@ class wallet_rpc_server : public epee::http_server_impl_base<wallet_rpc_server>
 	MAP_JON_RPC_WE("set_account_tag_description", on_set_account_tag_description, wallet_rpc::COMMAND_RPC_SET_ACCOUNT_TAG_DESCRIPTION)
 	MAP_JON_RPC_WE("get_height", on_getheight, wallet_rpc::COMMAND_RPC_GET_HEIGHT)
 	MAP_JON_RPC_WE("getheight", on_getheight, wallet_rpc::COMMAND_RPC_GET_HEIGHT)
+	MAP_JON_RPC_WE("get_refresh_stats", on_get_refresh_stats, wallet_rpc::COMMAND_RPC_GET_REFRESH_STATS)
 	MAP_JON_RPC_WE("transfer", on_transfer, wallet_rpc::COMMAND_RPC_TRANSFER)
 	MAP_JON_RPC_WE("transfer_split", on_transfer_split, wallet_rpc::COMMAND_RPC_TRANSFER_SPLIT)
 	MAP_JON_RPC_WE("sweep_all", on_sweep_all, wallet_rpc::COMMAND_RPC_SWEEP_ALL)
@@ -181,6 +188,7 @@ class wallet_rpc_server : public epee::http_server_impl_base<wallet_rpc_server>
 	bool on_untag_accounts(const wallet_rpc::COMMAND_RPC_UNTAG_ACCOUNTS::request &req, wallet_rpc::COMMAND_RPC_UNTAG_ACCOUNTS::response &res, epee::json_rpc::error &er);
 	bool on_set_account_tag_description(const wallet_rpc::COMMAND_RPC_SET_ACCOUNT_TAG_DESCRIPTION::request &req, wallet_rpc::COMMAND_RPC_SET_ACCOUNT_TAG_DESCRIPTION::response &res, epee::json_rpc::error &er);
 	bool on_getheight(const wallet_rpc::COMMAND_RPC_GET_HEIGHT::request &req, wallet_rpc::COMMAND_RPC_GET_HEIGHT::response &res, epee::json_rpc::error &er);
+	bool on_get_refresh_stats(const wallet_rpc::COMMAND_RPC_GET_REFRESH_STATS::request &req, wallet_rpc::COMMAND_RPC_GET_REFRESH_STATS::response &res, epee::json_rpc::error &er);
 	bool validate_transfer(const std::list<wallet_rpc::transfer_destination> &destinations, const std::string &s_payment_id, std::vector<cryptonote::tx_destination_entry> &dsts, crypto::uniform_payment_id& payment_id, bool at_least_one_destination, epee::json_rpc::error &er);
 	bool on_transfer(const wallet_rpc::COMMAND_RPC_TRANSFER::request &req, wallet_rpc::COMMAND_RPC_TRANSFER::response &res, epee::json_rpc::error &er);
 	bool on_transfer_split(const wallet_rpc::COMMAND_RPC_TRANSFER_SPLIT::request &req, wallet_rpc::COMMAND_RPC_TRANSFER_SPLIT::response &res, epee::json_rpc::error &er);
@@ -256,8 +264,13 @@ class wallet_rpc_server : public epee::http_server_impl_base<wallet_rpc_server>
 
 	boost::program_options::variables_map wallet_password_helper(const char* rpc_pwd);
 	bool wallet_path_helper(const std::string& filename, epee::json_rpc::error &er);
+	void host_wallet_backend(const std::string& name, std::unique_ptr<wallet2>&& wal);
+	void refresh_wallets();
 
-	wallet2 *m_wallet;
+	wallet2 *m_wallet; // with --multi-wallet, the one the current request is addressed to
+	std::map<std::string, std::unique_ptr<wallet2>> m_wallets; // hosted by name with --multi-wallet
+	std::string m_wallet_name;
+	bool m_multi_wallet;
 	std::string m_wallet_dir;
 	tools::private_file rpc_login_file;
 	std::atomic<bool> m_stop;
@@ -381,6 +381,49 @@ struct COMMAND_RPC_GET_HEIGHT
 	};
 };
 
+// Refresh pipeline stats, totals are summed over every refresh since the wallet was opened
+struct COMMAND_RPC_GET_REFRESH_STATS
+{
+	struct request
+	{
+		BEGIN_KV_SERIALIZE_MAP(request)
+		END_KV_SERIALIZE_MAP()
+	};
+
+	struct stage
+	{
+		std::string name;
+		uint64_t threads;
+		uint64_t queue_depth;
+		uint64_t queue_peak;
+		uint64_t items;
+		uint64_t busy_us;
+		uint64_t wait_in_us;
+		uint64_t wait_out_us;
+		uint64_t occupancy; // percent of thread time spent doing work
+
+		BEGIN_KV_SERIALIZE_MAP(stage)
+		KV_SERIALIZE(name)
+		KV_SERIALIZE(threads)
+		KV_SERIALIZE(queue_depth)
+		KV_SERIALIZE(queue_peak)
+		KV_SERIALIZE(items)
+		KV_SERIALIZE(busy_us)
+		KV_SERIALIZE(wait_in_us)
+		KV_SERIALIZE(wait_out_us)
+		KV_SERIALIZE(occupancy)
+		END_KV_SERIALIZE_MAP()
+	};
+
+	struct response
+	{
+		std::list<stage> stages;
+		BEGIN_KV_SERIALIZE_MAP(response)
+		KV_SERIALIZE(stages)
+		END_KV_SERIALIZE_MAP()
+	};
+};
+
 struct transfer_destination
 {
 	uint64_t amount;
@@ -44,6 +44,28 @@ using namespace std;
 using namespace crypto;
 typedef crypto::hash chash;
 
+// Hashes the input in lane 0 of a four lane hash_multi, while the other lanes get different
+// lengths of it. Those have to agree with a single lane hash or the test throws.
+template <typename cn_hash_t>
+static void cn_pow_hash_multi(const void *data, size_t length, char *hash)
+{
+	cn_hash_t ctx[4];
+	cn_hash_t *pctx[4] = {&ctx[0], &ctx[1], &ctx[2], &ctx[3]};
+	const void *in[4] = {data, data, data, data};
+	size_t len[4] = {length, length / 2, length / 3, length / 4};
+	chash res[4];
+	void *out[4] = {hash, &res[1], &res[2], &res[3]};
+
+	cn_hash_t::template hash_multi<4>(pctx, in, len, out);
+
+	for(size_t i = 1; i < 4; i++)
+	{
+		ctx[0].hash(data, len[i], &res[0]);
+		if(res[0] != res[i])
+			throw ios_base::failure("hash_multi lane mismatch");
+	}
+}
+
 PUSH_WARNINGS
 DISABLE_VS_WARNINGS(4297)
 extern "C" {
@@ -66,6 +88,14 @@ static void cn_pow_hash_heavy(const void *data, size_t length, char *hash)
 	cn_pow_hash_v2 ctx;
 	ctx.hash(data, length, hash);
 }
+static void cn_pow_hash_original_multi(const void *data, size_t length, char *hash)
+{
+	cn_pow_hash_multi<cn_pow_hash_v1>(data, length, hash);
+}
+static void cn_pow_hash_heavy_multi(const void *data, size_t length, char *hash)
+{
+	cn_pow_hash_multi<cn_pow_hash_v2>(data, length, hash);
+}
 static void hash_extra_blake(const void *data, size_t length, char *hash)
 {
 	if(length != 200)
@@ -114,7 +144,9 @@ struct hash_func
 	{"extra-groestl", hash_extra_groestl},
 	{"extra-jh", hash_extra_jh},
 	{"extra-skein", hash_extra_skein},
-	{"pow-heavy", cn_pow_hash_heavy}
+	{"pow-heavy", cn_pow_hash_heavy},
+	{"pow-original-multi", cn_pow_hash_original_multi},
+	{"pow-heavy-multi", cn_pow_hash_heavy_multi}
 };
 
 int main(int argc, char *argv[])
@@ -0,0 +1,164 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <algorithm>
+#include <unordered_set>
+#include <vector>
+
+#include "cryptonote_basic/account.h"
+#include "cryptonote_basic/cryptonote_basic.h"
+#include "cryptonote_basic/cryptonote_basic_impl.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_core/cryptonote_tx_utils.h"
+#include "ringct/rctOps.h"
+
+#include "multi_tx_test_base.h"
+
+// Assembles a block template out of Txes pooled transactions, all of which fit in the
+// block. The uncached variant parses every blob and collects its key images on each
+// call as fill_block_template used to; the cached one walks the size, fee and key images
+// the pool now keeps per transaction. Neither includes the db reads and input checks
+// the old path also repeated, so the real gap is larger.
+template <size_t Txes, bool Cached>
+class test_block_template : public multi_tx_test_base<2>
+{
+  public:
+	static const size_t loop_count = 10;
+	static const size_t tx_count = Txes;
+
+	typedef multi_tx_test_base<2> base_class;
+
+	struct candidate
+	{
+		size_t blob_size;
+		uint64_t fee;
+		std::vector<crypto::key_image> key_images;
+	};
+
+	bool init()
+	{
+		using namespace cryptonote;
+
+		if(!base_class::init())
+			return false;
+
+		account_base alice;
+		alice.generate_new(0);
+		std::vector<tx_destination_entry> destinations;
+		destinations.push_back(tx_destination_entry(m_source_amount - 1, alice.get_keys().m_account_address, false));
+		destinations.push_back(tx_destination_entry(1, alice.get_keys().m_account_address, false));
+
+		crypto::secret_key tx_key;
+		std::vector<crypto::secret_key> additional_tx_keys;
+		std::unordered_map<crypto::public_key, subaddress_index> subaddresses;
+		subaddresses[m_miners[real_source_idx].get_keys().m_account_address.m_spend_public_key] = {0, 0};
+		transaction tx;
+		if(!construct_tx_and_get_tx_key(m_miners[real_source_idx].get_keys(), subaddresses, m_sources, destinations, alice.get_keys().m_account_address, nullptr, tx, 0, tx_key, additional_tx_keys, true, nullptr))
+			return false;
+
+		// every pooled copy spends its own key images
+		m_blobs.resize(tx_count);
+		m_candidates.resize(tx_count);
+		for(size_t i = 0; i < tx_count; ++i)
+		{
+			for(txin_v &in : tx.vin)
+				boost::get<txin_to_key>(in).k_image = rct::rct2ki(rct::skGen());
+			tx.invalidate_hashes();
+			m_blobs[i] = tx_to_blob(tx);
+			m_candidates[i].blob_size = m_blobs[i].size();
+			m_candidates[i].fee = tx.rct_signatures.txnFee;
+			for(const txin_v &in : tx.vin)
+				m_candidates[i].key_images.push_back(boost::get<txin_to_key>(in).k_image);
+			m_median_size += m_blobs[i].size();
+		}
+		m_median_size += CRYPTONOTE_COINBASE_BLOB_RESERVED_SIZE;
+		return true;
+	}
+
+	bool test()
+	{
+		size_t total_size = 0;
+		uint64_t fee = 0;
+		uint64_t best_coinbase = 0;
+		std::unordered_set<crypto::key_image> k_images;
+		std::vector<size_t> tx_indices;
+		cryptonote::get_block_reward(cryptonote::MAINNET, m_median_size, 0, 0, best_coinbase, 1);
+
+		for(size_t i = 0; i < tx_count; ++i)
+		{
+			candidate parsed;
+			const candidate *c = &m_candidates[i];
+			if(!Cached)
+			{
+				cryptonote::transaction tx;
+				if(!cryptonote::parse_and_validate_tx_from_blob(m_blobs[i], tx))
+					return false;
+				parsed.blob_size = m_blobs[i].size();
+				parsed.fee = tx.rct_signatures.txnFee;
+				for(const cryptonote::txin_v &in : tx.vin)
+					parsed.key_images.push_back(boost::get<cryptonote::txin_to_key>(in).k_image);
+				c = &parsed;
+			}
+
+			uint64_t block_reward;
+			if(!cryptonote::get_block_reward(cryptonote::MAINNET, m_median_size, total_size + c->blob_size + CRYPTONOTE_COINBASE_BLOB_RESERVED_SIZE, 0, block_reward, 1))
+				continue;
+			uint64_t coinbase = block_reward + fee + c->fee;
+			if(coinbase < best_coinbase)
+				continue;
+			if(std::any_of(c->key_images.begin(), c->key_images.end(), [&k_images](const crypto::key_image &ki) { return k_images.count(ki) != 0; }))
+				continue;
+
+			tx_indices.push_back(i);
+			total_size += c->blob_size;
+			fee += c->fee;
+			best_coinbase = coinbase;
+			k_images.insert(c->key_images.begin(), c->key_images.end());
+		}
+		return tx_indices.size() == tx_count;
+	}
+
+  private:
+	std::vector<cryptonote::blobdata> m_blobs;
+	std::vector<candidate> m_candidates;
+	size_t m_median_size = 0;
+};
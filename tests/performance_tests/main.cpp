@@ -32,11 +32,13 @@
 
 #include "ringct/multiexp.h"
 #include "common/command_line.h"
+#include "common/threadpool.h"
 #include "common/util.h"
 #include "performance_tests.h"
 #include "performance_utils.h"
 
 // tests
+#include "block_template.h"
 #include "bulletproof.h"
 #include "check_tx_signature.h"
 #include "cn_fast_hash.h"
@@ -54,13 +56,18 @@
 #include "generate_keypair.h"
 #include "is_out_to_acc.h"
 #include "multiexp.h"
+#include "parse_blob.h"
+#include "queue_handoff.h"
 #include "range_proof.h"
+#include "rct_mg_inputs.h"
 #include "rct_mlsag.h"
 #include "rct_mlsag.h"
 #include "sc_check.h"
 #include "sc_reduce32.h"
 #include "signature.h"
 #include "subaddress_expand.h"
+#include "wallet_scan.h"
+#include "wallet_transfer_index.h"
 
 namespace po = boost::program_options;
 
@@ -68,6 +75,8 @@ int main(int argc, char **argv)
 {
 	//GULPS_TRY_ENTRY();
 	tools::on_startup();
+	// Start the pool before pinning the process, so that its workers keep all cores
+	tools::threadpool::getInstance();
 	set_process_affinity(1);
 	set_thread_high_priority();
 
@@ -150,6 +159,35 @@ int main(int argc, char **argv)
 
 	TEST_PERFORMANCE2(filter, p, test_wallet2_expand_subaddresses, 50, 200);
 
+	TEST_PERFORMANCE2(filter, p, test_wallet_scan, 500, false); // 1000 outputs per call
+	TEST_PERFORMANCE2(filter, p, test_wallet_scan, 500, true);
+
+	TEST_PERFORMANCE2(filter, p, test_transfer_index, 1000000, false); // synthetic 1M output wallet
+	TEST_PERFORMANCE2(filter, p, test_transfer_index, 1000000, true);
+
+	TEST_PERFORMANCE2(filter, p, test_block_template, 10000, false); // 10k pooled txes
+	TEST_PERFORMANCE2(filter, p, test_block_template, 10000, true);
+
+	TEST_PERFORMANCE3(filter, p, test_parse_blob, 100, 10, false); // 100 blocks of 10 txes
+	TEST_PERFORMANCE3(filter, p, test_parse_blob, 100, 10, true);
+
+	// 20000 items per call
+	TEST_PERFORMANCE3(filter, p, test_queue_handoff, false, 1, 1);
+	TEST_PERFORMANCE3(filter, p, test_queue_handoff, true, 1, 1);
+	TEST_PERFORMANCE3(filter, p, test_queue_handoff, false, 4, 4);
+	TEST_PERFORMANCE3(filter, p, test_queue_handoff, true, 4, 4);
+	TEST_PERFORMANCE3(filter, p, test_queue_handoff, false, 16, 16);
+	TEST_PERFORMANCE3(filter, p, test_queue_handoff, true, 16, 16);
+	TEST_PERFORMANCE3(filter, p, test_queue_handoff, false, 32, 32);
+	TEST_PERFORMANCE3(filter, p, test_queue_handoff, true, 32, 32);
+	TEST_PERFORMANCE3(filter, p, test_queue_handoff, false, 1, 32);
+	TEST_PERFORMANCE3(filter, p, test_queue_handoff, true, 1, 32);
+	TEST_PERFORMANCE3(filter, p, test_queue_handoff, false, 32, 1);
+	TEST_PERFORMANCE3(filter, p, test_queue_handoff, true, 32, 1);
+	// 10000 round trips per call
+	TEST_PERFORMANCE1(filter, p, test_queue_latency, false);
+	TEST_PERFORMANCE1(filter, p, test_queue_latency, true);
+
 	TEST_PERFORMANCE1(filter, p, test_cn_slow_hash, false);
 	TEST_PERFORMANCE1(filter, p, test_cn_slow_hash, true);
 	TEST_PERFORMANCE1(filter, p, test_cn_fast_hash, 32);
@@ -164,6 +202,10 @@ int main(int argc, char **argv)
 	TEST_PERFORMANCE3(filter, p, test_ringct_mlsag, 1, 10, true);
 	TEST_PERFORMANCE3(filter, p, test_ringct_mlsag, 1, 100, true);
 
+	// 64 input consolidation tx, serial vs threadpool
+	TEST_PERFORMANCE3(filter, p, test_rct_mg_inputs, 64, 11, false);
+	TEST_PERFORMANCE3(filter, p, test_rct_mg_inputs, 64, 11, true);
+
 	TEST_PERFORMANCE2(filter, p, test_equality, memcmp32, true);
 	TEST_PERFORMANCE2(filter, p, test_equality, memcmp32, false);
 	TEST_PERFORMANCE2(filter, p, test_equality, verify32, false);
@@ -0,0 +1,138 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <sstream>
+#include <vector>
+
+#include "cryptonote_basic/account.h"
+#include "cryptonote_basic/cryptonote_basic.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_core/cryptonote_tx_utils.h"
+#include "serialization/binary_span_archive.h"
+
+#include "multi_tx_test_base.h"
+
+// Parses a range of Blocks blocks, each with TxesPerBlock ring size 11 transactions,
+// from their blobs, either through binary_archive over an istringstream as the parse
+// helpers used to or through binary_span_archive straight from the blob.
+template <size_t Blocks, size_t TxesPerBlock, bool Span>
+class test_parse_blob : public multi_tx_test_base<11>
+{
+  public:
+	static const size_t loop_count = 100;
+
+	typedef multi_tx_test_base<11> base_class;
+
+	bool init()
+	{
+		using namespace cryptonote;
+
+		if(!base_class::init())
+			return false;
+
+		account_base alice;
+		alice.generate_new(0);
+		std::vector<tx_destination_entry> destinations;
+		destinations.push_back(tx_destination_entry(m_source_amount - 1, alice.get_keys().m_account_address, false));
+		destinations.push_back(tx_destination_entry(1, alice.get_keys().m_account_address, false));
+
+		crypto::secret_key tx_key;
+		std::vector<crypto::secret_key> additional_tx_keys;
+		std::unordered_map<crypto::public_key, subaddress_index> subaddresses;
+		subaddresses[m_miners[real_source_idx].get_keys().m_account_address.m_spend_public_key] = {0, 0};
+		transaction tx;
+		if(!construct_tx_and_get_tx_key(m_miners[real_source_idx].get_keys(), subaddresses, m_sources, destinations, alice.get_keys().m_account_address, nullptr, tx, 0, tx_key, additional_tx_keys, true, nullptr))
+			return false;
+		const blobdata tx_blob = tx_to_blob(tx);
+
+		for(size_t i = 0; i < Blocks; ++i)
+		{
+			block b;
+			b.major_version = 1;
+			b.minor_version = 1;
+			b.timestamp = i;
+			b.miner_tx = m_miner_txs[i % ring_size];
+			for(size_t j = 0; j < TxesPerBlock; ++j)
+			{
+				b.tx_hashes.push_back(crypto::rand<crypto::hash>());
+				m_tx_blobs.push_back(tx_blob);
+			}
+			m_block_blobs.push_back(block_to_blob(b));
+		}
+		return true;
+	}
+
+	bool test()
+	{
+		for(const cryptonote::blobdata &blob : m_block_blobs)
+		{
+			cryptonote::block b;
+			if(!parse(blob, b))
+				return false;
+		}
+		for(const cryptonote::blobdata &blob : m_tx_blobs)
+		{
+			cryptonote::transaction tx;
+			if(!parse(blob, tx))
+				return false;
+		}
+		return true;
+	}
+
+  private:
+	template <class T>
+	static bool parse(const cryptonote::blobdata &blob, T &v)
+	{
+		if(Span)
+		{
+			binary_span_archive<false> ba(blob);
+			return ::serialization::serialize(ba, v);
+		}
+		std::stringstream ss;
+		ss << blob;
+		binary_archive<false> ba(ss);
+		return ::serialization::serialize(ba, v);
+	}
+
+	std::vector<cryptonote::blobdata> m_block_blobs;
+	std::vector<cryptonote::blobdata> m_tx_blobs;
+};
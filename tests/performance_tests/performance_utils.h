@@ -60,6 +60,27 @@ void set_process_affinity(int core)
 #endif
 }
 
+// Threads inherit the affinity of main(), multi-threaded tests use this to spread out again
+void set_thread_affinity_any()
+{
+#if defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__DragonFly__) || defined(__sun)
+	return;
+#elif defined(BOOST_WINDOWS)
+	DWORD_PTR process_mask, system_mask;
+	if(::GetProcessAffinityMask(::GetCurrentProcess(), &process_mask, &system_mask))
+		::SetThreadAffinityMask(::GetCurrentThread(), system_mask);
+#elif defined(BOOST_HAS_PTHREADS)
+	cpu_set_t cpuset;
+	CPU_ZERO(&cpuset);
+	for(int i = 0; i < CPU_SETSIZE; ++i)
+		CPU_SET(i, &cpuset);
+	if(0 != ::pthread_setaffinity_np(::pthread_self(), sizeof(cpuset), &cpuset))
+	{
+		std::cout << "pthread_setaffinity_np - ERROR" << std::endl;
+	}
+#endif
+}
+
 void set_thread_high_priority()
 {
 #if defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__DragonFly__) || defined(__sun)
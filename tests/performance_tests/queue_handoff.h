@@ -0,0 +1,172 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "common/mpmc_queue.hpp"
+#include "common/thdq.hpp"
+#include "performance_utils.h"
+
+// thdq bounded the way the wallet refresh threads used it, by waiting for the size first
+template <typename T>
+class bounded_thdq
+{
+  public:
+	bounded_thdq(size_t capacity) : m_capacity(capacity) {}
+
+	bool push(T &&item)
+	{
+		m_queue.wait_for_size(m_capacity - 1);
+		m_queue.push(std::move(item));
+		return true;
+	}
+
+	bool pop(T &item) { return m_queue.pop(item); }
+	void set_finish_flag() { m_queue.set_finish_flag(); }
+
+  private:
+	thdq<T> m_queue;
+	size_t m_capacity;
+};
+
+// Moves a fixed number of heap allocated items from Producers to Consumers threads
+// through a queue of 64 slots, either a bounded thdq or an mpmc_queue.
+template <bool Mpmc, size_t Producers, size_t Consumers>
+class test_queue_handoff
+{
+  public:
+	static const size_t loop_count = 10;
+	static const size_t items = 20000;
+	static const size_t capacity = 64;
+
+	typedef std::unique_ptr<uint64_t> item_t;
+	typedef typename std::conditional<Mpmc, mpmc_queue<item_t>, bounded_thdq<item_t>>::type queue_t;
+
+	bool init()
+	{
+		return true;
+	}
+
+	bool test()
+	{
+		queue_t queue(capacity);
+		std::atomic<size_t> producers_left(Producers);
+		std::atomic<uint64_t> sum(0);
+		std::vector<std::thread> thds;
+		thds.reserve(Producers + Consumers);
+
+		for(size_t p = 0; p < Producers; p++)
+		{
+			thds.emplace_back([&, p] {
+				set_thread_affinity_any();
+				for(uint64_t i = p; i < items; i += Producers)
+					queue.push(item_t(new uint64_t(i)));
+				if(producers_left.fetch_sub(1) == 1)
+					queue.set_finish_flag();
+			});
+		}
+
+		for(size_t c = 0; c < Consumers; c++)
+		{
+			thds.emplace_back([&] {
+				set_thread_affinity_any();
+				uint64_t local = 0;
+				item_t item;
+				while(queue.pop(item))
+					local += *item;
+				sum += local;
+			});
+		}
+
+		for(std::thread &t : thds)
+			t.join();
+
+		return sum == uint64_t(items) * (items - 1) / 2;
+	}
+};
+
+// Round trip of a single item between two threads over a pair of queues, time per call
+// divided by round_trips gives the handoff latency.
+template <bool Mpmc>
+class test_queue_latency
+{
+  public:
+	static const size_t loop_count = 10;
+	static const size_t round_trips = 10000;
+
+	typedef std::unique_ptr<uint64_t> item_t;
+	typedef typename std::conditional<Mpmc, mpmc_queue<item_t>, bounded_thdq<item_t>>::type queue_t;
+
+	bool init()
+	{
+		return true;
+	}
+
+	bool test()
+	{
+		queue_t ping(1);
+		queue_t pong(1);
+
+		std::thread echo([&] {
+			set_thread_affinity_any();
+			item_t item;
+			while(ping.pop(item))
+				pong.push(std::move(item));
+			pong.set_finish_flag();
+		});
+
+		item_t item(new uint64_t(0));
+		bool ok = true;
+		for(size_t i = 0; i < round_trips && ok; i++)
+		{
+			++*item;
+			ping.push(std::move(item));
+			ok = pong.pop(item) && *item == i + 1;
+		}
+		ping.set_finish_flag();
+		echo.join();
+		return ok;
+	}
+};
@@ -0,0 +1,117 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <vector>
+
+#include "device/device.hpp"
+#include "ringct/rctSigs.h"
+
+// Verifies the MGs of a simple rct tx with Inputs inputs, as check_tx_inputs does for a
+// consolidation tx. Parallel goes through verRctNonSemanticsSimple and the threadpool,
+// otherwise the MGs are checked one after the other on the calling thread.
+template <size_t Inputs, size_t RingSize, bool Parallel>
+class test_rct_mg_inputs
+{
+  public:
+	static const size_t loop_count = 10;
+	static const size_t inputs = Inputs;
+	static const size_t ring_size = RingSize;
+	static const size_t real_idx = RingSize / 2;
+
+	bool init()
+	{
+		rct::ctkeyV sc, pc;
+		rct::ctkey sctmp, pctmp;
+		std::vector<unsigned int> index;
+		std::vector<uint64_t> inamounts, outamounts;
+		rct::ctkeyM mixRing(inputs);
+
+		for(size_t i = 0; i < inputs; i++)
+		{
+			std::tie(sctmp, pctmp) = rct::ctskpkGen(1000);
+			sc.push_back(sctmp);
+			pc.push_back(pctmp);
+			inamounts.push_back(1000);
+			index.push_back(real_idx);
+
+			for(size_t j = 0; j < ring_size; j++)
+			{
+				if(j == real_idx)
+					mixRing[i].push_back(pctmp);
+				else
+					mixRing[i].push_back({rct::scalarmultBase(rct::skGen()), rct::scalarmultBase(rct::skGen())});
+			}
+		}
+
+		rct::key Sk, Pk;
+		rct::keyV destinations, amount_keys;
+		const uint64_t fee = 1000;
+		for(size_t i = 0; i < 2; i++)
+		{
+			outamounts.push_back((inputs * 1000 - fee) / 2);
+			amount_keys.push_back(rct::hash_to_scalar(rct::zero()));
+			rct::skpkGen(Sk, Pk);
+			destinations.push_back(Pk);
+		}
+
+		rct::ctkeyV outSk;
+		m_rv = rct::genRctSimple(rct::zero(), sc, destinations, inamounts, outamounts, fee, mixRing, amount_keys, NULL, NULL, index, outSk, true, hw::get_device("default"));
+		return rct::verRctNonSemanticsSimple(m_rv);
+	}
+
+	bool test()
+	{
+		if(Parallel)
+			return rct::verRctNonSemanticsSimple(m_rv);
+
+		const rct::key message = rct::get_pre_mlsag_hash(m_rv, hw::get_device("default"));
+		for(size_t i = 0; i < inputs; i++)
+		{
+			if(!rct::verRctMGSimple(message, m_rv.p.MGs[i], m_rv.mixRing[i], m_rv.p.pseudoOuts[i]))
+				return false;
+		}
+		return true;
+	}
+
+  private:
+	rct::rctSig m_rv;
+};
@@ -0,0 +1,146 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "crypto/crypto.h"
+#include "cryptonote_basic/account.h"
+#include "cryptonote_basic/cryptonote_basic.h"
+#include "cryptonote_basic/subaddress_index.h"
+
+// Scans a chunk of Txes transactions with 2 outputs each, either one transaction at a
+// time or through the batched derivation API used by the wallet refresh threads.
+template <size_t Txes, bool Batched>
+class test_wallet_scan
+{
+  public:
+	static const size_t loop_count = 10;
+	static const size_t tx_count = Txes;
+	static const size_t outs_per_tx = 2;
+
+	bool init()
+	{
+		m_bob.generate_new(0);
+		m_subaddresses[m_bob.get_keys().m_account_address.m_spend_public_key] = {0, 0};
+
+		crypto::secret_key sec;
+		m_tx_keys.resize(tx_count);
+		m_out_keys.resize(tx_count * outs_per_tx);
+		for(size_t i = 0; i < tx_count; i++)
+			crypto::generate_legacy_keys(m_tx_keys[i], sec);
+		for(size_t i = 0; i < m_out_keys.size(); i++)
+			crypto::generate_legacy_keys(m_out_keys[i], sec);
+
+		m_derivations.resize(tx_count);
+		m_outputs.resize(m_out_keys.size());
+		return true;
+	}
+
+	bool test()
+	{
+		return Batched ? scan_batched() : scan_single();
+	}
+
+  private:
+	bool scan_single()
+	{
+		const crypto::secret_key &view_key = m_bob.get_keys().m_view_secret_key;
+		size_t found = 0;
+		for(size_t i = 0; i < tx_count; i++)
+		{
+			crypto::key_derivation derivation;
+			crypto::public_key spend_key;
+#ifdef HAVE_EC_64
+			if(!crypto::generate_key_derivation_64(m_tx_keys[i], view_key, derivation))
+#else
+			if(!crypto::generate_key_derivation(m_tx_keys[i], view_key, derivation))
+#endif
+				return false;
+
+			for(size_t j = 0; j < outs_per_tx; j++)
+			{
+#ifdef HAVE_EC_64
+				if(!crypto::derive_subaddress_public_key_64(m_out_keys[i * outs_per_tx + j], derivation, j, spend_key))
+#else
+				if(!crypto::derive_subaddress_public_key(m_out_keys[i * outs_per_tx + j], derivation, j, spend_key))
+#endif
+					return false;
+				found += m_subaddresses.count(spend_key);
+			}
+		}
+		return found == 0;
+	}
+
+	bool scan_batched()
+	{
+		for(size_t i = 0; i < tx_count; i++)
+			m_derivations[i].tx_key = m_tx_keys[i];
+		crypto::generate_key_derivations(m_bob.get_keys().m_view_secret_key, m_derivations.data(), m_derivations.size());
+
+		for(size_t i = 0; i < m_outputs.size(); i++)
+		{
+			if(!m_derivations[i / outs_per_tx].valid)
+				return false;
+			m_outputs[i].out_key = m_out_keys[i];
+			m_outputs[i].derivation = m_derivations[i / outs_per_tx].derivation;
+			m_outputs[i].output_index = i % outs_per_tx;
+		}
+		crypto::derive_subaddress_public_keys(m_outputs.data(), m_outputs.size());
+
+		size_t found = 0;
+		for(const crypto::subaddress_derivation &d : m_outputs)
+		{
+			if(!d.valid)
+				return false;
+			found += m_subaddresses.count(d.spend_key);
+		}
+		return found == 0;
+	}
+
+	cryptonote::account_base m_bob;
+	std::unordered_map<crypto::public_key, cryptonote::subaddress_index> m_subaddresses;
+	std::vector<crypto::public_key> m_tx_keys;
+	std::vector<crypto::public_key> m_out_keys;
+	std::vector<crypto::tx_key_derivation> m_derivations;
+	std::vector<crypto::subaddress_derivation> m_outputs;
+};
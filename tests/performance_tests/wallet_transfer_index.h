@@ -0,0 +1,126 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "crypto/crypto.h"
+#include "wallet/transfer_index.h"
+
+// Balance query plus input gathering for one account of a synthetic wallet with Outputs
+// outputs, 10% unspent, spread over 4 accounts of 50 subaddresses. The linear variant walks
+// every output the way wallet2 did before the transfer index.
+template <size_t Outputs, bool Indexed>
+class test_transfer_index
+{
+  public:
+	static const size_t loop_count = 100;
+	static const uint64_t height = 2000000;
+
+	struct output
+	{
+		cryptonote::subaddress_index index;
+		uint64_t amount;
+		uint64_t unlock_time;
+		uint64_t block_height;
+		bool spent;
+	};
+
+	bool init()
+	{
+		m_outputs.reserve(Outputs);
+		for(size_t i = 0; i < Outputs; i++)
+		{
+			uint32_t rnd = crypto::rand<uint32_t>();
+			output o{{rnd % 4, (rnd >> 8) % 50}, crypto::rand<uint64_t>() % 1000000000000, 0, i * height / Outputs, rnd % 10 != 0};
+			m_outputs.push_back(o);
+			if(!o.spent)
+				m_index.insert(i, o.index, o.amount, tools::transfer_index::unlock_height(o.unlock_time, o.block_height));
+		}
+		for(uint32_t i = 0; i < 10; i++)
+			m_minors.insert(i);
+		return true;
+	}
+
+	bool test()
+	{
+		uint64_t balance = 0;
+		size_t count = 0;
+		if(Indexed)
+		{
+			for(const auto &b : m_index.unlocked_balance_per_subaddress(0, height))
+				balance += b.second;
+			count = m_index.unlocked_outputs(0, m_minors, height).size();
+		}
+		else
+		{
+			std::map<uint32_t, uint64_t> amount_per_subaddr;
+			for(const output &o : m_outputs)
+				if(o.index.major == 0 && !o.spent && is_unlocked(o))
+					amount_per_subaddr[o.index.minor] += o.amount;
+			for(const auto &b : amount_per_subaddr)
+				balance += b.second;
+
+			std::vector<size_t> outputs;
+			for(size_t i = 0; i < m_outputs.size(); i++)
+			{
+				const output &o = m_outputs[i];
+				if(!o.spent && is_unlocked(o) && o.index.major == 0 && m_minors.count(o.index.minor) == 1)
+					outputs.push_back(i);
+			}
+			count = outputs.size();
+		}
+		return balance != 0 && count != 0;
+	}
+
+  private:
+	static bool is_unlocked(const output &o)
+	{
+		return height - 1 + CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_BLOCKS >= o.unlock_time &&
+			o.block_height + CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE <= height;
+	}
+
+	std::vector<output> m_outputs;
+	tools::transfer_index m_index;
+	std::set<uint32_t> m_minors;
+};
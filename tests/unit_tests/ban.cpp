@@ -77,6 +77,7 @@ class test_core
 	bool get_test_drop_download_height() const { return true; }
 	bool prepare_handle_incoming_blocks(const std::list<cryptonote::block_complete_entry> &blocks) { return true; }
 	bool cleanup_handle_incoming_blocks(bool force_sync = false) { return true; }
+	void precompute_incoming_blocks(uint64_t height, const std::list<cryptonote::block_complete_entry> &blocks) {}
 	uint64_t get_target_blockchain_height() const { return 1; }
 	size_t get_block_sync_size(uint64_t height) const { return BLOCKS_SYNCHRONIZING_DEFAULT_COUNT; }
 	virtual void on_transaction_relayed(const cryptonote::blobdata &tx) {}
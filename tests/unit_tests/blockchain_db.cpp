@@ -28,6 +28,7 @@
 
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/filesystem.hpp>
+#include <atomic>
 #include <chrono>
 #include <cstdio>
 #include <iostream>
@@ -448,4 +449,280 @@ TYPED_TEST(BlockchainDBTest, RetrieveBlockData)
 	ASSERT_HASH_EQ(get_block_hash(this->m_blocks[1]), hashes[1]);
 }
 
+TYPED_TEST(BlockchainDBTest, PowHashCache)
+{
+	boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+	std::string dirPath = tempPath.string();
+
+	this->set_prefix(dirPath);
+
+	ASSERT_NO_THROW(this->m_db->open(dirPath));
+	this->get_filenames();
+	this->init_hard_fork();
+
+	const crypto::hash id0 = get_block_hash(this->m_blocks[0]);
+	const crypto::hash id1 = get_block_hash(this->m_blocks[1]);
+	crypto::hash pow0 = crypto::cn_fast_hash(&id0, sizeof(id0));
+	crypto::hash pow;
+
+	ASSERT_FALSE(this->m_db->get_block_pow_hash(id0, pow));
+	ASSERT_NO_THROW(this->m_db->add_block_pow_hash(id0, pow0));
+	ASSERT_TRUE(this->m_db->get_block_pow_hash(id0, pow));
+	ASSERT_HASH_EQ(pow0, pow);
+	ASSERT_FALSE(this->m_db->get_block_pow_hash(id1, pow));
+
+	// entries are not touched by adding and popping blocks
+	std::vector<transaction> txs;
+	block b;
+	ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+	ASSERT_NO_THROW(this->m_db->pop_block(b, txs));
+	ASSERT_TRUE(this->m_db->get_block_pow_hash(id0, pow));
+	ASSERT_HASH_EQ(pow0, pow);
+
+	// adding it again is harmless
+	ASSERT_NO_THROW(this->m_db->add_block_pow_hash(id0, pow0));
+}
+
+TYPED_TEST(BlockchainDBTest, OutputDistribution)
+{
+	boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+	std::string dirPath = tempPath.string();
+
+	this->set_prefix(dirPath);
+
+	ASSERT_NO_THROW(this->m_db->open(dirPath));
+	this->get_filenames();
+	this->init_hard_fork();
+
+	std::vector<uint64_t> distribution;
+	uint64_t base = 0;
+	ASSERT_FALSE(this->m_db->get_output_distribution(0, 0, 0, distribution, base));
+
+	ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+	const uint64_t outs0 = this->m_db->get_num_outputs(0);
+	ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+	const uint64_t outs1 = this->m_db->get_num_outputs(0);
+
+	ASSERT_TRUE(this->m_db->get_output_distribution(0, 0, 0, distribution, base));
+	ASSERT_EQ(2, distribution.size());
+	ASSERT_EQ(outs0, distribution[0]);
+	ASSERT_EQ(outs1 - outs0, distribution[1]);
+	ASSERT_EQ(0, base);
+
+	base = 0;
+	ASSERT_TRUE(this->m_db->get_output_distribution(0, 1, 0, distribution, base));
+	ASSERT_EQ(1, distribution.size());
+	ASSERT_EQ(outs1 - outs0, distribution[0]);
+	ASSERT_EQ(outs0, base);
+
+	// the counts follow the chain back down
+	std::vector<transaction> txs;
+	block b;
+	ASSERT_NO_THROW(this->m_db->pop_block(b, txs));
+	base = 0;
+	ASSERT_TRUE(this->m_db->get_output_distribution(0, 0, 0, distribution, base));
+	ASSERT_EQ(1, distribution.size());
+	ASSERT_EQ(outs0, distribution[0]);
+	ASSERT_FALSE(this->m_db->get_output_distribution(0, 1, 0, distribution, base));
+}
+
+TYPED_TEST(BlockchainDBTest, ReadSnapshot)
+{
+	boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+	std::string dirPath = tempPath.string();
+
+	this->set_prefix(dirPath);
+
+	ASSERT_NO_THROW(this->m_db->open(dirPath));
+	this->get_filenames();
+	this->init_hard_fork();
+
+	ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+
+	// a read txn held by another thread keeps seeing the chain as it was when it started
+	std::atomic<int> stage(0);
+	uint64_t height_before = 0, height_after = 0;
+	std::thread reader([&]() {
+		this->m_db->block_txn_start(true);
+		height_before = this->m_db->height();
+		stage = 1;
+		while(stage != 2)
+			std::this_thread::yield();
+		height_after = this->m_db->height();
+		this->m_db->block_txn_stop();
+	});
+
+	while(stage != 1)
+		std::this_thread::yield();
+	EXPECT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+	stage = 2;
+	reader.join();
+
+	ASSERT_EQ(1, height_before);
+	ASSERT_EQ(1, height_after);
+	ASSERT_EQ(2, this->m_db->height());
+}
+
+TYPED_TEST(BlockchainDBTest, ChainSnapshot)
+{
+	boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+	std::string dirPath = tempPath.string();
+
+	this->set_prefix(dirPath);
+
+	ASSERT_NO_THROW(this->m_db->open(dirPath));
+	this->get_filenames();
+	this->init_hard_fork();
+
+	ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+	ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+
+	std::stringstream snapshot;
+	ASSERT_NO_THROW(this->m_db->export_snapshot(snapshot));
+
+	boost::filesystem::path copyPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+	std::unique_ptr<BlockchainDB> copy(new TypeParam());
+	ASSERT_NO_THROW(copy->open(copyPath.string()));
+
+	uint64_t imported = 0;
+	ASSERT_NO_THROW(imported = copy->import_snapshot(snapshot));
+	ASSERT_EQ(2, imported);
+	ASSERT_EQ(2, copy->height());
+	ASSERT_EQ(this->m_db->get_block_hash_from_height(1), copy->get_block_hash_from_height(1));
+	ASSERT_EQ(this->m_db->top_block_hash(), copy->top_block_hash());
+	for(const auto &tx : this->m_txs[1])
+		ASSERT_TRUE(copy->tx_exists(get_transaction_hash(tx)));
+
+	// a snapshot is only ever loaded into an empty database
+	snapshot.clear();
+	snapshot.seekg(0);
+	ASSERT_THROW(copy->import_snapshot(snapshot), DB_ERROR);
+	copy->close();
+	boost::filesystem::remove_all(copyPath);
+
+	// past the header comes the table manifest, a count and the length prefixed names
+	const std::string exported = snapshot.str();
+	size_t first_table = 8 + 4 + 4 + 8;
+	const uint8_t table_count = exported[first_table++];
+	for(uint8_t i = 0; i < table_count; i++)
+		first_table += 1 + uint8_t(exported[first_table]);
+
+	// a damaged chunk is refused: flip the first payload byte of the first table
+	std::string damaged = exported;
+	const size_t payload = first_table + 1 + uint8_t(damaged[first_table]) + 4 + 4;
+	ASSERT_LT(payload, damaged.size());
+	damaged[payload] ^= 0x5a;
+	std::stringstream damaged_stream(damaged);
+	copy.reset(new TypeParam());
+	ASSERT_NO_THROW(copy->open(copyPath.string()));
+	ASSERT_THROW(copy->import_snapshot(damaged_stream), DB_ERROR);
+	copy->close();
+	boost::filesystem::remove_all(copyPath);
+
+	// so is a snapshot of another db version, the records would be misread
+	std::string other_version = snapshot.str();
+	other_version[8 + 4] += 1;
+	std::stringstream other_version_stream(other_version);
+	copy.reset(new TypeParam());
+	ASSERT_NO_THROW(copy->open(copyPath.string()));
+	ASSERT_THROW(copy->import_snapshot(other_version_stream), DB_ERROR);
+	ASSERT_EQ(0, copy->height());
+	copy->close();
+	boost::filesystem::remove_all(copyPath);
+
+	// and a manifest that doesn't list the db tables in load order, here with two tables swapped
+	std::string reordered = exported;
+	const size_t indices = reordered.find("tx_indices"), outputs = reordered.find("tx_outputs");
+	ASSERT_LT(indices, first_table);
+	ASSERT_LT(outputs, first_table);
+	reordered.replace(indices, 10, "tx_outputs");
+	reordered.replace(outputs, 10, "tx_indices");
+	std::stringstream reordered_stream(reordered);
+	copy.reset(new TypeParam());
+	ASSERT_NO_THROW(copy->open(copyPath.string()));
+	ASSERT_THROW(copy->import_snapshot(reordered_stream), DB_ERROR);
+	ASSERT_EQ(0, copy->height());
+	copy->close();
+	boost::filesystem::remove_all(copyPath);
+
+	// or that misses a table
+	std::string missing = exported;
+	missing[8 + 4 + 4 + 8] -= 1;
+	std::stringstream missing_stream(missing);
+	copy.reset(new TypeParam());
+	ASSERT_NO_THROW(copy->open(copyPath.string()));
+	ASSERT_THROW(copy->import_snapshot(missing_stream), DB_ERROR);
+	ASSERT_EQ(0, copy->height());
+	copy->close();
+	boost::filesystem::remove_all(copyPath);
+}
+
+class BlockchainLMDBTest : public BlockchainDBTest<BlockchainLMDB>
+{
+  protected:
+	// turn a closed db back into a version 1 one: no block_rct_outs table, version 1
+	void downgrade_to_v1(const std::string &dirPath)
+	{
+		MDB_env *env;
+		MDB_txn *txn;
+		MDB_dbi dbi;
+		ASSERT_EQ(0, mdb_env_create(&env));
+		ASSERT_EQ(0, mdb_env_set_maxdbs(env, 20));
+		ASSERT_EQ(0, mdb_env_open(env, dirPath.c_str(), 0, 0644));
+		ASSERT_EQ(0, mdb_txn_begin(env, NULL, 0, &txn));
+
+		ASSERT_EQ(0, mdb_dbi_open(txn, "block_rct_outs", 0, &dbi));
+		ASSERT_EQ(0, mdb_drop(txn, dbi, 1));
+
+		char key[] = "version";
+		uint32_t version = 1;
+		MDB_val k = {sizeof(key), key};
+		MDB_val v = {sizeof(version), &version};
+		ASSERT_EQ(0, mdb_dbi_open(txn, "properties", 0, &dbi));
+		ASSERT_EQ(0, mdb_put(txn, dbi, &k, &v, 0));
+
+		ASSERT_EQ(0, mdb_txn_commit(txn));
+		mdb_env_close(env);
+	}
+};
+
+TEST_F(BlockchainLMDBTest, MigrateRctOutputCounts)
+{
+	boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+	std::string dirPath = tempPath.string();
+
+	this->set_prefix(dirPath);
+
+	ASSERT_NO_THROW(this->m_db->open(dirPath));
+	this->get_filenames();
+	this->init_hard_fork();
+
+	ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+	const uint64_t outs0 = this->m_db->get_num_outputs(0);
+	ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+	const uint64_t outs1 = this->m_db->get_num_outputs(0);
+	ASSERT_NO_THROW(this->m_db->close());
+
+	downgrade_to_v1(dirPath);
+
+	// opening it read-write runs migrate_1_2, which rebuilds the counts from output_amounts
+	ASSERT_NO_THROW(this->m_db->open(dirPath));
+
+	std::vector<uint64_t> distribution;
+	uint64_t base = 0;
+	ASSERT_TRUE(this->m_db->get_output_distribution(0, 0, 0, distribution, base));
+	ASSERT_EQ(2, distribution.size());
+	ASSERT_EQ(outs0, distribution[0]);
+	ASSERT_EQ(outs1 - outs0, distribution[1]);
+	ASSERT_EQ(0, base);
+
+	// and the counts are kept up to date from there on
+	std::vector<transaction> txs;
+	block b;
+	ASSERT_NO_THROW(this->m_db->pop_block(b, txs));
+	ASSERT_TRUE(this->m_db->get_output_distribution(0, 0, 0, distribution, base));
+	ASSERT_EQ(1, distribution.size());
+	ASSERT_EQ(outs0, distribution[0]);
+}
+
 } // anonymous namespace
@@ -30,8 +30,12 @@
 #include <gtest/gtest.h>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "crypto/crypto.h"
+#ifdef HAVE_EC_64
+#include "crypto/ecops64/ecops64.h"
+#endif
 
 namespace
 {
@@ -179,3 +183,166 @@ TEST(Crypto, generate_key_derivation_64)
 	}
 }
 #endif
+
+namespace
+{
+
+// Keys covering the edge cases of the batched code: random valid points, the identity,
+// a non-canonical y and points that are not on the curve, spread across several batches
+std::vector<crypto::public_key> make_batch_test_keys()
+{
+	using namespace crypto;
+	std::vector<public_key> keys;
+	for(size_t i = 0; i < 150; ++i)
+	{
+		public_key pk;
+		secret_key sk;
+		generate_legacy_keys(pk, sk);
+		keys.push_back(pk);
+	}
+
+	public_key identity = {};
+	identity.data[0] = 1;
+	keys[7] = identity;
+
+	public_key non_canonical;
+	memset(non_canonical.data, 0xff, 32);
+	non_canonical.data[0] = 0xee;
+	non_canonical.data[31] = 0x7f;
+	keys[64] = non_canonical;
+
+	size_t invalid = 0;
+	while(invalid < 3)
+	{
+		public_key pk;
+		random_scalar((unsigned char *)pk.data);
+		if(!check_key(pk))
+			keys[65 + 40 * invalid++] = pk;
+	}
+	return keys;
+}
+
+} // namespace anonymous
+
+TEST(Crypto, generate_key_derivations_matches_single)
+{
+	using namespace crypto;
+	const std::vector<public_key> keys = make_batch_test_keys();
+	public_key view_pub;
+	secret_key view_sec;
+	generate_legacy_keys(view_pub, view_sec);
+
+	std::vector<tx_key_derivation> batch(keys.size());
+	for(size_t i = 0; i < keys.size(); ++i)
+		batch[i].tx_key = keys[i];
+	generate_key_derivations(view_sec, batch.data(), batch.size());
+
+	for(size_t i = 0; i < keys.size(); ++i)
+	{
+		key_derivation single;
+		const bool valid = generate_key_derivation(keys[i], view_sec, single);
+		ASSERT_EQ(valid, batch[i].valid) << "key " << i;
+		if(valid)
+			ASSERT_EQ(0, memcmp(single.data, batch[i].derivation.data, 32)) << "key " << i;
+	}
+
+	// a batch with no decodable point must not touch the results
+	std::vector<tx_key_derivation> invalid(2);
+	invalid[0].tx_key = keys[65];
+	invalid[1].tx_key = keys[105];
+	generate_key_derivations(view_sec, invalid.data(), invalid.size());
+	ASSERT_FALSE(invalid[0].valid);
+	ASSERT_FALSE(invalid[1].valid);
+	generate_key_derivations(view_sec, nullptr, 0);
+}
+
+TEST(Crypto, derive_subaddress_public_keys_matches_single)
+{
+	using namespace crypto;
+	std::vector<public_key> keys = make_batch_test_keys();
+	key_derivation derivation;
+	memcpy(derivation.data, ::derivation[0], 32);
+
+	// an output key equal to H(derivation, index)*G derives the identity point
+	ec_scalar scalar;
+	derivation_to_scalar(derivation, 20, scalar);
+	secret_key scalar_key;
+	memcpy(scalar_key.data, scalar.data, 32);
+	ASSERT_TRUE(secret_key_to_public_key(scalar_key, keys[20]));
+
+	std::vector<subaddress_derivation> batch(keys.size());
+	for(size_t i = 0; i < keys.size(); ++i)
+	{
+		batch[i].out_key = keys[i];
+		batch[i].derivation = derivation;
+		batch[i].output_index = i;
+	}
+	derive_subaddress_public_keys(batch.data(), batch.size());
+
+	for(size_t i = 0; i < keys.size(); ++i)
+	{
+		public_key single;
+		const bool valid = derive_subaddress_public_key(keys[i], derivation, i, single);
+		ASSERT_EQ(valid, batch[i].valid) << "key " << i;
+		if(valid)
+			ASSERT_EQ(0, memcmp(single.data, batch[i].spend_key.data, 32)) << "key " << i;
+	}
+
+	public_key identity = {};
+	identity.data[0] = 1;
+	ASSERT_EQ(0, memcmp(identity.data, batch[20].spend_key.data, 32));
+}
+
+TEST(Crypto, check_keys_matches_check_key)
+{
+	using namespace crypto;
+	const std::vector<public_key> keys = make_batch_test_keys();
+	bool all_valid = true;
+	for(size_t i = 0; i < keys.size(); ++i)
+	{
+		ASSERT_EQ(check_key(keys[i]), check_keys(&keys[i], 1)) << "key " << i;
+		all_valid = all_valid && check_key(keys[i]);
+	}
+	ASSERT_FALSE(all_valid);
+	ASSERT_FALSE(check_keys(keys.data(), keys.size()));
+	ASSERT_TRUE(check_keys(keys.data(), 7));
+	ASSERT_TRUE(check_keys(keys.data(), 0));
+}
+
+#ifdef HAVE_EC_64
+// test for the optimized x86 64bit elliptic curve implementation
+TEST(Crypto, ge64_tobytes_batch_matches_single)
+{
+	using namespace crypto;
+	const size_t count = 9;
+	ge64_p2 points[count];
+	fe64 recip[count];
+	unsigned char batch_out[count][32];
+	unsigned char *out[count];
+	for(size_t i = 0; i < count; ++i)
+	{
+		public_key pk;
+		secret_key sk;
+		generate_legacy_keys(pk, sk);
+		ge64_p3 p3;
+		ASSERT_EQ(0, ge64_frombytes_vartime(&p3, (const unsigned char *)pk.data));
+		ge64_p3_to_p2(&points[i], &p3);
+		out[i] = batch_out[i];
+	}
+
+	// a zero z must only affect its own point, not the shared inversion
+	for(size_t zero_at : {size_t(0), size_t(4), count - 1})
+	{
+		ge64_p2 h[count];
+		memcpy(h, points, sizeof(h));
+		memset(h[zero_at].z, 0, sizeof(fe64));
+		ge64_tobytes_batch(out, h, recip, count);
+		for(size_t i = 0; i < count; ++i)
+		{
+			unsigned char single[32];
+			ge64_tobytes(single, &h[i]);
+			ASSERT_EQ(0, memcmp(single, batch_out[i], 32)) << "point " << i << " zero at " << zero_at;
+		}
+	}
+}
+#endif
@@ -444,6 +444,48 @@ TEST_F(positive_test_connection_to_levin_protocol_handler_calls, handler_process
 	ASSERT_EQ(3, m_commands_handler.callback_counter());
 }
 
+TEST_F(positive_test_connection_to_levin_protocol_handler_calls, shared_notify_is_sent_to_every_connection)
+{
+	const int expected_command = 4673262;
+	std::string in_data(1024, 'n');
+
+	test_connection_ptr conn1 = create_connection(false);
+	test_connection_ptr conn2 = create_connection(false);
+	for(test_connection *conn : {conn1.get(), conn2.get()})
+	{
+		epee::net_utils::connection_context_base &context = conn->m_protocol_handler.get_context_ref();
+		context = epee::net_utils::connection_context_base(boost::uuids::random_generator()(), epee::net_utils::ipv4_network_address{0, 0}, false);
+		conn->start();
+	}
+
+	epee::net_utils::shared_buffer message = epee::levin::make_notify_message(expected_command, in_data);
+	ASSERT_EQ(sizeof(epee::levin::bucket_head2) + in_data.size(), message.size());
+	ASSERT_EQ(1, m_handler_config.send(message, conn1->m_protocol_handler.get_connection_id()));
+	ASSERT_EQ(1, m_handler_config.send(message, conn2->m_protocol_handler.get_connection_id()));
+
+	const std::string expected_data(message.data(), message.size());
+	ASSERT_EQ(expected_data, conn1->last_send_data());
+	ASSERT_EQ(expected_data, conn2->last_send_data());
+
+	ASSERT_TRUE(conn1->m_protocol_handler.handle_recv(expected_data.data(), expected_data.size()));
+	ASSERT_EQ(1, m_commands_handler.notify_counter());
+	ASSERT_EQ(expected_command, m_commands_handler.last_command());
+	ASSERT_EQ(in_data, m_commands_handler.last_in_buf());
+}
+
+TEST(levin_shared_buffer, slices_share_storage)
+{
+	epee::net_utils::shared_buffer buff(std::string("0123456789"));
+	epee::net_utils::shared_buffer slice = buff.get_slice(2, 5);
+	ASSERT_EQ(5, slice.size());
+	ASSERT_EQ(buff.data() + 2, slice.data());
+	ASSERT_EQ(std::string("23456"), std::string(slice.data(), slice.size()));
+	ASSERT_EQ(buff.data() + 4, slice.get_slice(2, 3).data());
+	ASSERT_TRUE(buff.get_slice(10, 0).empty());
+	ASSERT_THROW(buff.get_slice(8, 3), std::out_of_range);
+	ASSERT_THROW(slice.get_slice(0, 6), std::out_of_range);
+}
+
 TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, handles_big_packet_1)
 {
 	std::string buf("yyyyyy");
@@ -545,6 +587,52 @@ TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, handles_two_re
 	ASSERT_EQ(2, m_commands_handler.invoke_counter());
 }
 
+TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, handles_packets_split_at_every_byte)
+{
+	m_in_data.assign("0123456789abcdefghijklmnopqrstuvwxyz");
+	m_req_head.m_cb = m_in_data.size();
+	prepare_buf();
+	m_buf.append(m_buf);
+
+	for(size_t i = 0; i < m_buf.size(); ++i)
+		ASSERT_TRUE(m_conn->m_protocol_handler.handle_recv(m_buf.data() + i, 1));
+	ASSERT_EQ(2, m_commands_handler.invoke_counter());
+	ASSERT_EQ(m_in_data, m_commands_handler.last_in_buf());
+}
+
+TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, handles_body_larger_than_pooled_buffer)
+{
+	// the body buffer starts small and grows as the chunks arrive
+	m_in_data.clear();
+	for(size_t i = 0; i < 3 * LEVIN_POOLED_BUFFER_MAX_SIZE + 7; ++i)
+		m_in_data.push_back(char('a' + i % 26));
+	m_req_head.m_cb = m_in_data.size();
+	prepare_buf();
+
+	for(size_t i = 0; i < m_buf.size(); i += 1000)
+		ASSERT_TRUE(m_conn->m_protocol_handler.handle_recv(m_buf.data() + i, std::min<size_t>(1000, m_buf.size() - i)));
+	ASSERT_EQ(1, m_commands_handler.invoke_counter());
+	ASSERT_EQ(m_in_data, m_commands_handler.last_in_buf());
+}
+
+TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, handles_empty_body_followed_by_packet)
+{
+	std::string body = m_in_data;
+	m_in_data.clear();
+	m_req_head.m_cb = 0;
+	prepare_buf();
+	std::string stream = m_buf;
+
+	m_in_data = body;
+	m_req_head.m_cb = m_in_data.size();
+	prepare_buf();
+	stream += m_buf;
+
+	ASSERT_TRUE(m_conn->m_protocol_handler.handle_recv(stream.data(), stream.size()));
+	ASSERT_EQ(2, m_commands_handler.invoke_counter());
+	ASSERT_EQ(body, m_commands_handler.last_in_buf());
+}
+
 TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, handles_unexpected_response)
 {
 	m_req_head.m_flags = LEVIN_PACKET_RESPONSE;
@@ -0,0 +1,139 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "gtest/gtest.h"
+
+#include "rpc/core_rpc_server_commands_defs.h"
+#include "rpc/get_blocks_cache.h"
+#include "storages/portable_storage_template_helper.h"
+
+namespace
+{
+std::string make_body(uint64_t start_height, uint64_t current_height, const std::string &block_blob)
+{
+	cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response res = AUTO_VAL_INIT(res);
+	res.blocks.emplace_back(block_blob, std::vector<cryptonote::blobdata>{"tx"});
+	res.output_indices.resize(1);
+	res.output_indices[0].indices.resize(2);
+	res.output_indices[0].indices[0].indices = {1, 2, 3};
+	res.output_indices[0].indices[1].indices = {4};
+	res.start_height = start_height;
+	res.current_height = current_height;
+	res.status = CORE_RPC_STATUS_OK;
+	std::string body;
+	epee::serialization::store_t_to_binary(res, body);
+	return body;
+}
+}
+
+TEST(get_blocks_cache, disabled_by_default)
+{
+	cryptonote::get_blocks_cache cache;
+	ASSERT_FALSE(cache.enabled());
+	ASSERT_FALSE(cache.add(10, 250, true, make_body(10, 1000, "block"), 1000, 11, crypto::null_hash));
+}
+
+TEST(get_blocks_cache, patches_current_height)
+{
+	cryptonote::get_blocks_cache cache;
+	cache.init(1024 * 1024, 100);
+
+	// a blob that spells out the field header must not confuse the patching
+	const std::string blob = std::string("\x0e" "current_height\x05", 16) + std::string(8, '\x07');
+	const crypto::hash id = crypto::cn_fast_hash(blob.data(), blob.size());
+	ASSERT_TRUE(cache.add(10, 250, true, make_body(10, 1000, blob), 1000, 11, id));
+
+	std::string body;
+	uint64_t end_height;
+	crypto::hash end_id;
+	ASSERT_FALSE(cache.find(11, 250, true, 1005, body, end_height, end_id));
+	ASSERT_FALSE(cache.find(10, 100, true, 1005, body, end_height, end_id));
+	ASSERT_TRUE(cache.find(10, 250, true, 1005, body, end_height, end_id));
+	ASSERT_EQ(11, end_height);
+	ASSERT_EQ(id, end_id);
+
+	cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response res;
+	ASSERT_TRUE(epee::serialization::load_t_from_binary(res, body));
+	ASSERT_EQ(1005, res.current_height);
+	ASSERT_EQ(10, res.start_height);
+	ASSERT_EQ(1, res.blocks.size());
+	ASSERT_EQ(blob, res.blocks[0].block);
+	ASSERT_EQ(1, res.output_indices.size());
+	ASSERT_EQ(3, res.output_indices[0].indices[0].indices.size());
+
+	const cryptonote::get_blocks_cache::stats stats = cache.get_stats();
+	ASSERT_EQ(1, stats.hits);
+	ASSERT_EQ(2, stats.misses);
+	ASSERT_EQ(1, stats.entries);
+}
+
+TEST(get_blocks_cache, rejects_mismatched_height)
+{
+	cryptonote::get_blocks_cache cache;
+	cache.init(1024 * 1024, 100);
+	ASSERT_FALSE(cache.add(10, 250, true, make_body(10, 1000, "block"), 999, 11, crypto::null_hash));
+	ASSERT_EQ(0, cache.get_stats().entries);
+}
+
+TEST(get_blocks_cache, evicts_least_recently_used)
+{
+	const std::string body = make_body(0, 1000, std::string(1000, 'b'));
+	cryptonote::get_blocks_cache cache;
+	cache.init(body.size() * 2, 100);
+
+	std::string out;
+	uint64_t end_height;
+	crypto::hash end_id;
+	ASSERT_TRUE(cache.add(0, 250, true, make_body(0, 1000, std::string(1000, 'b')), 1000, 1, crypto::null_hash));
+	ASSERT_TRUE(cache.add(1, 250, true, make_body(1, 1000, std::string(1000, 'b')), 1000, 2, crypto::null_hash));
+	ASSERT_TRUE(cache.find(0, 250, true, 1000, out, end_height, end_id));
+	ASSERT_TRUE(cache.add(2, 250, true, make_body(2, 1000, std::string(1000, 'b')), 1000, 3, crypto::null_hash));
+
+	ASSERT_TRUE(cache.find(0, 250, true, 1000, out, end_height, end_id));
+	ASSERT_FALSE(cache.find(1, 250, true, 1000, out, end_height, end_id));
+	ASSERT_TRUE(cache.find(2, 250, true, 1000, out, end_height, end_id));
+	ASSERT_EQ(2, cache.get_stats().entries);
+	ASSERT_LE(cache.get_stats().size, body.size() * 2);
+
+	cache.remove(0, 250, true);
+	ASSERT_FALSE(cache.find(0, 250, true, 1000, out, end_height, end_id));
+	ASSERT_EQ(1, cache.get_stats().entries);
+}
@@ -0,0 +1,110 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <thread>
+#include <vector>
+
+#include "common/metrics.h"
+#include "gtest/gtest.h"
+
+using tools::metrics::histogram;
+using tools::metrics::registry;
+
+TEST(metrics, bucket_bounds)
+{
+	for(uint64_t v : {0ull, 1ull, 7ull, 8ull, 9ull, 15ull, 16ull, 1000ull, 123456789ull, (1ull << 39) + 5})
+	{
+		size_t i = histogram::bucket_index(v);
+		ASSERT_LT(i, histogram::bucket_count);
+		ASSERT_LE(histogram::bucket_lower_bound(i), v);
+		ASSERT_LT(v, histogram::bucket_lower_bound(i) + histogram::bucket_width(i));
+	}
+	for(size_t i = 1; i < histogram::bucket_count; ++i)
+		ASSERT_EQ(histogram::bucket_lower_bound(i - 1) + histogram::bucket_width(i - 1), histogram::bucket_lower_bound(i));
+	ASSERT_EQ(histogram::bucket_count - 1, histogram::bucket_index(~0ull));
+}
+
+TEST(metrics, quantiles)
+{
+	histogram &h = registry::instance().get_histogram("test_quantiles");
+	for(uint64_t v = 1; v <= 1000; ++v)
+		h.record(v * 1000);
+
+	histogram::snapshot snap = h.get_snapshot();
+	ASSERT_EQ(1000, snap.count);
+	ASSERT_EQ(500500000ull, snap.sum);
+	ASSERT_NEAR(500000.0, snap.quantile(0.5), 500000.0 / 8);
+	ASSERT_NEAR(990000.0, snap.quantile(0.99), 990000.0 / 8);
+	ASSERT_EQ(0, registry::instance().get_histogram("test_empty").get_snapshot().quantile(0.5));
+}
+
+TEST(metrics, threads_are_merged)
+{
+	histogram &h = registry::instance().get_histogram("test_threads");
+	std::vector<std::thread> threads;
+	for(int t = 0; t < 4; ++t)
+		threads.emplace_back([&h] { for(int i = 0; i < 10000; ++i) h.record(100); });
+	for(std::thread &t : threads)
+		t.join();
+
+	// shards of the exited threads are reused, their counts kept
+	std::thread([&h] { h.record(100); }).join();
+
+	histogram::snapshot snap = h.get_snapshot();
+	ASSERT_EQ(40001, snap.count);
+	ASSERT_EQ(4000100, snap.sum);
+	ASSERT_EQ(40001, snap.buckets[histogram::bucket_index(100)]);
+}
+
+TEST(metrics, prometheus_text)
+{
+	registry &reg = registry::instance();
+	reg.get_counter("test_events_total", "Test events").inc(3);
+	reg.get_gauge("test_level").set(-2);
+	reg.get_histogram("test_latency").record(2000000000);
+	ASSERT_EQ(&reg.get_counter("test_events_total"), &reg.get_counter("test_events_total"));
+
+	const std::string text = reg.to_prometheus();
+	ASSERT_NE(std::string::npos, text.find("# HELP ryo_test_events_total Test events\n# TYPE ryo_test_events_total counter\nryo_test_events_total 3\n"));
+	ASSERT_NE(std::string::npos, text.find("# TYPE ryo_test_level gauge\nryo_test_level -2\n"));
+	ASSERT_NE(std::string::npos, text.find("# TYPE ryo_test_latency_seconds summary\n"));
+	ASSERT_NE(std::string::npos, text.find("ryo_test_latency_seconds_sum 2\nryo_test_latency_seconds_count 1\n"));
+	ASSERT_NE(std::string::npos, text.find("ryo_test_latency_seconds{quantile=\"0.5\"} 1.9"));
+}
@@ -0,0 +1,123 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "cryptonote_basic/account.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "device/device_default.hpp"
+#include "ringct/rctOps.h"
+#include "wallet/multi_account_scanner.h"
+
+using tools::multi_account_scanner;
+
+namespace
+{
+// Output to a standard address, keyed by the main tx key
+void add_output(cryptonote::transaction &tx, const crypto::secret_key &tx_key, const cryptonote::account_public_address &addr, uint64_t amount)
+{
+	crypto::key_derivation derivation;
+	crypto::public_key out_key;
+	ASSERT_TRUE(crypto::generate_key_derivation(addr.m_view_public_key, tx_key, derivation));
+	ASSERT_TRUE(crypto::derive_public_key(derivation, tx.vout.size(), addr.m_spend_public_key, out_key));
+	tx.vout.push_back({amount, cryptonote::txout_to_key(out_key)});
+}
+
+// Output to a subaddress, keyed by an additional tx key
+void add_sub_output(cryptonote::transaction &tx, std::vector<crypto::public_key> &additional, const cryptonote::account_public_address &addr, uint64_t amount)
+{
+	const crypto::secret_key r = rct::rct2sk(rct::skGen());
+	additional.push_back(rct::rct2pk(rct::scalarmultKey(rct::pk2rct(addr.m_spend_public_key), rct::sk2rct(r))));
+	add_output(tx, r, addr, amount);
+}
+}
+
+TEST(multi_account_scanner, finds_outputs_per_account)
+{
+	hw::core::device_default dev;
+	std::vector<cryptonote::account_base> accounts(3);
+	multi_account_scanner scanner;
+	for(auto &acc : accounts)
+	{
+		acc.generate_new(0);
+		ASSERT_EQ(scanner.add_account(acc.get_keys().m_view_secret_key, multi_account_scanner::make_subaddresses(acc.get_keys(), 2, 5)), &acc - accounts.data());
+	}
+	ASSERT_EQ(scanner.account_count(), 3);
+	ASSERT_EQ(scanner.subaddress_count(), 30);
+
+	cryptonote::account_base stranger;
+	stranger.generate_new(0);
+
+	const crypto::secret_key tx_key = rct::rct2sk(rct::skGen());
+	std::vector<crypto::public_key> additional;
+	cryptonote::transaction tx;
+	tx.rct_signatures.type = rct::RCTTypeNull;
+	add_sub_output(tx, additional, dev.get_subaddress(accounts[2].get_keys(), {1, 3}), 30);
+	add_output(tx, tx_key, accounts[1].get_keys().m_account_address, 10);
+	add_output(tx, tx_key, stranger.get_keys().m_account_address, 99);
+	additional.push_back(rct::rct2pk(rct::pkGen()));
+	additional.push_back(rct::rct2pk(rct::pkGen()));
+	ASSERT_TRUE(cryptonote::add_tx_pub_key_to_extra(tx, rct::rct2pk(rct::scalarmultBase(rct::sk2rct(tx_key)))));
+	ASSERT_TRUE(cryptonote::add_additional_tx_pub_keys_to_extra(tx.extra, additional));
+
+	cryptonote::transaction tx2;
+	const crypto::secret_key tx2_key = rct::rct2sk(rct::skGen());
+	tx2.rct_signatures.type = rct::RCTTypeNull;
+	add_output(tx2, tx2_key, accounts[1].get_keys().m_account_address, 20);
+	ASSERT_TRUE(cryptonote::add_tx_pub_key_to_extra(tx2, rct::rct2pk(rct::scalarmultBase(rct::sk2rct(tx2_key)))));
+
+	const multi_account_scanner::tx_entry txes[] = {{crypto::hash{1}, &tx, 7}, {crypto::hash{2}, &tx2, 8}};
+	std::vector<multi_account_scanner::found_output> found;
+	scanner.scan(txes, 2, found);
+
+	ASSERT_EQ(found.size(), 3);
+	ASSERT_EQ(found[0].account, 1);
+	ASSERT_EQ(found[0].height, 7);
+	ASSERT_EQ(found[0].output_index, 1);
+	ASSERT_EQ(found[0].index, cryptonote::subaddress_index(0, 0));
+	ASSERT_EQ(found[0].amount, 10);
+	ASSERT_EQ(found[1].account, 1);
+	ASSERT_EQ(found[1].txid, txes[1].txid);
+	ASSERT_EQ(found[1].amount, 20);
+	ASSERT_EQ(found[2].account, 2);
+	ASSERT_EQ(found[2].output_index, 0);
+	ASSERT_EQ(found[2].index, cryptonote::subaddress_index(1, 3));
+	ASSERT_EQ(found[2].amount, 30);
+}
@@ -1138,3 +1138,34 @@ TEST(ringct, aggregated)
 
 	ASSERT_TRUE(verRctSemanticsSimple(sp));
 }
+
+TEST(ringct, aggregated_bad_range_proof)
+{
+	static const size_t N_PROOFS = 8;
+	std::vector<rctSig> s(N_PROOFS);
+	std::vector<const rctSig *> sp(N_PROOFS);
+
+	for(size_t n = 0; n < N_PROOFS; ++n)
+	{
+		static const uint64_t inputs[] = {1000, 1000};
+		static const uint64_t outputs[] = {500, 1500};
+		s[n] = make_sample_simple_rct_sig(NELTS(inputs), inputs, NELTS(outputs), outputs, 0);
+		ASSERT_EQ(RCTTypeSimple, s[n].type);
+		sp[n] = &s[n];
+	}
+	ASSERT_TRUE(verRctSemanticsSimple(sp));
+
+	// one bad range proof among good ones fails the whole batch
+	const key ee = s[3].p.rangeSigs[1].asig.ee;
+	s[3].p.rangeSigs[1].asig.ee = skGen();
+	ASSERT_FALSE(verRctSemanticsSimple(sp));
+
+	// a sum check failing after the range proofs of the earlier txes were queued returns early,
+	// those tasks must not outlive what they write to
+	s[3].p.rangeSigs[1].asig.ee = ee;
+	s[N_PROOFS - 1].txnFee++;
+	for(int i = 0; i < 4; ++i)
+		ASSERT_FALSE(verRctSemanticsSimple(sp));
+	s[N_PROOFS - 1].txnFee--;
+	ASSERT_TRUE(verRctSemanticsSimple(sp));
+}
@@ -42,6 +42,7 @@
 #include "device/device.hpp"
 #include "ringct/rctSigs.h"
 #include "serialization/binary_archive.h"
+#include "serialization/binary_span_archive.h"
 #include "serialization/binary_utils.h"
 #include "serialization/debug_archive.h"
 #include "serialization/json_archive.h"
@@ -170,6 +171,51 @@ TEST(Serialization, BinaryArchiveVarInts)
 	ASSERT_EQ(x, x1);
 }
 
+TEST(Serialization, BinarySpanArchiveVarInts)
+{
+	uint64_t x = 0xff00000000, x1;
+	uint32_t y = 0x7f, y1;
+
+	ostringstream oss;
+	binary_archive<true> oar(oss);
+	oar.serialize_varint(x);
+	oar.serialize_varint(y);
+	ASSERT_TRUE(oss.good());
+	ASSERT_EQ(7, oss.str().size());
+
+	const std::string blob = oss.str();
+	binary_span_archive<false> iar(blob);
+	iar.serialize_varint(x1);
+	ASSERT_TRUE(iar.stream().good());
+	ASSERT_EQ(x, x1);
+	iar.serialize_varint(y1);
+	ASSERT_TRUE(iar.stream().good());
+	ASSERT_EQ(y, y1);
+	ASSERT_EQ(0, iar.remaining_bytes());
+	ASSERT_EQ(EOF, iar.stream().peek());
+	ASSERT_TRUE(iar.stream().eof());
+}
+
+TEST(Serialization, BinarySpanArchiveTruncated)
+{
+	uint64_t x = 0xff00000000, x1;
+
+	ostringstream oss;
+	binary_archive<true> oar(oss);
+	oar.serialize_int(x);
+	const std::string blob = oss.str().substr(0, 7);
+
+	binary_span_archive<false> iar(blob);
+	iar.serialize_int(x1);
+	ASSERT_FALSE(iar.stream().good());
+	ASSERT_EQ(0, iar.remaining_bytes());
+
+	istringstream iss(blob);
+	binary_archive<false> isar(iss);
+	isar.serialize_int(x1);
+	ASSERT_EQ(iss.rdstate(), iar.stream().rdstate());
+}
+
 TEST(Serialization, Test1)
 {
 	ostringstream str;
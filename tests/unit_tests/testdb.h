@@ -58,6 +58,8 @@ class BaseTestDB : public cryptonote::BlockchainDB
 	virtual void block_txn_stop() {}
 	virtual void block_txn_abort() {}
 	virtual void drop_hard_fork_info() {}
+	virtual void export_snapshot(std::ostream &out) const {}
+	virtual uint64_t import_snapshot(std::istream &in) { return 0; }
 	virtual bool block_exists(const crypto::hash &h, uint64_t *height) const { return false; }
 	virtual cryptonote::blobdata get_block_blob_from_height(const uint64_t &height) const { return cryptonote::t_serializable_object_to_blob(get_block_from_height(height)); }
 	virtual cryptonote::blobdata get_block_blob(const crypto::hash &h) const { return cryptonote::blobdata(); }
@@ -75,6 +77,8 @@ class BaseTestDB : public cryptonote::BlockchainDB
 	virtual cryptonote::difficulty_type get_block_difficulty(const uint64_t &height) const { return 0; }
 	virtual uint64_t get_block_already_generated_coins(const uint64_t &height) const { return 10000000000; }
 	virtual crypto::hash get_block_hash_from_height(const uint64_t &height) const { return crypto::hash(); }
+	virtual void add_block_pow_hash(const crypto::hash &blk_hash, const crypto::hash &pow_hash) {}
+	virtual bool get_block_pow_hash(const crypto::hash &blk_hash, crypto::hash &pow_hash) const { return false; }
 	virtual std::vector<cryptonote::block> get_blocks_range(const uint64_t &h1, const uint64_t &h2) const { return std::vector<cryptonote::block>(); }
 	virtual std::vector<crypto::hash> get_hashes_range(const uint64_t &h1, const uint64_t &h2) const { return std::vector<crypto::hash>(); }
 	virtual crypto::hash top_block_hash() const { return crypto::hash(); }
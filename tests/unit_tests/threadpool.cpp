@@ -0,0 +1,169 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+
+#include "common/threadpool.h"
+#include "gtest/gtest.h"
+
+namespace
+{
+void nested_submit(std::atomic<int> &leaves, int depth)
+{
+	if(depth == 0)
+	{
+		leaves++;
+		return;
+	}
+
+	tools::threadpool::waiter waiter;
+	for(int i = 0; i < 4; i++)
+		tools::threadpool::getInstance().submit(&waiter, [&leaves, depth] { nested_submit(leaves, depth - 1); });
+	waiter.wait();
+}
+}
+
+TEST(threadpool, wait_all)
+{
+	tools::threadpool &tpool = tools::threadpool::getInstance();
+	std::vector<int> results(1000, 0);
+	tools::threadpool::waiter waiter;
+	for(size_t i = 0; i < results.size(); i++)
+		tpool.submit(&waiter, [&results, i] { results[i] = (int)i + 1; });
+	waiter.wait();
+
+	for(size_t i = 0; i < results.size(); i++)
+		ASSERT_EQ(results[i], (int)i + 1);
+}
+
+TEST(threadpool, nested_wait)
+{
+	// Deeper than the pool is wide, every worker ends up waiting on its own subtasks
+	std::atomic<int> leaves(0);
+	nested_submit(leaves, 5);
+	ASSERT_EQ(leaves, 4 * 4 * 4 * 4 * 4);
+}
+
+TEST(threadpool, large_task)
+{
+	struct large_task
+	{
+		char payload[tools::threadpool::task::inline_size * 2];
+		std::atomic<int> *count;
+		void operator()() { (*count)++; }
+	};
+
+	std::atomic<int> count(0);
+	large_task t;
+	t.count = &count;
+	tools::threadpool::waiter waiter;
+	for(int i = 0; i < 10; i++)
+		tools::threadpool::getInstance().submit(&waiter, t);
+	waiter.wait();
+	ASSERT_EQ(count, 10);
+}
+
+TEST(threadpool, stats)
+{
+	tools::threadpool &tpool = tools::threadpool::getInstance();
+	tools::threadpool::stats before = tpool.get_stats();
+	{
+		tools::threadpool::waiter waiter;
+		for(int i = 0; i < 100; i++)
+			tpool.submit(&waiter, [] {});
+		waiter.wait();
+	}
+	tools::threadpool::stats after = tpool.get_stats();
+	ASSERT_EQ(after.submitted - before.submitted, 100u);
+	ASSERT_LE(after.executed - before.executed, 100u);
+}
+
+TEST(threadpool, wait_runs_only_own_tasks)
+{
+	// With the workers busy, a waiting thread must not pick up tasks of another waiter
+	tools::threadpool &tpool = tools::threadpool::getInstance();
+	const int workers = tpool.get_max_concurrency();
+	std::atomic<bool> release(false);
+	std::atomic<int> blocked(0);
+	tools::threadpool::waiter busy;
+	for(int i = 0; i < workers; i++)
+		tpool.submit(&busy, [&] { blocked++; while(!release) std::this_thread::yield(); });
+	while(blocked != workers)
+		std::this_thread::yield();
+
+	const std::thread::id self = std::this_thread::get_id();
+	std::atomic<int> foreign_on_self(0);
+	tools::threadpool::waiter other;
+	for(int i = 0; i < 16; i++)
+		tpool.submit(&other, [&] { if(std::this_thread::get_id() == self) foreign_on_self++; });
+
+	std::atomic<int> own(0);
+	tools::threadpool::waiter waiter;
+	for(int i = 0; i < 16; i++)
+		tpool.submit(&waiter, [&] { own++; });
+	waiter.wait();
+	ASSERT_EQ(16, own);
+	ASSERT_EQ(0, foreign_on_self);
+
+	release = true;
+	busy.wait();
+	other.wait();
+}
+
+TEST(threadpool, throwing_task_releases_waiter)
+{
+	tools::threadpool::waiter waiter;
+	std::atomic<int> count(0);
+	tools::threadpool::getInstance().submit(&waiter, [] { throw std::runtime_error("task failed"); });
+	for(int i = 0; i < 10; i++)
+		tools::threadpool::getInstance().submit(&waiter, [&count] { count++; });
+	// the exception surfaces here if this thread ran the task, the wait has to finish either way
+	try
+	{
+		waiter.wait();
+	}
+	catch(const std::runtime_error &)
+	{
+		waiter.wait();
+	}
+	ASSERT_EQ(10, count);
+}
@@ -0,0 +1,127 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "cryptonote_config.h"
+#include "wallet/transfer_index.h"
+
+namespace
+{
+// the check wallet2::is_transfer_unlocked did before it used the index
+bool unlocked_linear(uint64_t height, uint64_t unlock_time, uint64_t block_height)
+{
+	return height - 1 + CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_BLOCKS >= unlock_time &&
+		block_height + CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE <= height;
+}
+}
+
+TEST(transfer_index, unlock_height)
+{
+	for(uint64_t height = 1; height < 40; ++height)
+		for(uint64_t unlock_time = 0; unlock_time < 40; ++unlock_time)
+			for(uint64_t block_height = 0; block_height < 30; ++block_height)
+				ASSERT_EQ(unlocked_linear(height, unlock_time, block_height), height >= tools::transfer_index::unlock_height(unlock_time, block_height));
+
+	ASSERT_EQ(tools::transfer_index::unlock_height(std::numeric_limits<uint64_t>::max(), 0), std::numeric_limits<uint64_t>::max() - CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_BLOCKS + 1);
+}
+
+TEST(transfer_index, balances)
+{
+	tools::transfer_index index;
+	index.insert(0, {0, 0}, 10, 100);
+	index.insert(1, {0, 1}, 20, 100);
+	index.insert(2, {0, 1}, 30, 110);
+	index.insert(3, {1, 0}, 40, 100);
+
+	std::map<uint32_t, uint64_t> balance = index.balance_per_subaddress(0);
+	ASSERT_EQ(balance.size(), 2);
+	ASSERT_EQ(balance[0], 10);
+	ASSERT_EQ(balance[1], 50);
+	ASSERT_EQ(index.balance_per_subaddress(1)[0], 40);
+	ASSERT_TRUE(index.balance_per_subaddress(2).empty());
+
+	ASSERT_TRUE(index.unlocked_balance_per_subaddress(0, 99).empty());
+	balance = index.unlocked_balance_per_subaddress(0, 100);
+	ASSERT_EQ(balance.size(), 2);
+	ASSERT_EQ(balance[0], 10);
+	ASSERT_EQ(balance[1], 20);
+	ASSERT_EQ(index.unlocked_balance_per_subaddress(0, 110)[1], 50);
+
+	index.erase(1);
+	index.erase(1);
+	ASSERT_EQ(index.size(), 3);
+	ASSERT_EQ(index.balance_per_subaddress(0)[1], 30);
+	ASSERT_EQ(index.unlocked_balance_per_subaddress(0, 100).count(1), 0);
+
+	// outputs that change in place are reindexed
+	index.insert(2, {0, 0}, 35, 90);
+	ASSERT_EQ(index.size(), 3);
+	balance = index.balance_per_subaddress(0);
+	ASSERT_EQ(balance.size(), 1);
+	ASSERT_EQ(balance[0], 45);
+	ASSERT_EQ(index.unlocked_balance_per_subaddress(0, 90)[0], 35);
+}
+
+TEST(transfer_index, unlocked_outputs)
+{
+	tools::transfer_index index;
+	index.insert(5, {0, 2}, 1, 100);
+	index.insert(1, {0, 1}, 1, 105);
+	index.insert(3, {0, 2}, 1, 90);
+	index.insert(0, {0, 1}, 1, 90);
+	index.insert(4, {1, 1}, 1, 90);
+
+	ASSERT_EQ(index.unlocked_outputs(0, {}, 100), std::vector<size_t>({0, 3, 5}));
+	ASSERT_EQ(index.unlocked_outputs(0, {1}, 200), std::vector<size_t>({0, 1}));
+	ASSERT_EQ(index.unlocked_outputs(0, {1, 7}, 95), std::vector<size_t>({0}));
+	ASSERT_TRUE(index.unlocked_outputs(2, {}, 200).empty());
+	ASSERT_EQ(index.unlocked_outputs(200), std::vector<size_t>({0, 1, 3, 4, 5}));
+
+	// a reorg drops the most recent outputs
+	index.resize(3);
+	ASSERT_EQ(index.size(), 2);
+	ASSERT_EQ(index.unlocked_outputs(200), std::vector<size_t>({0, 1}));
+	ASSERT_TRUE(index.balance_per_subaddress(1).empty());
+
+	index.clear();
+	ASSERT_EQ(index.size(), 0);
+	ASSERT_TRUE(index.unlocked_outputs(200).empty());
+}
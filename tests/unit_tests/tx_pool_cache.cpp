@@ -0,0 +1,286 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_core/tx_pool_cache.h"
+
+using namespace cryptonote;
+
+namespace
+{
+crypto::hash make_hash(uint8_t n)
+{
+	crypto::hash h = crypto::null_hash;
+	h.data[0] = n;
+	return h;
+}
+
+crypto::key_image make_key_image(uint8_t n)
+{
+	crypto::key_image ki = AUTO_VAL_INIT(ki);
+	ki.data[0] = n;
+	return ki;
+}
+
+// a transaction of roughly extra_size bytes, told apart by its unlock time
+transaction make_tx(uint64_t unlock_time, size_t extra_size)
+{
+	transaction tx;
+	tx.version = 1;
+	tx.unlock_time = unlock_time;
+	tx.extra.resize(extra_size, 0x55);
+	return tx;
+}
+
+// a transaction spending the given key images
+transaction make_spending_tx(std::initializer_list<uint8_t> key_images)
+{
+	transaction tx;
+	tx.version = 1;
+	for(uint8_t n : key_images)
+	{
+		txin_to_key in;
+		in.k_image = make_key_image(n);
+		tx.vin.push_back(in);
+	}
+	return tx;
+}
+
+size_t cached_size(uint64_t unlock_time, size_t extra_size)
+{
+	parsed_tx_cache cache;
+	transaction tx = make_tx(unlock_time, extra_size);
+	cache.add(get_transaction_hash(tx), tx, 0);
+	return cache.size();
+}
+}
+
+TEST(parsed_tx_cache, hit)
+{
+	parsed_tx_cache cache;
+	transaction tx = make_tx(1, 100);
+	const crypto::hash id = get_transaction_hash(tx);
+	const parsed_tx_ptr added = cache.add(id, tx, t_serializable_object_to_blob(tx).size());
+
+	const parsed_tx_ptr ptx = cache.get(id);
+	ASSERT_TRUE(ptx != nullptr);
+	ASSERT_EQ(ptx, added);
+	ASSERT_EQ(get_transaction_hash(ptx->tx), id);
+	ASSERT_EQ(ptx->blob_size, t_serializable_object_to_blob(tx).size());
+	ASSERT_EQ(cache.count(), 1);
+	ASSERT_EQ(cache.size(), ptx->mem_size());
+}
+
+TEST(parsed_tx_cache, miss)
+{
+	parsed_tx_cache cache;
+	transaction tx = make_tx(1, 100);
+	ASSERT_TRUE(cache.get(get_transaction_hash(tx)) == nullptr);
+
+	cache.add(get_transaction_hash(tx), tx, 0);
+	ASSERT_TRUE(cache.get(get_transaction_hash(make_tx(2, 100))) == nullptr);
+	ASSERT_EQ(cache.count(), 1);
+}
+
+TEST(parsed_tx_cache, accounts_parsed_memory)
+{
+	// the parsed form is counted, not the blob size the caller passed
+	const size_t small = cached_size(1, 100);
+	const size_t large = cached_size(1, 100100);
+	ASSERT_GT(small, sizeof(parsed_tx));
+	ASSERT_GE(large - small, 100000);
+
+	parsed_tx_cache cache;
+	transaction tx = make_tx(1, 100);
+	const crypto::hash id = get_transaction_hash(tx);
+	const parsed_tx_ptr ptx = cache.add(id, tx, 0);
+	const std::string &json = cache.get_json(ptx);
+	ASSERT_FALSE(json.empty());
+	ASSERT_EQ(cache.size(), small + json.size());
+}
+
+TEST(parsed_tx_cache, eviction)
+{
+	const size_t entry_size = cached_size(0, 1000);
+	parsed_tx_cache cache(3 * entry_size);
+
+	crypto::hash ids[5];
+	for(size_t n = 0; n < 3; ++n)
+	{
+		transaction tx = make_tx(n, 1000);
+		ids[n] = get_transaction_hash(tx);
+		cache.add(ids[n], tx, 0);
+	}
+	ASSERT_EQ(cache.count(), 3);
+
+	// using the oldest entry makes the second one the least recently used
+	ASSERT_TRUE(cache.get(ids[0]) != nullptr);
+	transaction tx = make_tx(3, 1000);
+	ids[3] = get_transaction_hash(tx);
+	cache.add(ids[3], tx, 0);
+	ASSERT_EQ(cache.count(), 3);
+	ASSERT_TRUE(cache.get(ids[1]) == nullptr);
+	ASSERT_TRUE(cache.get(ids[0]) != nullptr);
+	ASSERT_TRUE(cache.get(ids[2]) != nullptr);
+	ASSERT_TRUE(cache.get(ids[3]) != nullptr);
+	ASSERT_LE(cache.size(), 3 * entry_size);
+
+	// a transaction larger than the whole cache is handed back but not kept
+	tx = make_tx(4, 4000);
+	ids[4] = get_transaction_hash(tx);
+	const parsed_tx_ptr ptx = cache.add(ids[4], tx, 0);
+	ASSERT_TRUE(ptx != nullptr);
+	ASSERT_EQ(ptx->tx.extra.size(), 4000);
+	ASSERT_TRUE(cache.get(ids[4]) == nullptr);
+	ASSERT_EQ(cache.count(), 0);
+	ASSERT_EQ(cache.size(), 0);
+}
+
+TEST(parsed_tx_cache, forget)
+{
+	parsed_tx_cache cache;
+	transaction tx0 = make_tx(0, 100), tx1 = make_tx(1, 200);
+	const crypto::hash id0 = get_transaction_hash(tx0), id1 = get_transaction_hash(tx1);
+	cache.add(id0, tx0, 0);
+	const size_t size0 = cache.size();
+	const parsed_tx_ptr ptx1 = cache.add(id1, tx1, 0);
+	cache.get_json(ptx1);
+
+	cache.forget(id1);
+	ASSERT_TRUE(cache.get(id1) == nullptr);
+	ASSERT_TRUE(cache.get(id0) != nullptr);
+	ASSERT_EQ(cache.count(), 1);
+	ASSERT_EQ(cache.size(), size0);
+
+	// forgetting an unknown transaction is a no-op, the caller's copy stays usable
+	cache.forget(id1);
+	ASSERT_EQ(cache.count(), 1);
+	ASSERT_EQ(ptx1->tx.extra.size(), 200);
+
+	cache.forget(id0);
+	ASSERT_EQ(cache.count(), 0);
+	ASSERT_EQ(cache.size(), 0);
+}
+
+namespace
+{
+typedef std::unordered_set<crypto::key_image> spent_set;
+}
+
+TEST(template_candidate_cache, carried_over_to_new_block)
+{
+	template_candidate_cache candidates;
+	const crypto::hash a = make_hash(1), b = make_hash(2), c = make_hash(3);
+	candidates.set(make_hash(10), make_spending_tx({1, 2}), 100, 5, true, a, 7);
+	candidates.set(make_hash(11), make_spending_tx({3}), 100, 5, false, crypto::null_hash, 7);
+	ASSERT_EQ(candidates.find(make_hash(10))->key_images.size(), 2);
+
+	candidates.on_block_added(a, b, 7, spent_set());
+	ASSERT_TRUE(candidates.find(make_hash(10))->is_current(b, 7));
+	ASSERT_FALSE(candidates.find(make_hash(11))->is_current(b, 7));
+
+	// a fork switch makes every verdict stale
+	candidates.on_block_added(b, c, 8, spent_set());
+	ASSERT_FALSE(candidates.find(make_hash(10))->is_current(c, 8));
+}
+
+TEST(template_candidate_cache, dropped_when_key_image_spent)
+{
+	template_candidate_cache candidates;
+	const crypto::hash a = make_hash(1), b = make_hash(2), c = make_hash(3);
+	candidates.set(make_hash(10), make_spending_tx({1, 2}), 100, 5, true, a, 7);
+	candidates.set(make_hash(11), make_spending_tx({3}), 100, 5, true, a, 7);
+
+	spent_set block_b;
+	block_b.insert(make_key_image(2));
+	candidates.on_block_added(a, b, 7, block_b);
+	ASSERT_FALSE(candidates.find(make_hash(10))->is_current(b, 7));
+	ASSERT_TRUE(candidates.find(make_hash(11))->is_current(b, 7));
+
+	// the dropped candidate is not revived by the next block either
+	candidates.on_block_added(b, c, 7, spent_set());
+	ASSERT_FALSE(candidates.find(make_hash(10))->is_current(c, 7));
+	ASSERT_TRUE(candidates.find(make_hash(11))->is_current(c, 7));
+}
+
+TEST(template_candidate_cache, dropped_on_reorg)
+{
+	template_candidate_cache candidates;
+	const crypto::hash a = make_hash(1), b = make_hash(2), b2 = make_hash(3);
+	candidates.set(make_hash(10), make_spending_tx({1}), 100, 5, true, a, 7);
+	candidates.on_block_added(a, b, 7, spent_set());
+	ASSERT_TRUE(candidates.find(make_hash(10))->is_current(b, 7));
+
+	// popping b leaves a on top, but the verdict may rely on b and is rechecked
+	candidates.on_blocks_removed();
+	ASSERT_FALSE(candidates.find(make_hash(10))->is_current(a, 7));
+	ASSERT_FALSE(candidates.find(make_hash(10))->is_current(b, 7));
+
+	candidates.on_block_added(a, b2, 7, spent_set());
+	ASSERT_FALSE(candidates.find(make_hash(10))->is_current(b2, 7));
+}
+
+TEST(template_candidate_cache, dropped_on_pool_removal)
+{
+	template_candidate_cache candidates;
+	const crypto::hash a = make_hash(1);
+	candidates.set(make_hash(10), make_spending_tx({1}), 100, 5, true, a, 7);
+	candidates.set(make_hash(11), make_spending_tx({2}), 100, 5, true, a, 7);
+	ASSERT_EQ(candidates.size(), 2);
+
+	candidates.erase(make_hash(10));
+	ASSERT_TRUE(candidates.find(make_hash(10)) == nullptr);
+	ASSERT_TRUE(candidates.find(make_hash(11)) != nullptr);
+	ASSERT_EQ(candidates.size(), 1);
+
+	// a transaction coming back gets an empty candidate, which fill_block_template reloads
+	const template_candidate &candidate = candidates[make_hash(10)];
+	ASSERT_EQ(candidate.blob_size, 0);
+	ASSERT_TRUE(candidate.key_images.empty());
+	ASSERT_FALSE(candidate.is_current(a, 7));
+
+	candidates.clear();
+	ASSERT_EQ(candidates.size(), 0);
+}
@@ -0,0 +1,247 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <boost/filesystem.hpp>
+
+#include "gtest/gtest.h"
+
+#include "file_io_utils.h"
+#include "string_tools.h"
+#include "wallet/wallet2.h"
+
+namespace
+{
+const char *spendkey_hex = "ee0085dbecc26a02415b0b7abab1ce0ef2b18a393d35e39ef5720dd5ba058806";
+// The subaddress table is only journaled when it grows, a large one keeps the
+// cache file big enough for a few records before the journal gets compacted
+const uint32_t subaddress_lookahead = 200;
+
+class wallet_cache_journal : public ::testing::Test
+{
+  protected:
+	wallet_cache_journal()
+	{
+		dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+		boost::filesystem::create_directories(dir);
+		wallet_file = (dir / "wallet").string();
+		journal_file = wallet_file + ".journal";
+	}
+
+	~wallet_cache_journal()
+	{
+		boost::system::error_code ec;
+		boost::filesystem::remove_all(dir, ec);
+	}
+
+	void generate(tools::wallet2 &w)
+	{
+		crypto::secret_key spendkey;
+		epee::string_tools::hex_to_pod(spendkey_hex, spendkey);
+		w.init("");
+		w.set_subaddress_lookahead(1, subaddress_lookahead);
+		w.generate_legacy(wallet_file, "", spendkey);
+	}
+
+	void load(tools::wallet2 &w)
+	{
+		w.init("");
+		w.set_subaddress_lookahead(1, subaddress_lookahead);
+		w.load(wallet_file, "");
+	}
+
+	// stores small changes until the journal outgrows the cache file and is folded back into it
+	size_t store_until_compacted(tools::wallet2 &w)
+	{
+		size_t stores = 0;
+		while(boost::filesystem::exists(journal_file) && stores < 1000)
+		{
+			w.set_attribute("filler" + std::to_string(stores), std::string(64, 'x'));
+			w.store();
+			++stores;
+		}
+		return stores;
+	}
+
+	std::string read_journal()
+	{
+		std::string buf;
+		EXPECT_TRUE(epee::file_io_utils::load_file_to_string(journal_file, buf));
+		return buf;
+	}
+
+	boost::filesystem::path dir;
+	std::string wallet_file;
+	std::string journal_file;
+};
+
+crypto::hash make_txid(uint8_t n)
+{
+	crypto::hash h = crypto::null_hash;
+	h.data[0] = n;
+	return h;
+}
+}
+
+TEST_F(wallet_cache_journal, append_and_replay)
+{
+	{
+		tools::wallet2 w(cryptonote::TESTNET);
+		generate(w);
+		ASSERT_FALSE(boost::filesystem::exists(journal_file));
+		const uint64_t cache_size = boost::filesystem::file_size(wallet_file);
+
+		w.set_attribute("first", "1");
+		w.store();
+		ASSERT_TRUE(boost::filesystem::exists(journal_file));
+		const uint64_t journal_size = boost::filesystem::file_size(journal_file);
+
+		w.set_tx_note(make_txid(1), "note");
+		w.set_attribute("second", "2");
+		w.store();
+		ASSERT_GT(boost::filesystem::file_size(journal_file), journal_size);
+
+		// the cache file itself is left alone
+		ASSERT_EQ(cache_size, boost::filesystem::file_size(wallet_file));
+	}
+
+	tools::wallet2 w(cryptonote::TESTNET);
+	load(w);
+	ASSERT_EQ("1", w.get_attribute("first"));
+	ASSERT_EQ("note", w.get_tx_note(make_txid(1)));
+	ASSERT_EQ("2", w.get_attribute("second"));
+
+	// replayed records are appended to, not rewritten
+	const uint64_t journal_size = boost::filesystem::file_size(journal_file);
+	w.set_attribute("third", "3");
+	w.store();
+	ASSERT_GT(boost::filesystem::file_size(journal_file), journal_size);
+
+	tools::wallet2 w2(cryptonote::TESTNET);
+	load(w2);
+	ASSERT_EQ("1", w2.get_attribute("first"));
+	ASSERT_EQ("3", w2.get_attribute("third"));
+}
+
+TEST_F(wallet_cache_journal, torn_tail_is_dropped)
+{
+	{
+		tools::wallet2 w(cryptonote::TESTNET);
+		generate(w);
+		w.set_attribute("first", "1");
+		w.store();
+		w.set_attribute("second", "2");
+		w.store();
+	}
+
+	// a record cut short by a crash is dropped, the ones before it are kept
+	boost::filesystem::resize_file(journal_file, boost::filesystem::file_size(journal_file) - 5);
+
+	{
+		tools::wallet2 w(cryptonote::TESTNET);
+		load(w);
+		ASSERT_EQ("1", w.get_attribute("first"));
+		ASSERT_EQ("", w.get_attribute("second"));
+
+		// nothing may be appended after the garbage, the next store writes the full cache
+		w.set_attribute("third", "3");
+		w.store();
+		ASSERT_FALSE(boost::filesystem::exists(journal_file));
+	}
+
+	tools::wallet2 w(cryptonote::TESTNET);
+	load(w);
+	ASSERT_EQ("1", w.get_attribute("first"));
+	ASSERT_EQ("", w.get_attribute("second"));
+	ASSERT_EQ("3", w.get_attribute("third"));
+}
+
+TEST_F(wallet_cache_journal, records_of_another_cache_file_are_ignored)
+{
+	std::string old_journal;
+	{
+		tools::wallet2 w(cryptonote::TESTNET);
+		generate(w);
+		w.set_attribute("value", "old");
+		w.store();
+		old_journal = read_journal();
+
+		w.set_attribute("value", "new");
+		ASSERT_GT(store_until_compacted(w), 0);
+		ASSERT_FALSE(boost::filesystem::exists(journal_file));
+	}
+
+	// a journal left over from before the last full store does not match the cache file's IV
+	ASSERT_TRUE(epee::file_io_utils::save_string_to_file(journal_file, old_journal));
+
+	tools::wallet2 w(cryptonote::TESTNET);
+	load(w);
+	ASSERT_EQ("new", w.get_attribute("value"));
+
+	w.set_attribute("other", "1");
+	w.store();
+	ASSERT_FALSE(boost::filesystem::exists(journal_file));
+}
+
+TEST_F(wallet_cache_journal, compaction)
+{
+	size_t stores;
+	{
+		tools::wallet2 w(cryptonote::TESTNET);
+		generate(w);
+		w.set_attribute("first", "1");
+		w.store();
+		stores = store_until_compacted(w);
+		ASSERT_GT(stores, 0);
+		ASSERT_LE(stores, 100);
+		ASSERT_FALSE(boost::filesystem::exists(journal_file));
+
+		// the journal is armed again against the new cache file
+		w.set_attribute("last", "2");
+		w.store();
+		ASSERT_TRUE(boost::filesystem::exists(journal_file));
+	}
+
+	tools::wallet2 w(cryptonote::TESTNET);
+	load(w);
+	ASSERT_EQ("1", w.get_attribute("first"));
+	for(size_t i = 0; i < stores; ++i)
+		ASSERT_EQ(std::string(64, 'x'), w.get_attribute("filler" + std::to_string(i)));
+	ASSERT_EQ("2", w.get_attribute("last"));
+}
@@ -0,0 +1,238 @@
+// Copyright (c) 2020, Ryo Currency Project
+//
+// Authors and copyright holders give permission for following:
+//
+// 1. Redistribution and use in source and binary forms WITHOUT modification.
+//
+// 2. Modification of the source form for your own personal use.
+//
+// As long as the following conditions are met:
+//
+// 3. You must not distribute modified copies of the work to third parties. This includes
+//    posting the work online, or hosting copies of the modified work for download.
+//
+// 4. Any derivative version of this work is also covered by this license, including point 8.
+//
+// 5. Neither the name of the copyright holders nor the names of the authors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// 6. You agree that this licence is governed by and shall be construed in accordance
+//    with the laws of England and Wales.
+//
+// 7. You agree to submit all disputes arising out of or in connection with this licence
+//    to the exclusive jurisdiction of the Courts of England and Wales.
+//
+// Authors and copyright holders agree that:
+//
+// 8. This licence expires and the work covered by it is released into the
+//    public domain on 1st of February 2021
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <ctime>
+
+#include "gtest/gtest.h"
+
+#include "cryptonote_core/cryptonote_tx_utils.h"
+#include "ringct/rctOps.h"
+#include "wallet/wallet2.h"
+
+// Runs the per wallet half of wallet2::refresh_shared on a synthetic chunk
+class wallet_shared_refresh : public ::testing::Test
+{
+  protected:
+	typedef tools::wallet2::wallet_rpc_scan_data scan_data;
+
+	wallet_shared_refresh() : chunk(new scan_data)
+	{
+		w1.set_subaddress_lookahead(1, 10);
+		w2.set_subaddress_lookahead(1, 10);
+		w1.generate_legacy("", "", rct::rct2sk(rct::skGen()));
+		w2.generate_legacy("", "", rct::rct2sk(rct::skGen()));
+		nobody.recover_legacy(rct::rct2sk(rct::skGen()));
+
+		// chunks start with a block the wallets have, here the genesis block
+		cryptonote::block genesis;
+		w1.generate_genesis(genesis);
+		chunk->blocks_start_height = 0;
+		global_outputs = 0;
+		append(genesis);
+	}
+
+	void append(const cryptonote::block &b)
+	{
+		cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::tx_output_indices miner_indices;
+		for(size_t i = 0; i < b.miner_tx.vout.size(); i++)
+			miner_indices.indices.push_back(global_outputs++);
+		cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices indices;
+		indices.indices.push_back(miner_indices);
+
+		chunk->blocks_bin.emplace_back(cryptonote::block_to_blob(b), std::vector<cryptonote::blobdata>());
+		chunk->o_indices.push_back(indices);
+		block_hashes.push_back(cryptonote::get_block_hash(b));
+	}
+
+	// appends a block whose miner tx pays to the given wallet, or to nobody
+	void add_block(const tools::wallet2 *payee)
+	{
+		cryptonote::block b;
+		w1.generate_genesis(b);
+		b.timestamp = time(nullptr);
+		b.prev_id = block_hashes.back();
+		const cryptonote::account_public_address &address = payee ? payee->get_account().get_keys().m_account_address : nobody.get_keys().m_account_address;
+		ASSERT_TRUE(cryptonote::construct_miner_tx(cryptonote::MAINNET, block_hashes.size(), 0, 0, 0, 0, address, b.miner_tx));
+		append(b);
+	}
+
+	// parses the chunk once for all the wallets, as refresh_shared does
+	void parse(std::initializer_list<const tools::wallet2 *> wallets)
+	{
+		tools::wallet2::block_skip_filter filter(**wallets.begin());
+		for(const tools::wallet2 *w : wallets)
+			filter.merge(tools::wallet2::block_skip_filter(*w));
+
+		chunk->blocks_parsed.resize(chunk->blocks_bin.size());
+		size_t in_count = tools::wallet2::block_parse_range(*chunk, filter, 0, chunk->blocks_bin.size());
+		tools::wallet2::block_parse_key_images(*chunk, in_count);
+	}
+
+	// scans the parsed chunk with the wallet's own filter and integrates what it found
+	std::vector<bool> scan(tools::wallet2 &w)
+	{
+		tools::wallet2::refresh_stage_counters stats[tools::wallet2::RefreshStageCount];
+		tools::wallet2::wallet_refresh_ctx rctx(stats, 1, 1, 1);
+		tools::wallet2::wallet_scan_ctx ctx(w, rctx);
+		tools::wallet2::block_scan_batch batch;
+		scan_data::scan_result res;
+		w.block_scan_chunk(ctx, *chunk, batch, res);
+		w.integrate_scanned_result(*chunk, res);
+		return res.skipped;
+	}
+
+	// runs the scanner over a single tx and returns the key images it took
+	std::unordered_set<crypto::key_image> scan_key_images(tools::wallet2 &w, const cryptonote::transaction &tx)
+	{
+		tools::wallet2::refresh_stage_counters stats[tools::wallet2::RefreshStageCount];
+		tools::wallet2::wallet_refresh_ctx rctx(stats, 1, 1, 1);
+		tools::wallet2::wallet_scan_ctx ctx(w, rctx);
+		tools::wallet2::block_scan_batch batch;
+		std::unordered_set<crypto::key_image> inc_kimg;
+		if(w.block_scan_prepare_tx(cryptonote::get_transaction_hash(tx), tx, batch))
+			w.block_scan_run(ctx, batch, inc_kimg);
+		return inc_kimg;
+	}
+
+	// makes the wallet already have the chunk up to the given height
+	void sync(tools::wallet2 &w, size_t height)
+	{
+		for(size_t i = 1; i <= height; i++)
+		{
+			w.m_blockchain.push_back(block_hashes[i]);
+			++w.m_local_bc_height;
+		}
+	}
+
+	static const crypto::hash &chain_hash(const tools::wallet2 &w, size_t height) { return w.m_blockchain[height]; }
+
+	bool parsed(size_t idx) const { return !chunk->blocks_parsed[idx].skipped; }
+
+	std::vector<uint64_t> transfer_heights(const tools::wallet2 &w) const
+	{
+		std::vector<uint64_t> heights;
+		for(size_t i = 0; i < w.get_num_transfer_details(); i++)
+			heights.push_back(w.get_transfer_details(i).m_block_height);
+		return heights;
+	}
+
+	tools::wallet2 w1, w2;
+	cryptonote::account_base nobody;
+	std::unique_ptr<scan_data> chunk;
+	std::vector<crypto::hash> block_hashes;
+	uint64_t global_outputs;
+};
+
+TEST_F(wallet_shared_refresh, wallets_at_different_heights_share_a_chunk)
+{
+	// w2 already has blocks 1 - 3
+	for(const tools::wallet2 *payee : {&w2, &w1, (tools::wallet2 *)nullptr, &w2, &w1, &w2})
+		add_block(payee);
+	sync(w2, 3);
+	parse({&w1, &w2});
+
+	ASSERT_EQ(scan(w1), std::vector<bool>({true, false, false, false, false, false, false}));
+	ASSERT_EQ(scan(w2), std::vector<bool>({true, true, true, true, false, false, false}));
+
+	ASSERT_EQ(transfer_heights(w1), std::vector<uint64_t>({2, 5}));
+	ASSERT_EQ(transfer_heights(w2), std::vector<uint64_t>({4, 6}));
+	ASSERT_EQ(w1.get_blockchain_current_height(), 7);
+	ASSERT_EQ(w2.get_blockchain_current_height(), 7);
+	for(size_t i = 0; i < block_hashes.size(); i++)
+	{
+		ASSERT_EQ(chain_hash(w1, i), block_hashes[i]);
+		ASSERT_EQ(chain_hash(w2, i), block_hashes[i]);
+	}
+}
+
+TEST_F(wallet_shared_refresh, own_filter_skips_blocks_the_merged_filter_kept)
+{
+	// w2 skips blocks below height 4, w1 needs everything
+	w2.explicit_refresh_from_block_height(false);
+	w2.set_refresh_from_block_height(4);
+	for(const tools::wallet2 *payee : {&w1, &w2, &w1, (tools::wallet2 *)nullptr, &w2})
+		add_block(payee);
+	parse({&w1, &w2});
+	for(size_t i = 1; i <= 5; i++)
+		ASSERT_TRUE(parsed(i));
+
+	ASSERT_EQ(scan(w1), std::vector<bool>({true, false, false, false, false, false}));
+	ASSERT_EQ(scan(w2), std::vector<bool>({true, true, true, true, false, false}));
+
+	// the output below w2's refresh height is not picked up, the block hash still is
+	ASSERT_EQ(transfer_heights(w1), std::vector<uint64_t>({1, 3}));
+	ASSERT_EQ(transfer_heights(w2), std::vector<uint64_t>({5}));
+	ASSERT_EQ(w2.get_blockchain_current_height(), 6);
+	ASSERT_EQ(chain_hash(w2, 2), block_hashes[2]);
+}
+
+TEST_F(wallet_shared_refresh, blocks_already_in_chain_are_skipped)
+{
+	for(const tools::wallet2 *payee : {(tools::wallet2 *)nullptr, &w1, &w1, (tools::wallet2 *)nullptr, &w1})
+		add_block(payee);
+	sync(w1, 3);
+	parse({&w1});
+
+	ASSERT_EQ(scan(w1), std::vector<bool>({true, true, true, true, false, false}));
+	ASSERT_EQ(transfer_heights(w1), std::vector<uint64_t>({5}));
+	ASSERT_EQ(w1.get_blockchain_current_height(), 6);
+
+	// scanning the chunk again finds it all in the chain
+	ASSERT_EQ(scan(w1), std::vector<bool>(6, true));
+	ASSERT_EQ(transfer_heights(w1), std::vector<uint64_t>({5}));
+	ASSERT_EQ(w1.get_blockchain_current_height(), 6);
+}
+
+TEST_F(wallet_shared_refresh, malformed_tx_yields_no_key_images)
+{
+	cryptonote::transaction tx;
+	ASSERT_TRUE(cryptonote::construct_miner_tx(cryptonote::MAINNET, 1, 0, 0, 0, 0, w1.get_account().get_keys().m_account_address, tx));
+	ASSERT_FALSE(scan_key_images(w1, tx).empty());
+
+	// a single additional tx pubkey for more than one output
+	for(size_t i = 0; i < 2; i++)
+	{
+		cryptonote::tx_out out;
+		out.target = cryptonote::txout_to_key(rct::rct2pk(rct::pkGen()));
+		tx.vout.push_back(out);
+	}
+	ASSERT_TRUE(cryptonote::add_additional_tx_pub_keys_to_extra(tx.extra, {rct::rct2pk(rct::pkGen())}));
+	ASSERT_TRUE(scan_key_images(w1, tx).empty());
+}